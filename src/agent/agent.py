@@ -1,18 +1,476 @@
 import os
+import ctypes
+import hashlib
+import shutil
+import struct
 import subprocess
 import json
+import tempfile
 import time
-from typing import List, Dict, Optional
+from concurrent.futures import ThreadPoolExecutor
+from typing import List, Dict, Optional, Tuple, Union
+
+class AnalyzerServer:
+    """A long-lived `analyzer --serve` process.
+
+    Requests are tab-separated lines; every response is a header line
+    "<id>\t<ok|error>\t<size>" followed by size bytes of payload. Requests
+    can be pipelined: submit() returns an id at once and result() waits for
+    that id's response (the server answers in completion order).
+    """
+
+    def __init__(self, analyzer_path: str, *args: str):
+        self.process = subprocess.Popen(
+            [analyzer_path, "--serve", *args],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE
+        )
+        self._next_id = 0
+        self._responses = {}
+
+    def submit(self, command: str, *paths: str) -> str:
+        """Sends one request and returns its id without waiting."""
+        fields = (command, *paths)
+        if any(c in field for field in fields for c in "\t\r\n"):
+            raise ValueError("request fields cannot contain tabs or newlines")
+        request_id = str(self._next_id)
+        self._next_id += 1
+        line = "\t".join((request_id, *fields)) + "\n"
+        self.process.stdin.write(line.encode("utf-8"))
+        self.process.stdin.flush()
+        return request_id
+
+    def result(self, request_id: str) -> bytes:
+        """Waits for the response to request_id; raises on an error reply."""
+        while request_id not in self._responses:
+            header = self.process.stdout.readline()
+            if not header:
+                raise RuntimeError("analyzer server exited")
+            rid, status, size = header.decode("utf-8").rstrip("\n").split("\t")
+            payload = self.process.stdout.read(int(size))
+            self._responses[rid] = (status == "ok", payload)
+        ok, payload = self._responses.pop(request_id)
+        if not ok:
+            raise RuntimeError(payload.decode("utf-8", errors="replace"))
+        return payload
+
+    def request(self, command: str, *paths: str) -> bytes:
+        return self.result(self.submit(command, *paths))
+
+    def close(self):
+        if self.process.poll() is None:
+            self.process.stdin.close()  # End of input stops the server
+            self.process.wait()
+
+
+class _AnalyzerOptions(ctypes.Structure):
+    _fields_ = [("entropy_window", ctypes.c_size_t),
+                ("entropy_stride", ctypes.c_size_t),
+                ("threads", ctypes.c_size_t),
+                ("pattern_top_k", ctypes.c_size_t),
+                ("period_top_k", ctypes.c_size_t),
+                ("cache_dir", ctypes.c_char_p)]
+
+
+class _AnalyzerPattern(ctypes.Structure):
+    _fields_ = [("length", ctypes.c_size_t),
+                ("bytes", ctypes.c_uint8 * 16),
+                ("count", ctypes.c_size_t),
+                ("first_offset", ctypes.c_size_t),
+                ("period", ctypes.c_size_t),
+                ("period_count", ctypes.c_size_t),
+                ("histogram", ctypes.c_uint32 * 16)]
+
+
+class _AnalyzerPeriod(ctypes.Structure):
+    _fields_ = [("period", ctypes.c_size_t), ("score", ctypes.c_float)]
+
+
+class _AnalyzerRegion(ctypes.Structure):
+    _fields_ = [("offset", ctypes.c_uint64), ("size", ctypes.c_uint64),
+                ("kind", ctypes.c_char_p), ("entropy", ctypes.c_float)]
+
+
+class _AnalyzerSizeTerm(ctypes.Structure):
+    _fields_ = [("offset", ctypes.c_uint32), ("width", ctypes.c_uint32),
+                ("big_endian", ctypes.c_int), ("stride", ctypes.c_uint32)]
+
+
+class _AnalyzerSizeSolution(ctypes.Structure):
+    _fields_ = [("header", ctypes.c_uint64), ("terms", ctypes.c_size_t),
+                ("counts", _AnalyzerSizeTerm * 2),
+                ("files", ctypes.c_size_t)]
+
+
+# Region likelihood keys, in the order the library stores them
+ELEMENT_TYPES = ("int16", "int32", "int64", "float16", "float32", "float64")
+
+
+def _phase_table(counts) -> Dict[str, List[List[int]]]:
+    """{width: [[LE, BE] per phase]} from flat [3][8][2] counts."""
+    return {
+        str(width): [[counts[w * 16 + 2 * p], counts[w * 16 + 2 * p + 1]]
+                     for p in range(width)]
+        for w, width in enumerate((2, 4, 8))
+    }
+
+
+def _buffer_pointer(data: Union[bytes, bytearray, memoryview]):
+    """A ctypes pointer to data's bytes and the object that keeps them
+    alive; bytes and writable buffers aren't copied."""
+    if isinstance(data, bytes):
+        return ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p), data
+    view = memoryview(data).cast("B")
+    if view.readonly:
+        view = memoryview(bytearray(view))
+    keep = (ctypes.c_char * len(view)).from_buffer(view)
+    return ctypes.cast(keep, ctypes.c_void_p), keep
+
+
+class AnalyzerResult:
+    """One analysis made in-process; owns its libanalyzer result."""
+
+    def __init__(self, library: "AnalyzerLibrary", handle: int):
+        self._lib = library.lib
+        self._handle = handle
+
+    def close(self):
+        if self._handle:
+            self._lib.analyzer_free(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    @property
+    def size(self) -> int:
+        return self._lib.analyzer_input_size(self._handle)
+
+    @property
+    def entropy(self) -> memoryview:
+        """The entropy map as a float32 memoryview over the result's own
+        storage (no copy); numpy.frombuffer accepts it directly. The view
+        keeps the result alive."""
+        count = ctypes.c_size_t()
+        values = self._lib.analyzer_entropy_map(self._handle,
+                                                ctypes.byref(count))
+        if not count.value:
+            return memoryview(b"").cast("f")
+        array = (ctypes.c_float * count.value).from_address(values)
+        array._owner = self
+        return memoryview(array).cast("B").cast("f")
+
+    @property
+    def alignment(self) -> Dict[str, List[List[int]]]:
+        """Per-phase [little endian, big endian] counts, as --format json."""
+        return _phase_table(self._lib.analyzer_alignment_counts(self._handle))
+
+    @property
+    def floats(self) -> Dict[str, List[List[int]]]:
+        """Plausible half/float32/float64 counts, laid out as alignment."""
+        return _phase_table(self._lib.analyzer_float_counts(self._handle))
+
+    @property
+    def record_stride(self) -> int:
+        return self._lib.analyzer_record_stride(self._handle)
+
+    @property
+    def patterns(self) -> List[Dict]:
+        pattern = _AnalyzerPattern()
+        top = []
+        for i in range(self._lib.analyzer_pattern_count(self._handle)):
+            self._lib.analyzer_get_pattern(self._handle, i,
+                                           ctypes.byref(pattern))
+            top.append({
+                "length": pattern.length,
+                "bytes": bytes(pattern.bytes[:pattern.length]).hex(),
+                "count": pattern.count, "first": pattern.first_offset,
+                "period": pattern.period,
+                "periodCount": pattern.period_count,
+                "histogram": list(pattern.histogram),
+            })
+        return top
+
+    def periods(self, words: bool = False) -> List[Dict]:
+        """Autocorrelation periods of the byte (or 4-byte word) signal."""
+        period = _AnalyzerPeriod()
+        found = []
+        for i in range(self._lib.analyzer_period_count(self._handle, words)):
+            self._lib.analyzer_get_period(self._handle, words, i,
+                                          ctypes.byref(period))
+            found.append({"period": period.period, "score": period.score})
+        return found
+
+    @property
+    def regions(self) -> List[Dict]:
+        """Homogeneous regions covering the input, as --format json."""
+        region = _AnalyzerRegion()
+        found = []
+        for i in range(self._lib.analyzer_region_count(self._handle)):
+            self._lib.analyzer_get_region(self._handle, i,
+                                          ctypes.byref(region))
+            likelihood = self._lib.analyzer_region_likelihood(self._handle, i)
+            found.append({"offset": region.offset, "size": region.size,
+                          "kind": region.kind.decode(),
+                          "entropy": region.entropy,
+                          "likelihood": dict(zip(ELEMENT_TYPES,
+                                                 likelihood[:6]))})
+        return found
+
+    @property
+    def pyramid_levels(self) -> int:
+        return self._lib.analyzer_pyramid_levels(self._handle)
+
+    def pyramid(self, level: int) -> Tuple[int, memoryview]:
+        """Block size and float32 entropy per block of pyramid `level`
+        (0 is 4 KiB blocks, each level up 64 times larger), viewed in
+        place like `entropy`."""
+        block, count = ctypes.c_size_t(), ctypes.c_size_t()
+        values = self._lib.analyzer_pyramid_level(
+            self._handle, level, ctypes.byref(block), ctypes.byref(count))
+        if not values:
+            raise IndexError(f"pyramid level {level} out of range")
+        array = (ctypes.c_float * count.value).from_address(values)
+        array._owner = self
+        return block.value, memoryview(array).cast("B").cast("f")
+
+    def entropy_range(self, begin: int, end: int,
+                      data: Optional[Union[bytes, bytearray,
+                                           memoryview]] = None) -> float:
+        """Entropy of bytes [begin, end) of the input. Buffers aren't kept
+        after analyze(), so unless the range is aligned to 256 KiB pass the
+        same data again; files are read from their mapping."""
+        pointer, keep = _buffer_pointer(data) if data is not None \
+            else (None, b"")
+        entropy = ctypes.c_float()
+        if not self._lib.analyzer_entropy_range(
+                self._handle, pointer, len(keep), begin, end,
+                ctypes.byref(entropy)):
+            raise ValueError("the range needs the input bytes; pass data")
+        return entropy.value
+
+    def zoom(self, begin: int = 0, end: Optional[int] = None,
+             max_cells: int = 64) -> List[Tuple[int, int, float]]:
+        """Bytes [begin, end) at the finest pyramid level that fits in
+        max_cells blocks, as (offset, size, entropy) per block: a large
+        file at a size that suits a prompt."""
+        end = self.size if end is None else min(end, self.size)
+        if begin >= end:
+            return []
+        level = self._lib.analyzer_pyramid_level_for(self._handle, begin,
+                                                     end, max_cells)
+        block, values = self.pyramid(level)
+        cells = []
+        for i in range(begin // block, (end + block - 1) // block):
+            offset = i * block
+            cells.append((offset, min(block, self.size - offset),
+                          values[i]))
+        return cells
+
+    def report(self, format: str = "text") -> bytes:
+        """The report the CLI prints with --format `format`."""
+        code = AnalyzerLibrary.FORMATS[format]
+        size = self._lib.analyzer_report(self._handle, code, None, 0)
+        buffer = ctypes.create_string_buffer(size)
+        self._lib.analyzer_report(self._handle, code, buffer, size)
+        return buffer.raw
+
+
+class AnalyzerLibrary:
+    """libanalyzer (the analyzer's C API, libanalyzer.h) loaded in-process.
+
+    Analyses run on buffers the caller already has, with no process start
+    or report parsing. ctypes releases the GIL for every call, so analyses
+    on several Python threads run in parallel.
+    """
+
+    ABI_VERSION = 1
+    FORMATS = {"text": 0, "json": 1, "msgpack": 2, "bin": 3}
+    NAMES = ("libanalyzer.so", "libanalyzer.dylib", "analyzer.dll")
+
+    def __init__(self, path: str):
+        lib = ctypes.CDLL(path)
+        handle, size = ctypes.c_void_p, ctypes.c_size_t
+        options = ctypes.POINTER(_AnalyzerOptions)
+        signatures = {
+            "analyzer_abi_version": (ctypes.c_uint32, []),
+            "analyzer_default_options": (None, [options]),
+            "analyzer_analyze_buffer":
+                (handle, [ctypes.c_void_p, size, ctypes.c_char_p, options]),
+            "analyzer_analyze_file": (handle, [ctypes.c_char_p, options]),
+            "analyzer_free": (None, [handle]),
+            "analyzer_input_size": (ctypes.c_uint64, [handle]),
+            "analyzer_entropy_map":
+                (ctypes.c_void_p, [handle, ctypes.POINTER(size)]),
+            "analyzer_alignment_counts": (ctypes.POINTER(size), [handle]),
+            "analyzer_float_counts": (ctypes.POINTER(size), [handle]),
+            "analyzer_record_stride": (size, [handle]),
+            "analyzer_pattern_count": (size, [handle]),
+            "analyzer_get_pattern":
+                (ctypes.c_int, [handle, size,
+                                ctypes.POINTER(_AnalyzerPattern)]),
+            "analyzer_period_count": (size, [handle, ctypes.c_int]),
+            "analyzer_get_period":
+                (ctypes.c_int, [handle, ctypes.c_int, size,
+                                ctypes.POINTER(_AnalyzerPeriod)]),
+            "analyzer_region_count": (size, [handle]),
+            "analyzer_get_region":
+                (ctypes.c_int, [handle, size,
+                                ctypes.POINTER(_AnalyzerRegion)]),
+            "analyzer_region_likelihood":
+                (ctypes.POINTER(ctypes.c_float), [handle, size]),
+            "analyzer_pyramid_levels": (size, [handle]),
+            "analyzer_pyramid_level":
+                (ctypes.c_void_p, [handle, size, ctypes.POINTER(size),
+                                   ctypes.POINTER(size)]),
+            "analyzer_pyramid_level_for":
+                (size, [handle, ctypes.c_uint64, ctypes.c_uint64, size]),
+            "analyzer_entropy_range":
+                (ctypes.c_int, [handle, ctypes.c_void_p, size,
+                                ctypes.c_uint64, ctypes.c_uint64,
+                                ctypes.POINTER(ctypes.c_float)]),
+            "analyzer_solve_sizes":
+                (size, [ctypes.POINTER(ctypes.c_void_p),
+                        ctypes.POINTER(size), size, size,
+                        ctypes.POINTER(_AnalyzerSizeSolution), size,
+                        ctypes.POINTER(ctypes.c_uint64)]),
+            "analyzer_report":
+                (size, [handle, ctypes.c_int, ctypes.c_char_p, size]),
+        }
+        for name, (restype, argtypes) in signatures.items():
+            function = getattr(lib, name)
+            function.restype = restype
+            function.argtypes = argtypes
+        version = lib.analyzer_abi_version()
+        if version != self.ABI_VERSION:
+            raise OSError(f"{path}: libanalyzer ABI {version}, "
+                          f"expected {self.ABI_VERSION}")
+        self.lib = lib
+
+    @classmethod
+    def find(cls, analyzer_path: str) -> Optional["AnalyzerLibrary"]:
+        """Loads the library built next to the analyzer binary, if any."""
+        directory = os.path.dirname(os.path.abspath(analyzer_path))
+        for name in cls.NAMES:
+            path = os.path.join(directory, name)
+            if os.path.exists(path):
+                try:
+                    return cls(path)
+                except OSError as e:
+                    print(f"Could not load {path}: {e}")
+        return None
+
+    def _options(self, cache_dir: Optional[str], threads: int):
+        options = _AnalyzerOptions()
+        self.lib.analyzer_default_options(ctypes.byref(options))
+        options.threads = threads
+        if cache_dir:
+            options.cache_dir = os.fsencode(cache_dir)
+        return options
+
+    def analyze(self, data: Union[bytes, bytearray, memoryview],
+                name: str = "", cache_dir: Optional[str] = None,
+                threads: int = 0) -> AnalyzerResult:
+        """Analyzes data in place; bytes and writable buffers aren't copied.
+        `name` is what the report calls the input."""
+        pointer, keep = _buffer_pointer(data)
+        handle = self.lib.analyzer_analyze_buffer(
+            pointer, len(keep), os.fsencode(name),
+            ctypes.byref(self._options(cache_dir, threads)))
+        if not handle:
+            raise RuntimeError("analysis failed")
+        return AnalyzerResult(self, handle)
+
+    def analyze_file(self, path: str, cache_dir: Optional[str] = None,
+                     threads: int = 0) -> AnalyzerResult:
+        """Maps and analyzes the file at path."""
+        handle = self.lib.analyzer_analyze_file(
+            os.fsencode(path), ctypes.byref(self._options(cache_dir, threads)))
+        if not handle:
+            raise RuntimeError(f"could not analyze {path}")
+        return AnalyzerResult(self, handle)
+
+
+    def solve_sizes(self, samples: List[Union[bytes, bytearray, memoryview]],
+                    search_bytes: int = 0) -> Tuple[int, List[Dict]]:
+        """Header + count * stride equations that explain the sizes of all
+        the samples (the fields record's "sizes"), best first, and the
+        number of equations tested. None unless the samples have two sizes.
+        Counts are searched in the first search_bytes of every sample, 0
+        for the library's default."""
+        buffers = [_buffer_pointer(sample) for sample in samples]
+        pointers = (ctypes.c_void_p * len(buffers))(
+            *[pointer for pointer, _ in buffers])
+        sizes = (ctypes.c_size_t * len(buffers))(
+            *[len(keep) for _, keep in buffers])
+        solutions = (_AnalyzerSizeSolution * 16)()
+        hypotheses = ctypes.c_uint64()
+        found = self.lib.analyzer_solve_sizes(
+            pointers, sizes, len(buffers), search_bytes, solutions, 16,
+            ctypes.byref(hypotheses))
+        equations = []
+        for solution in solutions[:found]:
+            counts = [{"offset": term.offset, "width": term.width,
+                       "bigEndian": bool(term.big_endian),
+                       "stride": term.stride}
+                      for term in solution.counts[:solution.terms]]
+            equations.append({"header": solution.header,
+                              "files": solution.files, "counts": counts})
+        return hypotheses.value, equations
+
 
 class AnalyzerWrapper:
-    def __init__(self, analyzer_path: str):
+    def __init__(self, analyzer_path: str, cache_dir: Optional[str] = None,
+                 serve: bool = False,
+                 library: Optional[AnalyzerLibrary] = None):
         self.analyzer_path = analyzer_path
+        # Results persist here between runs (--cache), keyed by file content
+        self.cache_dir = cache_dir
+        self.cache_args = ["--cache", cache_dir] if cache_dir else []
+        # With a library, analyses run in-process and take precedence over
+        # serve and the command line
+        self.library = library
+        # With serve, requests go to one long-lived --serve process instead
+        # of a process per call; it's started on first use.
+        self.serve = serve
+        self._server = None
+
+    def _get_server(self) -> AnalyzerServer:
+        if self._server is None or self._server.process.poll() is not None:
+            self._server = AnalyzerServer(self.analyzer_path, *self.cache_args)
+        return self._server
+
+    def _analyze_in_process(self, file_path: str, format: str,
+                            threads: int = 0) -> bytes:
+        with self.library.analyze_file(file_path, self.cache_dir,
+                                       threads) as result:
+            return result.report(format)
 
     def analyze(self, file_path: str) -> str:
         """Runs the C++ analyzer and returns the output as a string."""
+        if self.library:
+            try:
+                report = self._analyze_in_process(file_path, "text")
+                return report.decode('utf-8', errors='replace')
+            except RuntimeError as e:
+                print(f"Error running analyzer: {e}")
+                return ""
+        if self.serve:
+            try:
+                report = self._get_server().request("analyze", file_path)
+                return report.decode('utf-8', errors='replace')
+            except (OSError, RuntimeError, ValueError) as e:
+                print(f"Error running analyzer: {e}")
+                return ""
         try:
             result = subprocess.run(
-                [self.analyzer_path, file_path],
+                [self.analyzer_path, *self.cache_args, file_path],
                 capture_output=True,
                 text=False,
                 check=True
@@ -23,6 +481,255 @@ class AnalyzerWrapper:
             print(f"Error running analyzer: {e}")
             return ""
 
+    def _map_in_process(self, file_paths: List[str],
+                        format: str) -> List[Optional[bytes]]:
+        """Reports for file_paths from the library, None where a file could
+        not be opened. Files are analyzed one per core, like --batch."""
+
+        def report(path: str) -> Optional[bytes]:
+            try:
+                return self._analyze_in_process(path, format, threads=1)
+            except RuntimeError:
+                return None
+
+        with ThreadPoolExecutor(max_workers=os.cpu_count()) as executor:
+            return list(executor.map(report, file_paths))
+
+    def _run_list(self, mode: str, file_paths: List[str], *args: str) -> bytes:
+        """Runs one analyzer process with `mode` (--batch or --corpus) over a
+        list file of file_paths and returns its stdout."""
+        with tempfile.NamedTemporaryFile("w", suffix=".txt", delete=False) as f:
+            f.write("\n".join(file_paths) + "\n")
+            list_path = f.name
+        try:
+            result = subprocess.run(
+                [self.analyzer_path, *self.cache_args, mode, list_path, *args],
+                capture_output=True,
+                text=False
+            )
+        finally:
+            os.remove(list_path)
+        return result.stdout
+
+    def _run_batch(self, file_paths: List[str], *args: str) -> bytes:
+        """Runs one --batch process over file_paths and returns its stdout."""
+        return self._run_list("--batch", file_paths, *args)
+
+    def analyze_corpus(self, file_paths: List[str],
+                       corpus_bytes: int = 0) -> str:
+        """Cross-file statistics of file_paths, samples of one format, from
+        one --corpus process: per-offset byte variance, the constant fields
+        and the fields that correlate with the file size. corpus_bytes
+        overrides the offsets compared (default 4096). Empty for fewer than
+        two files or if the analyzer fails."""
+        if len(file_paths) < 2:
+            return ""
+        args = ["--corpus-bytes", str(corpus_bytes)] if corpus_bytes else []
+        return self._run_list("--corpus", file_paths, *args).decode(
+            'utf-8', errors='replace')
+
+    def index_lookup(self, index_path: str, file_path: str) -> List[Dict]:
+        """Formats in the signature index at index_path that file_path looks
+        like, best first, as the "matches" of --index --format json: label,
+        path, score and its minHash, layout, profile and magic parts. Empty
+        for a missing index or if the analyzer fails. Costs an analysis of
+        the file (free with the cache) plus well under a millisecond."""
+        if not os.path.exists(index_path):
+            return []
+        result = subprocess.run(
+            [self.analyzer_path, *self.cache_args, "--index", index_path,
+             "--format", "json", file_path],
+            capture_output=True,
+            text=True
+        )
+        if result.returncode != 0 or not result.stdout.strip():
+            return []
+        return json.loads(result.stdout.splitlines()[0]).get("matches", [])
+
+    def index_add(self, index_path: str, label: str,
+                  file_paths: List[str]) -> bool:
+        """Adds the signatures of file_paths, samples of format `label`, to
+        the index at index_path, creating it if need be."""
+        result = subprocess.run(
+            [self.analyzer_path, *self.cache_args, "--index", index_path,
+             "--index-add", label, *file_paths],
+            capture_output=True,
+            text=True
+        )
+        if result.returncode != 0:
+            print(f"Error indexing files: {result.stderr.strip()}")
+        return result.returncode == 0
+
+    def analyze_batch(self, file_paths: List[str]) -> Dict[str, str]:
+        """Analyzes many files in one analyzer process (--batch).
+
+        Returns a dict mapping each path to its report. Files the analyzer
+        could not open are missing from the dict.
+        """
+        if not file_paths:
+            return {}
+        if self.library:
+            reports = {}
+            for path, report in zip(file_paths,
+                                    self._map_in_process(file_paths, "text")):
+                if report is not None:
+                    reports[path] = report.decode('utf-8', errors='replace')
+            return reports
+        if self.serve:
+            try:
+                server = self._get_server()
+                ids = {path: server.submit("analyze", path) for path in file_paths}
+            except (OSError, ValueError) as e:
+                print(f"Error running analyzer: {e}")
+                return {}
+            reports = {}
+            for path, request_id in ids.items():
+                try:
+                    reports[path] = server.result(request_id).decode(
+                        'utf-8', errors='replace')
+                except RuntimeError:
+                    pass  # Could not be opened
+            return reports
+        stdout = self._run_batch(file_paths)
+
+        # Reports arrive in completion order; each starts with "File: <path>"
+        reports = {}
+        current = None
+        for line in stdout.decode('utf-8', errors='replace').splitlines(keepends=True):
+            if line.startswith("File: "):
+                current = line[len("File: "):].rstrip("\r\n")
+                reports[current] = ""
+            if current is not None:
+                reports[current] += line
+        return {path: text.rstrip("\n") + "\n" for path, text in reports.items()}
+
+    # --format bin record header: magic, version, record size, file size,
+    # window, stride, entropy count, alignment[3][8][2], floats[3][8][2],
+    # name length, pattern count. The pattern table follows the entropy values, the
+    # autocorrelation periods follow the pattern table and the regions
+    # follow the periods.
+    _BIN_HEADER = struct.Struct("<4sIQQQQQ96QII")
+    _BIN_STRIDE = struct.Struct("<3Q")
+    _BIN_PATTERN = struct.Struct("<5Q16s16I")
+    _BIN_PERIODS = struct.Struct("<QQII")
+    _BIN_PERIOD = struct.Struct("<QfI")
+    _BIN_REGION = struct.Struct("<QQIf6f")
+    REGION_KINDS = ("header", "padding", "text", "int16", "int32", "int64",
+                    "float16", "float32", "float64", "compressed", "mixed")
+
+    def analyze_structured(self, file_paths: List[str]) -> Dict[str, Dict]:
+        """Analyzes file_paths in one --batch --format bin process, or
+        in-process when the library is loaded.
+
+        Returns a dict mapping each path to a record with the same keys as
+        --format json. The entropy map is a float32 memoryview over the
+        output buffer, so no per-value parsing happens; numpy.frombuffer
+        accepts it directly. Files the analyzer could not open are missing.
+        """
+        if not file_paths:
+            return {}
+        if self.library:
+            data = memoryview(b"".join(
+                r for r in self._map_in_process(file_paths, "bin") if r))
+        else:
+            data = memoryview(self._run_batch(file_paths, "--format", "bin"))
+        records = {}
+        offset = 0
+        header = self._BIN_HEADER
+        while offset + header.size <= len(data):
+            fields = header.unpack_from(data, offset)
+            magic, _version, record_size, size, window, stride, count = fields[:7]
+            if magic != b"ANLZ":
+                break
+            counts, floats = fields[7:55], fields[55:103]
+            name_length, pattern_count = fields[103], fields[104]
+            name_start = offset + header.size
+            values_start = name_start + ((name_length + 7) & ~7)
+            patterns_start = values_start + ((4 * count + 7) & ~7)
+            record_stride, stride_votes, total_votes = \
+                self._BIN_STRIDE.unpack_from(data, patterns_start)
+            top = []
+            for i in range(pattern_count):
+                p = self._BIN_PATTERN.unpack_from(
+                    data, patterns_start + self._BIN_STRIDE.size +
+                    i * self._BIN_PATTERN.size)
+                top.append({
+                    "length": p[0], "bytes": p[5][:p[0]].hex(), "count": p[1],
+                    "first": p[2], "period": p[3], "periodCount": p[4],
+                    "histogram": list(p[6:]),
+                })
+            periods_start = (patterns_start + self._BIN_STRIDE.size +
+                             pattern_count * self._BIN_PATTERN.size)
+            region_offset, region_size, byte_count, word_count = \
+                self._BIN_PERIODS.unpack_from(data, periods_start)
+            periods = []
+            for i in range(byte_count + word_count):
+                period, score, _ = self._BIN_PERIOD.unpack_from(
+                    data, periods_start + self._BIN_PERIODS.size +
+                    i * self._BIN_PERIOD.size)
+                periods.append({"period": period, "score": score})
+            regions_start = (periods_start + self._BIN_PERIODS.size +
+                             (byte_count + word_count) * self._BIN_PERIOD.size)
+            (region_count,) = struct.unpack_from("<Q", data, regions_start)
+            regions = []
+            for i in range(region_count):
+                r_offset, r_size, kind, entropy, *likelihood = \
+                    self._BIN_REGION.unpack_from(
+                        data, regions_start + 8 + i * self._BIN_REGION.size)
+                regions.append({"offset": r_offset, "size": r_size,
+                                "kind": self.REGION_KINDS[kind],
+                                "entropy": entropy,
+                                "likelihood": dict(zip(ELEMENT_TYPES,
+                                                       likelihood))})
+            alignment = _phase_table(counts)
+            name = bytes(data[name_start:name_start + name_length]).decode(
+                "utf-8", errors="replace")
+            records[name] = {
+                "type": "analysis",
+                "file": name,
+                "size": size,
+                "alignmentScores": {k: v[0][0] for k, v in alignment.items()},
+                "alignment": alignment,
+                "floats": _phase_table(floats),
+                "entropy": {
+                    "window": window,
+                    "stride": stride,
+                    "values": data[values_start:values_start + 4 * count].cast("f"),
+                },
+                "patterns": {
+                    "recordStride": record_stride,
+                    "strideVotes": stride_votes,
+                    "totalVotes": total_votes,
+                    "top": top,
+                },
+                "periods": {
+                    "regionOffset": region_offset,
+                    "regionSize": region_size,
+                    "bytes": periods[:byte_count],
+                    "words": periods[byte_count:],
+                },
+                "regions": regions,
+            }
+            offset += record_size
+        return records
+
+    def zoom(self, file_path: str, begin: int = 0, end: Optional[int] = None,
+             max_cells: int = 64) -> List[Tuple[int, int, float]]:
+        """Entropy of bytes [begin, end) of file_path in at most about
+        max_cells blocks, as (offset, size, entropy), from the entropy
+        pyramid; with the cache a second look costs no analysis. Needs the
+        library: the command line has no pyramid output, so without it the
+        list is empty."""
+        if not self.library:
+            return []
+        try:
+            with self.library.analyze_file(file_path,
+                                           self.cache_dir) as result:
+                return result.zoom(begin, end, max_cells)
+        except RuntimeError as e:
+            print(f"Error running analyzer: {e}")
+            return []
+
 import google.generativeai as genai
 from dotenv import load_dotenv
 
@@ -99,9 +806,113 @@ struct SimpleMesh {
             print(f"LLM API Error: {e}")
             return ""
 
+class ParserHost:
+    """Builds generated parsers as shared objects and runs them through
+    parser_host, the loader built with the analyzer.
+
+    Parsers are compiled with one compiler call against parser_abi.h,
+    which is precompiled once per compiler, and cached by a hash of their
+    source, so an attempt costs a fraction of a second and a repeated one
+    only its run. parser_host maps the input and calls the parser in its
+    own process: a parser that crashes or hangs takes the host down, not
+    the agent.
+    """
+
+    FLAGS = ["-std=c++17", "-O1", "-fPIC"]
+    HOST_NAMES = ("parser_host", "parser_host.exe")
+    HEADER = "parser_abi.h"
+    SUFFIX = ".dll" if os.name == "nt" else ".so"
+
+    def __init__(self, host_path: str, header_path: str, cache_dir: str,
+                 compiler: Optional[str] = None):
+        compiler = (compiler or os.environ.get("CXX") or shutil.which("c++")
+                    or shutil.which("g++") or shutil.which("clang++"))
+        if not compiler:
+            raise OSError("no C++ compiler found")
+        version = subprocess.run([compiler, "--version"], capture_output=True,
+                                 text=True, check=True).stdout
+        self.host_path = host_path
+        self.header_path = header_path
+        self.cache_dir = cache_dir
+        self.compiler = compiler
+        self.clang = "clang" in version
+        with open(header_path, "rb") as f:
+            header = f.read()
+        # Keys the precompiled header and every parser built with it
+        self.key = hashlib.sha256("\0".join(
+            [compiler, version, *self.FLAGS]).encode() + header).hexdigest()
+        self.header_copy = os.path.join(cache_dir, f"pch-{self.key[:16]}",
+                                        self.HEADER)
+
+    @classmethod
+    def find(cls, analyzer_path: str,
+             cache_dir: str) -> Optional["ParserHost"]:
+        """The host built next to the analyzer binary, if there is one.
+        None without it or a compiler: callers build parsers with CMake."""
+        directory = os.path.dirname(os.path.abspath(analyzer_path))
+        header = os.path.join(directory, cls.HEADER)
+        for name in cls.HOST_NAMES:
+            path = os.path.join(directory, name)
+            if os.path.exists(path) and os.path.exists(header):
+                try:
+                    return cls(path, header, cache_dir)
+                except (OSError, subprocess.CalledProcessError) as e:
+                    print(f"Could not use {path}: {e}")
+        return None
+
+    def _precompile(self) -> None:
+        """Precompiles parser_abi.h into a directory of its own (GCC looks
+        for the .gch next to the header it's told to include)."""
+        pch = self.header_copy + (".pch" if self.clang else ".gch")
+        if os.path.exists(pch):
+            return
+        os.makedirs(os.path.dirname(pch), exist_ok=True)
+        shutil.copyfile(self.header_path, self.header_copy)
+        temp = f"{pch}.tmp{os.getpid()}"
+        subprocess.run([self.compiler, *self.FLAGS, "-x", "c++-header",
+                        self.header_copy, "-o", temp],
+                       check=True, capture_output=True)
+        os.replace(temp, pch)
+
+    def compile(self, source_path: str) -> Tuple[Optional[str], str]:
+        """(path of the built parser, "") or (None, compiler errors)."""
+        self._precompile()
+        with open(source_path, "rb") as f:
+            source = f.read()
+        digest = hashlib.sha256(self.key.encode() + source).hexdigest()
+        library = os.path.join(self.cache_dir, digest[:16] + self.SUFFIX)
+        if os.path.exists(library):
+            return library, ""
+        include = (["-include-pch", self.header_copy + ".pch"] if self.clang
+                   else ["-include", self.header_copy])
+        temp = f"{library}.tmp{os.getpid()}"
+        result = subprocess.run(
+            [self.compiler, *self.FLAGS, "-shared", *include, source_path,
+             "-o", temp], capture_output=True, text=True)
+        if result.returncode != 0:
+            return None, result.stderr
+        os.replace(temp, library)
+        return library, ""
+
+    def run(self, library: str, test_file: str,
+            timeout: float = 30) -> Tuple[bool, str]:
+        """Runs a built parser on test_file: (exited with 0, its stdout)."""
+        try:
+            result = subprocess.run([self.host_path, library, test_file],
+                                    capture_output=True, timeout=timeout)
+        except subprocess.TimeoutExpired:
+            print(f"Parser timed out after {timeout} s")
+            return False, ""
+        if result.stderr:
+            print(result.stderr.decode("utf-8", errors="replace"))
+        return (result.returncode == 0,
+                result.stdout.decode("utf-8", errors="replace"))
+
+
 class ParserGenerator:
-    def __init__(self, output_dir: str):
+    def __init__(self, output_dir: str, host: Optional[ParserHost] = None):
         self.output_dir = output_dir
+        self.host = host
         os.makedirs(output_dir, exist_ok=True)
 
     def generate_cpp(self, code: str, filename: str = "generated_parser.cpp") -> str:
@@ -112,6 +923,22 @@ class ParserGenerator:
         return path
 
     def compile_and_run(self, source_path: str, test_file: str) -> tuple[bool, str]:
+        """Compiles the generated parser and runs it, through the parser
+        host when there is one, else as a CMake project."""
+        if self.host is None:
+            return self._compile_with_cmake(source_path, test_file)
+        library, errors = self.host.compile(source_path)
+        if library is None:
+            print(f"Parser build failed:\n{errors}")
+            return False, ""
+        success, output_text = self.host.run(library, test_file)
+        if success:
+            print(f"Parser Output: {output_text}")
+            return True, output_text
+        return False, ""
+
+    def _compile_with_cmake(self, source_path: str,
+                            test_file: str) -> tuple[bool, str]:
         """Compiles the generated parser using CMake and runs it."""
         exe_path = source_path.replace(".cpp", ".exe")
         build_dir = os.path.join(self.output_dir, "build")
@@ -141,7 +968,8 @@ add_executable(parser "{os.path.basename(source_path)}")
         possible_paths = [
             os.path.join(build_dir, "Debug", "parser.exe"),
             os.path.join(build_dir, "parser.exe"),
-            os.path.join(build_dir, "Release", "parser.exe")
+            os.path.join(build_dir, "Release", "parser.exe"),
+            os.path.join(build_dir, "parser")
         ]
         
         real_exe_path = None
@@ -239,15 +1067,57 @@ class Validator:
                 values[field["name"]] = val
         return values
 
+
+# Signature similarity (analyzer --index) from which an indexed format is
+# offered to the LLM as a starting point.
+SIGNATURE_MATCH_SCORE = 0.6
+
+
 class Agent:
     def __init__(self, analyzer_path: str, work_dir: str):
-        self.analyzer = AnalyzerWrapper(analyzer_path)
+        self.analyzer = AnalyzerWrapper(analyzer_path,
+                                        os.path.join(work_dir, "cache"),
+                                        serve=True,
+                                        library=AnalyzerLibrary.find(
+                                            analyzer_path))
         self.llm = LLMClient()
-        self.generator = ParserGenerator(os.path.join(work_dir, "generated"))
+        self.generator = ParserGenerator(
+            os.path.join(work_dir, "generated"),
+            ParserHost.find(analyzer_path,
+                            os.path.join(work_dir, "cache", "parsers")))
         self.validator = Validator()
         self.logger = ExperimentLogger(os.path.join(work_dir, "logs"))
         self.work_dir = work_dir
         self.knowledge_base = []
+        # Signatures of the formats reversed so far, and the hypothesis that
+        # worked for each (formats/<label>.txt), so a new file can start from
+        # the closest known format.
+        self.format_index = os.path.join(work_dir, "cache", "formats.anlx")
+        self.format_dir = os.path.join(work_dir, "cache", "formats")
+
+    def _known_format(self, file_path: str) -> str:
+        """Prompt text for the indexed format most like file_path, or empty
+        if none is close or its hypothesis wasn't kept."""
+        matches = self.analyzer.index_lookup(self.format_index, file_path)
+        if not matches or matches[0]["score"] < SIGNATURE_MATCH_SCORE:
+            return ""
+        best = matches[0]
+        path = os.path.join(self.format_dir, best["label"] + ".txt")
+        if not os.path.exists(path):
+            return ""
+        with open(path, "r") as f:
+            hypothesis = f.read()
+        return (f"\nThis file resembles the known format {best['label']} "
+                f"(similarity {best['score']:.2f}), reversed as:\n"
+                f"{hypothesis}\n")
+
+    def _remember_format(self, label: str, file_path: str, hypothesis: str):
+        """Indexes file_path as format `label` with the hypothesis that
+        parsed it."""
+        if self.analyzer.index_add(self.format_index, label, [file_path]):
+            os.makedirs(self.format_dir, exist_ok=True)
+            with open(os.path.join(self.format_dir, label + ".txt"), "w") as f:
+                f.write(hypothesis)
 
     def run_experiment(self, format_name: str, spec_path: str, test_files: List[str]):
         """Runs an experiment on a specific format."""
@@ -257,14 +1127,22 @@ class Agent:
         with open(spec_path, 'r') as f:
             spec = json.load(f)
             
+        # Analyze every test file up front in a single analyzer process,
+        # and the samples together for what they have in common
+        analyses = self.analyzer.analyze_batch(test_files)
+        corpus = self.analyzer.analyze_corpus(test_files)
+        known = self._known_format(test_files[0]) if test_files else ""
+
         for file in test_files:
             print(f"Processing {file}...")
             
             # 1. Analyze
-            analysis = self.analyzer.analyze(file)
+            analysis = analyses.get(file)
+            if analysis is None:
+                analysis = self.analyzer.analyze(file)
             
             # 2. Reason
-            prompt = f"Analyze this file format based on the following analysis:\n{analysis}\nPrevious knowledge: {self.knowledge_base}"
+            prompt = f"Analyze this file format based on the following analysis:\n{analysis}\n{corpus}{known}\nPrevious knowledge: {self.knowledge_base}"
             hypothesis = self.llm.query(prompt)
             
             # 3. Generate Code
@@ -281,6 +1159,7 @@ class Agent:
                 
                 if score > 0.8:
                     self.knowledge_base.append(hypothesis)
+                    self._remember_format(format_name, file, hypothesis)
             
             # 6. Log
             self.logger.log_attempt(
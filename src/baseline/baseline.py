@@ -1,16 +1,54 @@
 import os
 import struct
 import math
-from typing import List, Dict
+from typing import List, Dict, Optional
 
 class BaselineHeuristic:
-    def __init__(self):
-        pass
+    def __init__(self, library=None):
+        # Optional AnalyzerLibrary (agent.py): runs the C++ analyzer on the
+        # bytes already read, and its periods add element size candidates
+        self.library = library
 
-    def analyze_file(self, file_path: str) -> Dict:
+    def element_sizes(self, data: bytes, name: str) -> List[int]:
+        """Candidate element sizes: vec3 first, then what the analyzer finds."""
+        sizes = [12]
+        if self.library is None:
+            return sizes
+        with self.library.analyze(data, name, threads=1) as analysis:
+            found = [analysis.record_stride]
+            found += [p["period"] for p in analysis.periods()]
+            found += [p["period"] for p in analysis.periods(words=True)]
+        for size in found:
+            if 0 < size <= 64 and size not in sizes:
+                sizes.append(size)
+        return sizes
+
+    def fit_sizes(self, samples: List[bytes]) -> Optional[Dict]:
+        """The best two-count size equation over all samples, from the
+        analyzer's solver (header + count * stride for every candidate
+        field). None without the library or a two-count fit."""
+        if self.library is None or not samples:
+            return None
+        _, equations = self.library.solve_sizes(samples)
+        for equation in equations:
+            if len(equation["counts"]) == 2:
+                return equation
+        return None
+
+    @staticmethod
+    def read_count(data: bytes, term: Dict) -> Optional[int]:
+        end = term["offset"] + term["width"]
+        if end > len(data):
+            return None
+        return int.from_bytes(data[term["offset"]:end],
+                              "big" if term["bigEndian"] else "little")
+
+    def analyze_file(self, file_path: str,
+                     equation: Optional[Dict] = None) -> Dict:
         """
         Analyzes a file using heuristics to infer structure.
-        Returns a dictionary with inferred fields.
+        Returns a dictionary with inferred fields. `equation` is a size
+        equation from fit_sizes; it is used if it explains this file.
         """
         with open(file_path, 'rb') as f:
             data = f.read()
@@ -53,18 +91,30 @@ class BaselineHeuristic:
         # 16 + C1*12 + C2*12 == FileSize
         
         found_fit = False
-        if len(candidates) >= 2:
+        if equation is not None:
+            counts = [self.read_count(data, term)
+                      for term in equation["counts"]]
+            if None not in counts and equation["header"] + sum(
+                    count * term["stride"] for count, term in
+                    zip(counts, equation["counts"])) == file_size:
+                inferred_structure["Version"] = 1 # Guess
+                inferred_structure["Vertices"] = counts[0]
+                inferred_structure["Triangles"] = counts[1]
+                found_fit = True
+
+        if not found_fit and len(candidates) >= 2:
             c1 = candidates[0][1]
             c2 = candidates[1][1]
             
             # Check fit
-            if 16 + c1 * 12 + c2 * 12 == file_size:
-                inferred_structure["Version"] = 1 # Guess
-                inferred_structure["Vertices"] = c1
-                inferred_structure["Triangles"] = c2
-                found_fit = True
-            elif 16 + c1 * 12 + c2 * 4 == file_size: # Maybe triangles are 1 int? Unlikely for mesh
-                 pass
+            sizes = self.element_sizes(data, file_path)
+            for s1 in sizes:
+                for s2 in sizes:
+                    if not found_fit and 16 + c1 * s1 + c2 * s2 == file_size:
+                        inferred_structure["Version"] = 1 # Guess
+                        inferred_structure["Vertices"] = c1
+                        inferred_structure["Triangles"] = c2
+                        found_fit = True
         
         return inferred_structure
 
@@ -73,22 +123,34 @@ def main():
     data_dir = os.path.join(base_dir, "data")
     test_files = [os.path.join(data_dir, f) for f in os.listdir(data_dir) if f.endswith(".smsh")]
     
-    heuristic = BaselineHeuristic()
-    
-    print("Running Baseline Heuristic...")
-    total_score = 0
-    total_files = 0
-    
     # We need the validator from agent.py or reimplement it
     # Let's just import it if possible, or copy-paste for independence
     import sys
     sys.path.append(os.path.join(base_dir, "src", "agent"))
-    from agent import Validator
+    from agent import AnalyzerLibrary, Validator
     validator = Validator()
+
+    library = None
+    for build in ("bin", "build", os.path.join("build", "Debug"),
+                  os.path.join("build", "Release")):
+        library = AnalyzerLibrary.find(os.path.join(
+            base_dir, "src", "cpp_analyzer", build, "analyzer"))
+        if library:
+            break
+    heuristic = BaselineHeuristic(library)
+    samples = []
+    for file in test_files:
+        with open(file, 'rb') as f:
+            samples.append(f.read())
+    equation = heuristic.fit_sizes(samples)
+    
+    print("Running Baseline Heuristic...")
+    total_score = 0
+    total_files = 0
     
     for file in test_files:
         print(f"Analyzing {os.path.basename(file)}...")
-        result = heuristic.analyze_file(file)
+        result = heuristic.analyze_file(file, equation)
         
         # Convert to "parser output" format for validator
         output_str = ""
@@ -0,0 +1,340 @@
+// Throughput benchmarks for the analysis kernels (Google Benchmark).
+//
+// Every kernel runs on three synthetic inputs at sizes from 4 KiB to 4 GiB
+// (in steps of 16x) and reports bytes/second:
+//
+//   zeros       all zero bytes
+//   random      uniform random bytes
+//   simplemesh  a SimpleMesh file like generate_simplemesh.py writes: the
+//               16-byte header, float32 xyz vertices in [-10, 10] and uint32
+//               vertex indices, two vertices per triangle
+//
+// Inputs are generated on first use and only one is kept at a time, so peak
+// memory is the largest size run (twice that for the diff). Benchmarks are
+// registered size first, so each input is generated once.
+//
+// Besides the Google Benchmark flags, --max_size=N[K|M|G] skips larger
+// inputs (the default runs all of them). For results to track across
+// commits, write JSON:
+//
+//   analyzer_bench --benchmark_out=bench.json --benchmark_out_format=json
+//
+// or build the analyzer_bench_json target, which does that with the build
+// directory's analyzer_bench.json.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alignment.h"
+#include "analysis.h"
+#include "autocorrelation.h"
+#include "diff.h"
+#include "entropy.h"
+#include "hash.h"
+#include "patterns.h"
+#include "thread_pool.h"
+
+namespace {
+
+const size_t kMinSize = size_t(4) << 10;
+const size_t kMaxSize = size_t(4) << 30;
+
+// Two copies of the input; larger sizes don't fit next to the original on
+// a machine that holds the 4 GiB one.
+const size_t kMaxDiffSize = size_t(256) << 20;
+
+enum class Input { Zeros, Random, SimpleMesh };
+
+const char *inputName(Input input) {
+  switch (input) {
+  case Input::Zeros:
+    return "zeros";
+  case Input::Random:
+    return "random";
+  case Input::SimpleMesh:
+    return "simplemesh";
+  }
+  return "";
+}
+
+uint64_t splitmix(uint64_t &state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void putU32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; ++i)
+    p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+void fillRandom(std::vector<uint8_t> &data, uint64_t seed) {
+  uint64_t state = seed;
+  size_t i = 0;
+  for (; i + 8 <= data.size(); i += 8) {
+    uint64_t v = splitmix(state);
+    std::memcpy(data.data() + i, &v, 8);
+  }
+  for (uint64_t v = splitmix(state); i < data.size(); ++i, v >>= 8)
+    data[i] = static_cast<uint8_t>(v);
+}
+
+void fillSimpleMesh(std::vector<uint8_t> &data, uint64_t seed) {
+  const size_t body = data.size() - 16;
+  const size_t vertices = body / 18; // 12 bytes each, half a triangle each
+  const size_t triangles = (body - vertices * 12) / 12;
+  std::memcpy(data.data(), "SMSH", 4);
+  putU32(data.data() + 4, 1);
+  putU32(data.data() + 8, static_cast<uint32_t>(vertices));
+  putU32(data.data() + 12, static_cast<uint32_t>(triangles));
+
+  uint64_t state = seed;
+  uint8_t *p = data.data() + 16;
+  for (size_t v = 0; v < vertices * 3; ++v, p += 4) {
+    float f = float((splitmix(state) >> 40) * (20.0 / 16777216.0) - 10.0);
+    std::memcpy(p, &f, 4);
+  }
+  for (size_t t = 0; t < triangles * 3; ++t, p += 4)
+    putU32(p, vertices ? uint32_t(splitmix(state) % vertices) : 0);
+  // Whatever is left over stays zero, like trailing padding.
+}
+
+// The input the benchmarks run on; regenerated when they move on to another.
+const std::vector<uint8_t> &input(Input kind, size_t size) {
+  static std::vector<uint8_t> data;
+  static Input currentKind;
+  static size_t currentSize = 0;
+  if (currentSize != size || currentKind != kind) {
+    data.clear();
+    data.shrink_to_fit();
+    data.resize(size);
+    if (kind == Input::Random)
+      fillRandom(data, size);
+    else if (kind == Input::SimpleMesh)
+      fillSimpleMesh(data, size);
+    currentKind = kind;
+    currentSize = size;
+  }
+  return data;
+}
+
+ByteView view(const std::vector<uint8_t> &data) {
+  return ByteView(data.data(), data.size());
+}
+
+// A copy with a few bytes replaced, a run inserted and a run deleted, so
+// the diff has anchors and hunks to find.
+std::vector<uint8_t> edited(const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> copy(data);
+  uint64_t state = data.size();
+  for (size_t i = 0; i < 16; ++i)
+    copy[splitmix(state) % copy.size()] ^= 0x5a;
+  size_t at = copy.size() / 3;
+  copy.insert(copy.begin() + at, 64, 0xee);
+  at = copy.size() * 2 / 3;
+  copy.erase(copy.begin() + at, copy.begin() + at + 32);
+  return copy;
+}
+
+void setBytes(benchmark::State &state, size_t size) {
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(size));
+}
+
+void BM_CalculateEntropy(benchmark::State &state, Input kind, size_t size) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(calculateEntropy(view(data)));
+  setBytes(state, size);
+}
+
+// The map analyzeFile builds: one value per window, windows every `stride`.
+void BM_EntropyMap(benchmark::State &state, Input kind, size_t size,
+                   size_t window, size_t stride) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  std::vector<float> map(entropyWindowCount(size, window, stride));
+  for (auto _ : state) {
+    computeEntropyWindows(view(data), window, stride, 0, map.size(),
+                          map.data());
+    benchmark::DoNotOptimize(map.data());
+  }
+  setBytes(state, size);
+}
+
+void BM_CheckAlignment(benchmark::State &state, Input kind, size_t size) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  AnalysisResult result;
+  for (auto _ : state) {
+    checkAlignment(view(data), result);
+    benchmark::DoNotOptimize(result.alignment);
+  }
+  setBytes(state, size);
+}
+
+void BM_FindPatterns(benchmark::State &state, Input kind, size_t size) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  AnalysisOptions options;
+  AnalysisResult result;
+  for (auto _ : state) {
+    findPatterns(view(data), options, result);
+    benchmark::DoNotOptimize(result.patterns);
+  }
+  setBytes(state, size);
+}
+
+void BM_FindPeriods(benchmark::State &state, Input kind, size_t size) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  AnalysisOptions options;
+  AnalysisResult result;
+  for (auto _ : state) {
+    findPeriods(view(data), options, result);
+    benchmark::DoNotOptimize(result.periods);
+  }
+  // Only a region of large inputs is correlated; report what was read.
+  setBytes(state, std::min(size, kAutocorrelationRegion));
+}
+
+void BM_HashBytes(benchmark::State &state, Input kind, size_t size) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(hashBytes(view(data)));
+  setBytes(state, size);
+}
+
+void BM_DiffBytes(benchmark::State &state, Input kind, size_t size) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  const std::vector<uint8_t> other = edited(data);
+  for (auto _ : state) {
+    DiffSummary diff = diffBytes(view(data), view(other));
+    benchmark::DoNotOptimize(diff.hunkCount);
+  }
+  setBytes(state, size);
+}
+
+// Every pass, as analyzeFile runs them, on one thread or on every core.
+void BM_AnalyzeData(benchmark::State &state, Input kind, size_t size,
+                    bool parallel) {
+  const std::vector<uint8_t> &data = input(kind, size);
+  AnalysisOptions options;
+  std::unique_ptr<ThreadPool> pool;
+  if (parallel)
+    pool = std::make_unique<ThreadPool>(resolveThreadCount(0) - 1);
+  AnalysisResult result;
+  for (auto _ : state) {
+    analyzeData(view(data), options, result, pool.get());
+    benchmark::DoNotOptimize(result.entropyMap.data());
+  }
+  setBytes(state, size);
+}
+
+// Parses a size with an optional K, M or G suffix (powers of 1024).
+bool parseSize(const char *text, size_t &size) {
+  char *end = nullptr;
+  unsigned long long value = std::strtoull(text, &end, 10);
+  if (end == text)
+    return false;
+  int shift = 0;
+  switch (*end) {
+  case 'K':
+  case 'k':
+    shift = 10;
+    break;
+  case 'M':
+  case 'm':
+    shift = 20;
+    break;
+  case 'G':
+  case 'g':
+    shift = 30;
+    break;
+  }
+  if (shift)
+    ++end;
+  size = static_cast<size_t>(value) << shift;
+  return *end == '\0';
+}
+
+void registerAll(size_t maxSize) {
+  const Input inputs[] = {Input::Zeros, Input::Random, Input::SimpleMesh};
+  for (size_t size = kMinSize; size <= maxSize && size <= kMaxSize;
+       size *= 16) {
+    for (Input kind : inputs) {
+      std::string suffix =
+          std::string("/") + inputName(kind) + "/" + std::to_string(size);
+      auto add = [&](const std::string &name, auto fn) {
+        return benchmark::RegisterBenchmark((name + suffix).c_str(), fn)
+            ->Unit(benchmark::kMicrosecond);
+      };
+      add("CalculateEntropy", [=](benchmark::State &state) {
+        BM_CalculateEntropy(state, kind, size);
+      });
+      add("EntropyMap", [=](benchmark::State &state) {
+        BM_EntropyMap(state, kind, size, 64, 64);
+      });
+      add("EntropyMapSliding", [=](benchmark::State &state) {
+        BM_EntropyMap(state, kind, size, 256, 16);
+      });
+      add("CheckAlignment", [=](benchmark::State &state) {
+        BM_CheckAlignment(state, kind, size);
+      });
+      add("FindPatterns", [=](benchmark::State &state) {
+        BM_FindPatterns(state, kind, size);
+      });
+      add("FindPeriods", [=](benchmark::State &state) {
+        BM_FindPeriods(state, kind, size);
+      });
+      add("HashBytes", [=](benchmark::State &state) {
+        BM_HashBytes(state, kind, size);
+      });
+      if (size <= kMaxDiffSize)
+        add("DiffBytes", [=](benchmark::State &state) {
+          BM_DiffBytes(state, kind, size);
+        });
+      add("AnalyzeData", [=](benchmark::State &state) {
+        BM_AnalyzeData(state, kind, size, false);
+      });
+      add("AnalyzeDataParallel", [=](benchmark::State &state) {
+        BM_AnalyzeData(state, kind, size, true);
+      })->UseRealTime();
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t maxSize = kMaxSize;
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    const char *flag = "--max_size=";
+    if (std::strncmp(argv[i], flag, std::strlen(flag)) == 0) {
+      if (!parseSize(argv[i] + std::strlen(flag), maxSize)) {
+        std::fprintf(stderr, "Invalid --max_size: %s\n", argv[i]);
+        return 1;
+      }
+      continue;
+    }
+    argv[kept++] = argv[i];
+  }
+  argc = kept;
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  // The kernel chosen at run time, after ANALYZER_CPU, as --profile says
+  benchmark::AddCustomContext("analyzer_simd", alignmentKernel());
+  benchmark::AddCustomContext("analyzer_max_size", std::to_string(maxSize));
+  registerAll(maxSize);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,514 @@
+"""Throughput regression suite for the analyzer command line.
+
+Generates a fixed-seed corpus with src/generator (SimpleMesh files and
+random formats, from 1 KiB to 4 GiB depending on the preset) and runs every
+mode of the analyzer over it:
+
+- single:   one process per file, --threads 1, for every corpus size
+- threaded: the largest file up to 1 GiB at 1, 2, 4, ... N threads
+- batch:    --batch over the small files and over the size ladder, at
+            1 to N threads
+- stream:   --stream over the size ladder (constant memory)
+- server:   --serve, sequential requests cold and warm, and pipelined
+
+It records throughput, p50/p99 latency, peak RSS and the thread scaling
+curves in a JSON file. With --baseline it compares them with a stored run
+and exits with status 1 if any got worse by more than the tolerance:
+
+  python src/cpp_analyzer/bench/throughput_suite.py --save-baseline base.json
+  python src/cpp_analyzer/bench/throughput_suite.py --baseline base.json
+
+Baselines hold for the machine they were recorded on. The corpus is kept
+in the work directory and only regenerated when the seed or preset change.
+Peak RSS comes from wait4(), so the suite runs on Linux and macOS.
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from typing import Dict, List, Optional, Tuple
+
+SRC_DIR = os.path.dirname(os.path.dirname(os.path.dirname(
+    os.path.abspath(__file__))))
+sys.path.append(SRC_DIR)
+
+from generator.generate_simplemesh import generate_simplemesh
+from generator.random_generator import RandomFormatGenerator
+
+KIB = 1 << 10
+MIB = 1 << 20
+GIB = 1 << 30
+
+# File sizes of the ladder, per preset. Each size gets a SimpleMesh file
+# and a file of one of the random formats.
+PRESETS = {
+    "quick": [KIB, 64 * KIB, MIB, 16 * MIB],
+    "standard": [KIB, 64 * KIB, MIB, 16 * MIB, 64 * MIB, 256 * MIB],
+    "full": [KIB, 64 * KIB, MIB, 16 * MIB, 64 * MIB, 256 * MIB, GIB,
+             4 * GIB],
+}
+# Random formats, and the small files of them that batch and server modes
+# run on (5 to 50 elements per array, as the generator writes by default)
+RANDOM_FORMATS = 8
+SMALL_FILES = 256
+# Files above this are drawn block by block and their later blocks repeat
+# the first TILE_BLOCKS, so multi-GB files write at disk speed
+TILE_ABOVE = 16 * MIB
+TILE_BLOCKS = 16
+# The threaded scaling curve runs on the largest file up to this size
+SCALING_MAX = GIB
+# Bump when the corpus layout changes, so old work directories regenerate
+CORPUS_VERSION = 1
+
+MODES = ("single", "threaded", "batch", "stream", "server")
+
+
+def size_name(size: int) -> str:
+    for unit, scale in (("G", GIB), ("M", MIB), ("K", KIB)):
+        if size >= scale and size % scale == 0:
+            return f"{size // scale}{unit}"
+    return str(size)
+
+
+class Corpus:
+    """The fixed-seed input files: `ladder` from tiny to the preset's
+    largest size, by size, and `small`, SMALL_FILES samples of the random
+    formats."""
+
+    def __init__(self, directory: str, preset: str, seed: int):
+        self.directory = directory
+        self.preset = preset
+        self.seed = seed
+        self.small_dir = os.path.join(directory, "small")
+        self.ladder: List[Tuple[str, str, int]] = []  # (name, path, size)
+        self.small: List[str] = []
+
+    def _manifest(self) -> Dict:
+        return {"version": CORPUS_VERSION, "preset": self.preset,
+                "seed": self.seed}
+
+    def _current(self, manifest_path: str) -> bool:
+        if not os.path.exists(manifest_path):
+            return False
+        with open(manifest_path, "r") as f:
+            manifest = json.load(f)
+        if {k: manifest.get(k) for k in self._manifest()} != self._manifest():
+            return False
+        return all(os.path.exists(path) and os.path.getsize(path) == size
+                   for path, size in manifest["files"].items())
+
+    def prepare(self):
+        """Generates the corpus unless the work directory already holds
+        this seed and preset's."""
+        manifest_path = os.path.join(self.directory, "manifest.json")
+        generator = RandomFormatGenerator(self.directory)
+        # The format specs come from the generator's global random state
+        random.seed(self.seed)
+        specs = [generator.generate_random_format(f"F{i}", num_files=0)
+                 for i in range(RANDOM_FORMATS)]
+
+        for i, size in enumerate(PRESETS[self.preset]):
+            name = size_name(size)
+            self.ladder.append((f"smsh-{name}",
+                                os.path.join(self.directory,
+                                             f"smsh-{name}.smsh"),
+                                size))
+            spec = specs[i % RANDOM_FORMATS]
+            self.ladder.append((f"{spec['name']}-{name}",
+                                os.path.join(self.directory,
+                                             f"{spec['name']}-{name}.bin"),
+                                size))
+        for i in range(SMALL_FILES):
+            self.small.append(os.path.join(
+                self.small_dir, f"F{i % RANDOM_FORMATS}_{i:03d}.bin"))
+
+        if self._current(manifest_path):
+            self.ladder = [(name, path, os.path.getsize(path))
+                           for name, path, _ in self.ladder]
+            return
+
+        print(f"Generating the {self.preset} corpus in {self.directory}...")
+        os.makedirs(self.small_dir, exist_ok=True)
+        files = {}
+        ladder = []
+        for name, path, size in self.ladder:
+            # A seed per file, so each file is the same whatever the preset
+            rng = random.Random(f"{self.seed}/{name}")
+            tile = TILE_BLOCKS if size > TILE_ABOVE else 0
+            if name.startswith("smsh-"):
+                # Twice as many vertices as triangles, 12 bytes each
+                vertices = max(1, (size - 16) // 18)
+                generate_simplemesh(path, vertices, vertices // 2, rng, tile)
+            else:
+                spec = specs[int(name[1:name.index("-")])]
+                generator.write_sized_file(path, spec, size, rng, tile)
+            files[path] = os.path.getsize(path)
+            ladder.append((name, path, files[path]))
+        self.ladder = ladder
+        for i, path in enumerate(self.small):
+            rng = random.Random(f"{self.seed}/small/{i}")
+            generator._write_file(path, specs[i % RANDOM_FORMATS], rng=rng)
+            files[path] = os.path.getsize(path)
+
+        manifest = self._manifest()
+        manifest["files"] = files
+        with open(manifest_path, "w") as f:
+            json.dump(manifest, f, indent=2)
+
+
+# Every run has --profile, whose report gives the analyzer's own peak RSS:
+# wait4's ru_maxrss would also count this script's RSS at the fork
+PEAK_RSS = re.compile(rb"([0-9.]+) MiB peak RSS")
+
+
+def peak_rss_mb(profile: bytes, usage) -> float:
+    match = PEAK_RSS.search(profile)
+    if match:
+        return float(match.group(1))
+    # ru_maxrss is in KiB on Linux and in bytes on macOS
+    scale = 1 if sys.platform == "darwin" else KIB
+    return usage.ru_maxrss * scale / MIB
+
+
+def run(command: List[str]) -> Tuple[float, float]:
+    """Runs command (with --profile added) with its output discarded;
+    returns its wall time in seconds and peak RSS in MiB. Raises if it
+    fails."""
+    with tempfile.TemporaryFile() as stderr:
+        start = time.perf_counter()
+        process = subprocess.Popen(command + ["--profile"],
+                                   stdout=subprocess.DEVNULL, stderr=stderr)
+        _, status, usage = os.wait4(process.pid, 0)
+        seconds = time.perf_counter() - start
+        process.returncode = os.waitstatus_to_exitcode(status)
+        stderr.seek(0)
+        output = stderr.read()
+        if process.returncode != 0:
+            raise RuntimeError(f"{' '.join(command)} exited with status "
+                               f"{process.returncode}: "
+                               f"{output.decode(errors='replace')}")
+    return seconds, peak_rss_mb(output, usage)
+
+
+def percentile(values: List[float], p: float) -> float:
+    """Nearest-rank percentile."""
+    ordered = sorted(values)
+    rank = max(0, min(len(ordered) - 1, int(-(-p * len(ordered) // 100)) - 1))
+    return ordered[rank]
+
+
+def thread_counts(max_threads: int) -> List[int]:
+    counts = []
+    threads = 1
+    while threads < max_threads:
+        counts.append(threads)
+        threads *= 2
+    return counts + [max_threads]
+
+
+class Suite:
+    def __init__(self, analyzer: str, corpus: Corpus, max_threads: int,
+                 repeat: int):
+        self.analyzer = analyzer
+        self.corpus = corpus
+        self.max_threads = max_threads
+        self.repeat = repeat
+        self.metrics: Dict[str, Dict] = {}
+        self.curves: Dict[str, List[Dict]] = {}
+
+    def record(self, key: str, value: float, unit: str, better: str):
+        """Adds one compared metric; better is "higher" or "lower"."""
+        self.metrics[key] = {"value": value, "unit": unit, "better": better}
+
+    def timed(self, *args: str) -> Tuple[float, float]:
+        """Median wall time and largest peak RSS over `repeat` runs of the
+        analyzer with args."""
+        runs = [run([self.analyzer, *args]) for _ in range(self.repeat)]
+        return (statistics.median(seconds for seconds, _ in runs),
+                max(rss for _, rss in runs))
+
+    def record_run(self, key: str, seconds: float, rss: float, size: int):
+        self.record(f"{key}/throughput", size / seconds / MIB, "MiB/s",
+                    "higher")
+        self.record(f"{key}/peak_rss", rss, "MiB", "lower")
+
+    def run_single(self):
+        for name, path, size in self.corpus.ladder:
+            seconds, rss = self.timed("--threads", "1", "--format", "json",
+                                      path)
+            self.record_run(f"single/{name}", seconds, rss, size)
+        # Per-file latency of a process per file, startup included
+        latencies = [run([self.analyzer, "--threads", "1", "--format",
+                          "json", path])[0] * 1000
+                     for path in self.corpus.small]
+        self.record("single/small/p50", percentile(latencies, 50), "ms",
+                    "lower")
+        self.record("single/small/p99", percentile(latencies, 99), "ms",
+                    "lower")
+
+    def run_threaded(self):
+        candidates = [entry for entry in self.corpus.ladder
+                      if entry[2] <= SCALING_MAX]
+        name, path, size = max(candidates, key=lambda entry: entry[2])
+        curve = []
+        for threads in thread_counts(self.max_threads):
+            seconds, rss = self.timed("--threads", str(threads), "--format",
+                                      "json", path)
+            self.record_run(f"threaded/{name}/t{threads}", seconds, rss,
+                            size)
+            curve.append({"threads": threads,
+                          "throughput": size / seconds / MIB,
+                          "speedup": curve[0]["seconds"] / seconds
+                          if curve else 1.0,
+                          "seconds": seconds})
+        for point in curve:
+            point["efficiency"] = point["speedup"] / point["threads"]
+        self.curves[f"threaded/{name}"] = curve
+
+    def _list_file(self, paths: List[str], name: str) -> str:
+        path = os.path.join(self.corpus.directory, name)
+        with open(path, "w") as f:
+            f.write("\n".join(paths) + "\n")
+        return path
+
+    def run_batch(self):
+        small = self._list_file(self.corpus.small, "small.txt")
+        ladder = self._list_file([path for _, path, _ in self.corpus.ladder],
+                                 "ladder.txt")
+        ladder_bytes = sum(size for _, _, size in self.corpus.ladder)
+        small_curve = []
+        for threads in thread_counts(self.max_threads):
+            seconds, rss = self.timed("--batch", small, "--threads",
+                                      str(threads), "--format", "json")
+            files_per_second = len(self.corpus.small) / seconds
+            self.record(f"batch/small/t{threads}/files_per_s",
+                        files_per_second, "files/s", "higher")
+            self.record(f"batch/small/t{threads}/peak_rss", rss, "MiB",
+                        "lower")
+            small_curve.append({"threads": threads,
+                                "files_per_s": files_per_second})
+        self.curves["batch/small"] = small_curve
+        ladder_curve = []
+        for threads in thread_counts(self.max_threads):
+            seconds, rss = self.timed("--batch", ladder, "--threads",
+                                      str(threads), "--format", "json")
+            self.record_run(f"batch/ladder/t{threads}", seconds, rss,
+                            ladder_bytes)
+            ladder_curve.append({"threads": threads,
+                                 "throughput": ladder_bytes / seconds / MIB})
+        self.curves["batch/ladder"] = ladder_curve
+
+    def run_stream(self):
+        for name, path, size in self.corpus.ladder:
+            if size < MIB:
+                continue
+            seconds, rss = self.timed("--stream", "--block-size",
+                                      str(MIB), "--format", "json", path)
+            self.record_run(f"stream/{name}", seconds, rss, size)
+
+    def _serve(self) -> subprocess.Popen:
+        profile = tempfile.TemporaryFile()
+        server = subprocess.Popen(
+            [self.analyzer, "--serve", "--threads", str(self.max_threads),
+             "--format", "json", "--profile"],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=profile)
+        server.profile = profile
+        return server
+
+    @staticmethod
+    def _send(server: subprocess.Popen, request_id: int, path: str):
+        server.stdin.write(f"{request_id}\tanalyze\t{path}\n".encode())
+
+    @staticmethod
+    def _receive(server: subprocess.Popen):
+        """Reads one response ("<id>\\t<ok|error>\\t<size>" and its
+        payload); raises on an error reply."""
+        header = server.stdout.readline()
+        if not header:
+            raise RuntimeError("analyzer server exited")
+        _, status, size = header.decode().rstrip("\n").split("\t")
+        payload = server.stdout.read(int(size))
+        if status != "ok":
+            raise RuntimeError(payload.decode(errors="replace"))
+
+    @staticmethod
+    def _stop(server: subprocess.Popen) -> float:
+        """Ends the server's input and returns its peak RSS in MiB."""
+        server.stdin.close()
+        _, _, usage = os.wait4(server.pid, 0)
+        server.returncode = 0
+        with server.profile:
+            server.profile.seek(0)
+            return peak_rss_mb(server.profile.read(), usage)
+
+    def run_server(self):
+        # Sequential requests for the small files, as the agent makes them:
+        # a first pass maps and analyzes every file, the second finds them
+        # mapped with their results
+        server = self._serve()
+        for phase in ("cold", "warm"):
+            latencies = []
+            for i, path in enumerate(self.corpus.small):
+                start = time.perf_counter()
+                self._send(server, i, path)
+                server.stdin.flush()
+                self._receive(server)
+                latencies.append((time.perf_counter() - start) * 1000)
+            self.record(f"server/{phase}/p50", percentile(latencies, 50),
+                        "ms", "lower")
+            self.record(f"server/{phase}/p99", percentile(latencies, 99),
+                        "ms", "lower")
+        self.record("server/peak_rss", self._stop(server), "MiB", "lower")
+
+        # Pipelined: every request written at once to a fresh server
+        server = self._serve()
+        start = time.perf_counter()
+        for i, path in enumerate(self.corpus.small):
+            self._send(server, i, path)
+        server.stdin.flush()
+        for _ in self.corpus.small:
+            self._receive(server)
+        seconds = time.perf_counter() - start
+        self._stop(server)
+        self.record("server/pipelined/requests_per_s",
+                    len(self.corpus.small) / seconds, "requests/s", "higher")
+
+    def run(self, modes: List[str]):
+        for mode in modes:
+            print(f"Running {mode}...")
+            start = time.perf_counter()
+            getattr(self, f"run_{mode}")()
+            print(f"  {mode} took {time.perf_counter() - start:.1f} s")
+
+
+def compare(results: Dict, baseline: Dict, tolerance: float,
+            rss_tolerance: float) -> List[str]:
+    """Prints every metric against the baseline and returns the keys that
+    regressed: throughput down, or latency or RSS up, by more than the
+    tolerance. Latencies within 1 ms and RSS within 4 MiB of the baseline
+    never count, as those are within run-to-run noise."""
+    for key in ("preset", "seed"):
+        if baseline["meta"][key] != results["meta"][key]:
+            raise ValueError(f"baseline {key} {baseline['meta'][key]} "
+                             f"differs from {results['meta'][key]}")
+    regressions = []
+    print(f"\n{'metric':<44} {'value':>12} {'baseline':>12} {'change':>8}")
+    for key, metric in sorted(results["metrics"].items()):
+        base = baseline["metrics"].get(key)
+        value = metric["value"]
+        if base is None:
+            print(f"{key:<44} {value:>12.3f} {'-':>12} {'new':>8}")
+            continue
+        change = (value - base["value"]) / base["value"] if base["value"] \
+            else 0.0
+        if metric["better"] == "higher":
+            regressed = change < -tolerance
+        else:
+            slack = 4.0 if metric["unit"] == "MiB" else 1.0
+            allowed = rss_tolerance if metric["unit"] == "MiB" else tolerance
+            regressed = (change > allowed and
+                         value - base["value"] > slack)
+        if regressed:
+            regressions.append(key)
+        print(f"{key:<44} {value:>12.3f} {base['value']:>12.3f} "
+              f"{change * 100:>+7.1f}%{'  REGRESSION' if regressed else ''}")
+    for key in sorted(set(baseline["metrics"]) - set(results["metrics"])):
+        print(f"{key:<44} {'-':>12} {baseline['metrics'][key]['value']:>12.3f}"
+              f" {'missing':>8}")
+    return regressions
+
+
+def find_analyzer() -> Optional[str]:
+    base = os.path.join(SRC_DIR, "cpp_analyzer")
+    for candidate in ("bin/analyzer", "build/analyzer",
+                      "build/Release/analyzer", "bin/analyzer.exe"):
+        path = os.path.join(base, candidate)
+        if os.path.exists(path):
+            return path
+    return None
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(
+        description="Throughput regression suite for the analyzer")
+    parser.add_argument("--analyzer", default=find_analyzer(),
+                        help="analyzer binary (default: bin/ or build/)")
+    parser.add_argument("--work-dir", default=os.path.join(
+        SRC_DIR, "cpp_analyzer", "build", "throughput"),
+        help="where the corpus and results are kept")
+    parser.add_argument("--preset", choices=sorted(PRESETS),
+                        default="standard",
+                        help="largest corpus file: quick 16 MiB, standard "
+                             "256 MiB, full 4 GiB (about 11 GB of corpus)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--max-threads", type=int,
+                        default=os.cpu_count() or 1,
+                        help="top of the scaling curves (default: all cores)")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="runs per measurement; the median counts")
+    parser.add_argument("--modes", default=",".join(MODES),
+                        help="comma-separated subset of " + ",".join(MODES))
+    parser.add_argument("--out", help="results JSON (default: "
+                                      "<work-dir>/results.json)")
+    parser.add_argument("--baseline", help="results to compare with; "
+                                           "regressions exit with status 1")
+    parser.add_argument("--save-baseline",
+                        help="also write the results here, as a baseline")
+    parser.add_argument("--tolerance", type=float, default=0.15,
+                        help="allowed slowdown (default 0.15: 15%%)")
+    parser.add_argument("--rss-tolerance", type=float, default=0.10,
+                        help="allowed peak RSS growth (default 0.10)")
+    args = parser.parse_args()
+
+    if not args.analyzer or not os.path.exists(args.analyzer):
+        parser.error("analyzer binary not found; pass --analyzer")
+    modes = [mode for mode in args.modes.split(",") if mode]
+    for mode in modes:
+        if mode not in MODES:
+            parser.error(f"unknown mode {mode}")
+    baseline = None
+    if args.baseline:
+        with open(args.baseline, "r") as f:
+            baseline = json.load(f)
+
+    corpus = Corpus(os.path.join(args.work_dir, "corpus"), args.preset,
+                    args.seed)
+    corpus.prepare()
+    suite = Suite(os.path.abspath(args.analyzer), corpus, args.max_threads,
+                  args.repeat)
+    suite.run(modes)
+
+    results = {
+        "meta": {"preset": args.preset, "seed": args.seed,
+                 "max_threads": args.max_threads, "repeat": args.repeat,
+                 "modes": modes, "analyzer": os.path.abspath(args.analyzer),
+                 "date": time.strftime("%Y-%m-%dT%H:%M:%S")},
+        "metrics": suite.metrics,
+        "curves": suite.curves,
+    }
+    out = args.out or os.path.join(args.work_dir, "results.json")
+    for path in filter(None, (out, args.save_baseline)):
+        with open(path, "w") as f:
+            json.dump(results, f, indent=2)
+    print(f"Results in {out}")
+
+    if baseline is None:
+        return 0
+    regressions = compare(results, baseline, args.tolerance,
+                          args.rss_tolerance)
+    if regressions:
+        print(f"\n{len(regressions)} regression(s) against {args.baseline}")
+        return 1
+    print(f"\nNo regressions against {args.baseline}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
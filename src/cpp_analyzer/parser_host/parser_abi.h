@@ -0,0 +1,66 @@
+#ifndef ANALYZER_PARSER_ABI_H
+#define ANALYZER_PARSER_ABI_H
+
+// Helper: Parser ABI
+//
+// The header every generated parser is compiled with. The agent passes it
+// with -include and precompiles it once per compiler, so a parser builds
+// with a single compiler call into a shared object, which parser_host
+// loads and runs against an input file.
+//
+// A parser either keeps the main(argc, argv) of a standalone program
+// (renamed below, so it becomes the analyzer_parser_main entry point and
+// reads argv[1] itself) or defines analyzer_parse, which is handed the
+// input already mapped. Either prints the fields it finds to stdout and
+// returns 0 on success. A parser that defines both is run through
+// analyzer_parse.
+//
+// A change to the entry points bumps ANALYZER_PARSER_ABI_VERSION, which
+// parser_host checks through analyzer_parser_abi_version().
+
+// The standard headers generated parsers use, so the precompiled header
+// covers them and their own #includes cost nothing.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#define ANALYZER_PARSER_EXPORT __declspec(dllexport)
+#else
+#define ANALYZER_PARSER_EXPORT __attribute__((visibility("default")))
+#endif
+
+#define ANALYZER_PARSER_ABI_VERSION 1
+
+extern "C" {
+
+ANALYZER_PARSER_EXPORT int analyzer_parser_abi_version(void) {
+  return ANALYZER_PARSER_ABI_VERSION;
+}
+
+// Parses the `size` bytes at `data`, the contents of the file at `path`.
+ANALYZER_PARSER_EXPORT int analyzer_parse(const uint8_t *data, size_t size,
+                                          const char *path);
+
+// A parser's main(), called with argv = {"parser", path}. A main() without
+// parameters has C++ linkage instead, which parser_host also looks for.
+ANALYZER_PARSER_EXPORT int analyzer_parser_main(int argc, char **argv);
+}
+
+#define main analyzer_parser_main
+
+#endif // ANALYZER_PARSER_ABI_H
@@ -0,0 +1,127 @@
+// parser_host: runs a generated parser built against parser_abi.h.
+//
+//   parser_host <parser shared object> <input file>
+//
+// Loads the parser and calls its entry point in this process: with the
+// input mapped for analyzer_parse, or with argv = {"parser", input} for a
+// parser's main(). What the parser prints goes to stdout as it would from
+// a standalone program, and its return value is the exit status. Loading
+// failures exit with status 2 so they tell apart from a parser rejecting
+// its input.
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "mapped_file.h"
+
+namespace {
+
+// Must match parser_abi.h
+const int kParserAbiVersion = 1;
+
+using AbiVersionFn = int (*)();
+using ParseFn = int (*)(const uint8_t *, size_t, const char *);
+using MainFn = int (*)(int, char **);
+using PlainMainFn = int (*)();
+
+// Helper: Shared object loading
+//
+// dlopen/LoadLibrary behind one interface. Symbols are resolved when the
+// parser is loaded, so one it calls but never defines fails here, with the
+// loader's message, rather than at the call. The object is never closed:
+// the parser's static destructors run at exit, after its output has been
+// flushed, as they would in a standalone program.
+class SharedObject {
+public:
+  bool open(const std::string &path) {
+#ifdef _WIN32
+    handle_ = LoadLibraryA(path.c_str());
+    if (!handle_)
+      error_ = "LoadLibrary failed with error " +
+               std::to_string(GetLastError());
+#else
+    handle_ = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle_)
+      error_ = dlerror();
+#endif
+    return handle_ != nullptr;
+  }
+
+  template <typename Fn> Fn symbol(const char *name) const {
+#ifdef _WIN32
+    return reinterpret_cast<Fn>(
+        GetProcAddress(static_cast<HMODULE>(handle_), name));
+#else
+    return reinterpret_cast<Fn>(dlsym(handle_, name));
+#endif
+  }
+
+  const std::string &error() const { return error_; }
+
+private:
+  void *handle_ = nullptr;
+  std::string error_;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: parser_host <parser shared object> <input file>"
+              << std::endl;
+    return 2;
+  }
+  const std::string library = argv[1];
+  const std::string input = argv[2];
+
+  SharedObject parser;
+  if (!parser.open(library)) {
+    std::cerr << "Failed to load parser: " << library << ": "
+              << parser.error() << std::endl;
+    return 2;
+  }
+  auto version = parser.symbol<AbiVersionFn>("analyzer_parser_abi_version");
+  if (!version || version() != kParserAbiVersion) {
+    std::cerr << "Not a parser for ABI " << kParserAbiVersion << ": "
+              << library << std::endl;
+    return 2;
+  }
+
+  int status = 0;
+  if (auto parse = parser.symbol<ParseFn>("analyzer_parse")) {
+    MappedFile file;
+    if (!file.open(input)) {
+      std::cerr << "Failed to open file: " << input << std::endl;
+      return 1;
+    }
+    status = parse(file.view().data(), file.view().size(), input.c_str());
+  } else if (auto parserMain = parser.symbol<MainFn>("analyzer_parser_main")) {
+    std::string name = "parser";
+    char *parserArgv[] = {&name[0], argv[2], nullptr};
+    status = parserMain(2, parserArgv);
+  } else if (auto plainMain =
+                 parser.symbol<PlainMainFn>("_Z20analyzer_parser_mainv")) {
+    // int main() with the Itanium C++ mangling (GCC, Clang)
+    status = plainMain();
+  } else {
+    std::cerr << "Parser defines neither analyzer_parse nor main: "
+              << library << std::endl;
+    return 2;
+  }
+
+  // The parser may have written through either stdio or iostreams.
+  std::cout.flush();
+  std::fflush(stdout);
+  return status;
+}
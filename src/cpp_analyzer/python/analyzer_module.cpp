@@ -0,0 +1,608 @@
+// Python module `analyzer`: the analysis in-process, results as arrays.
+//
+//   import analyzer
+//   result = analyzer.analyze("mesh.smsh")      # or bytes, bytearray, mmap,
+//   entropy = result.entropy                    # a numpy array, ...
+//   counts = result.alignment                   # [width][phase][LE, BE]
+//
+// analyze() takes a path (str or os.PathLike) or any contiguous buffer and
+// runs with the GIL released, so analyses on several Python threads run in
+// parallel. The arrays view memory owned by the result: nothing is copied,
+// and each array keeps its result alive. With numpy installed they are
+// numpy arrays; without, memoryviews with the same shape and format.
+//
+// Written against the CPython C API rather than a binding library, so the
+// module builds wherever the Python headers are installed.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <exception>
+#include <initializer_list>
+#include <new>
+#include <string>
+
+#include "analysis.h"
+#include "entropy.h"
+#include "output.h"
+
+namespace {
+
+struct ResultObject {
+  PyObject_HEAD
+  AnalysisResult *result;
+};
+
+// Read-only buffer over memory of a Result: what the arrays are made from.
+struct ViewObject {
+  PyObject_HEAD
+  PyObject *owner;
+  void *data;
+  const char *format;
+  Py_ssize_t itemSize;
+  int ndim;
+  Py_ssize_t shape[3];
+  Py_ssize_t strides[3];
+};
+
+PyTypeObject ResultType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject ViewType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// View methods
+
+void viewDealloc(PyObject *self) {
+  Py_XDECREF(reinterpret_cast<ViewObject *>(self)->owner);
+  Py_TYPE(self)->tp_free(self);
+}
+
+int viewGetBuffer(PyObject *self, Py_buffer *buffer, int flags) {
+  ViewObject *view = reinterpret_cast<ViewObject *>(self);
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "analysis results are read-only");
+    return -1;
+  }
+  Py_ssize_t items = 1;
+  for (int i = 0; i < view->ndim; ++i)
+    items *= view->shape[i];
+  buffer->buf = view->data;
+  buffer->obj = self;
+  Py_INCREF(self);
+  buffer->len = items * view->itemSize;
+  buffer->readonly = 1;
+  buffer->itemsize = view->itemSize;
+  buffer->format =
+      (flags & PyBUF_FORMAT) ? const_cast<char *>(view->format) : nullptr;
+  buffer->ndim = view->ndim;
+  // C-contiguous, so consumers that ask for less just see the bytes
+  buffer->shape = (flags & PyBUF_ND) == PyBUF_ND ? view->shape : nullptr;
+  buffer->strides =
+      (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? view->strides : nullptr;
+  buffer->suboffsets = nullptr;
+  buffer->internal = nullptr;
+  return 0;
+}
+
+PyBufferProcs viewBufferProcs = {viewGetBuffer, nullptr};
+
+// A METH_VARARGS | METH_KEYWORDS function as the PyCFunction the method
+// table holds. Going through void (*)(void) tells -Wcast-function-type the
+// cast is intended; the parameter type checks the signature.
+PyCFunction keywordMethod(PyCFunctionWithKeywords fn) {
+  return reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(fn));
+}
+
+// An array over `data` (owned by `owner`) with the given shape: numpy's if
+// it can be imported, else a memoryview.
+PyObject *makeArray(PyObject *owner, const void *data, const char *format,
+                    Py_ssize_t itemSize, std::initializer_list<size_t> shape) {
+  ViewObject *view = PyObject_New(ViewObject, &ViewType);
+  if (!view)
+    return nullptr;
+  Py_INCREF(owner);
+  view->owner = owner;
+  view->data = const_cast<void *>(data);
+  view->format = format;
+  view->itemSize = itemSize;
+  view->ndim = static_cast<int>(shape.size());
+  int dim = 0;
+  for (size_t extent : shape)
+    view->shape[dim++] = static_cast<Py_ssize_t>(extent);
+  Py_ssize_t stride = itemSize;
+  for (int i = view->ndim - 1; i >= 0; --i) {
+    view->strides[i] = stride;
+    stride *= view->shape[i];
+  }
+  PyObject *object = reinterpret_cast<PyObject *>(view);
+
+  PyObject *array = nullptr;
+  if (PyObject *numpy = PyImport_ImportModule("numpy")) {
+    array = PyObject_CallMethod(numpy, "asarray", "O", object);
+    Py_DECREF(numpy);
+  } else if (PyErr_ExceptionMatches(PyExc_ImportError)) {
+    PyErr_Clear();
+    array = PyMemoryView_FromObject(object);
+  }
+  Py_DECREF(object);
+  return array;
+}
+
+const char *sizeFormat() { return sizeof(size_t) == 8 ? "Q" : "I"; }
+
+// Result methods
+
+void resultDealloc(PyObject *self) {
+  delete reinterpret_cast<ResultObject *>(self)->result;
+  Py_TYPE(self)->tp_free(self);
+}
+
+const AnalysisResult &resultOf(PyObject *self) {
+  return *reinterpret_cast<ResultObject *>(self)->result;
+}
+
+PyObject *resultName(PyObject *self, void *) {
+  const std::string &name = resultOf(self).filename;
+  return PyUnicode_DecodeFSDefaultAndSize(name.data(), name.size());
+}
+
+PyObject *resultSize(PyObject *self, void *) {
+  return PyLong_FromSize_t(resultOf(self).fileSize);
+}
+
+PyObject *resultEntropy(PyObject *self, void *) {
+  const std::vector<float> &map = resultOf(self).entropyMap;
+  return makeArray(self, map.data(), "f", sizeof(float), {map.size()});
+}
+
+PyObject *resultEntropyWindow(PyObject *self, void *) {
+  return PyLong_FromSize_t(resultOf(self).entropyWindow);
+}
+
+PyObject *resultEntropyStride(PyObject *self, void *) {
+  return PyLong_FromSize_t(resultOf(self).entropyStride);
+}
+
+PyObject *resultAlignment(PyObject *self, void *) {
+  const AlignmentCounts &counts = resultOf(self).alignment;
+  return makeArray(self, counts.small, sizeFormat(), sizeof(size_t),
+                   {3, 8, 2});
+}
+
+PyObject *resultFloats(PyObject *self, void *) {
+  const AlignmentCounts &counts = resultOf(self).alignment;
+  return makeArray(self, counts.floats, sizeFormat(), sizeof(size_t),
+                   {3, 8, 2});
+}
+
+PyObject *resultAlignmentScores(PyObject *self, void *) {
+  PyObject *scores = PyDict_New();
+  if (!scores)
+    return nullptr;
+  for (const AlignmentScores::Entry &entry : resultOf(self).alignmentScores) {
+    PyObject *width = PyLong_FromLong(entry.width);
+    PyObject *score = PyLong_FromSize_t(entry.score);
+    int failed = !width || !score || PyDict_SetItem(scores, width, score);
+    Py_XDECREF(width);
+    Py_XDECREF(score);
+    if (failed) {
+      Py_DECREF(scores);
+      return nullptr;
+    }
+  }
+  return scores;
+}
+
+PyObject *resultRecordStride(PyObject *self, void *) {
+  return PyLong_FromSize_t(resultOf(self).patterns.recordStride);
+}
+
+PyObject *resultPatterns(PyObject *self, void *) {
+  const std::vector<RepeatedPattern> &patterns =
+      resultOf(self).patterns.patterns;
+  PyObject *list = PyList_New(static_cast<Py_ssize_t>(patterns.size()));
+  if (!list)
+    return nullptr;
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    const RepeatedPattern &p = patterns[i];
+    PyObject *histogram = PyList_New(RepeatedPattern::kHistogramBins);
+    if (!histogram) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    for (int bin = 0; bin < RepeatedPattern::kHistogramBins; ++bin)
+      PyList_SET_ITEM(histogram, bin,
+                      PyLong_FromUnsignedLong(p.histogram[bin]));
+    PyObject *pattern = Py_BuildValue(
+        "{s:n,s:y#,s:n,s:n,s:n,s:n,s:N}", "length", Py_ssize_t(p.length),
+        "bytes", reinterpret_cast<const char *>(p.bytes),
+        Py_ssize_t(p.length), "count", Py_ssize_t(p.count), "first",
+        Py_ssize_t(p.firstOffset), "period", Py_ssize_t(p.period),
+        "periodCount", Py_ssize_t(p.periodCount), "histogram", histogram);
+    if (!pattern) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), pattern);
+  }
+  return list;
+}
+
+PyObject *periodList(const std::vector<Period> &periods) {
+  PyObject *list = PyList_New(static_cast<Py_ssize_t>(periods.size()));
+  if (!list)
+    return nullptr;
+  for (size_t i = 0; i < periods.size(); ++i) {
+    PyObject *period = Py_BuildValue("{s:n,s:d}", "period",
+                                     Py_ssize_t(periods[i].period), "score",
+                                     double(periods[i].score));
+    if (!period) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), period);
+  }
+  return list;
+}
+
+PyObject *resultBytePeriods(PyObject *self, void *) {
+  return periodList(resultOf(self).periods.bytePeriods);
+}
+
+PyObject *resultWordPeriods(PyObject *self, void *) {
+  return periodList(resultOf(self).periods.wordPeriods);
+}
+
+PyObject *resultRegions(PyObject *self, void *) {
+  const std::vector<Region> &regions = resultOf(self).regions;
+  PyObject *list = PyList_New(static_cast<Py_ssize_t>(regions.size()));
+  if (!list)
+    return nullptr;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    const Region &r = regions[i];
+    auto name = [](int t) {
+      return elementTypeName(static_cast<ElementType>(t));
+    };
+    const float *l = r.likelihood;
+    PyObject *region = Py_BuildValue(
+        "{s:n,s:n,s:s,s:d,s:{s:d,s:d,s:d,s:d,s:d,s:d}}", "offset",
+        Py_ssize_t(r.offset), "size", Py_ssize_t(r.size), "kind",
+        regionKindName(r.kind), "entropy", double(r.entropy), "likelihood",
+        name(0), double(l[0]), name(1), double(l[1]), name(2), double(l[2]),
+        name(3), double(l[3]), name(4), double(l[4]), name(5), double(l[5]));
+    if (!region) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), region);
+  }
+  return list;
+}
+
+PyObject *resultPyramidLevels(PyObject *self, void *) {
+  return PyLong_FromSize_t(resultOf(self).entropyPyramid.levels());
+}
+
+// Parses the level argument of the pyramid methods into *level.
+bool pyramidLevel(PyObject *self, PyObject *args, size_t &level) {
+  Py_ssize_t index;
+  if (!PyArg_ParseTuple(args, "n", &index))
+    return false;
+  if (index < 0 ||
+      size_t(index) >= resultOf(self).entropyPyramid.levels()) {
+    PyErr_SetString(PyExc_IndexError, "pyramid level out of range");
+    return false;
+  }
+  level = size_t(index);
+  return true;
+}
+
+PyObject *resultPyramid(PyObject *self, PyObject *args) {
+  size_t level;
+  if (!pyramidLevel(self, args, level))
+    return nullptr;
+  const std::vector<float> &values =
+      resultOf(self).entropyPyramid.values(level);
+  return makeArray(self, values.data(), "f", sizeof(float), {values.size()});
+}
+
+PyObject *resultPyramidBlockSize(PyObject *self, PyObject *args) {
+  size_t level;
+  if (!pyramidLevel(self, args, level))
+    return nullptr;
+  return PyLong_FromUnsignedLongLong(EntropyPyramid::blockSize(level));
+}
+
+PyObject *resultLevelFor(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static const char *keywords[] = {"begin", "end", "max_blocks", nullptr};
+  unsigned long long begin, end;
+  Py_ssize_t maxBlocks = 64;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "KK|n",
+                                   const_cast<char **>(keywords), &begin,
+                                   &end, &maxBlocks))
+    return nullptr;
+  return PyLong_FromSize_t(resultOf(self).entropyPyramid.levelFor(
+      begin, end, size_t(std::max<Py_ssize_t>(maxBlocks, 1))));
+}
+
+PyObject *resultEntropyRange(PyObject *self, PyObject *args,
+                             PyObject *kwargs) {
+  static const char *keywords[] = {"begin", "end", "data", nullptr};
+  unsigned long long begin, end;
+  PyObject *dataObject = Py_None;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "KK|O",
+                                   const_cast<char **>(keywords), &begin,
+                                   &end, &dataObject))
+    return nullptr;
+  const AnalysisResult &result = resultOf(self);
+  Py_buffer buffer = {};
+  ByteView data = result.source.view();
+  if (dataObject != Py_None) {
+    if (PyObject_GetBuffer(dataObject, &buffer, PyBUF_SIMPLE) < 0)
+      return nullptr;
+    data = ByteView(static_cast<const uint8_t *>(buffer.buf),
+                    static_cast<size_t>(buffer.len));
+  }
+  float entropy = 0.0f;
+  bool ok = result.entropyPyramid.rangeEntropy(data, begin, end, entropy);
+  if (dataObject != Py_None)
+    PyBuffer_Release(&buffer);
+  if (!ok) {
+    PyErr_SetString(PyExc_ValueError,
+                    "the range needs input bytes; pass data=");
+    return nullptr;
+  }
+  return PyFloat_FromDouble(entropy);
+}
+
+PyObject *resultReport(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static const char *keywords[] = {"format", "entropy_map", nullptr};
+  const char *name = "text";
+  int entropyRows = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sp",
+                                   const_cast<char **>(keywords), &name,
+                                   &entropyRows))
+    return nullptr;
+  OutputFormat format;
+  if (!parseOutputFormat(name, format)) {
+    PyErr_Format(PyExc_ValueError, "unknown report format '%s'", name);
+    return nullptr;
+  }
+  try {
+    OutputBuffer out;
+    writeAnalysis(resultOf(self), format, out, entropyRows != 0);
+    const std::string &report = out.data();
+    return PyBytes_FromStringAndSize(report.data(), report.size());
+  } catch (const std::bad_alloc &) {
+    return PyErr_NoMemory();
+  } catch (const std::exception &e) {
+    PyErr_Format(PyExc_RuntimeError, "error writing the report: %s",
+                 e.what());
+  } catch (...) {
+    PyErr_SetString(PyExc_RuntimeError, "unknown error writing the report");
+  }
+  return nullptr;
+}
+
+PyGetSetDef resultGetSet[] = {
+    {"name", resultName, nullptr, "What the report calls the input", nullptr},
+    {"size", resultSize, nullptr, "Input size in bytes", nullptr},
+    {"entropy", resultEntropy, nullptr,
+     "Entropy map, float32 bits per byte per window (a view)", nullptr},
+    {"entropy_window", resultEntropyWindow, nullptr, nullptr, nullptr},
+    {"entropy_stride", resultEntropyStride, nullptr, nullptr, nullptr},
+    {"alignment", resultAlignment, nullptr,
+     "Alignment counts [width 2/4/8][phase][LE, BE] (a view)", nullptr},
+    {"floats", resultFloats, nullptr,
+     "Plausible half/float32/float64 counts, as alignment (a view)",
+     nullptr},
+    {"alignment_scores", resultAlignmentScores, nullptr,
+     "Phase-0 little-endian score per width", nullptr},
+    {"record_stride", resultRecordStride, nullptr,
+     "Record stride the patterns vote for, 0 if none", nullptr},
+    {"patterns", resultPatterns, nullptr, "Repeated n-grams", nullptr},
+    {"byte_periods", resultBytePeriods, nullptr,
+     "Autocorrelation periods of the byte signal", nullptr},
+    {"word_periods", resultWordPeriods, nullptr,
+     "Autocorrelation periods of the 4-byte word signal", nullptr},
+    {"regions", resultRegions, nullptr,
+     "Homogeneous regions covering the input, in order", nullptr},
+    {"pyramid_levels", resultPyramidLevels, nullptr,
+     "Levels of the entropy pyramid, from 4 KiB blocks up", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyMethodDef resultMethods[] = {
+    {"report", keywordMethod(resultReport),
+     METH_VARARGS | METH_KEYWORDS,
+     "report(format='text', entropy_map=False) -> bytes: the report the CLI "
+     "prints with --format (and --entropy-map)"},
+    {"pyramid", resultPyramid, METH_VARARGS,
+     "pyramid(level): entropy per block of the level, float32 (a view)"},
+    {"pyramid_block_size", resultPyramidBlockSize, METH_VARARGS,
+     "pyramid_block_size(level) -> int: bytes per block of the level"},
+    {"level_for", keywordMethod(resultLevelFor),
+     METH_VARARGS | METH_KEYWORDS,
+     "level_for(begin, end, max_blocks=64) -> int: the finest level that "
+     "shows the range in at most max_blocks blocks"},
+    {"entropy_range", keywordMethod(resultEntropyRange),
+     METH_VARARGS | METH_KEYWORDS,
+     "entropy_range(begin, end, data=None) -> float: entropy of bytes "
+     "[begin, end). Analyzed buffers are not kept, so unless the range is "
+     "aligned to 256 KiB pass the same data again."},
+    {nullptr, nullptr, 0, nullptr}};
+
+// Module functions
+
+// PyArg converter for an optional path: None leaves *out null.
+int optionalPath(PyObject *object, void *out) {
+  if (object == Py_None)
+    return 1;
+  return PyUnicode_FSConverter(object, out);
+}
+
+// The analysis itself, run without the GIL. Returns false if the file
+// can't be opened; throws std::bad_alloc.
+bool runAnalysis(const std::string &path, const Py_buffer *buffer,
+                 const std::string &name, const AnalysisOptions &options,
+                 AnalysisResult &result) {
+  if (!buffer)
+    return analyzeFile(path, options, result);
+  result.filename = name;
+  result.entropyWindow = options.entropyWindow;
+  result.entropyStride = options.entropyStride;
+  analyzeBuffer(ByteView(static_cast<const uint8_t *>(buffer->buf),
+                         static_cast<size_t>(buffer->len)),
+                options, result);
+  return true;
+}
+
+PyObject *analyze(PyObject *, PyObject *args, PyObject *kwargs) {
+  static const char *keywords[] = {"source",   "name",    "window",
+                                   "stride",   "threads", "patterns",
+                                   "periods",  "cache_dir", nullptr};
+  AnalysisOptions options;
+  PyObject *source;
+  PyObject *nameObject = nullptr;
+  PyObject *cacheObject = nullptr;
+  Py_ssize_t window = Py_ssize_t(options.entropyWindow), stride = 0;
+  Py_ssize_t threads = Py_ssize_t(options.threads);
+  Py_ssize_t topK = Py_ssize_t(options.patternTopK);
+  Py_ssize_t periods = Py_ssize_t(options.periodTopK);
+  if (!PyArg_ParseTupleAndKeywords(
+          args, kwargs, "O|$O&nnnnnO&", const_cast<char **>(keywords),
+          &source, optionalPath, &nameObject, &window, &stride, &threads,
+          &topK, &periods, optionalPath, &cacheObject))
+    return nullptr;
+  // Same ranges as the CLI
+  if (window < 1 || size_t(window) > kMaxEntropyWindow || stride < 0 ||
+      threads < 0 || threads > 4096 || topK < 0 || topK > 1024 ||
+      periods < 0 || periods > 64) {
+    Py_XDECREF(nameObject);
+    Py_XDECREF(cacheObject);
+    PyErr_SetString(PyExc_ValueError, "analyzer option out of range");
+    return nullptr;
+  }
+  options.entropyWindow = size_t(window);
+  options.entropyStride = stride ? size_t(stride) : size_t(window);
+  options.threads = size_t(threads);
+  options.patternTopK = size_t(topK);
+  options.periodTopK = size_t(periods);
+  if (cacheObject) {
+    options.cacheDir = PyBytes_AS_STRING(cacheObject);
+    Py_DECREF(cacheObject);
+  }
+  std::string name;
+  if (nameObject) {
+    name = PyBytes_AS_STRING(nameObject);
+    Py_DECREF(nameObject);
+  }
+
+  // A path is anything os.fspath accepts except bytes, which are data
+  std::string path;
+  Py_buffer buffer = {};
+  bool isPath = PyUnicode_Check(source) ||
+                PyObject_HasAttrString(source, "__fspath__");
+  if (isPath) {
+    PyObject *encoded = nullptr;
+    if (!PyUnicode_FSConverter(source, &encoded))
+      return nullptr;
+    path = PyBytes_AS_STRING(encoded);
+    Py_DECREF(encoded);
+  } else if (PyObject_GetBuffer(source, &buffer, PyBUF_SIMPLE) < 0) {
+    return nullptr;
+  }
+
+  ResultObject *self = PyObject_New(ResultObject, &ResultType);
+  if (!self) {
+    if (!isPath)
+      PyBuffer_Release(&buffer);
+    return nullptr;
+  }
+  self->result = nullptr;
+  bool opened = false, outOfMemory = false, failed = false;
+  std::string error; // What failed, when not out of memory
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    self->result = new AnalysisResult();
+    opened = runAnalysis(path, isPath ? nullptr : &buffer, name, options,
+                         *self->result);
+  } catch (const std::bad_alloc &) {
+    outOfMemory = true;
+  } catch (const std::exception &e) {
+    failed = true;
+    error = e.what();
+  } catch (...) {
+    failed = true;
+  }
+  Py_END_ALLOW_THREADS
+  if (!isPath)
+    PyBuffer_Release(&buffer);
+  PyObject *object = reinterpret_cast<PyObject *>(self);
+  if (outOfMemory) {
+    Py_DECREF(object);
+    return PyErr_NoMemory();
+  }
+  if (failed) {
+    Py_DECREF(object);
+    std::string input = !name.empty() ? name : isPath ? path : "the buffer";
+    if (error.empty())
+      PyErr_Format(PyExc_RuntimeError, "unknown error analyzing %s",
+                   input.c_str());
+    else
+      PyErr_Format(PyExc_RuntimeError, "error analyzing %s: %s",
+                   input.c_str(), error.c_str());
+    return nullptr;
+  }
+  if (!opened) {
+    Py_DECREF(object);
+    PyErr_Format(PyExc_OSError, "could not open %s", path.c_str());
+    return nullptr;
+  }
+  return object;
+}
+
+PyMethodDef moduleMethods[] = {
+    {"analyze", keywordMethod(analyze),
+     METH_VARARGS | METH_KEYWORDS,
+     "analyze(source, *, name=None, window=64, stride=0, threads=1, "
+     "patterns=4, periods=4, cache_dir=None) -> Result\n\n"
+     "Analyzes a file (source is a path) or a buffer, with the GIL "
+     "released. The options are the CLI's; stride 0 means the window, "
+     "threads 0 every core."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef moduleDef = {PyModuleDef_HEAD_INIT, "analyzer",
+                         "Binary format analysis, in-process.", -1,
+                         moduleMethods};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_analyzer(void) {
+  ViewType.tp_name = "analyzer.View";
+  ViewType.tp_basicsize = sizeof(ViewObject);
+  ViewType.tp_dealloc = viewDealloc;
+  ViewType.tp_as_buffer = &viewBufferProcs;
+  ViewType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ViewType.tp_doc = "Read-only buffer over analysis result memory";
+
+  ResultType.tp_name = "analyzer.Result";
+  ResultType.tp_basicsize = sizeof(ResultObject);
+  ResultType.tp_dealloc = resultDealloc;
+  ResultType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ResultType.tp_doc = "Analysis of one input, as returned by analyze()";
+  ResultType.tp_getset = resultGetSet;
+  ResultType.tp_methods = resultMethods;
+
+  if (PyType_Ready(&ViewType) < 0 || PyType_Ready(&ResultType) < 0)
+    return nullptr;
+  PyObject *module = PyModule_Create(&moduleDef);
+  if (!module)
+    return nullptr;
+  Py_INCREF(&ResultType);
+  if (PyModule_AddObject(module, "Result",
+                         reinterpret_cast<PyObject *>(&ResultType)) < 0) {
+    Py_DECREF(&ResultType);
+    Py_DECREF(module);
+    return nullptr;
+  }
+  return module;
+}
@@ -0,0 +1,267 @@
+#include "alignment.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// The kernel is always built for the compile-time target, and on x86 with
+// GCC or Clang also for AVX2 and AVX-512BW when the target lacks them; the
+// best one the CPU supports is picked on first use.
+#if defined(__AVX512BW__)
+#include <immintrin.h>
+#define ALIGNMENT_AVX512 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define ALIGNMENT_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ALIGNMENT_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ALIGNMENT_NEON 1
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#if !defined(__AVX2__)
+#define ALIGNMENT_DISPATCH_AVX2 1
+#endif
+#if !defined(__AVX512BW__)
+#define ALIGNMENT_DISPATCH_AVX512 1
+#endif
+#endif
+
+void AlignmentCounts::merge(const AlignmentCounts &other) {
+  for (int w = 0; w < 3; ++w)
+    for (int p = 0; p < 8; ++p)
+      for (int e = 0; e < 2; ++e) {
+        small[w][p][e] += other.small[w][p][e];
+        floats[w][p][e] += other.floats[w][p][e];
+      }
+}
+
+namespace {
+
+// "Small integer" thresholds per width. Counts and indices rarely need more
+// than 12 bits in a 16-bit field; 32- and 64-bit fields keep the original
+// < 100000 heuristic.
+//
+// 100000 = 0x000186A0, so a 32-bit value is small when its top byte is 0 and
+// either its second byte is 0, or it is 1 and the low 16 bits are < 0x86A0.
+// Every test below is written in terms of per-byte predicates so that they
+// can be evaluated for all byte offsets at once.
+//
+// A float is plausible when it is zero, or when the low 7 bits of its top
+// byte (the sign masked off) put the exponent in a range real data lives
+// in: 0x20 .. 0x5F for half (2^-7 <= |x| < 2^9), 0x30 .. 0x4F for float32
+// (2^-31 <= |x| < 2^33) and 0x3C .. 0x43 for float64 (2^-63 <= |x| <
+// 2^64). That excludes infinities, NaNs and denormals, which is what small
+// integers, counters and most non-float bytes read as; random bytes pass
+// the three tests at 1/2, 1/4 and 1/16.
+
+// Bit i of each mask describes byte i of a 64-byte unit.
+struct ByteMasks {
+  uint64_t zero; // == 0x00
+  uint64_t one;  // == 0x01
+  uint64_t lt10; // < 0x10 (high byte of a 16-bit value < 0x1000)
+  uint64_t lt86; // < 0x86
+  uint64_t eq86; // == 0x86
+  uint64_t ltA0; // < 0xA0
+  uint64_t f16;  // Top byte of a plausible half, sign masked off
+  uint64_t f32;  // Same for float32
+  uint64_t f64;  // Same for float64
+};
+
+// Bit i of the result is bit i + k of the 128-bit value (next:cur).
+inline uint64_t ahead(uint64_t cur, uint64_t next, int k) {
+  return (cur >> k) | (next << (64 - k));
+}
+
+// Bits i < n set (n in [0, 64]).
+inline uint64_t lowBits(size_t n) {
+  return n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+}
+
+namespace baseline {
+#if defined(ALIGNMENT_AVX512)
+#define KERNEL_AVX512 1
+const char *const kName = "avx512";
+#elif defined(ALIGNMENT_AVX2)
+#define KERNEL_AVX2 1
+const char *const kName = "avx2";
+#elif defined(ALIGNMENT_SSE2)
+#define KERNEL_SSE2 1
+const char *const kName = "sse2";
+#elif defined(ALIGNMENT_NEON)
+#define KERNEL_NEON 1
+const char *const kName = "neon";
+#else
+const char *const kName = "scalar";
+#endif
+#include "alignment_kernel.inc"
+#undef KERNEL_AVX512
+#undef KERNEL_AVX2
+#undef KERNEL_SSE2
+#undef KERNEL_NEON
+} // namespace baseline
+
+#if defined(ALIGNMENT_DISPATCH_AVX2)
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))),              \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+namespace avx2 {
+#define KERNEL_AVX2 1
+#include "alignment_kernel.inc"
+#undef KERNEL_AVX2
+} // namespace avx2
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
+
+#if defined(ALIGNMENT_DISPATCH_AVX512)
+#if defined(__clang__)
+#pragma clang attribute push(                                                 \
+    __attribute__((target("avx2,avx512f,avx512bw"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,avx512f,avx512bw")
+#endif
+namespace avx512 {
+#define KERNEL_AVX512 1
+#include "alignment_kernel.inc"
+#undef KERNEL_AVX512
+} // namespace avx512
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
+
+using CountUnits = void (*)(ByteView, size_t, size_t, AlignmentCounts &,
+                            uint8_t *);
+
+struct Kernel {
+  const char *name;
+  CountUnits countUnits;
+};
+
+// Helper: Select the kernel
+//
+// The widest kernel built in that the CPU runs. ANALYZER_CPU=sse2 or avx2
+// in the environment caps it, to compare kernels on one machine; the
+// compile-time target is never undercut.
+Kernel selectKernel() {
+  Kernel kernel = {baseline::kName, baseline::countUnits};
+#if defined(ALIGNMENT_DISPATCH_AVX2) || defined(ALIGNMENT_DISPATCH_AVX512)
+  const char *cap = std::getenv("ANALYZER_CPU");
+  bool allowAvx2 = !cap || std::strcmp(cap, "sse2") != 0;
+  bool allowAvx512 = allowAvx2 && (!cap || std::strcmp(cap, "avx2") != 0);
+  __builtin_cpu_init();
+#endif
+#if defined(ALIGNMENT_DISPATCH_AVX2)
+  if (allowAvx2 && __builtin_cpu_supports("avx2"))
+    kernel = {"avx2", avx2::countUnits};
+#endif
+#if defined(ALIGNMENT_DISPATCH_AVX512)
+  if (allowAvx512 && __builtin_cpu_supports("avx512bw"))
+    kernel = {"avx512", avx512::countUnits};
+#endif
+  return kernel;
+}
+
+const Kernel &activeKernel() {
+  static const Kernel kernel = selectKernel();
+  return kernel;
+}
+
+} // namespace
+
+// Helper: Check alignment
+//
+// Detects if data is aligned to 2, 4, or 8 byte boundaries.
+// This is crucial for identifying arrays of integers or floats.
+//
+// Heuristic:
+// We interpret the data as 2, 4 and 8-byte values at every phase offset and
+// in both byte orders. If the values look like "small integers" (indices,
+// counts), we increment that combination's score. A high score suggests a
+// structured array at that width and phase. The same values are scored as
+// half, float32 and float64 too, into the float counts: zero, or normal
+// with a sane exponent.
+//
+// Rather than decoding each value, each 64-byte unit is turned into a few
+// per-byte predicate bitmasks (== 0, < 0x10, ...) with SIMD compares. Shifts
+// and ANDs of those masks evaluate the test at all 64 offsets at once, and a
+// positional bit count per phase does the counting, so one pass scores
+// every combination.
+void checkAlignment(ByteView data, AnalysisResult &result) {
+  AlignmentAccumulator acc;
+  acc.feed(data);
+  acc.finish(result);
+}
+
+void countAlignment(ByteView data, size_t begin, size_t end,
+                    AlignmentCounts &counts, uint8_t *unitBest) {
+  end = std::min(end, data.size());
+  if (begin >= end)
+    return;
+  activeKernel().countUnits(data, begin, end, counts, unitBest);
+}
+
+const char *alignmentKernel() { return activeKernel().name; }
+
+void AlignmentAccumulator::feed(ByteView block) {
+  // Scoring a unit needs 7 bytes of lookahead; keep 8 for simplicity.
+  const size_t kLookahead = 8;
+  size_t pos = 0;
+
+  // Finish the units that started in earlier blocks, then drop back to
+  // scoring straight from the block at the next unit boundary.
+  if (!pending_.empty()) {
+    size_t units = (pending_.size() + 63) / 64;
+    size_t target = units * 64 + kLookahead;
+    size_t take = std::min(block.size(), target - pending_.size());
+    pending_.insert(pending_.end(), block.begin(), block.begin() + take);
+    if (pending_.size() < target)
+      return;
+    countAlignment(ByteView(pending_.data(), pending_.size()), 0, units * 64,
+                   counts_);
+    pending_.clear();
+    pos = take - kLookahead;
+  }
+
+  size_t rest = block.size() - pos;
+  if (rest >= 64 + kLookahead) {
+    size_t units = (rest - kLookahead) / 64;
+    countAlignment(block.subview(pos, units * 64 + kLookahead), 0, units * 64,
+                   counts_);
+    pos += units * 64;
+  }
+
+  pending_.assign(block.begin() + pos, block.end());
+}
+
+void AlignmentAccumulator::finish(AnalysisResult &result) {
+  countAlignment(ByteView(pending_.data(), pending_.size()), 0,
+                 pending_.size(), counts_);
+  pending_.clear();
+
+  storeAlignment(counts_, result);
+}
+
+void storeAlignment(const AlignmentCounts &counts, AnalysisResult &result) {
+  result.alignment = counts;
+  for (int w = 0; w < 3; ++w)
+    result.alignmentScores.entries[w] = {AlignmentCounts::kWidths[w],
+                                         counts.small[w][0][0]};
+  result.alignmentScores.count = 3;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "analysis.h"
+#include "byte_view.h"
+
+// Scores 2/4/8-byte alignment of `data` into result.alignment and
+// result.alignmentScores.
+void checkAlignment(ByteView data, AnalysisResult &result);
+
+// Counts the elements starting in data[begin, end) for every width, phase
+// and endianness, adding them to `counts`. `begin` must be a multiple of 64.
+// Elements may extend past `end` but must fit inside `data`, so tiles can
+// be counted independently and merged.
+//
+// With `unitBest`, also stores for each 64-byte unit the number of 2-, 4-
+// and 8-byte elements starting in it that look like small integers, at the
+// unit's best phase and byte order, in unitBest[kUnitBestSize * unit + w],
+// and of those that look like floats in unitBest[kUnitBestSize * unit + 3 +
+// w]: the local form of the counts that region segmentation uses.
+const size_t kUnitBestSize = 6;
+void countAlignment(ByteView data, size_t begin, size_t end,
+                    AlignmentCounts &counts, uint8_t *unitBest = nullptr);
+
+// The instruction set of the countAlignment kernel this process runs:
+// "avx512", "avx2", "sse2", "neon" or "scalar". x86 builds carry AVX2 and
+// AVX-512BW kernels beside their baseline and choose when first called.
+const char *alignmentKernel();
+
+// Set bits of `v`. The builtin is a library call without a popcount
+// instruction, slower than the bit trick.
+inline int popcount64(uint64_t v) {
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__POPCNT__) || defined(__aarch64__))
+  return __builtin_popcountll(v);
+#else
+  v = v - ((v >> 1) & 0x5555555555555555ull);
+  v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+  v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+  return static_cast<int>((v * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+// Set bits of `mask` at the positions i with i % width == phase, for width
+// 2, 4 or 8: the phase's bits are summed into bytes and the bytes added
+// with one multiply.
+inline int phaseCount(uint64_t mask, int width, int phase) {
+  const uint64_t bytes = 0x0101010101010101ull;
+  uint64_t x = mask >> phase;
+  if (width == 2) {
+    x &= 0x5555555555555555ull;
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+  } else if (width == 4) {
+    x &= 0x1111111111111111ull;
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+  } else {
+    x &= bytes;
+  }
+  return static_cast<int>((x * bytes) >> 56);
+}
+
+// Stores merged counts in result.alignment and the phase-0 little-endian
+// score of each width in result.alignmentScores.
+void storeAlignment(const AlignmentCounts &counts, AnalysisResult &result);
+
+// Incremental form of checkAlignment for streaming input. Blocks of any size
+// can be fed in; elements that straddle a block boundary are carried over,
+// so the counts match checkAlignment over the concatenated input.
+class AlignmentAccumulator {
+public:
+  void feed(ByteView block);
+  void finish(AnalysisResult &result);
+
+private:
+  AlignmentCounts counts_;
+  // Unscored bytes starting at a 64-byte boundary of the stream
+  std::vector<uint8_t> pending_;
+};
@@ -0,0 +1,224 @@
+#include "analysis.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#include "alignment.h"
+#include "arena.h"
+#include "autocorrelation.h"
+#include "cache.h"
+#include "entropy.h"
+#include "patterns.h"
+#include "profile.h"
+#include "regions.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Sized to stay resident in a core's L2 while every pass reads it. Tiles
+// are whole pyramid blocks, so each builds its own histograms.
+const size_t kTileSize = 256 * 1024;
+static_assert(kTileSize == EntropyPyramid::kHistogramBlock,
+              "a tile is one level-1 pyramid block");
+
+size_t ceilDiv(size_t a, size_t b) { return (a + b - 1) / b; }
+
+// Each tile rebuilds the sliding histogram for its first window, so keep
+// tiles large next to the window. Tiles stay a multiple of kTileSize (so
+// of 64 bytes, the unit the alignment scorer works in).
+size_t tileSizeFor(size_t window) {
+  return ceilDiv(std::max(kTileSize, window * 4), kTileSize) * kTileSize;
+}
+
+// The part of a file's result that doesn't depend on its bytes.
+void startResult(const std::string &filepath, const AnalysisOptions &options,
+                 AnalysisResult &result) {
+  result.clear();
+  result.filename = filepath;
+  result.entropyWindow = options.entropyWindow;
+  result.entropyStride = options.entropyStride;
+}
+
+} // namespace
+
+void AnalysisResult::clear() {
+  filename.clear();
+  fileSize = 0;
+  source.close();
+  entropyMap.clear();
+  entropyWindow = 64;
+  entropyStride = 64;
+  entropyPyramid.clear();
+  alignment = AlignmentCounts();
+  alignmentScores = AlignmentScores();
+  patterns.patterns.clear();
+  patterns.recordStride = 0;
+  patterns.strideVotes = 0;
+  patterns.totalVotes = 0;
+  periods.regionOffset = 0;
+  periods.regionSize = 0;
+  periods.bytePeriods.clear();
+  periods.wordPeriods.clear();
+  regions.clear();
+}
+
+AnalysisResult analyzeFile(const std::string &filepath,
+                           const AnalysisOptions &options, ThreadPool *pool) {
+  AnalysisResult result;
+  analyzeFile(filepath, options, result, pool);
+  return result;
+}
+
+bool analyzeFile(const std::string &filepath, const AnalysisOptions &options,
+                 AnalysisResult &result, ThreadPool *pool) {
+  startResult(filepath, options, result);
+
+  // Map the file instead of reading it; every pass below works on a view
+  // over the mapping, so nothing is copied out of the page cache.
+  {
+    ProfileZone zone(ProfilePhase::Load);
+    if (!result.source.open(filepath)) {
+      std::cerr << "Failed to open file: " << filepath << std::endl;
+      return false;
+    }
+    zone.addBytes(result.source.view().size());
+  }
+  analyzeBuffer(result.source.view(), options, result, pool);
+  return true;
+}
+
+void analyzeFile(const std::string &filepath, std::vector<uint8_t> &&bytes,
+                 const AnalysisOptions &options, AnalysisResult &result,
+                 ThreadPool *pool) {
+  startResult(filepath, options, result);
+  result.source.adopt(std::move(bytes));
+  analyzeBuffer(result.source.view(), options, result, pool);
+}
+
+void analyzeBuffer(ByteView data, const AnalysisOptions &options,
+                   AnalysisResult &result, ThreadPool *pool) {
+  result.fileSize = data.size();
+
+  std::unique_ptr<ThreadPool> ownedPool;
+  size_t threads = resolveThreadCount(options.threads);
+  if (!pool && threads > 1 && data.size() > kTileSize) {
+    ownedPool = std::make_unique<ThreadPool>(threads - 1);
+    pool = ownedPool.get();
+  }
+
+  uint64_t key = 0;
+  if (!options.cacheDir.empty()) {
+    key = analysisCacheKey(data, options);
+    if (loadCachedAnalysis(options.cacheDir, key, result))
+      return;
+  }
+
+  // A miss may still be a file seen before with a few blocks changed.
+  // Only inputs of several tiles have any to reuse.
+  std::unique_ptr<BlockCache> blocks;
+  if (!options.cacheDir.empty() && !result.filename.empty() &&
+      data.size() > tileSizeFor(options.entropyWindow))
+    blocks = std::make_unique<BlockCache>(
+        options.cacheDir, result.filename, options, data,
+        tileSizeFor(options.entropyWindow), regionCellSize(data.size()));
+
+  analyzeData(data, options, result, pool, blocks.get());
+  if (!options.cacheDir.empty())
+    storeCachedAnalysis(options.cacheDir, key, result);
+}
+
+void analyzeData(ByteView data, const AnalysisOptions &options,
+                 AnalysisResult &result, ThreadPool *pool,
+                 BlockCache *blocks) {
+  const size_t window = options.entropyWindow;
+  const size_t stride = options.entropyStride;
+  result.entropyWindow = window;
+  result.entropyStride = stride;
+
+  const size_t tileSize = tileSizeFor(window);
+  const size_t tiles = ceilDiv(data.size(), tileSize);
+  const size_t windows = entropyWindowCount(data.size(), window, stride);
+
+  result.entropyMap.resize(windows);
+  result.entropyPyramid.reset(data.size());
+  ArenaScope scope;
+  ScratchVector<AlignmentCounts> alignment(tiles, scope.resource());
+  // Region cells divide tiles, so each tile measures its own
+  const size_t cellSize = regionCellSize(data.size());
+  ScratchVector<RegionCell> cells(ceilDiv(data.size(), cellSize),
+                                  RegionCell(), scope.resource());
+  const float *unitEntropy = window == 64 && stride == 64
+                                 ? result.entropyMap.data()
+                                 : nullptr;
+
+  auto runTile = [&](size_t t) {
+    size_t begin = t * tileSize;
+    size_t end = std::min(begin + tileSize, data.size());
+
+    // Unchanged since the last analysis of this file: copy its results
+    if (blocks && blocks->restoreTile(t, blocks->tileChecksum(t), result,
+                                      alignment[t], cells.data()))
+      return;
+
+    // Calculate Entropy Map: the windows that start inside this tile
+    {
+      ProfileZone zone(ProfilePhase::Entropy, end - begin);
+      size_t first = std::min(ceilDiv(begin, stride), windows);
+      size_t last = std::min(ceilDiv(end, stride), windows);
+      computeEntropyWindows(data, window, stride, first, last - first,
+                            result.entropyMap.data() + first);
+    }
+
+    // Entropy Pyramid: the tile's 4 KiB and 256 KiB blocks
+    {
+      ProfileZone zone(ProfilePhase::Pyramid, end - begin);
+      result.entropyPyramid.buildBlocks(data, begin / kTileSize,
+                                        ceilDiv(end, kTileSize));
+    }
+
+    // Check Alignment: elements that start inside this tile, and the best
+    // small-integer and float counts of each of its units for the region
+    // cells
+    ArenaScope tileScope;
+    ScratchVector<uint8_t> unitBest(kUnitBestSize * ceilDiv(end - begin, 64),
+                                    0, tileScope.resource());
+    {
+      ProfileZone zone(ProfilePhase::Alignment, end - begin);
+      countAlignment(data, begin, end, alignment[t], unitBest.data());
+    }
+
+    // Region Cells: byte and element statistics per cell
+    ProfileZone zone(ProfilePhase::Regions, end - begin);
+    measureRegionCells(data, begin, end, cellSize, unitEntropy,
+                       unitBest.data(), cells.data() + begin / cellSize);
+  };
+
+  if (pool && tiles > 1) {
+    pool->parallelFor(tiles, runTile);
+  } else {
+    for (size_t t = 0; t < tiles; ++t)
+      runTile(t);
+  }
+
+  result.entropyPyramid.finish();
+
+  AlignmentCounts total;
+  for (const AlignmentCounts &tile : alignment)
+    total.merge(tile);
+  storeAlignment(total, result);
+
+  // Segment Regions: change points over the cells
+  findRegions(data, cells.data(), cells.size(), cellSize, unitEntropy,
+              result);
+
+  // Find Repeating Patterns: whole-buffer passes, one task per length
+  findPatterns(data, options, result, pool);
+
+  // Find Record Periods: autocorrelation over (a region of) the buffer
+  if (!blocks || !blocks->restorePeriods(result.periods))
+    findPeriods(data, options, result, pool);
+
+  if (blocks)
+    blocks->store(result, alignment.data(), cells.data());
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "byte_view.h"
+#include "entropy_pyramid.h"
+#include "mapped_file.h"
+
+class BlockCache;
+class ThreadPool;
+
+// Basic Analysis Structures
+
+// Knobs shared by every analysis mode.
+struct AnalysisOptions {
+  size_t entropyWindow = 64; // Bytes per entropy map value
+  size_t entropyStride = 64; // Distance between window starts
+  size_t threads = 1;        // Worker threads for tiled passes; 0 = all cores
+  size_t patternTopK = 4;    // Repeated n-grams reported per length; 0 = off
+  size_t periodTopK = 4;     // Autocorrelation periods per signal; 0 = off
+  std::string cacheDir;      // Persistent result cache (--cache); empty = off
+};
+
+// Small-integer and plausible-float counts for every element width (2, 4,
+// 8 bytes), phase (element offset modulo width) and byte order. A format
+// built from N-byte fields shows a peak at one phase of width N; comparing
+// the LE and BE columns tells the byte order, and comparing small with
+// floats whether the fields are integers or half/float32/float64 values.
+struct AlignmentCounts {
+  static constexpr int kWidths[3] = {2, 4, 8};
+  // small[widthIndex][phase][0 = little endian, 1 = big endian]
+  size_t small[3][8][2] = {};
+  // Same layout: IEEE-754 values of the width that are zero, or normal
+  // with a magnitude typical of real data (see checkAlignment)
+  size_t floats[3][8][2] = {};
+
+  void merge(const AlignmentCounts &other);
+};
+
+// Phase-0 little-endian score of each width, in kWidths order. Iterates
+// like the map it replaces, without a node per entry; empty until the
+// alignment pass has run.
+struct AlignmentScores {
+  struct Entry {
+    int width;
+    size_t score;
+  };
+
+  Entry entries[3] = {};
+  size_t count = 0;
+
+  const Entry *begin() const { return entries; }
+  const Entry *end() const { return entries + count; }
+  size_t size() const { return count; }
+};
+
+// An n-gram that occurs more than once in the input.
+struct RepeatedPattern {
+  static const int kHistogramBins = 16;
+
+  size_t length = 0;      // n-gram length in bytes (4, 8, 12 or 16)
+  uint8_t bytes[16] = {}; // The n-gram; bytes past `length` are zero
+  size_t count = 0;       // Occurrences, overlapping ones included
+  size_t firstOffset = 0;
+  size_t period = 0;      // Most common gap between consecutive occurrences
+  size_t periodCount = 0; // Gaps equal to `period` (a lower bound)
+  // Occurrences per sixteenth of the input: a record table shows an even
+  // band over its region, a magic number a single spike.
+  uint32_t histogram[kHistogramBins] = {};
+};
+
+struct PatternSummary {
+  static constexpr size_t kLengths[4] = {4, 8, 12, 16};
+
+  std::vector<RepeatedPattern> patterns; // By length, then count descending
+  size_t recordStride = 0; // Period with the most gap votes; 0 if none
+  size_t strideVotes = 0;  // Gaps equal to recordStride over all patterns
+  size_t totalVotes = 0;   // Gaps between consecutive occurrences, all patterns
+};
+
+// A lag at which the input correlates with itself.
+struct Period {
+  size_t period = 0; // In bytes
+  float score = 0;   // Normalized autocorrelation at that lag, up to 1
+};
+
+struct PeriodSummary {
+  size_t regionOffset = 0; // Bytes the autocorrelation was computed over
+  size_t regionSize = 0;
+  std::vector<Period> bytePeriods; // Byte signal, strongest first
+  std::vector<Period> wordPeriods; // 4-byte word signal, strongest first
+};
+
+// What a region of the input holds, from its byte and element statistics.
+enum class RegionKind {
+  Header,     // The first region, when it is small and others follow
+  Padding,    // Zeros or a repeated fill byte
+  Text,       // Printable ASCII
+  Int16,      // Arrays of small 2-, 4- or 8-byte integers (counts, indices)
+  Int32,
+  Int64,
+  Float16,    // Arrays of plausible 2-, 4- or 8-byte IEEE-754 values
+  Float32,
+  Float64,
+  Compressed, // Near 8 bits per byte: compressed, encrypted or random
+  Mixed       // None of the above: records, code, packed structures
+};
+
+// The kind's name in reports ("header", "int32", ...).
+const char *regionKindName(RegionKind kind);
+
+// Element types a region is scored for, in Region::likelihood order.
+enum class ElementType { Int16, Int32, Int64, Float16, Float32, Float64 };
+const int kElementTypes = 6;
+
+// The type's name in reports ("int16", "float32", ...).
+const char *elementTypeName(ElementType type);
+
+// A run of the input with homogeneous content (see regions.h).
+struct Region {
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  RegionKind kind = RegionKind::Mixed;
+  float entropy = 0; // Bits per byte over the whole region
+  // Per ElementType, the share of the region's elements of that width that
+  // pass the type's test (small integer, plausible float), at the best
+  // phase and byte order of each 64-byte unit
+  float likelihood[kElementTypes] = {};
+};
+
+// Move-only: a result owns its mapping, and its buffers are meant to be
+// handed on or reused (see clear()), never duplicated.
+struct AnalysisResult {
+  AnalysisResult() = default;
+  AnalysisResult(const AnalysisResult &) = delete;
+  AnalysisResult &operator=(const AnalysisResult &) = delete;
+  AnalysisResult(AnalysisResult &&) = default;
+  AnalysisResult &operator=(AnalysisResult &&) = default;
+
+  // Back to the empty state, unmapping the input but keeping the capacity
+  // of every buffer for the next file.
+  void clear();
+
+  std::string filename;
+  size_t fileSize = 0;
+  MappedFile source;             // Mapped input; passes read source.view()
+  std::vector<float> entropyMap; // Entropy per window
+  size_t entropyWindow = 64;     // Window/stride the map was built with
+  size_t entropyStride = 64;
+  EntropyPyramid entropyPyramid; // Entropy per 4 KiB block and coarser
+  AlignmentCounts alignment;       // Per width/phase/endianness scores
+  AlignmentScores alignmentScores; // Alignment -> Score (phase 0, LE)
+  PatternSummary patterns;         // Repeated n-grams and their period
+  PeriodSummary periods;           // Autocorrelation record periods
+  std::vector<Region> regions;     // Homogeneous runs covering the input
+};
+
+// Helper: Analyze a file
+//
+// Maps `filepath` and runs every pass over it (see analyzeData). On failure
+// the error is reported on stderr and an empty result is returned. With
+// options.cacheDir set, results are looked up in and added to the
+// persistent cache (see cache.h) first, and a file that changed since its
+// last analysis only recomputes the tiles that did.
+AnalysisResult analyzeFile(const std::string &filepath,
+                           const AnalysisOptions &options,
+                           ThreadPool *pool = nullptr);
+
+// Same, into a result that may be reused from an earlier file: its buffers
+// keep their capacity, so analyzing a run of files allocates only when one
+// needs more than any before it. Returns false if the file can't be opened.
+bool analyzeFile(const std::string &filepath, const AnalysisOptions &options,
+                 AnalysisResult &result, ThreadPool *pool = nullptr);
+
+// Same, for a file already read into `bytes` (batch mode reads ahead, see
+// prefetch.h): they become result.source.
+void analyzeFile(const std::string &filepath, std::vector<uint8_t> &&bytes,
+                 const AnalysisOptions &options, AnalysisResult &result,
+                 ThreadPool *pool = nullptr);
+
+// The part of analyzeFile after mapping: runs every pass over `data` (an
+// in-memory buffer; result.source is left alone) with the thread count and
+// cache of `options`. Uses `pool` if given, else makes one for
+// options.threads when the data is large enough to split.
+void analyzeBuffer(ByteView data, const AnalysisOptions &options,
+                   AnalysisResult &result, ThreadPool *pool = nullptr);
+
+// Runs every pass over `data` and stores the results in `result`.
+//
+// The buffer is split into cache-sized tiles and all passes run on a tile
+// while it is hot. Tiles are independent: entropy windows are written to
+// their slot in the map and alignment partial counts are merged in tile
+// order, so any thread count gives output identical to a single thread.
+// Tiles run on `pool` when one is given. With `blocks` (analyzeBuffer
+// makes one for a cached input it has seen under the same path), tiles
+// and periods whose bytes haven't changed are copied instead of computed,
+// and the new results are stored back.
+void analyzeData(ByteView data, const AnalysisOptions &options,
+                 AnalysisResult &result, ThreadPool *pool = nullptr,
+                 BlockCache *blocks = nullptr);
@@ -0,0 +1,57 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace {
+
+// Blocks beyond this much are freed when a scope ends instead of being
+// kept: one analysis of a huge input shouldn't pin its scratch for good.
+const size_t kRetainedBytes = size_t(64) << 20;
+
+} // namespace
+
+Arena::Arena(size_t blockSize) : blockSize_(blockSize) {}
+
+Arena::~Arena() {
+  for (Block &block : blocks_)
+    ::operator delete(block.data);
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+  for (; current_ < blocks_.size(); ++current_, used_ = 0) {
+    Block &block = blocks_[current_];
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+    size_t start = ((base + used_ + alignment - 1) & ~(alignment - 1)) - base;
+    if (start <= block.size && bytes <= block.size - start) {
+      used_ = start + bytes;
+      return block.data + start;
+    }
+  }
+
+  // Blocks come from operator new, aligned for any fundamental type; larger
+  // alignments get slack to round up into.
+  size_t size = std::max(blockSize_, bytes + alignment);
+  Block block{static_cast<char *>(::operator new(size)), size};
+  blocks_.push_back(block);
+  capacity_ += size;
+  current_ = blocks_.size() - 1;
+  used_ = 0;
+  return do_allocate(bytes, alignment);
+}
+
+void Arena::rewind(Mark mark) {
+  current_ = mark.block;
+  used_ = mark.used;
+  while (capacity_ > kRetainedBytes && blocks_.size() > current_ + 1) {
+    capacity_ -= blocks_.back().size;
+    ::operator delete(blocks_.back().data);
+    blocks_.pop_back();
+  }
+}
+
+Arena &threadArena() {
+  thread_local Arena arena;
+  return arena;
+}
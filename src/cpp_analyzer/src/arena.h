@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Helper: Scratch arena
+//
+// Monotonic bump allocator for the scratch buffers of an analysis (n-gram
+// tables, FFT blocks, per-tile partial counts). Allocation is a pointer
+// bump and deallocation is a no-op; everything allocated since a mark is
+// released at once by rewinding to it. Blocks are kept for reuse, so once a
+// thread's arena has grown to the footprint of the largest analysis it has
+// run, analyzing another file allocates nothing from the heap.
+//
+// Each thread has its own arena (threadArena()), so allocation takes no
+// lock. Memory may be used from any thread, but must only be allocated by
+// the owner. Scopes nest like the stack: a pool thread that runs other
+// tasks while waiting has them finish (and rewind) before it continues.
+// A container created outside a scope must not grow inside it (its new
+// storage would be released with the scope), so outputs are sized first.
+class Arena : public std::pmr::memory_resource {
+public:
+  struct Mark {
+    size_t block = 0;
+    size_t used = 0;
+  };
+
+  explicit Arena(size_t blockSize = size_t(1) << 20);
+  ~Arena() override;
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  Mark mark() const { return {current_, used_}; }
+  // Releases everything allocated since `mark`.
+  void rewind(Mark mark);
+
+  // Bytes held in blocks, used or not.
+  size_t capacity() const { return capacity_; }
+
+private:
+  struct Block {
+    char *data;
+    size_t size;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *, size_t, size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+  std::vector<Block> blocks_;
+  size_t current_ = 0; // Block being bumped
+  size_t used_ = 0;    // Bytes used in it
+  size_t capacity_ = 0;
+  size_t blockSize_;
+};
+
+// The calling thread's arena.
+Arena &threadArena();
+
+// Scratch allocations for the lifetime of a scope: rewinds the thread's
+// arena on exit. Converts to the memory resource for pmr containers.
+class ArenaScope {
+public:
+  ArenaScope() : arena_(threadArena()), mark_(arena_.mark()) {}
+  ~ArenaScope() { arena_.rewind(mark_); }
+
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+
+  Arena *resource() { return &arena_; }
+
+private:
+  Arena &arena_;
+  Arena::Mark mark_;
+};
+
+// Vector in scratch memory: ScratchVector<double> v(n, scope.resource()).
+template <typename T> using ScratchVector = std::pmr::vector<T>;
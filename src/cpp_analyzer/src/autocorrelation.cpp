@@ -0,0 +1,270 @@
+#include "autocorrelation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "arena.h"
+#include "fft.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+namespace {
+
+using Complex = Fft::Complex;
+
+// Blocks summed by one task. Fixed, so the floating-point summation order
+// (and with it the output) is the same for every thread count.
+const size_t kBlocksPerGroup = 32;
+
+// Peaks under this score are noise. Short inputs use a higher floor, as
+// the noise in a correlation estimate shrinks with 1/sqrt(n).
+const double kMinScore = 0.05;
+
+// A lag is a harmonic of a smaller peak dividing it unless it correlates
+// better by at least this much.
+const double kHarmonicMargin = 0.05;
+
+// std::complex's operator* handles NaN/inf operands specially, which keeps
+// it out of vector registers; the inputs here are always finite.
+Complex multiply(Complex a, Complex b) {
+  return Complex(a.real() * b.real() - a.imag() * b.imag(),
+                 a.real() * b.imag() + a.imag() * b.real());
+}
+
+// Spectra of blocks b and b + 1 (each zero padded to fft.size()) from one
+// complex transform: block b goes in the real part and block b + 1 in the
+// imaginary part, and the conjugate symmetry of real spectra separates
+// them again. Blocks past the end of the signal are zeros.
+void blockSpectra(const Fft &fft, const ScratchVector<double> &signal,
+                  size_t lags, size_t b, ScratchVector<Complex> &scratch,
+                  ScratchVector<Complex> &first,
+                  ScratchVector<Complex> &second) {
+  const size_t size = fft.size();
+  std::fill(scratch.begin(), scratch.end(), Complex());
+  for (size_t j = 0; j < lags; ++j) {
+    size_t i = b * lags + j;
+    double re = i < signal.size() ? signal[i] : 0.0;
+    double im = i + lags < signal.size() ? signal[i + lags] : 0.0;
+    scratch[j] = Complex(re, im);
+  }
+  fft.forward(scratch.data());
+  for (size_t k = 0; k < size; ++k) {
+    Complex z = scratch[k];
+    Complex mirror = std::conj(scratch[(size - k) & (size - 1)]);
+    first[k] = (z + mirror) * 0.5;
+    second[k] = multiply(z - mirror, Complex(0.0, -0.5));
+  }
+}
+
+// Adds the cross spectrum of a block with itself followed by its successor.
+// Shifting by half the transform size multiplies bin k by (-1)^k, so the
+// spectrum of the two blocks back to back is block + (-1)^k * next.
+void accumulate(const ScratchVector<Complex> &block,
+                const ScratchVector<Complex> &next, Complex *sum) {
+  for (size_t k = 0; k < block.size(); ++k) {
+    Complex pair = (k & 1) ? block[k] - next[k] : block[k] + next[k];
+    sum[k] += multiply(std::conj(block[k]), pair);
+  }
+}
+
+// Multiples of a period averaged into its comb score.
+const size_t kCombTeeth = 8;
+
+// Record periods from the autocorrelation `score` at lags [2, maxLag).
+//
+// A lag is a candidate if it's a local maximum. Candidates are ranked by
+// their comb score, the mean correlation at the first kCombTeeth multiples
+// of the lag: a true period P correlates at 2P, 3P, ... as well, while the
+// side peaks it produces (lags where two different fields of the record
+// line up) don't repeat at their own multiples. Only lags with at least two
+// teeth are considered. A candidate is dropped as a harmonic when a smaller
+// candidate dividing it scores about as well, and as an alias when the
+// correlation at it just repeats that at its residue modulo an accepted
+// period (the correlation of period-P data is itself P-periodic).
+// Periods are stored in `periods` times `unit`, strongest first.
+void pickPeriods(const ScratchVector<double> &score, size_t maxLag,
+                 size_t topK, double minScore, size_t unit,
+                 std::vector<Period> &periods) {
+  periods.clear();
+  ArenaScope scope;
+  maxLag = std::min(maxLag, score.size() - 1);
+  ScratchVector<double> comb(maxLag + 1, 0.0, scope.resource());
+  ScratchVector<size_t> peaks(scope.resource());
+  for (size_t k = 2; 2 * k <= maxLag; ++k) {
+    if (score[k] <= score[k - 1] || score[k] < score[k + 1])
+      continue;
+    double sum = 0;
+    size_t teeth = 0;
+    for (size_t m = k; m <= maxLag && teeth < kCombTeeth; m += k, ++teeth)
+      sum += score[m];
+    comb[k] = sum / double(teeth);
+    if (comb[k] >= minScore)
+      peaks.push_back(k);
+  }
+  std::sort(peaks.begin(), peaks.end(), [&](size_t a, size_t b) {
+    return comb[a] != comb[b] ? comb[a] > comb[b] : a < b;
+  });
+
+  ScratchVector<size_t> accepted(scope.resource());
+  for (size_t k : peaks) {
+    if (periods.size() == topK)
+      break;
+    bool harmonic = false;
+    for (size_t q : accepted) {
+      size_t residue = k % q;
+      if (residue && std::abs(score[k] - score[residue]) < kHarmonicMargin)
+        harmonic = true;
+    }
+    for (size_t d = 2; d * d <= k && !harmonic; ++d) {
+      if (k % d)
+        continue;
+      for (size_t divisor : {d, k / d})
+        if (comb[divisor] >= minScore &&
+            comb[k] < comb[divisor] + kHarmonicMargin)
+          harmonic = true;
+    }
+    if (harmonic)
+      continue;
+    accepted.push_back(k);
+    periods.push_back({k * unit, static_cast<float>(comb[k])});
+  }
+}
+
+// Smallest power of two covering lags up to n / 2 (a period has to repeat
+// at least once inside the region to be seen), capped at `maxLags`.
+size_t lagsFor(size_t n, size_t maxLags) {
+  size_t lags = 2;
+  while (lags < maxLags && lags <= n / 2)
+    lags <<= 1;
+  return lags;
+}
+
+// Subtracts a centered moving average of `window` samples. Removing only
+// the global mean would leave a file made of different sections (a float
+// table, then an index table) looking correlated at every lag; the moving
+// average removes the level of each section and keeps what varies within
+// a few records.
+void removeTrend(ScratchVector<double> &signal, size_t window) {
+  const size_t n = signal.size();
+  ArenaScope scope;
+  ScratchVector<double> prefix(n + 1, 0.0, scope.resource());
+  for (size_t i = 0; i < n; ++i)
+    prefix[i + 1] = prefix[i] + signal[i];
+  const size_t half = window / 2;
+  for (size_t i = 0; i < n; ++i) {
+    size_t lo = i > half ? i - half : 0;
+    size_t hi = std::min(n, i + half + 1);
+    signal[i] -= (prefix[hi] - prefix[lo]) / double(hi - lo);
+  }
+}
+
+} // namespace
+
+ByteView periodRegion(ByteView data) {
+  if (data.size() <= kAutocorrelationRegion)
+    return data;
+  size_t offset = ((data.size() - kAutocorrelationRegion) / 2) & ~size_t(63);
+  return data.subview(offset, kAutocorrelationRegion);
+}
+
+void autocorrelate(const ScratchVector<double> &signal, size_t lags,
+                   ScratchVector<double> &out, ThreadPool *pool) {
+  out.assign(lags, 0.0);
+  const size_t n = signal.size();
+  if (n == 0)
+    return;
+
+  ArenaScope scope;
+  const Fft fft(lags * 2, scope.resource());
+  const size_t size = fft.size();
+  const size_t blocks = (n + lags - 1) / lags;
+  const size_t groups = (blocks + kBlocksPerGroup - 1) / kBlocksPerGroup;
+  // One spectrum per group, back to back; allocated here because the
+  // groups run (and take their own scratch) on other threads.
+  ScratchVector<Complex> sums(groups * size, scope.resource());
+
+  auto runGroup = [&](size_t g) {
+    const size_t first = g * kBlocksPerGroup;
+    const size_t end = std::min(blocks, first + kBlocksPerGroup);
+    ArenaScope groupScope;
+    std::pmr::memory_resource *memory = groupScope.resource();
+    ScratchVector<Complex> scratch(size, memory), current(size, memory),
+        next(size, memory), prev(size, memory);
+    Complex *sum = sums.data() + g * size;
+    // Spectra come in pairs (j, j + 1); `prev` holds the one before j.
+    bool havePrev = false;
+    for (size_t j = first; j <= end; j += 2) {
+      blockSpectra(fft, signal, lags, j, scratch, current, next);
+      if (havePrev && j - 1 < end)
+        accumulate(prev, current, sum);
+      if (j < end)
+        accumulate(current, next, sum);
+      prev.swap(next);
+      havePrev = true;
+    }
+  };
+  if (pool && groups > 1) {
+    pool->parallelFor(groups, runGroup);
+  } else {
+    for (size_t g = 0; g < groups; ++g)
+      runGroup(g);
+  }
+
+  ScratchVector<Complex> total(size, scope.resource());
+  for (size_t g = 0; g < groups; ++g)
+    for (size_t k = 0; k < size; ++k)
+      total[k] += sums[g * size + k];
+  fft.inverse(total.data());
+
+  const double energy = total[0].real() / double(n);
+  if (!(energy > 0.0))
+    return;
+  for (size_t k = 0; k < lags && k < n; ++k)
+    out[k] = total[k].real() / double(n - k) / energy;
+}
+
+void findPeriods(ByteView data, const AnalysisOptions &options,
+                 AnalysisResult &result, ThreadPool *pool) {
+  ProfileZone zone(ProfilePhase::Periods, data.size());
+  PeriodSummary &summary = result.periods;
+  summary.regionOffset = 0;
+  summary.regionSize = 0;
+  summary.bytePeriods.clear();
+  summary.wordPeriods.clear();
+  if (options.periodTopK == 0 || data.empty())
+    return;
+
+  ByteView region = periodRegion(data);
+  const size_t size = region.size();
+  summary.regionOffset = static_cast<size_t>(region.data() - data.data());
+  summary.regionSize = size;
+
+  ArenaScope scope;
+  ScratchVector<double> bytes(region.begin(), region.end(), scope.resource());
+  ScratchVector<double> score(scope.resource());
+  size_t lags = lagsFor(size, kAutocorrelationLags);
+  removeTrend(bytes, lags * 2);
+  autocorrelate(bytes, lags, score, pool);
+  double floor = std::max(kMinScore, 4.0 / std::sqrt(double(size)));
+  pickPeriods(score, size / 2, options.periodTopK, floor, 1,
+              summary.bytePeriods);
+
+  const size_t wordCount = size / 4;
+  if (wordCount < 4)
+    return;
+  ScratchVector<double> words(wordCount, scope.resource());
+  for (size_t j = 0; j < wordCount; ++j) {
+    // Assembled from bytes, so the word is little endian on any host.
+    uint32_t v = uint32_t(region[4 * j]) | uint32_t(region[4 * j + 1]) << 8 |
+        uint32_t(region[4 * j + 2]) << 16 | uint32_t(region[4 * j + 3]) << 24;
+    words[j] = std::log2(1.0 + double(v));
+  }
+  lags = lagsFor(wordCount, kAutocorrelationLags / 4);
+  removeTrend(words, lags * 2);
+  // Reuses the byte pass's storage: no larger than kAutocorrelationLags.
+  autocorrelate(words, lags, score, pool);
+  floor = std::max(kMinScore, 4.0 / std::sqrt(double(wordCount)));
+  pickPeriods(score, wordCount / 2, options.periodTopK, floor, 4,
+              summary.wordPeriods);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "analysis.h"
+#include "arena.h"
+#include "byte_view.h"
+
+class ThreadPool;
+
+// Longest lag examined, in samples. Records longer than 4 KiB are rare and
+// a longer lag raises the cost of every block.
+const size_t kAutocorrelationLags = 4096;
+
+// Inputs larger than this are correlated over a region of this size taken
+// from the middle, past any header and before any trailer.
+const size_t kAutocorrelationRegion = size_t(8) << 20;
+
+// The part of `data` findPeriods correlates: all of it, or the middle
+// kAutocorrelationRegion bytes (from a 64-byte boundary) of a larger input.
+ByteView periodRegion(ByteView data);
+
+// Normalized autocorrelation of `signal` (mean already removed) at lags
+// 0 .. lags - 1: out[k] = (sum x[i] x[i+k] / (n - k)) / (sum x[i]^2 / n).
+// `lags` must be a power of two. All zeros if the signal is constant.
+// `out` is resized before any scratch is taken, so it may live in the
+// calling thread's arena.
+//
+// The signal is cut into blocks of `lags` samples and each block is
+// correlated against itself and its successor in the frequency domain
+// (blocks are zero padded to twice their size, so nothing wraps around).
+// Summing the per-block cross spectra and inverting once gives the exact
+// sums in O(n log lags) time and O(lags) memory, where a direct scan costs
+// O(n * lags) and a single whole-signal FFT O(n) memory. Blocks are summed
+// in fixed groups, so the result doesn't depend on the thread count.
+void autocorrelate(const ScratchVector<double> &signal, size_t lags,
+                   ScratchVector<double> &out, ThreadPool *pool = nullptr);
+
+// Helper: Find record periods
+//
+// Correlates the input with itself to find the periods of fixed-size
+// records, and stores them in result.periods. Two signals are used: the byte
+// values, and log2(1 + v) of each little-endian 4-byte word, which keeps
+// float exponents and small integer fields coherent across records. Peaks
+// of each are reported strongest first, up to options.periodTopK per
+// signal. A multiple of a reported period is only reported when it
+// correlates clearly better: a float3 array peaks at 4, 8, 12, ... and
+// shows up as 4 alone unless its x, y and z columns differ, in which case 12
+// outranks 4 and both are kept.
+void findPeriods(ByteView data, const AnalysisOptions &options,
+                 AnalysisResult &result, ThreadPool *pool = nullptr);
@@ -0,0 +1,137 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "prefetch.h"
+#include "thread_pool.h"
+
+bool collectBatchInputs(const std::string &source,
+                        std::vector<std::string> &paths) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+
+  if (fs::is_directory(source, ec)) {
+    std::vector<std::string> found;
+    for (const fs::directory_entry &entry : fs::directory_iterator(source, ec)) {
+      if (entry.is_regular_file(ec))
+        found.push_back(entry.path().string());
+    }
+    if (ec)
+      return false;
+    std::sort(found.begin(), found.end());
+    paths.insert(paths.end(), found.begin(), found.end());
+    return true;
+  }
+
+  std::ifstream list(source);
+  if (!list)
+    return false;
+  std::string line;
+  while (std::getline(list, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty() || line[0] == '#')
+      continue;
+    paths.push_back(line);
+  }
+  return true;
+}
+
+size_t runBatch(const std::vector<std::string> &paths,
+                const AnalysisOptions &options, ThreadPool *pool,
+                const std::function<void(AnalysisResult &)> &onResult,
+                size_t prefetchBytes) {
+  std::atomic<size_t> failures{0};
+
+  // Finished results go back on a free list and are reused by the next
+  // file, so there are only ever as many as files in flight and their
+  // buffers are allocated once rather than per file.
+  std::mutex spareMutex;
+  std::vector<std::unique_ptr<AnalysisResult>> spare;
+  spare.reserve(pool ? pool->concurrency() : 1);
+
+  auto takeResult = [&] {
+    std::unique_ptr<AnalysisResult> result;
+    {
+      std::lock_guard<std::mutex> lock(spareMutex);
+      if (!spare.empty()) {
+        result = std::move(spare.back());
+        spare.pop_back();
+      }
+    }
+    if (!result)
+      result = std::make_unique<AnalysisResult>();
+    return result;
+  };
+  auto giveResult = [&](std::unique_ptr<AnalysisResult> result) {
+    std::lock_guard<std::mutex> lock(spareMutex);
+    spare.push_back(std::move(result));
+  };
+
+  if (prefetchBytes) {
+    Prefetcher prefetcher(paths, prefetchBytes);
+    // A task gets its result with the path and bytes parked in it (the
+    // capture has to stay small); both go back for reuse when it's done.
+    auto analyzeRead = [&](AnalysisResult *raw) {
+      std::unique_ptr<AnalysisResult> result(raw);
+      std::string path = std::move(result->filename);
+      std::vector<uint8_t> bytes = result->source.release();
+      analyzeFile(path, std::move(bytes), options, *result, pool);
+      onResult(*result);
+      prefetcher.recycle(result->source.release());
+      giveResult(std::move(result));
+    };
+    std::unique_ptr<TaskGroup> group;
+    if (pool)
+      group = std::make_unique<TaskGroup>(*pool);
+    PrefetchedFile file;
+    while (prefetcher.next(file)) {
+      if (!file.ok) {
+        std::cerr << "Failed to open file: " << paths[file.index]
+                  << std::endl;
+        prefetcher.recycle(std::move(file.data));
+        failures.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      std::unique_ptr<AnalysisResult> result = takeResult();
+      result->filename = paths[file.index];
+      result->source.adopt(std::move(file.data));
+      AnalysisResult *raw = result.release();
+      if (group)
+        group->run([&analyzeRead, raw] { analyzeRead(raw); });
+      else
+        analyzeRead(raw);
+    }
+    if (group)
+      group->wait();
+    return failures.load();
+  }
+
+  auto analyzeOne = [&](const std::string &path) {
+    std::unique_ptr<AnalysisResult> result = takeResult();
+    if (analyzeFile(path, options, *result, pool))
+      onResult(*result);
+    else
+      failures.fetch_add(1, std::memory_order_relaxed);
+    result->source.close();
+    giveResult(std::move(result));
+  };
+
+  if (!pool) {
+    for (const std::string &path : paths)
+      analyzeOne(path);
+    return failures.load();
+  }
+
+  TaskGroup group(*pool);
+  for (const std::string &path : paths)
+    group.run([&analyzeOne, &path] { analyzeOne(path); });
+  group.wait();
+  return failures.load();
+}
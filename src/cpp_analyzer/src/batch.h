@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+
+// Expands a --batch argument into input paths. A directory contributes its
+// regular files (not recursive, sorted by name); any other file is read as a
+// list with one path per line. Blank lines and lines starting with '#' are
+// skipped. Returns false if `source` can't be read.
+bool collectBatchInputs(const std::string &source,
+                        std::vector<std::string> &paths);
+
+// Helper: Batch analysis
+//
+// Analyzes every path in one process. Each file is one task on `pool` and
+// fans out into tile tasks on the same pool, so a corpus of small files
+// spreads across workers and one large file still uses all of them.
+// `onResult` is called as each file finishes, in completion order and
+// possibly from several threads at once; the mapping is closed right after
+// it returns and the result's buffers are reused for a later file, so it
+// must not be kept. Runs sequentially when `pool` is null.
+//
+// With `prefetchBytes`, files are read into memory by a Prefetcher of that
+// budget instead of being mapped: the calling thread keeps the reads
+// queued and turns each finished file into a task, so the disk works on
+// later files while the pool analyzes earlier ones, and files waiting for
+// a worker hold at most that many bytes. The caller only waits on I/O, so
+// the pool should have a worker per core. Fed from the cache only, both
+// ways give the same results.
+// Returns the number of files that could not be opened.
+size_t runBatch(const std::vector<std::string> &paths,
+                const AnalysisOptions &options, ThreadPool *pool,
+                const std::function<void(AnalysisResult &)> &onResult,
+                size_t prefetchBytes = 0);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Non-owning view over a contiguous run of bytes.
+//
+// This is a stand-in for std::span<const uint8_t> while the project builds as
+// C++17. Every analysis pass takes a ByteView so it can run directly on a
+// memory-mapped file (or any other buffer) without copying it first.
+class ByteView {
+public:
+  ByteView() = default;
+  ByteView(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const uint8_t *begin() const { return data_; }
+  const uint8_t *end() const { return data_ + size_; }
+  const uint8_t &operator[](size_t i) const { return data_[i]; }
+
+  // Returns the bytes in [offset, offset + count), clamped to the view.
+  ByteView subview(size_t offset, size_t count) const {
+    if (offset >= size_)
+      return ByteView(data_ + size_, 0);
+    size_t avail = size_ - offset;
+    return ByteView(data_ + offset, count < avail ? count : avail);
+  }
+
+private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
@@ -0,0 +1,507 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "autocorrelation.h"
+#include "entropy.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include "output.h"
+#include "regions.h"
+
+// Entry layout (little endian):
+//
+//   0  char[4]  magic "ANLC"
+//   4  u32      cache version (kCacheVersion)
+//   8  u64      key
+//  16  ...      the result as a --format bin record
+//   .  u32      entropy pyramid level count
+//   .  ...      per level: u64 block count, f32 value per block, and for
+//               levels >= 1, 256 u64 counts per block
+//
+// Block entry layout (little endian):
+//
+//   0  char[4]  magic "ANLB"
+//   4  u32      cache version (kCacheVersion)
+//   8  u64      key (path and options)
+//  16  u64      input size
+//  24  u64      tile size
+//  32  u64      region cell size
+//  40  u64      tile count T
+//  48  u64      offset of the periods record
+//  56  ...      T x (u64 checksum, u64 offset of the tile's record)
+//   .  ...      per tile: f32 per entropy window starting in it, f32 per
+//               4 KiB pyramid block, f32 and 256 u64 counts per 256 KiB
+//               block, the u64 alignment counts (small, then floats, in
+//               AlignmentCounts order), then per region cell its eleven u32
+//               fields (entropy as f32 bits) in RegionCell order
+//   .  ...      periods: u64 region checksum, u64 region offset, u64 region
+//               size, then for bytes and words a u32 count and per period
+//               a u64 lag and an f32 score
+namespace {
+
+namespace fs = std::filesystem;
+
+const char kCacheMagic[4] = {'A', 'N', 'L', 'C'};
+const size_t kCacheHeaderSize = 16;
+const char kBlockMagic[4] = {'A', 'N', 'L', 'B'};
+const size_t kBlockHeaderSize = 56;
+const size_t kAlignmentValues = 2 * 3 * 8 * 2;
+const size_t kCellBytes = 11 * 4;
+
+// Bump whenever a pass changes what it computes: old entries then miss
+// instead of returning stale results.
+const uint32_t kCacheVersion = 4;
+
+uint64_t readLE(const uint8_t *p, int n) {
+  uint64_t v = 0;
+  for (int i = n - 1; i >= 0; --i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+void putLE(std::string &out, uint64_t v, int n) {
+  for (int i = 0; i < n; ++i)
+    out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void putFloat(std::string &out, float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  putLE(out, bits, 4);
+}
+
+// Reads a float at `p` and advances it.
+float takeFloat(const uint8_t *&p) {
+  uint32_t bits = static_cast<uint32_t>(readLE(p, 4));
+  float value;
+  std::memcpy(&value, &bits, sizeof value);
+  p += 4;
+  return value;
+}
+
+uint64_t takeLE(const uint8_t *&p, int n) {
+  uint64_t v = readLE(p, n);
+  p += n;
+  return v;
+}
+
+size_t ceilDiv(size_t a, size_t b) { return (a + b - 1) / b; }
+
+// Bytes past its end a tile's results depend on: the rest of an entropy
+// window or of an 8-byte element that starts inside it.
+size_t tileReach(size_t window) { return std::max<size_t>(window, 8); }
+
+// Seed for keys of entries made with `options`: the output-affecting
+// options and the cache version. Thread count is left out: the output
+// doesn't depend on it.
+uint64_t optionsSeed(const AnalysisOptions &options) {
+  std::string knobs;
+  putLE(knobs, kCacheVersion, 4);
+  putLE(knobs, options.entropyWindow, 8);
+  putLE(knobs, options.entropyStride, 8);
+  putLE(knobs, options.patternTopK, 8);
+  putLE(knobs, options.periodTopK, 8);
+  return hashBytes(
+      ByteView(reinterpret_cast<const uint8_t *>(knobs.data()), knobs.size()));
+}
+
+// The pyramid section after the bin record. Returns false if it's truncated
+// or doesn't match the levels of an input of pyramid.inputSize() bytes.
+bool readPyramid(ByteView bytes, EntropyPyramid &pyramid) {
+  size_t pos = 0;
+  auto take = [&](size_t n) -> const uint8_t * {
+    if (n > bytes.size() - pos)
+      return nullptr;
+    const uint8_t *p = bytes.data() + pos;
+    pos += n;
+    return p;
+  };
+  const uint8_t *p = take(4);
+  if (!p || readLE(p, 4) != pyramid.levels())
+    return false;
+  for (size_t l = 0; l < pyramid.levels(); ++l) {
+    std::vector<float> &values = pyramid.values(l);
+    std::vector<uint64_t> &counts = pyramid.counts(l);
+    if (!(p = take(8)) || readLE(p, 8) != values.size() ||
+        !(p = take(values.size() * 4)))
+      return false;
+    for (float &value : values) {
+      uint32_t bits = static_cast<uint32_t>(readLE(p, 4));
+      std::memcpy(&value, &bits, sizeof value);
+      p += 4;
+    }
+    if (!(p = take(counts.size() * 8)))
+      return false;
+    for (uint64_t &count : counts) {
+      count = readLE(p, 8);
+      p += 8;
+    }
+  }
+  return true;
+}
+
+void writePyramid(const EntropyPyramid &pyramid, OutputBuffer &out) {
+  std::string bytes;
+  putLE(bytes, pyramid.levels(), 4);
+  for (size_t l = 0; l < pyramid.levels(); ++l) {
+    const std::vector<float> &values = pyramid.values(l);
+    putLE(bytes, values.size(), 8);
+    for (float value : values) {
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof bits);
+      putLE(bytes, bits, 4);
+    }
+    for (uint64_t count : pyramid.counts(l))
+      putLE(bytes, count, 8);
+    out.append(bytes);
+    bytes.clear();
+  }
+  out.append(bytes);
+}
+
+fs::path entryPath(const std::string &dir, uint64_t key,
+                   const char *extension = "anlz") {
+  char name[32];
+  std::snprintf(name, sizeof name, "%016llx.%s",
+                static_cast<unsigned long long>(key), extension);
+  return fs::path(dir) / name;
+}
+
+// Writes the entry at `path` through `fill` into a temporary file and
+// renames it into place, creating `dir` if needed.
+void writeEntry(const std::string &dir, const fs::path &path,
+                const std::function<void(OutputBuffer &)> &fill) {
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+
+  // Unique per writer: batch threads can store the same key at once when
+  // two inputs have identical content.
+  static std::atomic<uint64_t> counter{0};
+  uint64_t nonce =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+      static_cast<uint64_t>(
+          std::chrono::steady_clock::now().time_since_epoch().count()) ^
+      (counter.fetch_add(1) << 48);
+  fs::path temp = path;
+  temp += ".tmp" + std::to_string(nonce);
+
+  std::FILE *file = std::fopen(temp.string().c_str(), "wb");
+  if (!file) {
+    std::cerr << "Failed to write cache entry: " << path.string() << std::endl;
+    return;
+  }
+  {
+    OutputBuffer out(file);
+    fill(out);
+  }
+  bool written = std::ferror(file) == 0;
+  written = std::fclose(file) == 0 && written;
+  if (written)
+    fs::rename(temp, path, ec);
+  if (!written || ec) {
+    fs::remove(temp, ec);
+    std::cerr << "Failed to write cache entry: " << path.string() << std::endl;
+  }
+}
+
+} // namespace
+
+uint64_t analysisCacheKey(ByteView data, const AnalysisOptions &options) {
+  return hashBytes(data, optionsSeed(options));
+}
+
+bool loadCachedAnalysis(const std::string &dir, uint64_t key,
+                        AnalysisResult &result) {
+  MappedFile entry;
+  if (!entry.open(entryPath(dir, key).string()))
+    return false;
+  ByteView bytes = entry.view();
+  if (bytes.size() < kCacheHeaderSize ||
+      std::memcmp(bytes.data(), kCacheMagic, 4) != 0 ||
+      readLE(bytes.data() + 4, 4) != kCacheVersion ||
+      readLE(bytes.data() + 8, 8) != key)
+    return false;
+
+  AnalysisResult cached;
+  ByteView record = bytes.subview(kCacheHeaderSize, bytes.size());
+  if (!readAnalysisRecord(record, cached) ||
+      cached.fileSize != result.fileSize)
+    return false;
+  // The record was read, so its size field (at offset 8) is in range
+  result.entropyPyramid.reset(result.fileSize);
+  if (!readPyramid(record.subview(readLE(record.data() + 8, 8),
+                                  record.size()),
+                   result.entropyPyramid))
+    return false;
+  result.entropyMap = std::move(cached.entropyMap);
+  result.entropyWindow = cached.entropyWindow;
+  result.entropyStride = cached.entropyStride;
+  result.alignment = cached.alignment;
+  result.alignmentScores = cached.alignmentScores;
+  result.patterns = std::move(cached.patterns);
+  result.periods = std::move(cached.periods);
+  result.regions = std::move(cached.regions);
+  return true;
+}
+
+void storeCachedAnalysis(const std::string &dir, uint64_t key,
+                         const AnalysisResult &result) {
+  writeEntry(dir, entryPath(dir, key), [&](OutputBuffer &out) {
+    std::string header(kCacheMagic, 4);
+    putLE(header, kCacheVersion, 4);
+    putLE(header, key, 8);
+    out.append(header);
+    writeAnalysis(result, OutputFormat::Binary, out);
+    writePyramid(result.entropyPyramid, out);
+  });
+}
+
+// A tile's bytes and the results it owns: entropy windows, 4 KiB and
+// 256 KiB pyramid blocks and region cells, each as [first, last).
+struct BlockCache::Span {
+  size_t begin = 0, end = 0;
+  size_t firstWindow = 0, lastWindow = 0;
+  size_t firstBlock = 0, lastBlock = 0;
+  size_t firstHistogram = 0, lastHistogram = 0;
+  size_t firstCell = 0, lastCell = 0;
+};
+
+BlockCache::BlockCache(const std::string &dir, const std::string &path,
+                       const AnalysisOptions &options, ByteView data,
+                       size_t tileSize, size_t cellSize)
+    : dir_(dir), data_(data), window_(options.entropyWindow),
+      stride_(options.entropyStride), tileSize_(tileSize),
+      cellSize_(cellSize) {
+  windows_ = entropyWindowCount(data.size(), window_, stride_);
+  tiles_ = ceilDiv(data.size(), tileSize);
+  checksums_.assign(tiles_, 0);
+
+  // The same file reached through another relative path or a link shares
+  // its entry.
+  std::error_code ec;
+  std::string name = fs::weakly_canonical(path, ec).string();
+  if (ec)
+    name = path;
+  key_ = hashBytes(
+      ByteView(reinterpret_cast<const uint8_t *>(name.data()), name.size()),
+      optionsSeed(options));
+
+  if (!entry_.open(entryPath(dir, key_, "anlb").string()))
+    return;
+  ByteView bytes = entry_.view();
+  if (bytes.size() < kBlockHeaderSize ||
+      std::memcmp(bytes.data(), kBlockMagic, 4) != 0 ||
+      readLE(bytes.data() + 4, 4) != kCacheVersion ||
+      readLE(bytes.data() + 8, 8) != key_ ||
+      readLE(bytes.data() + 24, 8) != tileSize ||
+      readLE(bytes.data() + 32, 8) != cellSize) {
+    entry_.close();
+    return;
+  }
+  uint64_t tiles = readLE(bytes.data() + 40, 8);
+  uint64_t periods = readLE(bytes.data() + 48, 8);
+  if (tiles > (bytes.size() - kBlockHeaderSize) / 16 ||
+      periods < kBlockHeaderSize + tiles * 16 || periods > bytes.size()) {
+    entry_.close();
+    return;
+  }
+  table_ = bytes.subview(kBlockHeaderSize, tiles * 16);
+  periods_ = bytes.subview(periods, bytes.size());
+}
+
+BlockCache::Span BlockCache::span(size_t t) const {
+  const size_t size = data_.size();
+  Span span;
+  span.begin = t * tileSize_;
+  span.end = std::min(span.begin + tileSize_, size);
+  span.firstWindow = std::min(ceilDiv(span.begin, stride_), windows_);
+  span.lastWindow = std::min(ceilDiv(span.end, stride_), windows_);
+  span.firstBlock = span.begin / EntropyPyramid::kBaseBlock;
+  span.lastBlock = ceilDiv(span.end, EntropyPyramid::kBaseBlock);
+  span.firstHistogram = span.begin / EntropyPyramid::kHistogramBlock;
+  span.lastHistogram = ceilDiv(span.end, EntropyPyramid::kHistogramBlock);
+  span.firstCell = span.begin / cellSize_;
+  span.lastCell = ceilDiv(span.end, cellSize_);
+  return span;
+}
+
+size_t BlockCache::payloadSize(const Span &span) {
+  return 4 * (span.lastWindow - span.firstWindow) +
+         4 * (span.lastBlock - span.firstBlock) +
+         (4 + 256 * 8) * (span.lastHistogram - span.firstHistogram) +
+         8 * kAlignmentValues + kCellBytes * (span.lastCell - span.firstCell);
+}
+
+uint64_t BlockCache::tileChecksum(size_t t) const {
+  size_t begin = t * tileSize_;
+  size_t end = std::min(begin + tileSize_ + tileReach(window_), data_.size());
+  return hashBytes(data_.subview(begin, end - begin));
+}
+
+bool BlockCache::restoreTile(size_t t, uint64_t checksum,
+                             AnalysisResult &result,
+                             AlignmentCounts &alignment, RegionCell *cells) {
+  checksums_[t] = checksum;
+  if (t >= table_.size() / 16)
+    return false;
+  const uint8_t *row = table_.data() + 16 * t;
+  if (readLE(row, 8) != checksum)
+    return false;
+  uint64_t begin = readLE(row + 8, 8);
+  uint64_t end = t + 1 < table_.size() / 16
+                     ? readLE(row + 24, 8)
+                     : static_cast<uint64_t>(periods_.data() -
+                                             entry_.view().data());
+  const Span span = this->span(t);
+  if (begin < kBlockHeaderSize || end < begin ||
+      end > entry_.view().size() || end - begin != payloadSize(span))
+    return false;
+
+  const uint8_t *p = entry_.view().data() + begin;
+  for (size_t w = span.firstWindow; w < span.lastWindow; ++w)
+    result.entropyMap[w] = takeFloat(p);
+  EntropyPyramid &pyramid = result.entropyPyramid;
+  for (size_t b = span.firstBlock; b < span.lastBlock; ++b)
+    pyramid.values(0)[b] = takeFloat(p);
+  for (size_t b = span.firstHistogram; b < span.lastHistogram; ++b) {
+    pyramid.values(1)[b] = takeFloat(p);
+    uint64_t *counts = &pyramid.counts(1)[b * 256];
+    for (int i = 0; i < 256; ++i)
+      counts[i] = takeLE(p, 8);
+  }
+  for (auto *table : {&alignment.small, &alignment.floats})
+    for (auto &phases : *table)
+      for (auto &orders : phases)
+        for (size_t &count : orders)
+          count = static_cast<size_t>(takeLE(p, 8));
+  for (size_t c = span.firstCell; c < span.lastCell; ++c) {
+    RegionCell &cell = cells[c];
+    cell.units = static_cast<uint32_t>(takeLE(p, 4));
+    cell.bytes = static_cast<uint32_t>(takeLE(p, 4));
+    cell.entropy = takeFloat(p);
+    cell.zero = static_cast<uint32_t>(takeLE(p, 4));
+    cell.text = static_cast<uint32_t>(takeLE(p, 4));
+    for (uint32_t &count : cell.small)
+      count = static_cast<uint32_t>(takeLE(p, 4));
+    for (uint32_t &count : cell.floats)
+      count = static_cast<uint32_t>(takeLE(p, 4));
+  }
+  return true;
+}
+
+bool BlockCache::restorePeriods(PeriodSummary &periods) {
+  ByteView region = periodRegion(data_);
+  size_t offset = static_cast<size_t>(region.data() - data_.data());
+  periodsChecksum_ = hashBytes(region, offset);
+  if (!entry_.isOpen() || periods_.size() < 24 ||
+      readLE(periods_.data(), 8) != periodsChecksum_ ||
+      readLE(periods_.data() + 8, 8) != offset ||
+      readLE(periods_.data() + 16, 8) != region.size())
+    return false;
+
+  PeriodSummary restored;
+  restored.regionOffset = offset;
+  restored.regionSize = region.size();
+  size_t pos = 24;
+  for (auto *list : {&restored.bytePeriods, &restored.wordPeriods}) {
+    if (periods_.size() - pos < 4)
+      return false;
+    size_t count = static_cast<size_t>(readLE(periods_.data() + pos, 4));
+    pos += 4;
+    if (count > (periods_.size() - pos) / 12)
+      return false;
+    const uint8_t *p = periods_.data() + pos;
+    for (size_t i = 0; i < count; ++i) {
+      Period period;
+      period.period = static_cast<size_t>(takeLE(p, 8));
+      period.score = takeFloat(p);
+      list->push_back(period);
+    }
+    pos += 12 * count;
+  }
+  periods = std::move(restored);
+  return true;
+}
+
+void BlockCache::store(const AnalysisResult &result,
+                       const AlignmentCounts *alignment,
+                       const RegionCell *cells) {
+  std::string bytes(kBlockMagic, 4);
+  putLE(bytes, kCacheVersion, 4);
+  putLE(bytes, key_, 8);
+  putLE(bytes, data_.size(), 8);
+  putLE(bytes, tileSize_, 8);
+  putLE(bytes, cellSize_, 8);
+  putLE(bytes, tiles_, 8);
+  size_t periods = kBlockHeaderSize + 16 * tiles_;
+  for (size_t t = 0; t < tiles_; ++t)
+    periods += payloadSize(span(t));
+  putLE(bytes, periods, 8);
+  bytes.reserve(periods + 64);
+
+  size_t offset = kBlockHeaderSize + 16 * tiles_;
+  for (size_t t = 0; t < tiles_; ++t) {
+    putLE(bytes, checksums_[t], 8);
+    putLE(bytes, offset, 8);
+    offset += payloadSize(span(t));
+  }
+
+  const EntropyPyramid &pyramid = result.entropyPyramid;
+  for (size_t t = 0; t < tiles_; ++t) {
+    const Span span = this->span(t);
+    for (size_t w = span.firstWindow; w < span.lastWindow; ++w)
+      putFloat(bytes, result.entropyMap[w]);
+    for (size_t b = span.firstBlock; b < span.lastBlock; ++b)
+      putFloat(bytes, pyramid.values(0)[b]);
+    for (size_t b = span.firstHistogram; b < span.lastHistogram; ++b) {
+      putFloat(bytes, pyramid.values(1)[b]);
+      for (int i = 0; i < 256; ++i)
+        putLE(bytes, pyramid.counts(1)[b * 256 + i], 8);
+    }
+    for (auto *table : {&alignment[t].small, &alignment[t].floats})
+      for (auto &phases : *table)
+        for (auto &orders : phases)
+          for (size_t count : orders)
+            putLE(bytes, count, 8);
+    for (size_t c = span.firstCell; c < span.lastCell; ++c) {
+      const RegionCell &cell = cells[c];
+      putLE(bytes, cell.units, 4);
+      putLE(bytes, cell.bytes, 4);
+      putFloat(bytes, cell.entropy);
+      putLE(bytes, cell.zero, 4);
+      putLE(bytes, cell.text, 4);
+      for (uint32_t count : cell.small)
+        putLE(bytes, count, 4);
+      for (uint32_t count : cell.floats)
+        putLE(bytes, count, 4);
+    }
+  }
+
+  const PeriodSummary &summary = result.periods;
+  putLE(bytes, periodsChecksum_, 8);
+  putLE(bytes, summary.regionOffset, 8);
+  putLE(bytes, summary.regionSize, 8);
+  for (auto *list : {&summary.bytePeriods, &summary.wordPeriods}) {
+    putLE(bytes, list->size(), 4);
+    for (const Period &period : *list) {
+      putLE(bytes, period.period, 8);
+      putFloat(bytes, period.score);
+    }
+  }
+
+  // The entry may be the file being replaced: let its mapping go first.
+  entry_.close();
+  writeEntry(dir_, entryPath(dir_, key_, "anlb"),
+             [&](OutputBuffer &out) { out.append(bytes); });
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "byte_view.h"
+#include "mapped_file.h"
+
+struct RegionCell;
+
+// Helper: Analysis cache
+//
+// Persistent results keyed by content, so rerunning the analyzer over the
+// same data files (every experiment does) costs a hash and a small read
+// instead of a full analysis. Each entry is one file in the cache directory
+// named after its key, holding a short header, the --format bin record of
+// the result and its entropy pyramid. Renamed or copied inputs hit too; any
+// change to the bytes or to an option that affects the output misses.
+
+// Key for `data` analyzed with `options`: a hash of the content seeded with
+// the output-affecting options and the cache version.
+uint64_t analysisCacheKey(ByteView data, const AnalysisOptions &options);
+
+// Fills `result` (all but filename and source) from the entry for `key`.
+// Returns false on a miss or an unreadable entry.
+bool loadCachedAnalysis(const std::string &dir, uint64_t key,
+                        AnalysisResult &result);
+
+// Writes the entry for `key`, creating `dir` if needed. The entry is written
+// to a temporary file and renamed into place, so concurrent runs sharing a
+// cache never see a partial entry. Failures are reported on stderr and
+// otherwise ignored.
+void storeCachedAnalysis(const std::string &dir, uint64_t key,
+                         const AnalysisResult &result);
+
+// Helper: Block cache
+//
+// Lets a file that grew or changed in a few places be re-analyzed in time
+// proportional to the change. Beside the content-keyed entries, the cache
+// keeps one entry per input path (named after a hash of the canonical path
+// and the options) with the per-tile results of its last analysis: entropy
+// windows, pyramid blocks, alignment counts and region cells, each under a
+// checksum of the bytes the tile read. Tiles whose bytes are unchanged are
+// copied from it, and the periods likewise when the autocorrelation region
+// is. The whole-input passes that follow (pyramid levels, the merge of
+// alignment counts, segmentation) rerun over the restored tiles, and the
+// repeated-pattern search reruns in full, as its sketch carries state from
+// every byte to the next. The result matches a full analysis exactly.
+//
+// A change of cell size (the input crossing a power-of-two size past 2 MiB)
+// or of the options starts over.
+class BlockCache {
+public:
+  // Maps the entry for `path` if there is one. `data`, `tileSize` and
+  // `cellSize` are the input about to be analyzed and how analyzeData
+  // cuts it.
+  BlockCache(const std::string &dir, const std::string &path,
+             const AnalysisOptions &options, ByteView data, size_t tileSize,
+             size_t cellSize);
+
+  // Checksum of the bytes tile t reads: its own and the windows and
+  // elements that start in it reach past its end.
+  uint64_t tileChecksum(size_t t) const;
+
+  // Copies tile t's results from the entry into `result` (entropy map and
+  // pyramid levels 0 and 1), `alignment` and `cells` (the whole input's) if
+  // the entry has them for `checksum`. Returns false otherwise. Either way
+  // the checksum is kept for store(). Tiles may be restored concurrently.
+  bool restoreTile(size_t t, uint64_t checksum, AnalysisResult &result,
+                   AlignmentCounts &alignment, RegionCell *cells);
+
+  // Copies the periods from the entry if their region is unchanged.
+  bool restorePeriods(PeriodSummary &periods);
+
+  // Replaces the entry with the results of this analysis, `alignment` and
+  // `cells` holding every tile's. Written like the content-keyed entries.
+  void store(const AnalysisResult &result, const AlignmentCounts *alignment,
+             const RegionCell *cells);
+
+private:
+  struct Span;
+  Span span(size_t t) const;
+  static size_t payloadSize(const Span &span);
+
+  std::string dir_;
+  uint64_t key_ = 0;
+  ByteView data_;
+  size_t window_ = 0;
+  size_t stride_ = 0;
+  size_t windows_ = 0;
+  size_t tileSize_ = 0;
+  size_t cellSize_ = 0;
+  size_t tiles_ = 0;
+
+  MappedFile entry_;              // Last analysis; unopened if none
+  ByteView table_;                // Its (checksum, offset) pairs
+  ByteView periods_;              // Its periods record
+  std::vector<uint64_t> checksums_; // This analysis', per tile
+  uint64_t periodsChecksum_ = 0;
+};
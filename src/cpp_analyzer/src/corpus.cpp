@@ -0,0 +1,356 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "profile.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Fields of a tile, per width: kCorpusTileBytes / width offsets times two
+// byte orders, at kFieldBase[w] + 2 * k + bigEndian for the k-th offset.
+const int kFieldWidths[3] = {2, 4, 8};
+const size_t kFieldBase[3] = {0, kCorpusTileBytes,
+                              kCorpusTileBytes + kCorpusTileBytes / 2};
+const size_t kTileFields = kFieldBase[2] + kCorpusTileBytes / 4;
+
+// Most (tile, block) partials held at once, about 7 MiB. Tiles are taken
+// in batches of this many partials when the corpus has many blocks.
+const size_t kMaxCorpusPartials = 256;
+
+// Count, means and centered second moments of (value, file size).
+struct Moments {
+  double n = 0;
+  double meanX = 0;
+  double meanY = 0;
+  double m2x = 0;
+  double m2y = 0;
+  double cxy = 0;
+};
+
+// Chan et al.'s pairwise update: exact in the counts, stable in the rest.
+void mergeMoments(Moments &a, const Moments &b) {
+  if (b.n == 0)
+    return;
+  if (a.n == 0) {
+    a = b;
+    return;
+  }
+  double n = a.n + b.n;
+  double dx = b.meanX - a.meanX;
+  double dy = b.meanY - a.meanY;
+  double weight = a.n * b.n / n;
+  a.m2x += b.m2x + dx * dx * weight;
+  a.m2y += b.m2y + dy * dy * weight;
+  a.cxy += b.cxy + dx * dy * weight;
+  a.meanX += dx * b.n / n;
+  a.meanY += dy * b.n / n;
+  a.n = n;
+}
+
+// One tile over one block of inputs, or (after merging) over all of them.
+struct TilePartial {
+  uint32_t count[kCorpusTileBytes];
+  uint64_t sum[kCorpusTileBytes];
+  uint64_t sumSquares[kCorpusTileBytes];
+  uint8_t minimum[kCorpusTileBytes];
+  uint8_t maximum[kCorpusTileBytes];
+  Moments fields[kTileFields];
+
+  void reset() {
+    std::memset(count, 0, sizeof count);
+    std::memset(sum, 0, sizeof sum);
+    std::memset(sumSquares, 0, sizeof sumSquares);
+    std::memset(minimum, 0xff, sizeof minimum);
+    std::memset(maximum, 0, sizeof maximum);
+    for (Moments &m : fields)
+      m = Moments();
+  }
+
+  void merge(const TilePartial &other) {
+    for (size_t i = 0; i < kCorpusTileBytes; ++i) {
+      count[i] += other.count[i];
+      sum[i] += other.sum[i];
+      sumSquares[i] += other.sumSquares[i];
+      minimum[i] = std::min(minimum[i], other.minimum[i]);
+      maximum[i] = std::max(maximum[i], other.maximum[i]);
+    }
+    for (size_t f = 0; f < kTileFields; ++f)
+      mergeMoments(fields[f], other.fields[f]);
+  }
+};
+
+uint64_t readField(const uint8_t *p, int width, bool bigEndian) {
+  uint64_t v = 0;
+  for (int i = 0; i < width; ++i)
+    v |= uint64_t(p[bigEndian ? width - 1 - i : i]) << (8 * i);
+  return v;
+}
+
+// Helper: Accumulate a tile
+//
+// Streams [tileStart, tileStart + tileBytes) of inputs [first, last)
+// through `out`. The field sums are taken relative to the first
+// value and size of the block, which keeps the second moments exact enough
+// in doubles, and centered once at the end.
+void accumulateTile(const std::vector<ByteView> &inputs,
+                    const std::vector<uint64_t> &sizes, size_t first,
+                    size_t last, size_t tileStart, size_t tileBytes,
+                    TilePartial &out) {
+  ProfileZone zone(ProfilePhase::Corpus);
+  out.reset();
+  struct Sums {
+    double x = 0, y = 0, xx = 0, yy = 0, xy = 0;
+    double refX = 0, refY = 0;
+    uint32_t n = 0;
+  };
+  Sums sums[kTileFields];
+
+  for (size_t f = first; f < last; ++f) {
+    const ByteView &input = inputs[f];
+    if (input.size() <= tileStart)
+      continue;
+    size_t avail = std::min(input.size() - tileStart, tileBytes);
+    const uint8_t *p = input.data() + tileStart;
+    zone.addBytes(avail);
+    for (size_t i = 0; i < avail; ++i) {
+      uint32_t b = p[i];
+      ++out.count[i];
+      out.sum[i] += b;
+      out.sumSquares[i] += b * b;
+      out.minimum[i] = std::min<uint8_t>(out.minimum[i], p[i]);
+      out.maximum[i] = std::max<uint8_t>(out.maximum[i], p[i]);
+    }
+
+    double y = static_cast<double>(sizes[f]);
+    for (int w = 0; w < 3; ++w) {
+      int width = kFieldWidths[w];
+      size_t present = avail / width;
+      for (size_t k = 0; k < present; ++k) {
+        for (size_t e = 0; e < 2; ++e) {
+          size_t index = kFieldBase[w] + 2 * k + e;
+          double x = static_cast<double>(readField(p + k * width, width, e));
+          Sums &s = sums[index];
+          if (s.n++ == 0) {
+            s.refX = x;
+            s.refY = y;
+          }
+          double dx = x - s.refX;
+          double dy = y - s.refY;
+          s.x += dx;
+          s.y += dy;
+          s.xx += dx * dx;
+          s.yy += dy * dy;
+          s.xy += dx * dy;
+        }
+      }
+    }
+  }
+
+  for (size_t index = 0; index < kTileFields; ++index) {
+    const Sums &s = sums[index];
+    if (s.n == 0)
+      continue;
+    double n = s.n;
+    Moments &m = out.fields[index];
+    m.n = n;
+    m.meanX = s.refX + s.x / n;
+    m.meanY = s.refY + s.y / n;
+    m.m2x = std::max(0.0, s.xx - s.x * s.x / n);
+    m.m2y = std::max(0.0, s.yy - s.y * s.y / n);
+    m.cxy = s.xy - s.x * s.y / n;
+  }
+}
+
+bool betterCorrelation(const SizeCorrelation &x, const SizeCorrelation &y) {
+  double rx = std::fabs(x.r), ry = std::fabs(y.r);
+  if (rx != ry)
+    return rx > ry;
+  if (x.offset != y.offset)
+    return x.offset < y.offset;
+  if (x.width != y.width)
+    return x.width < y.width;
+  return x.bigEndian < y.bigEndian;
+}
+
+// Stores a merged tile: its offsets below summary.bytes and the candidate
+// correlations of the fields every input has, in the byte order that
+// correlates better.
+void storeTile(const TilePartial &tile, size_t tileStart,
+               CorpusSummary &summary,
+               std::vector<SizeCorrelation> &candidates) {
+  size_t end = std::min(summary.bytes - tileStart, kCorpusTileBytes);
+  for (size_t i = 0; i < end; ++i) {
+    size_t offset = tileStart + i;
+    uint32_t n = tile.count[i];
+    summary.coverage[offset] = n;
+    if (n == 0)
+      continue;
+    double mean = double(tile.sum[i]) / n;
+    double variance = double(tile.sumSquares[i]) / n - mean * mean;
+    summary.mean[offset] = static_cast<float>(mean);
+    summary.variance[offset] = static_cast<float>(std::max(0.0, variance));
+    summary.minimum[offset] = tile.minimum[i];
+    summary.maximum[offset] = tile.maximum[i];
+  }
+
+  if (summary.files < 3)
+    return;
+  bool constant[kCorpusTileBytes];
+  for (size_t i = 0; i < kCorpusTileBytes; ++i)
+    constant[i] = tile.count[i] == summary.files &&
+                  tile.minimum[i] == tile.maximum[i];
+  auto allConstant = [&](size_t begin, size_t length) {
+    return std::all_of(constant + begin, constant + begin + length,
+                       [](bool c) { return c; });
+  };
+  for (int w = 0; w < 3; ++w) {
+    int width = kFieldWidths[w];
+    for (size_t k = 0; k < kCorpusTileBytes / width; ++k) {
+      size_t start = k * width;
+      // With the other half of its word constant, a 2-byte field is an
+      // affine function of the word, and an 8-byte field one of its
+      // varying half: the same correlation, listed once.
+      if (w == 0 && allConstant((start & ~size_t(3)) + (~start & 2), 2))
+        continue;
+      if (w == 2 && (allConstant(start, 4) || allConstant(start + 4, 4)))
+        continue;
+      SizeCorrelation best;
+      bool found = false;
+      for (size_t e = 0; e < 2; ++e) {
+        const Moments &m = tile.fields[kFieldBase[w] + 2 * k + e];
+        if (m.n != double(summary.files) || m.m2x <= 0)
+          continue;
+        if (e == 0)
+          ++summary.fieldsTested;
+        // A count whose low byte never changes while a higher one does is
+        // the wrong byte order or a misaligned read.
+        size_t low = e ? start + width - 1 : start;
+        if (m.m2y <= 0 || constant[low])
+          continue;
+        SizeCorrelation c;
+        c.offset = static_cast<uint32_t>(tileStart + start);
+        c.width = static_cast<uint32_t>(width);
+        c.bigEndian = e == 1;
+        c.r = m.cxy / std::sqrt(m.m2x * m.m2y);
+        c.slope = m.cxy / m.m2x;
+        c.intercept = m.meanY - c.slope * m.meanX;
+        if (std::isfinite(c.r) &&
+            (!found || std::fabs(c.r) > std::fabs(best.r))) {
+          best = c;
+          found = true;
+        }
+      }
+      if (found)
+        candidates.push_back(best);
+    }
+  }
+}
+
+// Runs of constant offsets, with the bytes of the first input.
+void findConstants(const std::vector<ByteView> &inputs,
+                   CorpusSummary &summary) {
+  auto constantAt = [&](size_t offset) {
+    return summary.files >= 2 && summary.coverage[offset] == summary.files &&
+           summary.minimum[offset] == summary.maximum[offset];
+  };
+  size_t start = 0;
+  while (start < summary.bytes) {
+    if (!constantAt(start)) {
+      ++start;
+      continue;
+    }
+    size_t end = start + 1;
+    while (end < summary.bytes && constantAt(end))
+      ++end;
+    summary.constantBytes += end - start;
+    ++summary.constantFields;
+    if (summary.constants.size() < kMaxFields) {
+      Field field;
+      field.offset = start;
+      field.length = end - start;
+      field.stable = true;
+      field.distinct = 1;
+      std::memcpy(field.value, inputs[0].data() + start,
+                  std::min(field.length, Field::kMaxValueBytes));
+      summary.constants.push_back(field);
+    }
+    start = end;
+  }
+}
+
+} // namespace
+
+CorpusSummary analyzeCorpus(const std::vector<ByteView> &inputs,
+                            size_t bytes, ThreadPool *pool) {
+  std::vector<uint64_t> sizes(inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i)
+    sizes[i] = inputs[i].size();
+  return analyzeCorpus(inputs, sizes, bytes, pool);
+}
+
+CorpusSummary analyzeCorpus(const std::vector<ByteView> &inputs,
+                            const std::vector<uint64_t> &sizes, size_t bytes,
+                            ThreadPool *pool) {
+  CorpusSummary summary;
+  summary.files = inputs.size();
+  if (inputs.empty())
+    return summary;
+  summary.smallestSize = sizes[0];
+  double total = 0;
+  for (uint64_t size : sizes) {
+    summary.smallestSize = std::min<size_t>(summary.smallestSize, size);
+    summary.largestSize = std::max<size_t>(summary.largestSize, size);
+    total += static_cast<double>(size);
+  }
+  summary.meanSize = total / inputs.size();
+  summary.bytes = std::min(bytes, summary.largestSize);
+  summary.coverage.assign(summary.bytes, 0);
+  summary.mean.assign(summary.bytes, 0.0f);
+  summary.variance.assign(summary.bytes, 0.0f);
+  summary.minimum.assign(summary.bytes, 0);
+  summary.maximum.assign(summary.bytes, 0);
+
+  size_t tiles = (summary.bytes + kCorpusTileBytes - 1) / kCorpusTileBytes;
+  size_t blocks = (inputs.size() + kCorpusFileBlock - 1) / kCorpusFileBlock;
+  size_t batch = std::max<size_t>(1, kMaxCorpusPartials / blocks);
+  std::vector<TilePartial> partials(std::min(tiles, batch) * blocks);
+  std::vector<SizeCorrelation> candidates;
+
+  for (size_t firstTile = 0; firstTile < tiles; firstTile += batch) {
+    size_t batchTiles = std::min(batch, tiles - firstTile);
+    auto task = [&](size_t i) {
+      size_t tile = firstTile + i / blocks;
+      size_t block = i % blocks;
+      size_t first = block * kCorpusFileBlock;
+      size_t last = std::min(inputs.size(), first + kCorpusFileBlock);
+      size_t start = tile * kCorpusTileBytes;
+      accumulateTile(inputs, sizes, first, last, start,
+                     std::min(kCorpusTileBytes, summary.bytes - start),
+                     partials[i]);
+    };
+    if (pool)
+      pool->parallelFor(batchTiles * blocks, task);
+    else
+      for (size_t i = 0; i < batchTiles * blocks; ++i)
+        task(i);
+
+    for (size_t t = 0; t < batchTiles; ++t) {
+      TilePartial &merged = partials[t * blocks];
+      for (size_t b = 1; b < blocks; ++b)
+        merged.merge(partials[t * blocks + b]);
+      storeTile(merged, (firstTile + t) * kCorpusTileBytes, summary,
+                candidates);
+    }
+  }
+
+  findConstants(inputs, summary);
+  size_t kept = std::min(candidates.size(), kMaxCorpusCorrelations);
+  std::partial_sort(candidates.begin(), candidates.begin() + kept,
+                    candidates.end(), betterCorrelation);
+  candidates.resize(kept);
+  summary.correlations = std::move(candidates);
+  return summary;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_view.h"
+#include "diff.h"
+
+class ThreadPool;
+
+// Offsets covered by default: the header area, where fields sit at the
+// same offset in every sample.
+const size_t kCorpusBytes = 4096;
+// Tile edges: offsets per tile and inputs per block. A tile's accumulators
+// (about 27 KiB) stay in L1/L2 while a block of inputs streams through it.
+const size_t kCorpusTileBytes = 256;
+const size_t kCorpusFileBlock = 256;
+// Field-size correlations kept for the report, best first.
+const size_t kMaxCorpusCorrelations = 16;
+
+// An aligned integer field whose value tracks the file size across the
+// corpus: size ~= intercept + slope * value, Pearson correlation r.
+struct SizeCorrelation {
+  uint32_t offset = 0;
+  uint32_t width = 0; // 2, 4 or 8 bytes
+  bool bigEndian = false;
+  double r = 0;
+  double slope = 0;
+  double intercept = 0;
+};
+
+struct CorpusSummary {
+  size_t files = 0;
+  size_t bytes = 0; // Offsets analyzed: [0, bytes)
+  size_t smallestSize = 0;
+  size_t largestSize = 0;
+  double meanSize = 0;
+
+  // Per offset: the inputs long enough to have it, and the mean, variance,
+  // minimum and maximum of its byte over them.
+  std::vector<uint32_t> coverage;
+  std::vector<float> mean;
+  std::vector<float> variance;
+  std::vector<uint8_t> minimum;
+  std::vector<uint8_t> maximum;
+
+  // Runs of offsets with the same byte in every input (and in at least
+  // two); the first kMaxFields, in offset order, all marked stable.
+  size_t constantBytes = 0;
+  size_t constantFields = 0;
+  std::vector<Field> constants;
+
+  size_t fieldsTested = 0; // Fields present in every input, non-constant
+  std::vector<SizeCorrelation> correlations;
+};
+
+// Helper: Corpus statistics
+//
+// Per-offset statistics over many samples of one format at once: the
+// variance of every byte, which offsets never change, and which aligned
+// 2-, 4- and 8-byte integers (either byte order) correlate with the file
+// size. The offset range is cut into kCorpusTileBytes tiles and the inputs
+// into kCorpusFileBlock blocks; each (tile, block) pair is one task that
+// streams the tile's slice of every input in the block through accumulators
+// sized to stay in cache, so the work is N x bytes with no shared state and
+// spreads over `pool` evenly. Blocks are merged per tile in block order,
+// so the result doesn't depend on the thread count. Each field is
+// reported in the byte order that correlates better, and not at all when
+// its low byte is constant; a 2- or 8-byte field is left out when the rest
+// of its 4-byte word, or one of its 4-byte halves, is constant, as it then
+// repeats the correlation of a 4-byte field.
+CorpusSummary analyzeCorpus(const std::vector<ByteView> &inputs,
+                            size_t bytes = kCorpusBytes,
+                            ThreadPool *pool = nullptr);
+
+// Same, for inputs that hold only the first `bytes` of each file (corpus
+// mode reads no further, see prefetch.h); `sizes` are the whole files'.
+CorpusSummary analyzeCorpus(const std::vector<ByteView> &inputs,
+                            const std::vector<uint64_t> &sizes,
+                            size_t bytes = kCorpusBytes,
+                            ThreadPool *pool = nullptr);
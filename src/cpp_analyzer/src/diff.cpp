@@ -0,0 +1,436 @@
+#include "diff.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#include "hash.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DIFF_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define DIFF_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define DIFF_NEON 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Content-defined chunk sizes. Boundaries fall where the top kChunkBits of
+// the gear hash are zero, so chunks average kMinChunk + 2^kChunkBits bytes.
+const size_t kMinChunk = 256;
+const size_t kMaxChunk = 8192;
+const int kChunkBits = 10;
+// Bit k of a gear hash depends on the last k + 1 bytes only, so hashing can
+// start this many bytes before the earliest allowed boundary.
+const size_t kGearWindow = 64;
+
+// Equal runs shorter than this don't split a hunk.
+const size_t kMinEqualRun = 8;
+
+// Block of offsets compared across all files at once by compareFields.
+const size_t kFieldBlock = size_t(64) << 10;
+
+unsigned lowestSetBit(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+unsigned highestSetBit(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse(&index, mask);
+  return index;
+#else
+  return 31 - __builtin_clz(mask);
+#endif
+}
+
+// Bit i set when a[i] == b[i], for the next vector's worth of bytes.
+#if defined(DIFF_AVX2)
+const size_t kVectorBytes = 32;
+const uint32_t kAllEqual = 0xffffffffu;
+uint32_t equalMask(const uint8_t *a, const uint8_t *b) {
+  __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a));
+  __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b));
+  return static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+}
+#elif defined(DIFF_SSE2)
+const size_t kVectorBytes = 16;
+const uint32_t kAllEqual = 0xffffu;
+uint32_t equalMask(const uint8_t *a, const uint8_t *b) {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+  __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+}
+#elif defined(DIFF_NEON)
+const size_t kVectorBytes = 16;
+const uint32_t kAllEqual = 0xffffu;
+uint32_t equalMask(const uint8_t *a, const uint8_t *b) {
+  // NEON has no movemask: weight each lane by its bit and add across.
+  static const uint8_t kWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                       1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t eq = vceqq_u8(vld1q_u8(a), vld1q_u8(b));
+  uint8x16_t bits = vandq_u8(eq, vld1q_u8(kWeights));
+  return uint32_t(vaddv_u8(vget_low_u8(bits))) |
+         uint32_t(vaddv_u8(vget_high_u8(bits))) << 8;
+}
+#else
+const size_t kVectorBytes = 8;
+const uint32_t kAllEqual = 0xffu;
+uint32_t equalMask(const uint8_t *a, const uint8_t *b) {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < 8; ++i)
+    mask |= uint32_t(a[i] == b[i]) << i;
+  return mask;
+}
+#endif
+
+// Number of leading bytes where a and b agree, at most n.
+size_t equalPrefix(const uint8_t *a, const uint8_t *b, size_t n) {
+  size_t i = 0;
+  for (; i + kVectorBytes <= n; i += kVectorBytes) {
+    uint32_t eq = equalMask(a + i, b + i);
+    if (eq != kAllEqual)
+      return i + lowestSetBit(~eq);
+  }
+  while (i < n && a[i] == b[i])
+    ++i;
+  return i;
+}
+
+// Number of leading bytes where a and b differ, at most n.
+size_t differentPrefix(const uint8_t *a, const uint8_t *b, size_t n) {
+  size_t i = 0;
+  for (; i + kVectorBytes <= n; i += kVectorBytes) {
+    uint32_t eq = equalMask(a + i, b + i);
+    if (eq)
+      return i + lowestSetBit(eq);
+  }
+  while (i < n && a[i] != b[i])
+    ++i;
+  return i;
+}
+
+// Number of trailing bytes before aEnd and bEnd that agree, at most n.
+size_t equalSuffix(const uint8_t *aEnd, const uint8_t *bEnd, size_t n) {
+  size_t i = 0;
+  for (; i + kVectorBytes <= n; i += kVectorBytes) {
+    const size_t back = i + kVectorBytes;
+    uint32_t ne = ~equalMask(aEnd - back, bEnd - back) & kAllEqual;
+    if (ne)
+      return i + (kVectorBytes - 1 - highestSetBit(ne));
+  }
+  while (i < n && aEnd[-1 - ptrdiff_t(i)] == bEnd[-1 - ptrdiff_t(i)])
+    ++i;
+  return i;
+}
+
+// same[i] &= (a[i] == b[i]); 0xff marks offsets equal so far.
+void andEqual(const uint8_t *a, const uint8_t *b, size_t n, uint8_t *same) {
+  size_t i = 0;
+#if defined(DIFF_AVX2)
+  for (; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+    __m256i *s = reinterpret_cast<__m256i *>(same + i);
+    _mm256_storeu_si256(
+        s, _mm256_and_si256(_mm256_loadu_si256(s), _mm256_cmpeq_epi8(x, y)));
+  }
+#elif defined(DIFF_SSE2)
+  for (; i + 16 <= n; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    __m128i *s = reinterpret_cast<__m128i *>(same + i);
+    _mm_storeu_si128(s,
+                     _mm_and_si128(_mm_loadu_si128(s), _mm_cmpeq_epi8(x, y)));
+  }
+#elif defined(DIFF_NEON)
+  for (; i + 16 <= n; i += 16)
+    vst1q_u8(same + i, vandq_u8(vld1q_u8(same + i),
+                                vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i))));
+#endif
+  for (; i < n; ++i)
+    same[i] &= a[i] == b[i] ? 0xff : 0x00;
+}
+
+// Random per-byte values for the gear hash (splitmix64, fixed seed, so
+// chunk boundaries are the same from run to run).
+struct GearTable {
+  uint64_t values[256];
+  GearTable() {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (uint64_t &v : values) {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      v = z ^ (z >> 31);
+    }
+  }
+};
+const GearTable kGear;
+
+struct Chunk {
+  size_t offset;
+  size_t length;
+  uint64_t hash;
+};
+
+std::vector<Chunk> cutChunks(ByteView data) {
+  std::vector<Chunk> chunks;
+  chunks.reserve(data.size() / (kMinChunk + (size_t(1) << kChunkBits)) + 1);
+  const uint64_t mask = ~uint64_t(0) << (64 - kChunkBits);
+  const uint8_t *p = data.data();
+  size_t start = 0;
+  while (start < data.size()) {
+    size_t end = std::min(data.size(), start + kMaxChunk);
+    size_t cut = end;
+    if (end - start > kMinChunk) {
+      uint64_t h = 0;
+      for (size_t i = start + kMinChunk - kGearWindow; i < end; ++i) {
+        h = (h << 1) + kGear.values[p[i]];
+        if (!(h & mask) && i + 1 - start >= kMinChunk) {
+          cut = i + 1;
+          break;
+        }
+      }
+    }
+    ByteView chunk = data.subview(start, cut - start);
+    chunks.push_back({start, chunk.size(), hashBytes(chunk)});
+    start = cut;
+  }
+  return chunks;
+}
+
+struct Anchor {
+  size_t offsetA;
+  size_t offsetB;
+  size_t length;
+};
+
+// The longest subsequence of `matches` (ordered by offsetB) whose offsetA
+// also increases, by patience sorting.
+std::vector<Anchor> increasingAnchors(const std::vector<Anchor> &matches) {
+  std::vector<size_t> tails; // Index of the smallest tail per length
+  std::vector<size_t> previous(matches.size());
+  for (size_t i = 0; i < matches.size(); ++i) {
+    auto pos = std::lower_bound(
+        tails.begin(), tails.end(), matches[i].offsetA,
+        [&](size_t t, size_t offset) { return matches[t].offsetA < offset; });
+    previous[i] = pos == tails.begin() ? SIZE_MAX : *(pos - 1);
+    if (pos == tails.end())
+      tails.push_back(i);
+    else
+      *pos = i;
+  }
+  std::vector<Anchor> anchors(tails.size());
+  size_t i = tails.empty() ? SIZE_MAX : tails.back();
+  for (size_t k = anchors.size(); k-- > 0; i = previous[i])
+    anchors[k] = matches[i];
+  return anchors;
+}
+
+// Accumulates hunks and totals while the gaps are walked in file order.
+class DiffBuilder {
+public:
+  DiffBuilder(ByteView a, ByteView b, DiffSummary &summary)
+      : a_(a), b_(b), summary_(summary) {}
+
+  void equal(size_t count) { summary_.equalBytes += count; }
+
+  // Aligns A[aLo, aHi) with B[bLo, bHi), which lie between two anchors.
+  void gap(size_t aLo, size_t aHi, size_t bLo, size_t bHi) {
+    size_t lengthA = aHi - aLo, lengthB = bHi - bLo;
+    size_t common = std::min(lengthA, lengthB);
+    size_t head = equalPrefix(a_.data() + aLo, b_.data() + bLo, common);
+    size_t tail = equalSuffix(a_.data() + aHi, b_.data() + bHi, common - head);
+    equal(head + tail);
+    lengthA -= head + tail;
+    lengthB -= head + tail;
+    if (lengthA == lengthB) {
+      lockstep(aLo + head, bLo + head, lengthA);
+      return;
+    }
+    // Sizes differ: part of it is an insertion or deletion, and without an
+    // anchor inside there's no telling where. One hunk for the lot.
+    common = std::min(lengthA, lengthB);
+    summary_.changedBytes += common;
+    summary_.deletedBytes += lengthA - common;
+    summary_.insertedBytes += lengthB - common;
+    hunk(aLo + head, lengthA, bLo + head, lengthB);
+  }
+
+private:
+  // Same-length ranges: differing runs separated by fewer than
+  // kMinEqualRun equal bytes form one hunk.
+  void lockstep(size_t offsetA, size_t offsetB, size_t n) {
+    const uint8_t *a = a_.data() + offsetA;
+    const uint8_t *b = b_.data() + offsetB;
+    size_t i = equalPrefix(a, b, n);
+    equal(i);
+    while (i < n) {
+      size_t start = i, end = i;
+      while (i < n) {
+        size_t different = differentPrefix(a + i, b + i, n - i);
+        summary_.changedBytes += different;
+        i += different;
+        end = i;
+        size_t same = equalPrefix(a + i, b + i, n - i);
+        equal(same);
+        i += same;
+        if (same >= kMinEqualRun)
+          break;
+      }
+      hunk(offsetA + start, end - start, offsetB + start, end - start);
+    }
+  }
+
+  void hunk(size_t offsetA, size_t lengthA, size_t offsetB, size_t lengthB) {
+    ++summary_.hunkCount;
+    if (summary_.hunks.size() < kMaxDiffHunks)
+      summary_.hunks.push_back({offsetA, lengthA, offsetB, lengthB});
+    if (a_.empty())
+      return;
+    // Bin k covers A[k * size / bins, (k + 1) * size / bins).
+    const uint64_t size = a_.size();
+    const uint64_t bins = DiffSummary::kHistogramBins;
+    uint64_t lo = offsetA, hi = offsetA + lengthA;
+    for (uint64_t k = lo * bins / size; k < bins && lo < hi; ++k) {
+      uint64_t binEnd = std::min(hi, (k + 1) * size / bins);
+      if (binEnd > lo) {
+        summary_.histogram[k] += static_cast<uint32_t>(binEnd - lo);
+        lo = binEnd;
+      }
+    }
+  }
+
+  ByteView a_;
+  ByteView b_;
+  DiffSummary &summary_;
+};
+
+} // namespace
+
+DiffSummary diffBytes(ByteView a, ByteView b, ThreadPool *pool) {
+  ProfileZone zone(ProfilePhase::Diff, a.size() + b.size());
+  DiffSummary summary;
+  std::vector<Chunk> chunks[2];
+  ByteView inputs[2] = {a, b};
+  auto cut = [&](size_t i) { chunks[i] = cutChunks(inputs[i]); };
+  if (pool) {
+    pool->parallelFor(2, cut);
+  } else {
+    cut(0);
+    cut(1);
+  }
+
+  // Chunks of B found in A, in B order. A chunk repeated in A matches its
+  // first occurrence.
+  std::unordered_map<uint64_t, size_t> byHash;
+  byHash.reserve(chunks[0].size());
+  for (size_t i = 0; i < chunks[0].size(); ++i)
+    byHash.emplace(chunks[0][i].hash, i);
+  std::vector<Anchor> matches;
+  for (const Chunk &chunk : chunks[1]) {
+    auto it = byHash.find(chunk.hash);
+    if (it == byHash.end())
+      continue;
+    const Chunk &match = chunks[0][it->second];
+    if (match.length == chunk.length &&
+        std::memcmp(a.data() + match.offset, b.data() + chunk.offset,
+                    chunk.length) == 0)
+      matches.push_back({match.offset, chunk.offset, chunk.length});
+  }
+  std::vector<Anchor> anchors = increasingAnchors(matches);
+  summary.anchors = anchors.size();
+
+  DiffBuilder builder(a, b, summary);
+  size_t offsetA = 0, offsetB = 0;
+  for (const Anchor &anchor : anchors) {
+    builder.gap(offsetA, anchor.offsetA, offsetB, anchor.offsetB);
+    builder.equal(anchor.length);
+    offsetA = anchor.offsetA + anchor.length;
+    offsetB = anchor.offsetB + anchor.length;
+  }
+  builder.gap(offsetA, a.size(), offsetB, b.size());
+  return summary;
+}
+
+FieldSummary compareFields(const std::vector<ByteView> &inputs) {
+  ProfileZone zone(ProfilePhase::Diff);
+  FieldSummary summary;
+  summary.files = inputs.size();
+  if (inputs.empty())
+    return summary;
+  summary.commonSize = inputs[0].size();
+  for (const ByteView &input : inputs) {
+    summary.commonSize = std::min(summary.commonSize, input.size());
+    summary.largestSize = std::max(summary.largestSize, input.size());
+    zone.addBytes(input.size());
+  }
+
+  auto close = [&](size_t offset, size_t length, bool stable) {
+    if (length == 0)
+      return;
+    (stable ? summary.stableBytes : summary.varyingBytes) += length;
+    ++(stable ? summary.stableFields : summary.varyingFields);
+    if (summary.fields.size() == kMaxFields)
+      return;
+    Field field;
+    field.offset = offset;
+    field.length = length;
+    field.stable = stable;
+    size_t shown = std::min(length, Field::kMaxValueBytes);
+    std::memcpy(field.value, inputs[0].data() + offset, shown);
+    if (stable) {
+      field.distinct = 1;
+    } else if (length <= Field::kMaxValueBytes) {
+      std::vector<std::string> values;
+      for (const ByteView &input : inputs)
+        values.emplace_back(
+            reinterpret_cast<const char *>(input.data() + offset), length);
+      std::sort(values.begin(), values.end());
+      field.distinct =
+          std::unique(values.begin(), values.end()) - values.begin();
+    }
+    summary.fields.push_back(field);
+  };
+
+  std::vector<uint8_t> same(kFieldBlock);
+  size_t fieldStart = 0;
+  bool fieldStable = true;
+  for (size_t start = 0; start < summary.commonSize; start += kFieldBlock) {
+    size_t length = std::min(kFieldBlock, summary.commonSize - start);
+    std::fill(same.begin(), same.begin() + length, 0xff);
+    for (size_t f = 1; f < inputs.size(); ++f)
+      andEqual(inputs[0].data() + start, inputs[f].data() + start, length,
+               same.data());
+    for (size_t i = 0; i < length; ++i) {
+      bool stable = same[i] != 0;
+      if (stable != fieldStable) {
+        close(fieldStart, start + i - fieldStart, fieldStable);
+        fieldStart = start + i;
+        fieldStable = stable;
+      }
+    }
+  }
+  close(fieldStart, summary.commonSize - fieldStart, fieldStable);
+  summary.sizes = solveSizes(inputs);
+  return summary;
+}
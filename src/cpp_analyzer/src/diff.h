@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_view.h"
+#include "sizes.h"
+
+class ThreadPool;
+
+// Hunks and fields kept for the report; the totals always cover everything.
+const size_t kMaxDiffHunks = 64;
+const size_t kMaxFields = 64;
+
+// A differing range: A[offsetA, offsetA + lengthA) became
+// B[offsetB, offsetB + lengthB). One of the lengths is 0 for a pure
+// insertion or deletion.
+struct DiffHunk {
+  size_t offsetA = 0;
+  size_t lengthA = 0;
+  size_t offsetB = 0;
+  size_t lengthB = 0;
+};
+
+struct DiffSummary {
+  static const int kHistogramBins = 16;
+
+  size_t equalBytes = 0;    // Matched and identical
+  size_t changedBytes = 0;  // Overwritten in place
+  size_t deletedBytes = 0;  // Only in A
+  size_t insertedBytes = 0; // Only in B
+  size_t anchors = 0;       // Content-defined chunks matched between A and B
+  size_t hunkCount = 0;
+  std::vector<DiffHunk> hunks; // The first kMaxDiffHunks, in file order
+  // Bytes of A inside hunks, per sixteenth of A: where the edits are.
+  uint32_t histogram[kHistogramBins] = {};
+};
+
+// Helper: Byte-level diff
+//
+// Aligns B against A and summarizes what changed. Both files are cut into
+// content-defined chunks (a gear rolling hash picks the boundaries from the
+// bytes themselves, so an insertion only disturbs the chunk it lands in);
+// chunks of B found verbatim in A become anchors, and the longest run of
+// anchors in increasing order on both sides fixes the alignment. This is
+// what lets the diff resync after an insertion or deletion instead of
+// reporting the whole tail as changed. The gaps between anchors are trimmed
+// with vectorized equal-run scans from both ends and what remains is
+// compared in lockstep into hunks. Near-linear in the file sizes.
+DiffSummary diffBytes(ByteView a, ByteView b, ThreadPool *pool = nullptr);
+
+// A run of offsets that are the same in every file (stable) or differ in at
+// least one (varying).
+struct Field {
+  static const size_t kMaxValueBytes = 16;
+
+  size_t offset = 0;
+  size_t length = 0;
+  bool stable = false;
+  // Stable fields: the bytes (first kMaxValueBytes). Varying fields of at
+  // most kMaxValueBytes: the number of distinct values across the files,
+  // 0 for longer ones.
+  uint8_t value[kMaxValueBytes] = {};
+  size_t distinct = 0;
+};
+
+struct FieldSummary {
+  size_t files = 0;
+  size_t commonSize = 0; // Smallest file: offsets compared
+  size_t largestSize = 0;
+  size_t stableBytes = 0;
+  size_t varyingBytes = 0;
+  size_t stableFields = 0;
+  size_t varyingFields = 0;
+  std::vector<Field> fields; // The first kMaxFields, in offset order
+  SizeSummary sizes;         // Count fields that explain the file sizes
+};
+
+// Helper: Field analysis
+//
+// Compares N files offset by offset over their common prefix and splits it
+// into stable and varying fields. Samples of one format share magic numbers,
+// version and reserved fields while counts, sizes and payload vary, so the
+// stable fields are a first guess at the fixed part of a header. All files
+// are compared against the first, 16 to 32 bytes at a time. The file sizes
+// are then solved for header and count fields (solveSizes).
+FieldSummary compareFields(const std::vector<ByteView> &inputs);
@@ -0,0 +1,362 @@
+#include "entropy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ENTROPY_SSE2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define ENTROPY_NEON 1
+#endif
+
+namespace {
+
+// Entropy kernel
+//
+// With c[b] the count of byte value b in an n-byte buffer:
+//   H = -sum(c/n * log2(c/n)) = log2(n) - (1/n) * sum(c * log2(c))
+// so the only per-buffer work is a histogram and sum(c * log2(c)); no
+// division or log2 per bin is needed.
+//
+// The histogram is split into 4 interleaved sub-histograms (byte i goes to
+// sub-histogram i % 4). Runs of the same byte (padding, zeroed fields) would
+// otherwise make every increment wait on the previous store to the same bin.
+// The sub-histograms are merged with 16-lane SIMD adds.
+
+// Buffers up to this size keep 8-bit bin counts, which can't overflow.
+const size_t kMaxSmallChunk = 255;
+
+// log2(c) in 8.24 fixed point for c in [0, 255]. Summing log2(c[b]) over
+// every byte of the buffer equals sum(c * log2(c)) over the bins, so small
+// buffers do n lookups instead of a 256-bin scan, and integer adds keep the
+// accumulators off the floating-point latency chain.
+const int kLog2FixedShift = 24;
+
+struct Log2Table {
+  uint32_t fixed[kMaxSmallChunk + 1];
+  Log2Table() {
+    fixed[0] = 0;
+    for (size_t c = 1; c <= kMaxSmallChunk; ++c)
+      fixed[c] = static_cast<uint32_t>(
+          std::lround(std::log2(static_cast<double>(c)) *
+                      static_cast<double>(1u << kLog2FixedShift)));
+  }
+};
+
+const Log2Table kLog2Table;
+
+// Merges the 4 sub-histograms into counts[256].
+void mergeHistograms(const uint8_t (&hist)[4][256], uint8_t (&counts)[256]) {
+#if defined(ENTROPY_SSE2)
+  for (int b = 0; b < 256; b += 16) {
+    __m128i sum = _mm_load_si128(reinterpret_cast<const __m128i *>(&hist[0][b]));
+    sum = _mm_add_epi8(
+        sum, _mm_load_si128(reinterpret_cast<const __m128i *>(&hist[1][b])));
+    sum = _mm_add_epi8(
+        sum, _mm_load_si128(reinterpret_cast<const __m128i *>(&hist[2][b])));
+    sum = _mm_add_epi8(
+        sum, _mm_load_si128(reinterpret_cast<const __m128i *>(&hist[3][b])));
+    _mm_store_si128(reinterpret_cast<__m128i *>(&counts[b]), sum);
+  }
+#elif defined(ENTROPY_NEON)
+  for (int b = 0; b < 256; b += 16) {
+    uint8x16_t sum = vaddq_u8(vld1q_u8(&hist[0][b]), vld1q_u8(&hist[1][b]));
+    sum = vaddq_u8(sum, vld1q_u8(&hist[2][b]));
+    sum = vaddq_u8(sum, vld1q_u8(&hist[3][b]));
+    vst1q_u8(&counts[b], sum);
+  }
+#else
+  for (int b = 0; b < 256; ++b)
+    counts[b] = static_cast<uint8_t>(hist[0][b] + hist[1][b] + hist[2][b] +
+                                     hist[3][b]);
+#endif
+}
+
+float smallChunkEntropy(ByteView data) {
+  const uint8_t *p = data.data();
+  size_t n = data.size();
+
+  alignas(16) uint8_t hist[4][256];
+  alignas(16) uint8_t counts[256];
+  std::memset(hist, 0, sizeof(hist));
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    hist[0][p[i]]++;
+    hist[1][p[i + 1]]++;
+    hist[2][p[i + 2]]++;
+    hist[3][p[i + 3]]++;
+  }
+  for (; i < n; ++i)
+    hist[0][p[i]]++;
+
+  mergeHistograms(hist, counts);
+  // A single byte value: exactly 0, which the rounded table below misses
+  // by a few ulps either way for lengths that aren't powers of two
+  if (counts[p[0]] == n)
+    return 0.0f;
+
+  const uint32_t *log2Fixed = kLog2Table.fixed;
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += log2Fixed[counts[p[i]]];
+    s1 += log2Fixed[counts[p[i + 1]]];
+    s2 += log2Fixed[counts[p[i + 2]]];
+    s3 += log2Fixed[counts[p[i + 3]]];
+  }
+  for (; i < n; ++i)
+    s0 += log2Fixed[counts[p[i]]];
+
+  double sumCLogC = static_cast<double>(s0 + s1 + s2 + s3) /
+                    static_cast<double>(1u << kLog2FixedShift);
+  double total = static_cast<double>(n);
+  return static_cast<float>(
+      std::max(0.0, std::log2(total) - sumCLogC / total));
+}
+
+// Sub-histogram bins are 32-bit; countBytes works in pieces small enough
+// that they can't overflow.
+const size_t kMaxCountPiece = size_t(1) << 32;
+
+// Larger buffers (whole regions rather than map chunks) use wide bins and
+// a single pass over the 256 bins, which is cheaper than n lookups once
+// n > 256.
+float largeBufferEntropy(ByteView data) {
+  uint64_t counts[256] = {};
+  countBytes(data, counts);
+  return histogramEntropy(counts, data.size());
+}
+
+} // namespace
+
+void countBytes(ByteView data, uint64_t *counts) {
+  for (size_t piece = 0; piece < data.size(); piece += kMaxCountPiece) {
+    const uint8_t *p = data.data() + piece;
+    size_t n = std::min(kMaxCountPiece, data.size() - piece);
+
+    uint32_t hist[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      hist[0][p[i]]++;
+      hist[1][p[i + 1]]++;
+      hist[2][p[i + 2]]++;
+      hist[3][p[i + 3]]++;
+    }
+    for (; i < n; ++i)
+      hist[0][p[i]]++;
+    for (int b = 0; b < 256; ++b)
+      counts[b] += uint64_t(hist[0][b]) + hist[1][b] + hist[2][b] + hist[3][b];
+  }
+}
+
+float histogramEntropy(const uint64_t *counts, uint64_t total) {
+  if (total == 0)
+    return 0.0f;
+  double sumCLogC = 0.0;
+  for (int b = 0; b < 256; ++b) {
+    if (counts[b] == total)
+      return 0.0f; // log2(n) - n log2(n) / n can round below zero
+    if (counts[b] > 1) {
+      double count = static_cast<double>(counts[b]);
+      sumCLogC += count * std::log2(count);
+    }
+  }
+  double n = static_cast<double>(total);
+  return static_cast<float>(std::max(0.0, std::log2(n) - sumCLogC / n));
+}
+
+// Helper: Calculate Shannon Entropy of a buffer
+//
+// Shannon Entropy measures the randomness or information density of data.
+// Formula: H(X) = -sum(p(x) * log2(p(x)))
+// Range: 0.0 (all bytes are same) to 8.0 (all bytes are random/uniform)
+//
+// Interpretation for Reverse Engineering:
+// - Low Entropy (< 3.0): Text, padding (zeros), or sparse data.
+// - Medium Entropy (3.0 - 6.0): Code, structured data, or repeating patterns.
+// - High Entropy (> 7.0): Compressed data, encrypted data, or dense
+// floating-point arrays.
+//
+// We calculate this per 64-byte chunk to visualize the "texture" of the file.
+// For example, a file might start with low entropy (header) and switch to high
+// entropy (mesh data).
+float calculateEntropy(ByteView data) {
+  if (data.empty())
+    return 0.0f;
+  if (data.size() <= kMaxSmallChunk)
+    return smallChunkEntropy(data);
+  return largeBufferEntropy(data);
+}
+
+SlidingEntropy::SlidingEntropy(size_t window)
+    : cLogC_(window + 1), window_(window),
+      log2Window_(std::log2(static_cast<double>(window))) {
+  const double scale = 4294967296.0; // 2^32
+  for (size_t c = 2; c <= window; ++c) {
+    double count = static_cast<double>(c);
+    cLogC_[c] = static_cast<int64_t>(std::llround(count * std::log2(count) *
+                                                  scale));
+  }
+}
+
+void SlidingEntropy::push(uint8_t byte) {
+  uint32_t &c = counts_[byte];
+  sum_ += cLogC_[c + 1] - cLogC_[c];
+  ++c;
+  ++size_;
+}
+
+void SlidingEntropy::pop(uint8_t byte) {
+  uint32_t &c = counts_[byte];
+  sum_ -= cLogC_[c] - cLogC_[c - 1];
+  --c;
+  --size_;
+}
+
+void SlidingEntropy::clear() {
+  std::memset(counts_, 0, sizeof(counts_));
+  sum_ = 0;
+  size_ = 0;
+}
+
+float SlidingEntropy::entropy() const {
+  if (size_ == 0)
+    return 0.0f;
+  double total = static_cast<double>(size_);
+  double log2Total = size_ == window_ ? log2Window_ : std::log2(total);
+  // One byte value fills the window: exactly 0, not the fixed-point
+  // rounding error (which can be negative, printing as -0.00)
+  if (sum_ == cLogC_[size_])
+    return 0.0f;
+  double sumCLogC = static_cast<double>(sum_) / 4294967296.0;
+  return static_cast<float>(std::max(0.0, log2Total - sumCLogC / total));
+}
+
+size_t entropyWindowCount(size_t size, size_t window, size_t stride) {
+  if (size == 0)
+    return 0;
+  // Index of the first window that reaches the end of the data...
+  size_t reachesEnd = size > window ? (size - window + stride - 1) / stride : 0;
+  // ...unless a gap (stride > window) means the last start comes earlier.
+  size_t lastStart = (size - 1) / stride;
+  return std::min(reachesEnd, lastStart) + 1;
+}
+
+void computeEntropyWindows(ByteView data, size_t window, size_t stride,
+                           size_t first, size_t count, float *out) {
+  if (stride == window) {
+    for (size_t k = 0; k < count; ++k)
+      out[k] = calculateEntropy(data.subview((first + k) * window, window));
+    return;
+  }
+
+  SlidingEntropy hist(window);
+  size_t lo = first * stride, hi = lo; // hist holds data[lo, hi)
+  for (size_t k = 0; k < count; ++k) {
+    size_t start = (first + k) * stride;
+    size_t end = std::min(start + window, data.size());
+    if (start >= hi) {
+      // Gap between windows (stride > window): nothing carries over.
+      hist.clear();
+      lo = hi = start;
+    }
+    for (; lo < start; ++lo)
+      hist.pop(data[lo]);
+    for (; hi < end; ++hi)
+      hist.push(data[hi]);
+    out[k] = hist.entropy();
+  }
+}
+
+void computeEntropyMap(ByteView data, size_t window, size_t stride,
+                       std::vector<float> &out) {
+  size_t count = entropyWindowCount(data.size(), window, stride);
+  size_t base = out.size();
+  out.resize(base + count);
+  computeEntropyWindows(data, window, stride, 0, count, out.data() + base);
+}
+
+EntropyAccumulator::EntropyAccumulator(size_t window, size_t stride,
+                                       Sink sink)
+    : window_(window), stride_(stride), sink_(std::move(sink)),
+      sliding_(stride == window ? 0 : window) {
+  if (stride_ == window_)
+    pending_.reserve(window_);
+  else
+    ring_.resize(window_);
+}
+
+void EntropyAccumulator::feed(ByteView block) {
+  if (stride_ == window_)
+    feedChunks(block);
+  else
+    feedSliding(block);
+}
+
+void EntropyAccumulator::feedChunks(ByteView block) {
+  size_t pos = 0;
+
+  // Complete a chunk left over from the previous block first.
+  if (!pending_.empty()) {
+    size_t take = std::min(window_ - pending_.size(), block.size());
+    pending_.insert(pending_.end(), block.begin(), block.begin() + take);
+    pos = take;
+    if (pending_.size() < window_)
+      return;
+    sink_(offset_, calculateEntropy(ByteView(pending_.data(), window_)));
+    offset_ += window_;
+    pending_.clear();
+  }
+
+  // Whole chunks are scored in place.
+  for (; block.size() - pos >= window_; pos += window_) {
+    sink_(offset_, calculateEntropy(block.subview(pos, window_)));
+    offset_ += window_;
+  }
+
+  pending_.insert(pending_.end(), block.begin() + pos, block.end());
+}
+
+void EntropyAccumulator::feedSliding(ByteView block) {
+  for (uint8_t byte : block) {
+    // Bytes between windows (stride > window) are never part of one.
+    if (hi_ >= nextStart_) {
+      ring_[hi_ % window_] = byte;
+      sliding_.push(byte);
+    } else {
+      lo_ = hi_ + 1;
+    }
+    ++hi_;
+
+    if (hi_ == nextStart_ + window_) {
+      sink_(nextStart_, sliding_.entropy());
+      emitted_ = true;
+      lastEnd_ = hi_;
+      nextStart_ += stride_;
+      for (; lo_ < nextStart_ && lo_ < hi_; ++lo_)
+        sliding_.pop(ring_[lo_ % window_]);
+    }
+  }
+}
+
+void EntropyAccumulator::finish() {
+  if (stride_ != window_) {
+    // The last full window didn't reach the end of the input: emit the
+    // shorter window that does, matching computeEntropyMap.
+    if ((!emitted_ || lastEnd_ < hi_) && nextStart_ < hi_)
+      sink_(nextStart_, sliding_.entropy());
+    return;
+  }
+
+  if (pending_.empty())
+    return;
+  sink_(offset_, calculateEntropy(ByteView(pending_.data(), pending_.size())));
+  offset_ += pending_.size();
+  pending_.clear();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "byte_view.h"
+
+// Shannon entropy of `data` in bits per byte (0.0 - 8.0).
+float calculateEntropy(ByteView data);
+
+// Adds the count of every byte value in `data` to counts[256].
+void countBytes(ByteView data, uint64_t *counts);
+
+// Entropy in bits per byte of `total` bytes with value counts counts[256].
+float histogramEntropy(const uint64_t *counts, uint64_t total);
+
+// Largest supported sliding window. Keeps the fixed-point sums in range.
+const size_t kMaxEntropyWindow = size_t(1) << 24;
+
+// Running byte histogram over a window that slides through the input.
+//
+// push() adds the incoming byte and pop() drops the outgoing one. Each one
+// updates sum(c * log2(c)) from a precomputed table, so a window costs O(1)
+// no matter its size. The sum is kept in 32.32 fixed point, so it never
+// drifts: a window has the same value however it was reached.
+class SlidingEntropy {
+public:
+  explicit SlidingEntropy(size_t window);
+
+  void push(uint8_t byte);
+  void pop(uint8_t byte);
+  void clear();
+
+  size_t size() const { return size_; }
+  float entropy() const;
+
+private:
+  uint32_t counts_[256] = {};
+  std::vector<int64_t> cLogC_; // c * log2(c) in 32.32 fixed point, c <= window
+  int64_t sum_ = 0;
+  size_t size_ = 0;
+  size_t window_;
+  double log2Window_;
+};
+
+// Fills `out` with one entropy value per window. Windows start at multiples
+// of `stride` and hold `window` bytes. The last window stops at the end of
+// the data, so it can be shorter. No window starts after one that already
+// reached the end.
+//
+// With stride == window this is the classic non-overlapping chunk map and
+// runs calculateEntropy per chunk. Any other stride slides one histogram
+// through the buffer, so overlapping maps (e.g. window 256, stride 1) cost
+// O(n) in total.
+void computeEntropyMap(ByteView data, size_t window, size_t stride,
+                       std::vector<float> &out);
+
+// Number of values computeEntropyMap produces for `size` bytes.
+size_t entropyWindowCount(size_t size, size_t window, size_t stride);
+
+// Computes windows [first, first + count) of the map for `data` into out[0,
+// count). Ranges can be computed independently and in any order; the values
+// are identical to computing the whole map at once.
+void computeEntropyWindows(ByteView data, size_t window, size_t stride,
+                           size_t first, size_t count, float *out);
+
+// Incremental entropy map builder for streaming input.
+//
+// Blocks of any size can be fed in. Windows that straddle a block boundary
+// are carried over, so the emitted values match computeEntropyMap over the
+// concatenated input. Overlapping windows keep a ring buffer of the last
+// `window` bytes, so memory stays O(window).
+class EntropyAccumulator {
+public:
+  using Sink = std::function<void(size_t offset, float entropy)>;
+
+  EntropyAccumulator(size_t window, size_t stride, Sink sink);
+
+  void feed(ByteView block);
+  // Emits the trailing partial window, if any.
+  void finish();
+
+private:
+  void feedChunks(ByteView block);
+  void feedSliding(ByteView block);
+
+  size_t window_;
+  size_t stride_;
+  Sink sink_;
+
+  // Non-overlapping (stride == window) path
+  size_t offset_ = 0; // Stream offset of the next chunk to emit
+  std::vector<uint8_t> pending_;
+
+  // Sliding path
+  SlidingEntropy sliding_;
+  std::vector<uint8_t> ring_; // Byte at stream position p is ring_[p % window]
+  size_t lo_ = 0;             // Histogram holds stream positions [lo_, hi_)
+  size_t hi_ = 0;
+  size_t nextStart_ = 0;   // Start of the next window to emit
+  size_t lastEnd_ = 0;     // End of the last emitted window
+  bool emitted_ = false;
+};
@@ -0,0 +1,132 @@
+#include "entropy_pyramid.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "entropy.h"
+
+namespace {
+
+uint64_t ceilDiv(uint64_t a, uint64_t b) { return (a + b - 1) / b; }
+
+void addCounts(uint64_t *into, const uint64_t *from) {
+  for (int b = 0; b < 256; ++b)
+    into[b] += from[b];
+}
+
+} // namespace
+
+void EntropyPyramid::reset(uint64_t size) {
+  size_ = size;
+  levelCount_ = 0;
+  for (uint64_t blocks = ceilDiv(size, kBaseBlock); blocks > 0;
+       blocks = blocks > 1 ? ceilDiv(blocks, kFanout) : 0) {
+    if (levels_.size() == levelCount_)
+      levels_.emplace_back();
+    Level &level = levels_[levelCount_];
+    level.values.assign(blocks, 0.0f);
+    level.counts.assign(levelCount_ > 0 ? blocks * 256 : 0, 0);
+    ++levelCount_;
+  }
+  for (size_t i = levelCount_; i < levels_.size(); ++i) {
+    levels_[i].values.clear();
+    levels_[i].counts.clear();
+  }
+}
+
+void EntropyPyramid::buildBlocks(ByteView data, size_t first, size_t last) {
+  std::vector<float> &base = levels_[0].values;
+  for (size_t block = first; block < last; ++block) {
+    uint64_t begin = uint64_t(block) * kHistogramBlock;
+    uint64_t end = std::min<uint64_t>(begin + kHistogramBlock, size_);
+    uint64_t total[256] = {};
+    for (uint64_t at = begin; at < end; at += kBaseBlock) {
+      ByteView piece = data.subview(at, kBaseBlock);
+      uint64_t counts[256] = {};
+      countBytes(piece, counts);
+      base[at / kBaseBlock] = histogramEntropy(counts, piece.size());
+      addCounts(total, counts);
+    }
+    // Inputs of one 4 KiB block or less have no level 1
+    if (levelCount_ > 1) {
+      std::memcpy(&levels_[1].counts[block * 256], total, sizeof total);
+      levels_[1].values[block] = histogramEntropy(total, end - begin);
+    }
+  }
+}
+
+void EntropyPyramid::finish() {
+  for (size_t l = 2; l < levelCount_; ++l) {
+    const std::vector<uint64_t> &below = levels_[l - 1].counts;
+    Level &level = levels_[l];
+    size_t childCount = below.size() / 256;
+    for (size_t block = 0; block < level.values.size(); ++block) {
+      uint64_t *counts = &level.counts[block * 256];
+      size_t lastChild = std::min((block + 1) * kFanout, childCount);
+      for (size_t child = block * kFanout; child < lastChild; ++child)
+        addCounts(counts, &below[child * 256]);
+      uint64_t begin = block * blockSize(l);
+      uint64_t end = std::min(begin + blockSize(l), size_);
+      level.values[block] = histogramEntropy(counts, end - begin);
+    }
+  }
+}
+
+size_t EntropyPyramid::levelFor(uint64_t begin, uint64_t end,
+                                size_t maxBlocks) const {
+  end = std::min(end, size_);
+  for (size_t l = 0; l < levelCount_; ++l) {
+    uint64_t block = blockSize(l);
+    uint64_t blocks = begin < end ? ceilDiv(end, block) - begin / block : 0;
+    if (blocks <= maxBlocks)
+      return l;
+  }
+  return levelCount_ > 0 ? levelCount_ - 1 : 0;
+}
+
+bool EntropyPyramid::rangeEntropy(ByteView data, uint64_t begin, uint64_t end,
+                                  float &entropy) const {
+  end = std::min(end, size_);
+  if (begin >= end) {
+    entropy = 0.0f;
+    return true;
+  }
+  uint64_t counts[256] = {};
+  auto countRange = [&](uint64_t from, uint64_t to) {
+    if (from >= to)
+      return true;
+    if (to > data.size())
+      return false;
+    countBytes(data.subview(from, to - from), counts);
+    return true;
+  };
+
+  // Whole 256 KiB blocks in the middle come from the histograms; the
+  // level-1 block holding the end of the input counts as partial.
+  uint64_t fullBlocks = levelCount_ > 1 ? size_ / kHistogramBlock : 0;
+  uint64_t first = ceilDiv(begin, kHistogramBlock);
+  uint64_t last = std::min(end / kHistogramBlock, fullBlocks);
+  if (first >= last) {
+    if (!countRange(begin, end))
+      return false;
+  } else {
+    if (!countRange(begin, first * kHistogramBlock) ||
+        !countRange(last * kHistogramBlock, end))
+      return false;
+    // Take the blocks at each end that don't fill a block of the level
+    // above, then climb: at most 2 * (kFanout - 1) blocks per level. The
+    // top level has a single block.
+    for (size_t l = 1; first < last; ++l) {
+      const std::vector<uint64_t> &stored = levels_[l].counts;
+      bool top = l + 1 == levelCount_;
+      for (; first < last && (top || first % kFanout != 0); ++first)
+        addCounts(counts, &stored[first * 256]);
+      for (; last > first && last % kFanout != 0; --last)
+        addCounts(counts, &stored[(last - 1) * 256]);
+      first /= kFanout;
+      last /= kFanout;
+    }
+  }
+  entropy = histogramEntropy(counts, end - begin);
+  return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_view.h"
+
+// Helper: Entropy pyramid
+//
+// Entropy of the input at every resolution, like the mip levels of a
+// texture: level 0 has one value per 4 KiB block, and each level up merges
+// 64 blocks of the one below (256 KiB, 16 MiB, 1 GiB, ...) until a single
+// block covers the input. The entropy map is the finer 64-byte view; the
+// pyramid is what keeps a large file small to look at, and lets a caller
+// zoom into a range at whatever resolution fits its budget.
+//
+// analyzeData builds it in its tile pass: each tile counts the bytes of its
+// 4 KiB blocks and adds them into its 256 KiB histogram, and finish()
+// merges those upward. Levels from 256 KiB up keep their histograms, so the
+// entropy of any byte range comes from O(log n) stored blocks plus at most
+// two partial 256 KiB blocks counted from the data.
+class EntropyPyramid {
+public:
+  static const size_t kBaseBlock = 4096;
+  static const size_t kFanout = 64;
+  // Smallest block with a stored histogram: level 1, and one tile
+  static const size_t kHistogramBlock = kBaseBlock * kFanout;
+
+  // Sizes every level for an input of `size` bytes and zeroes it. Buffers
+  // keep their capacity, so a pyramid reused across files stops allocating.
+  void reset(uint64_t size);
+  void clear() { reset(0); }
+
+  // Counts the 256 KiB blocks [first, last) of `data` into levels 0 and 1.
+  // Ranges of blocks may be built on different threads at once.
+  void buildBlocks(ByteView data, size_t first, size_t last);
+  // Fills the levels above 1 from level 1, once every block is built.
+  void finish();
+
+  uint64_t inputSize() const { return size_; }
+  size_t levels() const { return levelCount_; }
+  static uint64_t blockSize(size_t level) {
+    return uint64_t(kBaseBlock) << (6 * level);
+  }
+
+  // One value per block of `level`; the last block may be partial.
+  const std::vector<float> &values(size_t level) const {
+    return levels_[level].values;
+  }
+  std::vector<float> &values(size_t level) { return levels_[level].values; }
+  // 256 counts per block for levels >= 1, empty for level 0.
+  const std::vector<uint64_t> &counts(size_t level) const {
+    return levels_[level].counts;
+  }
+  std::vector<uint64_t> &counts(size_t level) { return levels_[level].counts; }
+
+  // The finest level that covers bytes [begin, end) in at most `maxBlocks`
+  // blocks (the coarsest level if none does).
+  size_t levelFor(uint64_t begin, uint64_t end, size_t maxBlocks) const;
+
+  // Entropy of bytes [begin, end) of the input. `data` is the input the
+  // pyramid was built from; it's only read for the partial 256 KiB blocks
+  // at the ends, so it may be empty when the range is aligned to them.
+  // Returns false if it needs bytes `data` doesn't have.
+  bool rangeEntropy(ByteView data, uint64_t begin, uint64_t end,
+                    float &entropy) const;
+
+private:
+  struct Level {
+    std::vector<float> values;
+    std::vector<uint64_t> counts;
+  };
+
+  std::vector<Level> levels_; // levels_[levelCount_...] are spares
+  size_t levelCount_ = 0;
+  uint64_t size_ = 0;
+};
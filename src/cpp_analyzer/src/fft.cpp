@@ -0,0 +1,55 @@
+#include "fft.h"
+
+#include <cmath>
+#include <utility>
+
+Fft::Fft(size_t size, std::pmr::memory_resource *memory)
+    : size_(size), twiddles_(size / 2, memory), reversed_(size, memory) {
+  const double pi = std::acos(-1.0);
+  for (size_t k = 0; k < size / 2; ++k)
+    twiddles_[k] = std::polar(1.0, -2.0 * pi * double(k) / double(size));
+
+  size_t bits = 0;
+  while ((size_t(1) << bits) < size)
+    ++bits;
+  for (size_t i = 0; i < size; ++i) {
+    size_t r = 0;
+    for (size_t b = 0; b < bits; ++b)
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    reversed_[i] = r;
+  }
+}
+
+void Fft::transform(Complex *data, bool inverse) const {
+  const size_t n = size_;
+  for (size_t i = 0; i < n; ++i)
+    if (i < reversed_[i])
+      std::swap(data[i], data[reversed_[i]]);
+
+  // Iterative Cooley-Tukey: butterflies of span `half` use every
+  // (n / length)-th twiddle. The inverse uses the conjugate twiddles.
+  for (size_t length = 2; length <= n; length <<= 1) {
+    const size_t half = length / 2;
+    const size_t step = n / length;
+    for (size_t start = 0; start < n; start += length) {
+      for (size_t j = 0; j < half; ++j) {
+        Complex w = twiddles_[j * step];
+        if (inverse)
+          w = std::conj(w);
+        Complex &a = data[start + j];
+        Complex &b = data[start + j + half];
+        // Written out: std::complex multiplication checks for NaN/inf.
+        Complex t(b.real() * w.real() - b.imag() * w.imag(),
+                  b.real() * w.imag() + b.imag() * w.real());
+        b = a - t;
+        a += t;
+      }
+    }
+  }
+
+  if (inverse) {
+    const double scale = 1.0 / double(n);
+    for (size_t i = 0; i < n; ++i)
+      data[i] *= scale;
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// In-place radix-2 complex FFT of a fixed power-of-two size.
+//
+// Twiddle factors and the bit-reversal permutation are computed once in the
+// constructor, so one Fft can transform many blocks. transform() is const
+// and safe to call from several threads at once. The tables are allocated
+// from `memory` (an arena, for a transform that lives for one analysis).
+class Fft {
+public:
+  using Complex = std::complex<double>;
+
+  explicit Fft(size_t size, std::pmr::memory_resource *memory =
+                                std::pmr::get_default_resource());
+
+  size_t size() const { return size_; }
+
+  // Forward transform: X[k] = sum x[j] e^(-2 pi i jk / n).
+  void forward(Complex *data) const { transform(data, false); }
+  // Inverse transform, scaled by 1/n so inverse(forward(x)) == x.
+  void inverse(Complex *data) const { transform(data, true); }
+
+private:
+  void transform(Complex *data, bool inverse) const;
+
+  size_t size_;
+  std::pmr::vector<Complex> twiddles_; // e^(-2 pi i k / n) for k < n / 2
+  std::pmr::vector<size_t> reversed_;  // Bit-reversed index of each position
+};
@@ -0,0 +1,66 @@
+#include "hash.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace {
+
+const uint64_t kSecret[4] = {0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+                             0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL};
+
+// Low and high halves of the 128-bit product, xored together.
+uint64_t mix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t product = static_cast<__uint128_t>(a) * b;
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  uint64_t high;
+  uint64_t low = _umul128(a, b, &high);
+  return low ^ high;
+#else
+  uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+  uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+  uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+  uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+  uint64_t low = (ll & 0xffffffff) | (mid << 32);
+  uint64_t high = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  return low ^ high;
+#endif
+}
+
+// Little-endian load, so hashes are the same on every host.
+uint64_t load64(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+} // namespace
+
+uint64_t hashBytes(ByteView data, uint64_t seed) {
+  const uint8_t *p = data.data();
+  size_t n = data.size();
+  uint64_t a = seed ^ kSecret[0];
+  uint64_t b = seed ^ kSecret[1];
+
+  while (n >= 32) {
+    a = mix(load64(p) ^ kSecret[2], load64(p + 8) ^ a);
+    b = mix(load64(p + 16) ^ kSecret[3], load64(p + 24) ^ b);
+    p += 32;
+    n -= 32;
+  }
+  // Tail of up to 31 bytes, zero padded; the length is mixed in below, so
+  // padding can't collide with real zero bytes.
+  uint8_t tail[32] = {};
+  if (n)
+    std::memcpy(tail, p, n);
+  a = mix(load64(tail) ^ kSecret[2], load64(tail + 8) ^ a);
+  b = mix(load64(tail + 16) ^ kSecret[3], load64(tail + 24) ^ b);
+
+  uint64_t h = mix(a ^ kSecret[0], b ^ static_cast<uint64_t>(data.size()));
+  return mix(h ^ kSecret[1], h ^ kSecret[3]);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "byte_view.h"
+
+// Fast non-cryptographic 64-bit hash of a byte range.
+//
+// Two independent lanes each fold 16 bytes per step with a 64x64->128-bit
+// multiply (the xxh3/wyhash construction), so large inputs hash at memory
+// speed. Good for hash tables, content matching and cache keys; not for
+// anything adversarial.
+uint64_t hashBytes(ByteView data, uint64_t seed = 0);
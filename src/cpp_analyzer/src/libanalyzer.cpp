@@ -0,0 +1,310 @@
+#include "libanalyzer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "entropy.h"
+#include "output.h"
+#include "sizes.h"
+
+struct analyzer_result {
+  AnalysisResult result;
+  std::string report; // Last rendering, in reportFormat
+  int reportFormat = -1;
+};
+
+namespace {
+
+// Options as the CLI would take them; false (with a message) if one is
+// outside the range the CLI accepts.
+bool toOptions(const analyzer_options *in, AnalysisOptions &out) {
+  analyzer_options defaults;
+  analyzer_default_options(&defaults);
+  const analyzer_options &options = in ? *in : defaults;
+  if (options.entropy_window < 1 ||
+      options.entropy_window > kMaxEntropyWindow ||
+      options.threads > 4096 || options.pattern_top_k > 1024 ||
+      options.period_top_k > 64) {
+    std::cerr << "Invalid analyzer options" << std::endl;
+    return false;
+  }
+  out.entropyWindow = options.entropy_window;
+  out.entropyStride =
+      options.entropy_stride ? options.entropy_stride : options.entropy_window;
+  out.threads = options.threads;
+  out.patternTopK = options.pattern_top_k;
+  out.periodTopK = options.period_top_k;
+  out.cacheDir = options.cache_dir ? options.cache_dir : "";
+  return true;
+}
+
+// Helper: C boundary
+//
+// No exception may cross into C: it would call std::terminate and take the
+// host (a ctypes caller, say) down with it. Runs fn() and returns what it
+// returns, or prints why it failed on stderr and returns `failed`. Besides
+// allocation failures, std::system_error can come from starting the pool's
+// threads and std::filesystem errors from the cache.
+template <typename Result, typename Fn>
+Result guarded(const char *what, const char *name, Result failed, Fn &&fn) {
+  try {
+    return fn();
+  } catch (const std::bad_alloc &) {
+    std::cerr << "Out of memory " << what << " " << name << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << "Error " << what << " " << name << ": " << e.what()
+              << std::endl;
+  } catch (...) {
+    std::cerr << "Unknown error " << what << " " << name << std::endl;
+  }
+  return failed;
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t analyzer_abi_version(void) { return ANALYZER_ABI_VERSION; }
+
+void analyzer_default_options(analyzer_options *options) {
+  AnalysisOptions defaults;
+  options->entropy_window = defaults.entropyWindow;
+  options->entropy_stride = defaults.entropyStride;
+  options->threads = defaults.threads;
+  options->pattern_top_k = defaults.patternTopK;
+  options->period_top_k = defaults.periodTopK;
+  options->cache_dir = nullptr;
+}
+
+// Errors, including any exception, become a NULL result (see guarded).
+analyzer_result *analyzer_analyze_buffer(const void *data, size_t size,
+                                         const char *name,
+                                         const analyzer_options *options) {
+  return guarded<analyzer_result *>(
+      "analyzing", name ? name : "buffer", nullptr,
+      [&]() -> analyzer_result * {
+        AnalysisOptions analysis;
+        if (!toOptions(options, analysis))
+          return nullptr;
+        auto handle = std::make_unique<analyzer_result>();
+        AnalysisResult &result = handle->result;
+        result.filename = name ? name : "";
+        result.entropyWindow = analysis.entropyWindow;
+        result.entropyStride = analysis.entropyStride;
+        analyzeBuffer(ByteView(static_cast<const uint8_t *>(data), size),
+                      analysis, result);
+        return handle.release();
+      });
+}
+
+analyzer_result *analyzer_analyze_file(const char *path,
+                                       const analyzer_options *options) {
+  if (!path)
+    return nullptr;
+  return guarded<analyzer_result *>(
+      "analyzing", path, nullptr, [&]() -> analyzer_result * {
+        AnalysisOptions analysis;
+        if (!toOptions(options, analysis))
+          return nullptr;
+        auto handle = std::make_unique<analyzer_result>();
+        if (!analyzeFile(path, analysis, handle->result))
+          return nullptr;
+        return handle.release();
+      });
+}
+
+void analyzer_free(analyzer_result *result) { delete result; }
+
+uint64_t analyzer_input_size(const analyzer_result *result) {
+  return result->result.fileSize;
+}
+
+const float *analyzer_entropy_map(const analyzer_result *result,
+                                  size_t *count) {
+  *count = result->result.entropyMap.size();
+  return result->result.entropyMap.data();
+}
+
+const size_t *analyzer_alignment_counts(const analyzer_result *result) {
+  return &result->result.alignment.small[0][0][0];
+}
+
+const size_t *analyzer_float_counts(const analyzer_result *result) {
+  return &result->result.alignment.floats[0][0][0];
+}
+
+size_t analyzer_record_stride(const analyzer_result *result) {
+  return result->result.patterns.recordStride;
+}
+
+size_t analyzer_pattern_count(const analyzer_result *result) {
+  return result->result.patterns.patterns.size();
+}
+
+int analyzer_get_pattern(const analyzer_result *result, size_t index,
+                         analyzer_pattern *pattern) {
+  const std::vector<RepeatedPattern> &patterns =
+      result->result.patterns.patterns;
+  if (index >= patterns.size())
+    return 0;
+  const RepeatedPattern &p = patterns[index];
+  pattern->length = p.length;
+  std::memcpy(pattern->bytes, p.bytes, sizeof pattern->bytes);
+  pattern->count = p.count;
+  pattern->first_offset = p.firstOffset;
+  pattern->period = p.period;
+  pattern->period_count = p.periodCount;
+  std::memcpy(pattern->histogram, p.histogram, sizeof pattern->histogram);
+  return 1;
+}
+
+size_t analyzer_period_count(const analyzer_result *result, int words) {
+  const PeriodSummary &periods = result->result.periods;
+  return (words ? periods.wordPeriods : periods.bytePeriods).size();
+}
+
+int analyzer_get_period(const analyzer_result *result, int words,
+                        size_t index, analyzer_period *period) {
+  const PeriodSummary &periods = result->result.periods;
+  const std::vector<Period> &list =
+      words ? periods.wordPeriods : periods.bytePeriods;
+  if (index >= list.size())
+    return 0;
+  period->period = list[index].period;
+  period->score = list[index].score;
+  return 1;
+}
+
+size_t analyzer_region_count(const analyzer_result *result) {
+  return result->result.regions.size();
+}
+
+int analyzer_get_region(const analyzer_result *result, size_t index,
+                        analyzer_region *region) {
+  const std::vector<Region> &regions = result->result.regions;
+  if (index >= regions.size())
+    return 0;
+  const Region &r = regions[index];
+  region->offset = r.offset;
+  region->size = r.size;
+  region->kind = regionKindName(r.kind);
+  region->entropy = r.entropy;
+  return 1;
+}
+
+const float *analyzer_region_likelihood(const analyzer_result *result,
+                                        size_t index) {
+  const std::vector<Region> &regions = result->result.regions;
+  return index < regions.size() ? regions[index].likelihood : nullptr;
+}
+
+size_t analyzer_pyramid_levels(const analyzer_result *result) {
+  return result->result.entropyPyramid.levels();
+}
+
+const float *analyzer_pyramid_level(const analyzer_result *result,
+                                    size_t level, size_t *block_size,
+                                    size_t *count) {
+  const EntropyPyramid &pyramid = result->result.entropyPyramid;
+  if (level >= pyramid.levels())
+    return nullptr;
+  *block_size = EntropyPyramid::blockSize(level);
+  *count = pyramid.values(level).size();
+  return pyramid.values(level).data();
+}
+
+size_t analyzer_pyramid_level_for(const analyzer_result *result,
+                                  uint64_t begin, uint64_t end,
+                                  size_t max_blocks) {
+  return result->result.entropyPyramid.levelFor(begin, end, max_blocks);
+}
+
+int analyzer_entropy_range(const analyzer_result *result, const void *data,
+                           size_t size, uint64_t begin, uint64_t end,
+                           float *entropy) {
+  return guarded("reading the entropy of", result->result.filename.c_str(),
+                 0, [&] {
+                   ByteView bytes =
+                       data ? ByteView(static_cast<const uint8_t *>(data),
+                                       size)
+                            : result->result.source.view();
+                   return result->result.entropyPyramid.rangeEntropy(
+                       bytes, begin, end, *entropy);
+                 });
+}
+
+size_t analyzer_solve_sizes(const void *const *data, const size_t *sizes,
+                            size_t count, size_t search_bytes,
+                            analyzer_size_solution *solutions,
+                            size_t capacity, uint64_t *hypotheses) {
+  return guarded("solving sizes of", "inputs", size_t(0), [&] {
+    std::vector<ByteView> inputs;
+    for (size_t i = 0; i < count; ++i)
+      inputs.emplace_back(static_cast<const uint8_t *>(data[i]), sizes[i]);
+    SizeSummary summary =
+        solveSizes(inputs, search_bytes ? search_bytes : kSizeSearchBytes);
+    if (hypotheses)
+      *hypotheses = summary.hypotheses;
+    for (size_t i = 0; i < std::min(capacity, summary.solutions.size());
+         ++i) {
+      const SizeSolution &solution = summary.solutions[i];
+      analyzer_size_solution &out = solutions[i];
+      out = analyzer_size_solution();
+      out.header = solution.header;
+      out.terms = solution.terms;
+      out.files = solution.files;
+      for (size_t t = 0; t < solution.terms; ++t) {
+        out.counts[t].offset = solution.counts[t].offset;
+        out.counts[t].width = solution.counts[t].width;
+        out.counts[t].big_endian = solution.counts[t].bigEndian;
+        out.counts[t].stride = solution.counts[t].stride;
+      }
+    }
+    return summary.solutions.size();
+  });
+}
+
+size_t analyzer_report(analyzer_result *result, analyzer_format format,
+                       char *buffer, size_t capacity) {
+  if (result->reportFormat != static_cast<int>(format)) {
+    OutputFormat outputFormat;
+    switch (format) {
+    case ANALYZER_FORMAT_JSON:
+      outputFormat = OutputFormat::Json;
+      break;
+    case ANALYZER_FORMAT_MSGPACK:
+      outputFormat = OutputFormat::MsgPack;
+      break;
+    case ANALYZER_FORMAT_BIN:
+      outputFormat = OutputFormat::Binary;
+      break;
+    default:
+      outputFormat = OutputFormat::Text;
+      break;
+    }
+    bool rendered = guarded(
+        "rendering the report of", result->result.filename.c_str(), false,
+        [&] {
+          OutputBuffer out;
+          writeAnalysis(result->result, outputFormat, out);
+          result->report = out.data();
+          result->reportFormat = static_cast<int>(format);
+          return true;
+        });
+    if (!rendered)
+      return 0;
+  }
+  const std::string &report = result->report;
+  if (buffer)
+    std::memcpy(buffer, report.data(), std::min(capacity, report.size()));
+  return report.size();
+}
+
+} // extern "C"
@@ -0,0 +1,213 @@
+#ifndef LIBANALYZER_H
+#define LIBANALYZER_H
+
+// Helper: C API
+//
+// The analyzer as a library with a plain C ABI, for callers that can't
+// link C++ (Python through ctypes or cffi, mostly). Everything the CLI
+// computes for one input is available: analyze a buffer or a file, read
+// the entropy map, alignment counts, patterns and periods in place, or
+// render the report in any --format, then free the result.
+//
+// The ABI only grows: functions and enum values are added, never changed,
+// and a change that can't be made that way bumps ANALYZER_ABI_VERSION.
+// Callers that load the library at run time should check
+// analyzer_abi_version() against the version they were written for.
+//
+// Results are immutable once returned and may be read from any thread.
+// Any number of analyses may run at once on different threads.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(ANALYZER_BUILD_SHARED)
+#define ANALYZER_API __declspec(dllexport)
+#elif defined(ANALYZER_USE_SHARED)
+#define ANALYZER_API __declspec(dllimport)
+#else
+#define ANALYZER_API
+#endif
+#else
+#define ANALYZER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ANALYZER_ABI_VERSION 1
+
+typedef struct analyzer_result analyzer_result;
+
+// The CLI's knobs; see analyzer_default_options for the defaults.
+typedef struct analyzer_options {
+  size_t entropy_window; // Bytes per entropy map value, 1 .. 16 MiB
+  size_t entropy_stride; // Distance between window starts; 0 = window
+  size_t threads;        // Worker threads; 0 = all cores
+  size_t pattern_top_k;  // Repeated n-grams per length, <= 1024; 0 = off
+  size_t period_top_k;   // Autocorrelation periods per signal, <= 64
+  const char *cache_dir; // Persistent result cache (--cache); NULL = off
+} analyzer_options;
+
+typedef enum analyzer_format {
+  ANALYZER_FORMAT_TEXT = 0,
+  ANALYZER_FORMAT_JSON = 1,
+  ANALYZER_FORMAT_MSGPACK = 2,
+  ANALYZER_FORMAT_BIN = 3
+} analyzer_format;
+
+typedef struct analyzer_pattern {
+  size_t length; // n-gram length in bytes (4, 8, 12 or 16)
+  uint8_t bytes[16];
+  size_t count; // Occurrences, overlapping ones included
+  size_t first_offset;
+  size_t period;       // Most common gap between occurrences
+  size_t period_count; // Gaps equal to `period`
+  uint32_t histogram[16]; // Occurrences per sixteenth of the input
+} analyzer_pattern;
+
+typedef struct analyzer_period {
+  size_t period; // In bytes
+  float score;   // Normalized autocorrelation, up to 1
+} analyzer_period;
+
+typedef struct analyzer_region {
+  uint64_t offset;
+  uint64_t size;
+  const char *kind; // "header", "padding", "text", "int32", ..., static
+  float entropy;    // Bits per byte over the whole region
+} analyzer_region;
+
+// One count field of a size equation: `stride` bytes per counted element.
+typedef struct analyzer_size_term {
+  uint32_t offset;
+  uint32_t width; // 2, 4 or 8 bytes
+  int big_endian;
+  uint32_t stride;
+} analyzer_size_term;
+
+// size == header + sum of count * stride over the terms.
+typedef struct analyzer_size_solution {
+  uint64_t header;
+  size_t terms; // 1 or 2, in offset order
+  analyzer_size_term counts[2];
+  size_t files; // Inputs the equation holds for
+} analyzer_size_solution;
+
+ANALYZER_API uint32_t analyzer_abi_version(void);
+
+ANALYZER_API void analyzer_default_options(analyzer_options *options);
+
+// Analyzes `size` bytes at `data`, which only need to stay valid for the
+// call. `name` (may be NULL) is what the report calls the input. `options`
+// may be NULL for the defaults. Returns NULL if the options are out of
+// range or the analysis fails (out of memory, threads that can't start);
+// the reason is printed on stderr. No C++ exception escapes any function
+// of this API.
+ANALYZER_API analyzer_result *
+analyzer_analyze_buffer(const void *data, size_t size, const char *name,
+                        const analyzer_options *options);
+
+// Maps and analyzes the file at `path`. Returns NULL if it can't be opened,
+// the options are out of range or the analysis fails.
+ANALYZER_API analyzer_result *
+analyzer_analyze_file(const char *path, const analyzer_options *options);
+
+ANALYZER_API void analyzer_free(analyzer_result *result);
+
+ANALYZER_API uint64_t analyzer_input_size(const analyzer_result *result);
+
+// The entropy map, one float per window (bits per byte), owned by the
+// result. Its length goes to *count.
+ANALYZER_API const float *analyzer_entropy_map(const analyzer_result *result,
+                                               size_t *count);
+
+// Alignment counts as 3 x 8 x 2 values: [width 2, 4, 8][phase][little
+// endian, big endian]. Phases past the width are zero.
+ANALYZER_API const size_t *
+analyzer_alignment_counts(const analyzer_result *result);
+
+// Plausible-float counts in the same layout: [width 2, 4, 8] are half,
+// float32 and float64.
+ANALYZER_API const size_t *
+analyzer_float_counts(const analyzer_result *result);
+
+// The record stride the patterns vote for, 0 if none.
+ANALYZER_API size_t analyzer_record_stride(const analyzer_result *result);
+
+ANALYZER_API size_t analyzer_pattern_count(const analyzer_result *result);
+// Copies pattern `index` (by length, then count) to *pattern. Returns 0 if
+// the index is out of range.
+ANALYZER_API int analyzer_get_pattern(const analyzer_result *result,
+                                      size_t index, analyzer_pattern *pattern);
+
+// Periods of the byte signal (words == 0) or the 4-byte word signal.
+ANALYZER_API size_t analyzer_period_count(const analyzer_result *result,
+                                          int words);
+ANALYZER_API int analyzer_get_period(const analyzer_result *result, int words,
+                                     size_t index, analyzer_period *period);
+
+// Homogeneous regions covering the input, in order.
+ANALYZER_API size_t analyzer_region_count(const analyzer_result *result);
+ANALYZER_API int analyzer_get_region(const analyzer_result *result,
+                                     size_t index, analyzer_region *region);
+
+// The element type likelihoods of region `index`: 6 floats, for int16,
+// int32, int64, float16, float32 and float64, owned by the result. NULL if
+// the index is out of range.
+ANALYZER_API const float *
+analyzer_region_likelihood(const analyzer_result *result, size_t index);
+
+// Levels of the entropy pyramid: level 0 has one value per 4 KiB block,
+// and each level up merges 64 blocks of the one below.
+ANALYZER_API size_t analyzer_pyramid_levels(const analyzer_result *result);
+// The values of `level` (bits per byte, the last block may be partial),
+// owned by the result. The block size goes to *block_size and the length
+// to *count. Returns NULL if the level is out of range.
+ANALYZER_API const float *analyzer_pyramid_level(const analyzer_result *result,
+                                                 size_t level,
+                                                 size_t *block_size,
+                                                 size_t *count);
+// The finest level that shows bytes [begin, end) in at most `max_blocks`
+// blocks, for zooming into a range at a fixed budget.
+ANALYZER_API size_t analyzer_pyramid_level_for(const analyzer_result *result,
+                                               uint64_t begin, uint64_t end,
+                                               size_t max_blocks);
+// Entropy of bytes [begin, end) of the input, from the pyramid's stored
+// histograms and at most two partial 256 KiB blocks of the input. Those
+// are read from `data` (`size` bytes, the analyzed input), or with NULL
+// data from the file analyzer_analyze_file mapped. Returns 0 if bytes it
+// needs aren't available.
+ANALYZER_API int analyzer_entropy_range(const analyzer_result *result,
+                                        const void *data, size_t size,
+                                        uint64_t begin, uint64_t end,
+                                        float *entropy);
+
+// Solves the sizes of `count` inputs (data[i], sizes[i] bytes) for header
+// and count fields in their first `search_bytes` (0 = 4096), as the fields
+// record's size equations: those that hold in every input, none unless the
+// inputs have two sizes. Copies up to `capacity` solutions, best first, to
+// `solutions` and the number of equations tested to *hypotheses (may be
+// NULL). Returns the number of solutions, at most 16; 0 if solving fails.
+ANALYZER_API size_t analyzer_solve_sizes(const void *const *data,
+                                         const size_t *sizes, size_t count,
+                                         size_t search_bytes,
+                                         analyzer_size_solution *solutions,
+                                         size_t capacity,
+                                         uint64_t *hypotheses);
+
+// Renders the report in `format` and copies up to `capacity` bytes of it to
+// `buffer` (may be NULL with capacity 0). Returns the full report size, so
+// a caller can ask for the size first, or 0 if rendering fails. Not thread
+// safe for one result: the last rendering is kept so the second call
+// doesn't render again.
+ANALYZER_API size_t analyzer_report(analyzer_result *result,
+                                    analyzer_format format, char *buffer,
+                                    size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBANALYZER_H
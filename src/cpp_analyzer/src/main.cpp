@@ -1,192 +1,615 @@
-#include <algorithm>
-#include <cmath>
-#include <fstream>
-#include <iomanip>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <string>
 #include <vector>
 
-// Basic Analysis Structures
-struct AnalysisResult {
-  std::string filename;
-  size_t fileSize;
-  std::vector<uint8_t> rawData;       // Store raw data for analysis
-  std::vector<float> entropyMap;      // Entropy per 64-byte chunk
-  std::map<int, int> alignmentScores; // Alignment -> Score
-};
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "alignment.h"
+#include "analysis.h"
+#include "batch.h"
+#include "byte_view.h"
+#include "corpus.h"
+#include "diff.h"
+#include "entropy.h"
+#include "mapped_file.h"
+#include "output.h"
+#include "prefetch.h"
+#include "profile.h"
+#include "sample.h"
+#include "server.h"
+#include "signature.h"
+#include "stream.h"
+#include "thread_pool.h"
+
+// --profile counts allocations per phase: every operator new in the CLI
+// bumps the calling thread's counter. The replacements come as a set, the
+// deletes freeing with std::free to match. All stay out of line: inlined,
+// GCC pairs malloc() or free() with the other side's operator and warns of
+// a mismatch.
+#if defined(__GNUC__) || defined(__clang__)
+#define ANALYZER_NOINLINE __attribute__((noinline))
+#else
+#define ANALYZER_NOINLINE
+#endif
 
-// Helper: Calculate Shannon Entropy of a buffer
-//
-// Shannon Entropy measures the randomness or information density of data.
-// Formula: H(X) = -sum(p(x) * log2(p(x)))
-// Range: 0.0 (all bytes are same) to 8.0 (all bytes are random/uniform)
-//
-// Interpretation for Reverse Engineering:
-// - Low Entropy (< 3.0): Text, padding (zeros), or sparse data.
-// - Medium Entropy (3.0 - 6.0): Code, structured data, or repeating patterns.
-// - High Entropy (> 7.0): Compressed data, encrypted data, or dense
-// floating-point arrays.
-//
-// We calculate this per 64-byte chunk to visualize the "texture" of the file.
-// For example, a file might start with low entropy (header) and switch to high
-// entropy (mesh data).
-float calculateEntropy(const std::vector<uint8_t> &data) {
-  if (data.empty())
-    return 0.0f;
-
-  std::map<uint8_t, int> frequencies;
-  for (uint8_t byte : data) {
-    frequencies[byte]++;
-  }
-
-  float entropy = 0.0f;
-  float total = static_cast<float>(data.size());
-
-  for (auto const &[byte, count] : frequencies) {
-    float p = count / total;
-    entropy -= p * std::log2(p);
-  }
-
-  return entropy;
+ANALYZER_NOINLINE void *operator new(size_t size) {
+  AllocationCounter &counter = threadAllocations();
+  ++counter.count;
+  counter.bytes += size;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
 }
 
-// Helper: Check alignment
-//
-// Detects if data is aligned to 2, 4, or 8 byte boundaries.
-// This is crucial for identifying arrays of integers or floats.
-//
-// Heuristic:
-// We iterate through the file at the given stride (e.g., 4 bytes).
-// If the values interpreted at these offsets look like "small integers"
-// (indices, counts), we increment the score. A high score suggests a structured
-// array.
-void checkAlignment(const std::vector<uint8_t> &data, AnalysisResult &result) {
-  std::vector<int> alignments = {2, 4, 8};
-
-  for (int align : alignments) {
-    int score = 0;
-    // Check if data looks aligned at these boundaries
-    // Heuristic: Count how many values are "small integers" (likely
-    // counts/indices) or "valid floats" when interpreted at this alignment. For
-    // MVP, let's just check if 4-byte integers are small (< 100000)
-
-    if (align == 4 && data.size() >= 4) {
-      for (size_t i = 0; i <= data.size() - 4; i += 4) {
-        // Safe cast? strict aliasing might be an issue but for MVP C++ char* is
-        // usually fine
-        uint32_t val = 0;
-        // Manual reconstruction to avoid alignment issues on some archs (x86 is
-        // fine though)
-        val |= data[i];
-        val |= (uint32_t)data[i + 1] << 8;
-        val |= (uint32_t)data[i + 2] << 16;
-        val |= (uint32_t)data[i + 3] << 24;
-
-        if (val < 100000)
-          score++;
-      }
-    }
-    result.alignmentScores[align] = score;
-  }
+ANALYZER_NOINLINE void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+ANALYZER_NOINLINE void operator delete(void *p) noexcept { std::free(p); }
+
+ANALYZER_NOINLINE void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+ANALYZER_NOINLINE void operator delete[](void *p) noexcept { std::free(p); }
+
+ANALYZER_NOINLINE void operator delete[](void *p, size_t) noexcept {
+  std::free(p);
 }
 
-// Helper: Find repeating patterns
-void findPatterns(const std::vector<uint8_t> &data, AnalysisResult &result) {
-  // MVP: Just look for 4-byte sequences that repeat often
-  // Placeholder for now
+// Runs `write` as one output phase, flushing what it wrote to the sink.
+template <typename Write>
+void writeOutput(OutputBuffer &out, const Write &write) {
+  ProfileZone zone(ProfilePhase::Output);
+  size_t before = out.written();
+  write();
+  out.flush();
+  zone.addBytes(out.written() - before);
 }
 
-AnalysisResult analyzeFile(const std::string &filepath) {
+// Streaming mode can't print the summary first: size and alignment are only
+// known once the input is exhausted, and the entropy map is never held in
+// memory. Rows are written as they're computed and the summary follows.
+int runStream(const std::string &filepath, size_t blockSize,
+              const AnalysisOptions &options, OutputFormat format) {
+  if (!formatSupportsStreaming(format)) {
+    std::cerr << "--stream supports --format text and json only" << std::endl;
+    return 1;
+  }
+  OutputBuffer out(stdout);
+  writeStreamBegin(filepath, options, format, out);
+
   AnalysisResult result;
-  result.filename = filepath;
+  size_t index = 0;
+  auto sink = [&](size_t offset, float e) {
+    writeStreamEntropy(index++, offset, e, format, out);
+  };
+  if (!analyzeStream(filepath, blockSize, options, sink, result))
+    return 1;
+
+  writeStreamEnd(result, format, out);
+  return 0;
+}
+
+// Batch mode writes each file's report as soon as it's done. Reports are
+// rendered off-lock and written whole, so records never interleave. Text
+// reports start with their "File:" line and end with a blank line.
+int runBatchMode(const std::string &source, const AnalysisOptions &options,
+                 OutputFormat format, bool entropyRows, size_t prefetchBytes,
+                 ThreadPool *pool) {
+  std::vector<std::string> paths;
+  if (!collectBatchInputs(source, paths)) {
+    std::cerr << "Failed to read batch input: " << source << std::endl;
+    return 1;
+  }
+
+  std::mutex outputMutex;
+  size_t failures =
+      runBatch(paths, options, pool, [&](AnalysisResult &result) {
+        // One per thread and reused, so it stops growing after a few files.
+        thread_local OutputBuffer report;
+        ProfileZone zone(ProfilePhase::Output);
+        report.clear();
+        writeAnalysis(result, format, report, entropyRows);
+        if (format == OutputFormat::Text)
+          report.put('\n');
+        zone.addBytes(report.data().size());
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::fwrite(report.data().data(), 1, report.data().size(), stdout);
+        std::fflush(stdout);
+      }, prefetchBytes);
+
+  if (failures > 0) {
+    std::cerr << failures << " of " << paths.size()
+              << " batch inputs could not be analyzed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Corpus mode loads every sample up front and writes one record. Inputs
+// that can't be opened are reported and left out.
+int runCorpusMode(const std::string &source, size_t bytes, bool prefetch,
+                  OutputFormat format, ThreadPool *pool) {
+  std::vector<std::string> paths;
+  if (!collectBatchInputs(source, paths)) {
+    std::cerr << "Failed to read corpus input: " << source << std::endl;
+    return 1;
+  }
+
+  // Only the first `bytes` of a sample are compared, so that's all that is
+  // read, with every read queued at once. The heads are all kept until the
+  // end; the budget is what they add up to.
+  if (prefetch) {
+    std::vector<PrefetchedFile> heads(paths.size());
+    Prefetcher prefetcher(paths, SIZE_MAX, bytes);
+    PrefetchedFile file;
+    while (prefetcher.next(file))
+      heads[file.index] = std::move(file);
+
+    std::vector<std::string> names;
+    std::vector<ByteView> views;
+    std::vector<uint64_t> sizes;
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (!heads[i].ok) {
+        std::cerr << "Failed to open file: " << paths[i] << std::endl;
+        continue;
+      }
+      names.push_back(paths[i]);
+      views.emplace_back(heads[i].data.data(), heads[i].data.size());
+      sizes.push_back(heads[i].size);
+    }
+    if (views.empty()) {
+      std::cerr << "No corpus inputs could be opened" << std::endl;
+      return 1;
+    }
 
-  std::ifstream file(filepath, std::ios::binary);
-  if (!file) {
-    std::cerr << "Failed to open file: " << filepath << std::endl;
-    return result;
+    CorpusSummary corpus = analyzeCorpus(views, sizes, bytes, pool);
+    OutputBuffer out(stdout);
+    writeOutput(out,
+                [&] { writeCorpusAnalysis(names, corpus, format, out); });
+    return names.size() == paths.size() ? 0 : 1;
   }
 
-  // Read entire file
-  std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)),
-                              std::istreambuf_iterator<char>());
-  result.rawData = buffer;
-  result.fileSize = buffer.size();
+  // Otherwise every sample is mapped, in parallel: with thousands of small
+  // files the opens are most of the cost.
+  std::vector<MappedFile> files(paths.size());
+  auto open = [&](size_t i) {
+    ProfileZone zone(ProfilePhase::Load);
+    if (files[i].open(paths[i]))
+      zone.addBytes(files[i].size());
+  };
+  if (pool)
+    pool->parallelFor(paths.size(), open);
+  else
+    for (size_t i = 0; i < paths.size(); ++i)
+      open(i);
 
-  // Calculate Entropy Map (64-byte chunks)
-  const size_t chunkSize = 64;
-  for (size_t i = 0; i < buffer.size(); i += chunkSize) {
-    size_t end = std::min(i + chunkSize, buffer.size());
-    std::vector<uint8_t> chunk(buffer.begin() + i, buffer.begin() + end);
-    result.entropyMap.push_back(calculateEntropy(chunk));
+  std::vector<std::string> names;
+  std::vector<ByteView> views;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!files[i].isOpen()) {
+      std::cerr << "Failed to open file: " << paths[i] << std::endl;
+      continue;
+    }
+    names.push_back(paths[i]);
+    views.push_back(files[i].view());
+  }
+  if (views.empty()) {
+    std::cerr << "No corpus inputs could be opened" << std::endl;
+    return 1;
   }
 
-  // Check Alignment
-  checkAlignment(result.rawData, result);
+  CorpusSummary corpus = analyzeCorpus(views, bytes, pool);
+  OutputBuffer out(stdout);
+  writeOutput(out, [&] { writeCorpusAnalysis(names, corpus, format, out); });
+  return names.size() == paths.size() ? 0 : 1;
+}
 
-  return result;
+// Sample mode reads a few blocks and reports estimates instead of counts.
+int runSampleMode(const std::string &filepath, SampleMode mode, size_t blocks,
+                  uint64_t seed, const AnalysisOptions &options,
+                  OutputFormat format, ThreadPool *pool) {
+  if (format == OutputFormat::Binary) {
+    std::cerr << "--sample has no bin record; use text, json or msgpack"
+              << std::endl;
+    return 1;
+  }
+  SampleSummary summary;
+  if (!sampleFile(filepath, mode, blocks, seed, options, summary, pool))
+    return 1;
+  OutputBuffer out(stdout);
+  writeOutput(out, [&] { writeSampleAnalysis(summary, format, out); });
+  return 0;
 }
 
-void printAnalysis(const AnalysisResult &result) {
-  std::cout << "File: " << result.filename << std::endl;
-  std::cout << "Size: " << result.fileSize << " bytes" << std::endl;
+// Index mode analyzes each file for its signature. With a label the
+// signatures are added to the index under it; otherwise each file's best
+// matches are reported.
+int runIndexMode(const std::string &indexPath, const std::string &label,
+                 const std::vector<std::string> &paths,
+                 const AnalysisOptions &options, OutputFormat format,
+                 ThreadPool *pool) {
+  if (label.empty() && format == OutputFormat::Binary) {
+    std::cerr << "--index has no bin record; use text, json or msgpack"
+              << std::endl;
+    return 1;
+  }
+  SignatureIndex index;
+  if (!index.open(indexPath))
+    return 1;
+
+  OutputBuffer out(stdout);
+  size_t failures = 0;
+  for (const std::string &path : paths) {
+    AnalysisResult result;
+    if (!analyzeFile(path, options, result, pool)) {
+      ++failures;
+      continue;
+    }
+    IndexQuery query;
+    query.signature = computeSignature(result.source.view(), result);
+    if (!label.empty()) {
+      index.add({label, path, query.signature});
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    query.matches =
+        index.query(query.signature, kMaxSignatureMatches, &query.candidates);
+    query.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    query.indexSize = index.size();
+    writeOutput(out, [&] { writeIndexQuery(path, query, format, out); });
+  }
 
-  std::cout << "Alignment Scores: ";
-  for (auto const &[align, score] : result.alignmentScores) {
-    std::cout << align << ":" << score << " ";
+  if (!label.empty()) {
+    if (!index.write())
+      return 1;
+    std::cerr << "Indexed " << paths.size() - failures << " files as "
+              << label << "; " << indexPath << " holds " << index.size()
+              << " entries" << std::endl;
   }
-  std::cout << std::endl;
+  return failures == 0 ? 0 : 1;
+}
 
-  std::cout << "Entropy Map (" << result.entropyMap.size()
-            << " chunks):" << std::endl;
+struct CliOptions {
+  bool stream = false;
+  bool serve = false;
+  std::string socketPath;  // --socket <path>, implies --serve
+  std::string batchSource; // --batch <dir|listfile>
+  std::string corpusSource; // --corpus <dir|listfile>
+  size_t corpusBytes = kCorpusBytes;
+  size_t prefetchBytes = kDefaultPrefetchBytes; // 0 maps instead of reading
+  bool sample = false; // --sample <mode>
+  SampleMode sampleMode = SampleMode::Stratified;
+  size_t sampleBlocks = kDefaultSampleBlocks;
+  size_t seed = 0;
+  std::string indexPath;  // --index <path>: look files up, or add them
+  std::string indexLabel; // --index-add <label>
+  bool profile = false;
+  std::string profileTrace; // --profile-trace <path>, implies --profile
+  bool entropyMap = false;  // --entropy-map: text reports list every window
+  size_t blockSize = kDefaultStreamBlockSize;
+  OutputFormat format = OutputFormat::Text;
+  AnalysisOptions analysis;
+  std::vector<std::string> paths;
+};
 
-  // Simple visualization
-  for (size_t i = 0; i < result.entropyMap.size(); ++i) {
-    float e = result.entropyMap[i];
-    // Scale 0-8 to 0-10 chars
-    int bars = static_cast<int>(e * 1.25f);
-    std::cout << std::setw(4) << (i * 64) << ": [" << std::string(bars, '#')
-              << std::string(10 - bars, ' ') << "] " << std::fixed
-              << std::setprecision(2) << e << std::endl;
+bool parseSize(const std::string &flag, const char *text, size_t min,
+               size_t max, size_t &out) {
+  char *end = nullptr;
+  unsigned long long value = std::strtoull(text, &end, 10);
+  if (text[0] == '-' || end == text || *end != '\0' || value < min ||
+      value > max) {
+    std::cerr << "Invalid " << flag << ": " << text << std::endl;
+    return false;
   }
+  out = static_cast<size_t>(value);
+  return true;
 }
 
-// Helper: Differential Analysis
-//
-// Compares two files to identify structural differences.
-// Currently, we only compare file sizes to detect "strides".
-//
-// Usage:
-// If File A has 10 items and File B has 20 items, and Size(B) - Size(A) = 120
-// bytes, then we can infer that each item is likely 12 bytes (120 / 10).
-void compareFiles(const AnalysisResult &r1, const AnalysisResult &r2) {
-  std::cout << "\nDifferential Analysis (" << r1.filename << " vs "
-            << r2.filename << "):" << std::endl;
-
-  if (r1.fileSize != r2.fileSize) {
-    std::cout << "Size diff: " << r1.fileSize << " vs " << r2.fileSize
-              << " (Delta: " << (long long)r2.fileSize - (long long)r1.fileSize
-              << ")" << std::endl;
-  } else {
-    std::cout << "Size match." << std::endl;
+bool parseArgs(int argc, char *argv[], CliOptions &options) {
+  bool strideSet = false;
+  bool threadsSet = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--stream") {
+      options.stream = true;
+    } else if (arg == "--serve") {
+      options.serve = true;
+    } else if (arg == "--socket" && i + 1 < argc) {
+      options.serve = true;
+      options.socketPath = argv[++i];
+    } else if (arg == "--block-size" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 1, SIZE_MAX, options.blockSize))
+        return false;
+    } else if (arg == "--window" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 1, kMaxEntropyWindow,
+                     options.analysis.entropyWindow))
+        return false;
+    } else if (arg == "--stride" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 1, SIZE_MAX,
+                     options.analysis.entropyStride))
+        return false;
+      strideSet = true;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 0, 4096, options.analysis.threads))
+        return false;
+      threadsSet = true;
+    } else if (arg == "--patterns" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 0, 1024, options.analysis.patternTopK))
+        return false;
+    } else if (arg == "--periods" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 0, 64, options.analysis.periodTopK))
+        return false;
+    } else if (arg == "--format" && i + 1 < argc) {
+      if (!parseOutputFormat(argv[++i], options.format)) {
+        std::cerr << "Invalid --format: " << argv[i] << std::endl;
+        return false;
+      }
+    } else if (arg == "--profile") {
+      options.profile = true;
+    } else if (arg == "--profile-trace" && i + 1 < argc) {
+      options.profile = true;
+      options.profileTrace = argv[++i];
+    } else if (arg == "--entropy-map") {
+      options.entropyMap = true;
+    } else if (arg == "--batch" && i + 1 < argc) {
+      options.batchSource = argv[++i];
+    } else if (arg == "--corpus" && i + 1 < argc) {
+      options.corpusSource = argv[++i];
+    } else if (arg == "--corpus-bytes" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 1, SIZE_MAX, options.corpusBytes))
+        return false;
+    } else if (arg == "--prefetch" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 0, SIZE_MAX, options.prefetchBytes))
+        return false;
+    } else if (arg == "--sample" && i + 1 < argc) {
+      options.sample = true;
+      if (!parseSampleMode(argv[++i], options.sampleMode)) {
+        std::cerr << "Invalid --sample: " << argv[i] << std::endl;
+        return false;
+      }
+    } else if (arg == "--sample-blocks" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 1, size_t(1) << 20,
+                     options.sampleBlocks))
+        return false;
+    } else if (arg == "--seed" && i + 1 < argc) {
+      if (!parseSize(arg, argv[++i], 0, SIZE_MAX, options.seed))
+        return false;
+    } else if (arg == "--index" && i + 1 < argc) {
+      options.indexPath = argv[++i];
+    } else if (arg == "--index-add" && i + 1 < argc) {
+      options.indexLabel = argv[++i];
+      if (options.indexLabel.empty()) {
+        std::cerr << "Invalid --index-add: empty label" << std::endl;
+        return false;
+      }
+    } else if (arg == "--cache" && i + 1 < argc) {
+      options.analysis.cacheDir = argv[++i];
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      return false;
+    } else {
+      options.paths.push_back(arg);
+    }
+  }
+  // A window without an explicit stride keeps the chunks non-overlapping.
+  if (!strideSet)
+    options.analysis.entropyStride = options.analysis.entropyWindow;
+  // Batch, corpus and server modes exist to keep every core busy; default
+  // to all.
+  if (options.serve) {
+    if (!threadsSet)
+      options.analysis.threads = 0;
+    return options.paths.empty() && !options.stream && !options.sample &&
+           options.indexPath.empty() && options.batchSource.empty();
+  }
+  if (!options.batchSource.empty() || !options.corpusSource.empty()) {
+    if (!threadsSet)
+      options.analysis.threads = 0;
+    return options.paths.empty() && !options.stream &&
+           !options.sample && options.indexPath.empty() &&
+           (options.batchSource.empty() || options.corpusSource.empty());
   }
+  if (options.sample)
+    return options.paths.size() == 1 && !options.stream &&
+           options.indexPath.empty() && options.indexLabel.empty();
+  if (!options.indexLabel.empty() && options.indexPath.empty())
+    return false;
+  return !options.paths.empty() &&
+         (options.indexPath.empty() || !options.stream);
 }
 
 int main(int argc, char *argv[]) {
-  if (argc < 2) {
-    std::cerr << "Usage: analyzer <file_path> [compare_file_path]" << std::endl;
+  CliOptions options;
+  if (!parseArgs(argc, argv, options)) {
+    std::cerr << "Usage: analyzer [options] <file_path> [compare_file_path...]"
+              << std::endl;
+    std::cerr << "       analyzer --stream [--block-size N] [options] "
+                 "<file_path|->"
+              << std::endl;
+    std::cerr << "       analyzer --batch <dir|listfile> [options]"
+              << std::endl;
+    std::cerr << "       analyzer --corpus <dir|listfile> [--corpus-bytes N] "
+                 "[options]"
+              << std::endl;
+    std::cerr << "       analyzer --serve [--socket PATH] [options]"
+              << std::endl;
+    std::cerr << "       analyzer --sample stratified|reservoir "
+                 "[--sample-blocks N] [--seed N] [options] <file_path|->"
+              << std::endl;
+    std::cerr << "       analyzer --index PATH [--index-add LABEL] [options] "
+                 "<file_path...>"
+              << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --window N   entropy window in bytes (default 64)"
+              << std::endl;
+    std::cerr << "  --stride N   distance between windows (default: window)"
+              << std::endl;
+    std::cerr << "  --threads N  worker threads, 0 = all cores (default 1, "
+                 "batch and corpus: 0)"
+              << std::endl;
+    std::cerr << "  --patterns K repeated n-grams shown per length, 0 = off "
+                 "(default 4)"
+              << std::endl;
+    std::cerr << "  --periods K  autocorrelation periods shown per signal, "
+                 "0 = off (default 4)"
+              << std::endl;
+    std::cerr << "  --format F   text, json, msgpack or bin (default text)"
+              << std::endl;
+    std::cerr << "  --entropy-map  list every entropy window in text reports"
+              << std::endl;
+    std::cerr << "  --corpus-bytes N  offsets compared by --corpus "
+                 "(default 4096)"
+              << std::endl;
+    std::cerr << "  --prefetch N  bytes batch mode reads ahead, 0 = map "
+                 "files instead (default 268435456)"
+              << std::endl;
+    std::cerr << "  --sample-blocks N  64 KiB blocks --sample reads "
+                 "(default 128)"
+              << std::endl;
+    std::cerr << "  --seed N     picks the blocks --sample reads (default 0)"
+              << std::endl;
+    std::cerr << "  --index-add LABEL  add the files to --index as format "
+                 "LABEL instead of looking them up"
+              << std::endl;
+    std::cerr << "  --cache DIR  reuse results stored in DIR, keyed by content"
+              << std::endl;
+    std::cerr << "  --profile    time each phase, report on stderr"
+              << std::endl;
+    std::cerr << "  --profile-trace FILE  also write a Chrome trace to FILE"
+              << std::endl;
     return 1;
   }
 
-  std::string filepath = argv[1];
-  AnalysisResult result = analyzeFile(filepath);
-  printAnalysis(result);
+  // Reports when main returns, after the output buffers are flushed.
+  struct ProfileReport {
+    const CliOptions &options;
+    ~ProfileReport() {
+      if (!options.profile)
+        return;
+      writeProfileReport(std::cerr);
+      std::cerr << "Alignment kernel: " << alignmentKernel() << std::endl;
+      if (const char *backend = lastPrefetchBackend())
+        std::cerr << "Prefetch backend: " << backend << std::endl;
+      if (!options.profileTrace.empty())
+        writeProfileTrace(options.profileTrace);
+    }
+  } profileReport{options};
+  if (options.profile)
+    enableProfiling(!options.profileTrace.empty());
+
+#ifdef _WIN32
+  // msgpack and bin are raw bytes; text mode would mangle 0x0a.
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  if (options.stream) {
+    if (options.paths.size() > 1) {
+      std::cerr << "--stream analyzes a single input" << std::endl;
+      return 1;
+    }
+    return runStream(options.paths[0], options.blockSize, options.analysis,
+                     options.format);
+  }
+
+  // One pool serves every file analyzed by this run.
+  std::unique_ptr<ThreadPool> pool;
+  size_t threads = resolveThreadCount(options.analysis.threads);
+
+  // The server's main thread sits in reads, so all `threads` are workers;
+  // even one worker lets the next request be read while it's busy.
+  if (options.serve) {
+    pool = std::make_unique<ThreadPool>(threads);
+    return runServer(options.socketPath, options.analysis, options.format,
+                     options.entropyMap, pool.get());
+  }
+
+  // Likewise a prefetching batch: the main thread keeps the reads going.
+  if (!options.batchSource.empty() && options.prefetchBytes > 0) {
+    pool = std::make_unique<ThreadPool>(threads);
+    return runBatchMode(options.batchSource, options.analysis, options.format,
+                        options.entropyMap, options.prefetchBytes,
+                        pool.get());
+  }
 
-  if (argc >= 3) {
-    std::string filepath2 = argv[2];
-    AnalysisResult result2 = analyzeFile(filepath2);
-    compareFiles(result, result2);
+  if (threads > 1)
+    pool = std::make_unique<ThreadPool>(threads - 1);
+
+  if (!options.indexPath.empty())
+    return runIndexMode(options.indexPath, options.indexLabel, options.paths,
+                        options.analysis, options.format, pool.get());
+
+  if (options.sample)
+    return runSampleMode(options.paths[0], options.sampleMode,
+                         options.sampleBlocks, options.seed, options.analysis,
+                         options.format, pool.get());
+
+  if (!options.corpusSource.empty())
+    return runCorpusMode(options.corpusSource, options.corpusBytes,
+                         options.prefetchBytes > 0, options.format,
+                         pool.get());
+
+  if (!options.batchSource.empty())
+    return runBatchMode(options.batchSource, options.analysis, options.format,
+                        options.entropyMap, 0, pool.get());
+
+  std::string filepath = options.paths[0];
+  AnalysisResult result = analyzeFile(filepath, options.analysis, pool.get());
+  OutputBuffer out(stdout);
+  writeOutput(out, [&] {
+    writeAnalysis(result, options.format, out, options.entropyMap);
+  });
+
+  if (options.paths.size() < 2)
+    return 0;
+
+  // Two files get both analyses and the byte diff. With more, the field
+  // analysis is the point, so the other files are only mapped.
+  std::vector<std::string> names = {result.filename};
+  std::vector<ByteView> views = {result.source.view()};
+  AnalysisResult result2;
+  std::vector<MappedFile> others(options.paths.size() - 1);
+  if (options.paths.size() == 2) {
+    std::string filepath2 = options.paths[1];
+    result2 = analyzeFile(filepath2, options.analysis, pool.get());
+    DiffSummary diff =
+        diffBytes(result.source.view(), result2.source.view(), pool.get());
+    writeOutput(out, [&] {
+      if (options.format != OutputFormat::Text)
+        writeAnalysis(result2, options.format, out);
+      writeComparison(result, result2, diff, options.format, out);
+    });
+    names.push_back(filepath2);
+    views.push_back(result2.source.view());
+  } else {
+    for (size_t i = 1; i < options.paths.size(); ++i) {
+      ProfileZone zone(ProfilePhase::Load);
+      if (!others[i - 1].open(options.paths[i])) {
+        std::cerr << "Failed to open file: " << options.paths[i] << std::endl;
+        continue;
+      }
+      zone.addBytes(others[i - 1].view().size());
+      names.push_back(options.paths[i]);
+      views.push_back(others[i - 1].view());
+    }
   }
+  FieldSummary fields = compareFields(views);
+  writeOutput(out, [&] {
+    writeFieldAnalysis(names, fields, options.format, out);
+  });
 
   return 0;
 }
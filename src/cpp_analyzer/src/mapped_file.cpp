@@ -0,0 +1,204 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kReadBlockSize = 1 << 20;
+
+#ifdef _WIN32
+bool readAll(HANDLE handle, std::vector<uint8_t> &out) {
+  for (;;) {
+    size_t used = out.size();
+    out.resize(used + kReadBlockSize);
+    DWORD got = 0;
+    if (!ReadFile(handle, out.data() + used, (DWORD)kReadBlockSize, &got,
+                  nullptr)) {
+      out.resize(used);
+      return GetLastError() == ERROR_BROKEN_PIPE;
+    }
+    out.resize(used + got);
+    if (got == 0)
+      return true;
+  }
+}
+#else
+bool readAll(int fd, std::vector<uint8_t> &out) {
+  for (;;) {
+    size_t used = out.size();
+    out.resize(used + kReadBlockSize);
+    ssize_t got = ::read(fd, out.data() + used, kReadBlockSize);
+    if (got < 0) {
+      out.resize(used);
+      return false;
+    }
+    out.resize(used + static_cast<size_t>(got));
+    if (got == 0)
+      return true;
+  }
+}
+#endif
+
+} // namespace
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept { swap(other); }
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    swap(other);
+  }
+  return *this;
+}
+
+void MappedFile::swap(MappedFile &other) noexcept {
+  std::swap(opened_, other.opened_);
+  std::swap(mapping_, other.mapping_);
+  std::swap(size_, other.size_);
+  std::swap(fallback_, other.fallback_);
+#ifdef _WIN32
+  std::swap(fileHandle_, other.fileHandle_);
+  std::swap(mappingHandle_, other.mappingHandle_);
+#endif
+}
+
+void MappedFile::adopt(std::vector<uint8_t> &&bytes) {
+  close();
+  fallback_ = std::move(bytes);
+  size_ = fallback_.size();
+  opened_ = true;
+}
+
+std::vector<uint8_t> MappedFile::release() {
+  std::vector<uint8_t> bytes = std::move(fallback_);
+  fallback_.clear();
+  close();
+  return bytes;
+}
+
+ByteView MappedFile::view() const {
+  if (mapping_)
+    return ByteView(static_cast<const uint8_t *>(mapping_), size_);
+  return ByteView(fallback_.data(), fallback_.size());
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path) {
+  close();
+
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &fileSize) &&
+      fileSize.QuadPart > 0) {
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+      void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      if (base) {
+        fileHandle_ = file;
+        mappingHandle_ = mapping;
+        mapping_ = base;
+        size_ = static_cast<size_t>(fileSize.QuadPart);
+        opened_ = true;
+        return true;
+      }
+      CloseHandle(mapping);
+    }
+  }
+
+  // Not mappable (empty file, pipe, console): read it instead.
+  bool ok = readAll(file, fallback_);
+  CloseHandle(file);
+  if (!ok) {
+    fallback_.clear();
+    return false;
+  }
+  size_ = fallback_.size();
+  opened_ = true;
+  return true;
+}
+
+void MappedFile::close() {
+  if (mapping_)
+    UnmapViewOfFile(mapping_);
+  if (mappingHandle_)
+    CloseHandle(mappingHandle_);
+  if (fileHandle_)
+    CloseHandle(fileHandle_);
+  mapping_ = nullptr;
+  mappingHandle_ = nullptr;
+  fileHandle_ = nullptr;
+  fallback_.clear();
+  fallback_.shrink_to_fit();
+  size_ = 0;
+  opened_ = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    size_t length = static_cast<size_t>(st.st_size);
+    void *base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base != MAP_FAILED) {
+      // Every pass walks the file front to back; let the kernel read ahead.
+      madvise(base, length, MADV_SEQUENTIAL);
+      ::close(fd); // The mapping keeps its own reference to the file
+      mapping_ = base;
+      size_ = length;
+      opened_ = true;
+      return true;
+    }
+  }
+
+  // Not mappable (empty file, pipe, device, procfs): read it instead. Size
+  // reported by stat for these is unreliable, so read until EOF.
+  bool ok = readAll(fd, fallback_);
+  ::close(fd);
+  if (!ok) {
+    fallback_.clear();
+    return false;
+  }
+  size_ = fallback_.size();
+  opened_ = true;
+  return true;
+}
+
+void MappedFile::close() {
+  if (mapping_)
+    munmap(mapping_, size_);
+  mapping_ = nullptr;
+  fallback_.clear();
+  fallback_.shrink_to_fit();
+  size_ = 0;
+  opened_ = false;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "byte_view.h"
+
+// Read-only, memory-mapped input file.
+//
+// Regular files are mapped with mmap (POSIX) or MapViewOfFile (Windows), so
+// the analysis passes read straight from the page cache instead of from a
+// private copy. Inputs that cannot be mapped (pipes, character devices,
+// procfs entries) are read once into an owned buffer so callers never need
+// to care which path was taken.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  // Opens and maps `path`. Returns false if the file could not be opened.
+  bool open(const std::string &path);
+  // Takes over bytes already read (see prefetch.h) as the file's contents.
+  void adopt(std::vector<uint8_t> &&bytes);
+  // Closes the file, handing back the adopted or read buffer (empty if the
+  // file was mapped) so its storage can be reused.
+  std::vector<uint8_t> release();
+  void close();
+
+  bool isOpen() const { return opened_; }
+  bool isMapped() const { return mapping_ != nullptr; }
+  ByteView view() const;
+  size_t size() const { return size_; }
+
+private:
+  void swap(MappedFile &other) noexcept;
+
+  bool opened_ = false;
+  void *mapping_ = nullptr; // Base address of the mapping, if mapped
+  size_t size_ = 0;
+  std::vector<uint8_t> fallback_; // Owned copy when mapping isn't possible
+#ifdef _WIN32
+  void *fileHandle_ = nullptr;
+  void *mappingHandle_ = nullptr;
+#endif
+};
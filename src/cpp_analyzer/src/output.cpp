@@ -0,0 +1,2146 @@
+#include "output.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "alignment.h"
+
+// Binary record layout (all integers little endian, record size a multiple
+// of 8 so records can be concatenated and read with aligned loads):
+//
+//   0  char[4]  magic "ANLZ"
+//   4  u32      version (kBinaryVersion)
+//   8  u64      record size in bytes, this header included
+//  16  u64      file size
+//  24  u64      entropy window
+//  32  u64      entropy stride
+//  40  u64      entropy value count
+//  48  u64[3][8][2] alignment counts, as AnalysisResult::alignment.small
+// 432  u64[3][8][2] float counts, as AnalysisResult::alignment.floats
+// 816  u32      filename length
+// 820  u32      repeated pattern count
+// 824  char[]   filename, zero padded to a multiple of 8
+//      f32[]    entropy values, zero padded to a multiple of 8
+//      u64[3]   record stride, stride votes, total votes
+//      then per pattern (120 bytes, see RepeatedPattern):
+//        u64[5] length, count, first offset, period, period count
+//        u8[16] the n-gram, zero padded
+//        u32[16] offset histogram
+//      u64[2]   autocorrelation region offset and size
+//      u32[2]   byte period count, word period count
+//      then per period, byte periods first (16 bytes):
+//        u64 period, f32 score, u32 reserved (0)
+//      u64      region count
+//      then per region (48 bytes):
+//        u64 offset, u64 size, u32 kind (RegionKind), f32 entropy,
+//        f32[6] likelihood (ElementType order)
+namespace {
+
+const char kBinaryMagic[4] = {'A', 'N', 'L', 'Z'};
+const uint32_t kBinaryVersion = 5;
+const size_t kBinaryHeaderSize = 824;
+const size_t kBinaryPatternSize = 120;
+const size_t kBinaryPeriodSize = 16;
+const size_t kBinaryRegionSize = 48;
+
+// Regions listed by the text report; the other formats hold them all
+const size_t kMaxRegionRows = 64;
+
+size_t padTo8(size_t n) { return (n + 7) & ~size_t(7); }
+
+bool hostIsLittleEndian() {
+  const uint16_t probe = 1;
+  uint8_t low;
+  std::memcpy(&low, &probe, 1);
+  return low == 1;
+}
+
+void putLE32(OutputBuffer &out, uint32_t v) {
+  uint8_t b[4];
+  for (int i = 0; i < 4; ++i)
+    b[i] = static_cast<uint8_t>(v >> (8 * i));
+  out.append(b, 4);
+}
+
+void putLE64(OutputBuffer &out, uint64_t v) {
+  uint8_t b[8];
+  for (int i = 0; i < 8; ++i)
+    b[i] = static_cast<uint8_t>(v >> (8 * i));
+  out.append(b, 8);
+}
+
+void putZeros(OutputBuffer &out, size_t n) {
+  static const uint8_t zeros[8] = {};
+  out.append(zeros, n);
+}
+
+void putFloatLE(OutputBuffer &out, float f) {
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof bits);
+  putLE32(out, bits);
+}
+
+// float32 array as little-endian bytes: one bulk copy on LE hosts.
+void putFloatsLE(OutputBuffer &out, const std::vector<float> &values) {
+  if (hostIsLittleEndian()) {
+    out.append(values.data(), values.size() * sizeof(float));
+    return;
+  }
+  for (float f : values) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof bits);
+    putLE32(out, bits);
+  }
+}
+
+void writeBinary(const AnalysisResult &result, OutputBuffer &out) {
+  size_t nameSize = padTo8(result.filename.size());
+  size_t valuesSize = padTo8(result.entropyMap.size() * sizeof(float));
+  const PatternSummary &patterns = result.patterns;
+  const PeriodSummary &periods = result.periods;
+  size_t recordSize =
+      kBinaryHeaderSize + nameSize + valuesSize + 24 +
+      patterns.patterns.size() * kBinaryPatternSize + 24 +
+      (periods.bytePeriods.size() + periods.wordPeriods.size()) *
+          kBinaryPeriodSize +
+      8 + result.regions.size() * kBinaryRegionSize;
+
+  out.append(kBinaryMagic, 4);
+  putLE32(out, kBinaryVersion);
+  putLE64(out, recordSize);
+  putLE64(out, result.fileSize);
+  putLE64(out, result.entropyWindow);
+  putLE64(out, result.entropyStride);
+  putLE64(out, result.entropyMap.size());
+  for (int w = 0; w < 3; ++w)
+    for (int p = 0; p < 8; ++p)
+      for (int order = 0; order < 2; ++order)
+        putLE64(out, result.alignment.small[w][p][order]);
+  for (int w = 0; w < 3; ++w)
+    for (int p = 0; p < 8; ++p)
+      for (int order = 0; order < 2; ++order)
+        putLE64(out, result.alignment.floats[w][p][order]);
+  putLE32(out, static_cast<uint32_t>(result.filename.size()));
+  putLE32(out, static_cast<uint32_t>(patterns.patterns.size()));
+  out.append(result.filename);
+  putZeros(out, nameSize - result.filename.size());
+  putFloatsLE(out, result.entropyMap);
+  putZeros(out, valuesSize - result.entropyMap.size() * sizeof(float));
+
+  putLE64(out, patterns.recordStride);
+  putLE64(out, patterns.strideVotes);
+  putLE64(out, patterns.totalVotes);
+  for (const RepeatedPattern &pattern : patterns.patterns) {
+    putLE64(out, pattern.length);
+    putLE64(out, pattern.count);
+    putLE64(out, pattern.firstOffset);
+    putLE64(out, pattern.period);
+    putLE64(out, pattern.periodCount);
+    out.append(pattern.bytes, sizeof pattern.bytes);
+    for (uint32_t bin : pattern.histogram)
+      putLE32(out, bin);
+  }
+
+  putLE64(out, periods.regionOffset);
+  putLE64(out, periods.regionSize);
+  putLE32(out, static_cast<uint32_t>(periods.bytePeriods.size()));
+  putLE32(out, static_cast<uint32_t>(periods.wordPeriods.size()));
+  for (const auto *list : {&periods.bytePeriods, &periods.wordPeriods}) {
+    for (const Period &period : *list) {
+      uint32_t bits;
+      std::memcpy(&bits, &period.score, sizeof bits);
+      putLE64(out, period.period);
+      putLE32(out, bits);
+      putLE32(out, 0);
+    }
+  }
+
+  putLE64(out, result.regions.size());
+  for (const Region &region : result.regions) {
+    putLE64(out, region.offset);
+    putLE64(out, region.size);
+    putLE32(out, static_cast<uint32_t>(region.kind));
+    putFloatLE(out, region.entropy);
+    for (float likelihood : region.likelihood)
+      putFloatLE(out, likelihood);
+  }
+}
+
+// Little-endian reads from a bin record. Reading past the end yields zeros
+// and clears ok(), so a truncated record is caught once at the end.
+class RecordReader {
+public:
+  explicit RecordReader(ByteView data) : data_(data) {}
+
+  const uint8_t *bytes(size_t n) {
+    if (n > data_.size() - pos_) {
+      ok_ = false;
+      pos_ = data_.size();
+      return nullptr;
+    }
+    const uint8_t *p = data_.data() + pos_;
+    pos_ += n;
+    return p;
+  }
+  uint64_t u64() { return little(8); }
+  uint32_t u32() { return static_cast<uint32_t>(little(4)); }
+  float f32() {
+    uint32_t bits = u32();
+    float f;
+    std::memcpy(&f, &bits, sizeof f);
+    return f;
+  }
+  size_t position() const { return pos_; }
+  bool ok() const { return ok_; }
+
+private:
+  uint64_t little(int n) {
+    const uint8_t *p = bytes(static_cast<size_t>(n));
+    uint64_t v = 0;
+    for (int i = n - 1; p && i >= 0; --i)
+      v = (v << 8) | p[i];
+    return v;
+  }
+
+  ByteView data_;
+  size_t pos_ = 0;
+  bool ok_ = true;
+};
+
+bool readBinary(ByteView record, AnalysisResult &result) {
+  RecordReader in(record);
+  const uint8_t *magic = in.bytes(4);
+  if (!magic || std::memcmp(magic, kBinaryMagic, 4) != 0 ||
+      in.u32() != kBinaryVersion)
+    return false;
+  uint64_t recordSize = in.u64();
+  if (recordSize > record.size())
+    return false;
+  in = RecordReader(record.subview(0, recordSize));
+  in.bytes(16);
+
+  result.fileSize = in.u64();
+  result.entropyWindow = in.u64();
+  result.entropyStride = in.u64();
+  uint64_t valueCount = in.u64();
+  AlignmentCounts alignment;
+  for (int w = 0; w < 3; ++w)
+    for (int p = 0; p < 8; ++p)
+      for (int order = 0; order < 2; ++order)
+        alignment.small[w][p][order] = in.u64();
+  for (int w = 0; w < 3; ++w)
+    for (int p = 0; p < 8; ++p)
+      for (int order = 0; order < 2; ++order)
+        alignment.floats[w][p][order] = in.u64();
+  storeAlignment(alignment, result);
+  uint32_t nameSize = in.u32();
+  uint32_t patternCount = in.u32();
+  if (valueCount > recordSize / sizeof(float) ||
+      patternCount > recordSize / kBinaryPatternSize)
+    return false;
+  const uint8_t *name = in.bytes(padTo8(nameSize));
+  if (!name)
+    return false;
+  result.filename.assign(reinterpret_cast<const char *>(name), nameSize);
+  result.entropyMap.resize(valueCount);
+  for (float &e : result.entropyMap)
+    e = in.f32();
+  in.bytes(padTo8(valueCount * sizeof(float)) - valueCount * sizeof(float));
+
+  PatternSummary &patterns = result.patterns;
+  patterns = PatternSummary();
+  patterns.recordStride = in.u64();
+  patterns.strideVotes = in.u64();
+  patterns.totalVotes = in.u64();
+  patterns.patterns.resize(patternCount);
+  for (RepeatedPattern &pattern : patterns.patterns) {
+    pattern.length = in.u64();
+    pattern.count = in.u64();
+    pattern.firstOffset = in.u64();
+    pattern.period = in.u64();
+    pattern.periodCount = in.u64();
+    if (const uint8_t *bytes = in.bytes(sizeof pattern.bytes))
+      std::memcpy(pattern.bytes, bytes, sizeof pattern.bytes);
+    for (uint32_t &bin : pattern.histogram)
+      bin = in.u32();
+  }
+
+  PeriodSummary &periods = result.periods;
+  periods = PeriodSummary();
+  periods.regionOffset = in.u64();
+  periods.regionSize = in.u64();
+  uint32_t byteCount = in.u32();
+  uint32_t wordCount = in.u32();
+  if (byteCount + uint64_t(wordCount) > recordSize / kBinaryPeriodSize)
+    return false;
+  periods.bytePeriods.resize(byteCount);
+  periods.wordPeriods.resize(wordCount);
+  for (auto *list : {&periods.bytePeriods, &periods.wordPeriods}) {
+    for (Period &period : *list) {
+      period.period = in.u64();
+      period.score = in.f32();
+      in.u32();
+    }
+  }
+
+  uint64_t regionCount = in.u64();
+  if (regionCount > recordSize / kBinaryRegionSize)
+    return false;
+  result.regions.resize(regionCount);
+  for (Region &region : result.regions) {
+    region.offset = in.u64();
+    region.size = in.u64();
+    uint32_t kind = in.u32();
+    if (kind > static_cast<uint32_t>(RegionKind::Mixed))
+      return false;
+    region.kind = static_cast<RegionKind>(kind);
+    region.entropy = in.f32();
+    for (float &likelihood : region.likelihood)
+      likelihood = in.f32();
+  }
+  return in.ok() && in.position() == recordSize;
+}
+
+void putHex(OutputBuffer &out, const uint8_t *bytes, size_t size) {
+  static const char hex[] = "0123456789abcdef";
+  for (size_t i = 0; i < size; ++i) {
+    out.put(hex[bytes[i] >> 4]);
+    out.put(hex[bytes[i] & 15]);
+  }
+}
+
+// ---- text ----
+
+// "%.2f" for an entropy value. e * 100 is exact in a double (24-bit
+// mantissa times a 7-bit constant), so nearbyint's round-half-even gives the
+// same digits printf does, without a locale-aware library call per row.
+void putFixed2(OutputBuffer &out, float e) {
+  double scaled = std::nearbyint(static_cast<double>(e) * 100.0);
+  if (std::signbit(e)) {
+    out.put('-');
+    scaled = -scaled;
+  }
+  uint64_t hundredths = static_cast<uint64_t>(scaled);
+  out.appendUnsigned(hundredths / 100);
+  out.put('.');
+  out.put(static_cast<char>('0' + hundredths / 10 % 10));
+  out.put(static_cast<char>('0' + hundredths % 10));
+}
+
+void writeEntropyRowText(size_t offset, float e, OutputBuffer &out) {
+  // Scale 0-8 to 0-10 chars
+  int bars = static_cast<int>(e * 1.25f);
+  char gauge[13] = "[          ]";
+  for (int i = 0; i < bars && i < 10; ++i)
+    gauge[1 + i] = '#';
+  out.appendUnsigned(offset, 4);
+  out.append(": ", 2);
+  out.append(gauge, 12);
+  out.put(' ');
+  putFixed2(out, e);
+  out.put('\n');
+}
+
+// "<title> 2:[le/be le/be] 4:[...] 8:[...]"
+void writePhaseTableText(const char *title, const size_t counts[3][8][2],
+                         OutputBuffer &out) {
+  out.append(title);
+  for (int w = 0; w < 3; ++w) {
+    int width = AlignmentCounts::kWidths[w];
+    out.put(' ');
+    out.appendSigned(width);
+    out.append(":[", 2);
+    for (int p = 0; p < width; ++p) {
+      if (p)
+        out.put(' ');
+      out.appendUnsigned(counts[w][p][0]);
+      out.put('/');
+      out.appendUnsigned(counts[w][p][1]);
+    }
+    out.put(']');
+  }
+  out.put('\n');
+}
+
+void writeAlignmentText(const AnalysisResult &result, OutputBuffer &out) {
+  out.append("Alignment Scores: ");
+  for (auto const &[align, score] : result.alignmentScores) {
+    out.appendSigned(align);
+    out.put(':');
+    out.appendUnsigned(score);
+    out.put(' ');
+  }
+  out.put('\n');
+
+  // Full tables: per width, the score of each phase in LE and BE order.
+  writePhaseTableText("Alignment Phases (LE/BE):", result.alignment.small,
+                      out);
+  writePhaseTableText("Float Phases (LE/BE):", result.alignment.floats, out);
+}
+
+// "Autocorrelation Periods (bytes): 12:0.81 4:0.62", then the same for the
+// word signal; omitted when the pass didn't run.
+void writePeriodsText(const PeriodSummary &summary, OutputBuffer &out) {
+  if (summary.regionSize == 0)
+    return;
+  const char *labels[2] = {"bytes", "words"};
+  const std::vector<Period> *lists[2] = {&summary.bytePeriods,
+                                         &summary.wordPeriods};
+  for (int s = 0; s < 2; ++s) {
+    out.append("Autocorrelation Periods (");
+    out.append(labels[s], std::strlen(labels[s]));
+    out.append("):");
+    if (lists[s]->empty())
+      out.append(" none");
+    for (const Period &period : *lists[s]) {
+      out.put(' ');
+      out.appendUnsigned(period.period);
+      out.put(':');
+      putFixed2(out, period.score);
+    }
+    out.put('\n');
+  }
+}
+
+// One line per pattern: length, bytes, count, first offset, period and the
+// number of gaps that matched it, then where in the file it occurs (one
+// column per sixteenth, '#' for at least half the busiest column's count).
+void writePatternsText(const PatternSummary &summary, OutputBuffer &out) {
+  if (summary.patterns.empty())
+    return;
+  if (summary.recordStride) {
+    out.append("Record Stride: ");
+    out.appendUnsigned(summary.recordStride);
+    out.append(" (");
+    out.appendUnsigned(summary.strideVotes);
+    out.append(" of ");
+    out.appendUnsigned(summary.totalVotes);
+    out.append(" gaps)\n");
+  }
+  out.append("Repeated Patterns:\n");
+  for (const RepeatedPattern &pattern : summary.patterns) {
+    out.appendUnsigned(pattern.length, 4);
+    out.append("B ");
+    putHex(out, pattern.bytes, pattern.length);
+    out.append(" count ");
+    out.appendUnsigned(pattern.count);
+    out.append(" first ");
+    out.appendUnsigned(pattern.firstOffset);
+    out.append(" period ");
+    out.appendUnsigned(pattern.period);
+    out.append(" (");
+    out.appendUnsigned(pattern.periodCount);
+    out.append(") [");
+    uint32_t peak =
+        *std::max_element(pattern.histogram,
+                          pattern.histogram + RepeatedPattern::kHistogramBins);
+    for (uint32_t bin : pattern.histogram)
+      out.put(bin == 0 ? ' ' : bin * 2 >= peak ? '#' : '.');
+    out.append("]\n");
+  }
+}
+
+// One line per region: offset+size, kind and entropy in bits per byte.
+void writeRegionsText(const std::vector<Region> &regions, OutputBuffer &out) {
+  if (regions.empty())
+    return;
+  out.append("Regions (");
+  out.appendUnsigned(regions.size());
+  out.append("):\n");
+  size_t shown = std::min(regions.size(), kMaxRegionRows);
+  for (size_t i = 0; i < shown; ++i) {
+    const Region &region = regions[i];
+    out.appendUnsigned(region.offset, 10);
+    out.put('+');
+    out.appendUnsigned(region.size);
+    out.put(' ');
+    out.append(regionKindName(region.kind));
+    out.put(' ');
+    putFixed2(out, region.entropy);
+    out.put('\n');
+  }
+  if (regions.size() > shown) {
+    out.append("  ... ");
+    out.appendUnsigned(regions.size() - shown);
+    out.append(" more\n");
+  }
+}
+
+void writeAnalysisText(const AnalysisResult &result, bool entropyRows,
+                       OutputBuffer &out) {
+  out.append("File: ");
+  out.append(result.filename);
+  out.append("\nSize: ");
+  out.appendUnsigned(result.fileSize);
+  out.append(" bytes\n");
+
+  writeAlignmentText(result, out);
+  writePeriodsText(result.periods, out);
+  writePatternsText(result.patterns, out);
+  writeRegionsText(result.regions, out);
+  if (!entropyRows)
+    return;
+
+  out.append("Entropy Map (");
+  out.appendUnsigned(result.entropyMap.size());
+  out.append(" chunks");
+  if (result.entropyWindow != 64 || result.entropyStride != 64) {
+    out.append(", window ");
+    out.appendUnsigned(result.entropyWindow);
+    out.append(", stride ");
+    out.appendUnsigned(result.entropyStride);
+  }
+  out.append("):\n");
+
+  // Simple visualization
+  for (size_t i = 0; i < result.entropyMap.size(); ++i)
+    writeEntropyRowText(i * result.entropyStride, result.entropyMap[i], out);
+}
+
+// Totals, then the first hunks as "A offset+length -> B offset+length" and
+// where in A the edits fall (same columns as the pattern spread).
+void writeDiffText(const DiffSummary &diff, OutputBuffer &out) {
+  out.append("Byte Diff: ");
+  out.appendUnsigned(diff.equalBytes);
+  out.append(" equal, ");
+  out.appendUnsigned(diff.changedBytes);
+  out.append(" changed, ");
+  out.appendUnsigned(diff.deletedBytes);
+  out.append(" deleted, ");
+  out.appendUnsigned(diff.insertedBytes);
+  out.append(" inserted (");
+  out.appendUnsigned(diff.anchors);
+  out.append(" anchors)\n");
+  if (diff.hunkCount == 0)
+    return;
+  out.append("Hunks (");
+  out.appendUnsigned(diff.hunkCount);
+  out.append("):\n");
+  for (const DiffHunk &hunk : diff.hunks) {
+    out.append("  A ");
+    out.appendUnsigned(hunk.offsetA);
+    out.put('+');
+    out.appendUnsigned(hunk.lengthA);
+    out.append(" -> B ");
+    out.appendUnsigned(hunk.offsetB);
+    out.put('+');
+    out.appendUnsigned(hunk.lengthB);
+    out.put('\n');
+  }
+  if (diff.hunkCount > diff.hunks.size()) {
+    out.append("  ... ");
+    out.appendUnsigned(diff.hunkCount - diff.hunks.size());
+    out.append(" more\n");
+  }
+  uint32_t peak = *std::max_element(
+      diff.histogram, diff.histogram + DiffSummary::kHistogramBins);
+  if (peak == 0) // Only insertions: no bytes of A involved
+    return;
+  out.append("Change Spread: [");
+  for (uint32_t bin : diff.histogram)
+    out.put(bin == 0 ? ' ' : bin * 2 >= peak ? '#' : '.');
+  out.append("]\n");
+}
+
+// One line per field: offset+length, then the bytes of a stable field or
+// the number of distinct values of a short varying one.
+void writeFieldsText(const std::vector<std::string> &filenames,
+                     const FieldSummary &fields, OutputBuffer &out) {
+  out.append("\nField Analysis (");
+  out.appendUnsigned(filenames.size());
+  out.append(" files, ");
+  out.appendUnsigned(fields.commonSize);
+  out.append(" common bytes, largest ");
+  out.appendUnsigned(fields.largestSize);
+  out.append("):\n");
+  out.append("Stable: ");
+  out.appendUnsigned(fields.stableBytes);
+  out.append(" bytes in ");
+  out.appendUnsigned(fields.stableFields);
+  out.append(" fields, Varying: ");
+  out.appendUnsigned(fields.varyingBytes);
+  out.append(" bytes in ");
+  out.appendUnsigned(fields.varyingFields);
+  out.append(" fields\n");
+  for (const Field &field : fields.fields) {
+    out.appendUnsigned(field.offset, 10);
+    out.put('+');
+    out.appendUnsigned(field.length);
+    if (field.stable) {
+      out.append(" stable ");
+      putHex(out, field.value, std::min(field.length, Field::kMaxValueBytes));
+      if (field.length > Field::kMaxValueBytes)
+        out.append("...");
+    } else {
+      out.append(" varying");
+      if (field.distinct) {
+        out.put(' ');
+        out.appendUnsigned(field.distinct);
+        out.append(" values");
+      }
+    }
+    out.put('\n');
+  }
+  size_t total = fields.stableFields + fields.varyingFields;
+  if (total > fields.fields.size()) {
+    out.append("  ... ");
+    out.appendUnsigned(total - fields.fields.size());
+    out.append(" more\n");
+  }
+
+  const SizeSummary &sizes = fields.sizes;
+  if (sizes.distinctSizes < 2) {
+    out.append("Size Equations: none, the files are all the same size\n");
+    return;
+  }
+  out.append("Size Equations (");
+  out.appendUnsigned(sizes.consistent);
+  out.append(" of ");
+  out.appendUnsigned(sizes.hypotheses);
+  out.append(" hypotheses fit every file):\n");
+  for (const SizeSolution &solution : sizes.solutions) {
+    out.append("  size = ");
+    out.appendUnsigned(solution.header);
+    for (size_t t = 0; t < solution.terms; ++t) {
+      const CountTerm &term = solution.counts[t];
+      out.append(" + u");
+      out.appendUnsigned(term.width * 8);
+      out.append(term.bigEndian ? "be@" : "le@");
+      out.appendUnsigned(term.offset);
+      out.append(" * ");
+      out.appendUnsigned(term.stride);
+    }
+    out.put('\n');
+  }
+}
+
+// "u32le@8" for a field
+void putFieldNameText(OutputBuffer &out, uint32_t offset, uint32_t width,
+                      bool bigEndian) {
+  out.put('u');
+  out.appendUnsigned(width * 8);
+  out.append(bigEndian ? "be@" : "le@");
+  out.appendUnsigned(offset);
+}
+
+// Four significant digits: the slope of a wide field can be 1e-9.
+void putGeneral4(OutputBuffer &out, double value) {
+  char text[32];
+  auto res = std::to_chars(text, text + sizeof text, value,
+                           std::chars_format::general, 4);
+  out.append(text, static_cast<size_t>(res.ptr - text));
+}
+
+// Summary line, the constant fields, a variance map with one character per
+// offset ('=' constant, else the standard deviation / 8 as a digit, capped
+// at 9; uniform random bytes read 9) and the size correlations.
+void writeCorpusText(const std::vector<std::string> &filenames,
+                     const CorpusSummary &corpus, OutputBuffer &out) {
+  const size_t kMapRow = 64;
+  out.append("\nCorpus Analysis (");
+  out.appendUnsigned(filenames.size());
+  out.append(" files, sizes ");
+  out.appendUnsigned(corpus.smallestSize);
+  out.append(" .. ");
+  out.appendUnsigned(corpus.largestSize);
+  out.append(", mean ");
+  out.appendUnsigned(static_cast<uint64_t>(std::llround(corpus.meanSize)));
+  out.append("):\nOffsets: ");
+  out.appendUnsigned(corpus.bytes);
+  out.append(" analyzed, ");
+  out.appendUnsigned(corpus.constantBytes);
+  out.append(" constant bytes in ");
+  out.appendUnsigned(corpus.constantFields);
+  out.append(" fields\n");
+  for (const Field &field : corpus.constants) {
+    out.appendUnsigned(field.offset, 10);
+    out.put('+');
+    out.appendUnsigned(field.length);
+    out.append(" constant ");
+    putHex(out, field.value, std::min(field.length, Field::kMaxValueBytes));
+    if (field.length > Field::kMaxValueBytes)
+      out.append("...");
+    out.put('\n');
+  }
+  if (corpus.constantFields > corpus.constants.size()) {
+    out.append("  ... ");
+    out.appendUnsigned(corpus.constantFields - corpus.constants.size());
+    out.append(" more\n");
+  }
+
+  out.append("Byte Variance ('=' constant, 0-9 standard deviation / 8):\n");
+  for (size_t row = 0; row < corpus.bytes; row += kMapRow) {
+    out.appendUnsigned(row, 6);
+    out.append(": ", 2);
+    size_t end = std::min(corpus.bytes, row + kMapRow);
+    for (size_t i = row; i < end; ++i) {
+      if (corpus.coverage[i] == corpus.files &&
+          corpus.minimum[i] == corpus.maximum[i]) {
+        out.put('=');
+        continue;
+      }
+      int digit = static_cast<int>(std::sqrt(corpus.variance[i]) / 8.0f);
+      out.put(static_cast<char>('0' + std::min(digit, 9)));
+    }
+    out.put('\n');
+  }
+
+  out.append("Size Correlations (");
+  out.appendUnsigned(corpus.fieldsTested);
+  out.append(" varying fields tested):\n");
+  for (const SizeCorrelation &c : corpus.correlations) {
+    out.append("  ");
+    putFieldNameText(out, c.offset, c.width, c.bigEndian);
+    out.append(" r=");
+    putFixed2(out, static_cast<float>(c.r));
+    out.append(" size ~= ");
+    putGeneral4(out, c.intercept);
+    out.append(" + ");
+    putGeneral4(out, c.slope);
+    out.append(" * value\n");
+  }
+}
+
+// "value [low, high]": entropies and shares to two decimals, counts whole.
+void putEstimateText(OutputBuffer &out, const Estimate &e, bool count) {
+  auto put = [&](double v) {
+    if (count)
+      out.appendUnsigned(static_cast<uint64_t>(std::llround(v)));
+    else
+      putFixed2(out, static_cast<float>(v));
+  };
+  put(e.value);
+  out.append(" [", 2);
+  put(e.low);
+  out.append(", ", 2);
+  put(e.high);
+  out.put(']');
+}
+
+// What was sampled, the entropy and alignment estimates, the patterns as
+// writePatternsText lists them (count estimated, histogram over the
+// sample) and the entropy profile, one row per sampled block.
+void writeSampleText(const SampleSummary &summary, OutputBuffer &out) {
+  out.append("File: ");
+  out.append(summary.filename);
+  out.append("\nSize: ");
+  out.appendUnsigned(summary.inputSize);
+  out.append(" bytes\nSample: ");
+  out.append(sampleModeName(summary.mode));
+  out.append(", ");
+  out.appendUnsigned(summary.blocks.size());
+  out.append(" of ");
+  out.appendUnsigned(summary.inputBlocks);
+  out.append(" blocks of ");
+  out.appendUnsigned(summary.blockSize);
+  out.append(" bytes (");
+  out.appendUnsigned(summary.sampledBytes);
+  out.append(" bytes, seed ");
+  out.appendUnsigned(summary.seed);
+  out.append(")\nEntropy (95% intervals): mean ");
+  putEstimateText(out, summary.meanEntropy, false);
+  out.append(", high-entropy share ");
+  putEstimateText(out, summary.highEntropyShare, false);
+  out.append("\nAlignment Scores (estimated):");
+  for (int w = 0; w < 3; ++w) {
+    out.put(' ');
+    out.appendSigned(AlignmentCounts::kWidths[w]);
+    out.put(':');
+    putEstimateText(out, summary.alignmentScores[w], true);
+  }
+  out.put('\n');
+  writePhaseTableText("Alignment Phases (LE/BE):", summary.alignment.small,
+                      out);
+  writePhaseTableText("Float Phases (LE/BE):", summary.alignment.floats, out);
+
+  if (!summary.patterns.empty()) {
+    if (summary.recordStride) {
+      out.append("Record Stride: ");
+      out.appendUnsigned(summary.recordStride);
+      out.append(" (");
+      out.appendUnsigned(summary.strideVotes);
+      out.append(" of ");
+      out.appendUnsigned(summary.totalVotes);
+      out.append(" gaps in the sample)\n");
+    }
+    out.append("Repeated Patterns (estimated count, from ");
+    out.appendUnsigned(summary.patternBytes);
+    out.append(" sampled bytes):\n");
+  }
+  for (const SampledPattern &entry : summary.patterns) {
+    const RepeatedPattern &pattern = entry.pattern;
+    out.appendUnsigned(pattern.length, 4);
+    out.append("B ");
+    putHex(out, pattern.bytes, pattern.length);
+    out.append(" count ");
+    putEstimateText(out, entry.count, true);
+    out.append(" first ");
+    out.appendUnsigned(pattern.firstOffset);
+    out.append(" period ");
+    out.appendUnsigned(pattern.period);
+    out.append(" (");
+    out.appendUnsigned(pattern.periodCount);
+    out.append(") [");
+    uint32_t peak =
+        *std::max_element(pattern.histogram,
+                          pattern.histogram + RepeatedPattern::kHistogramBins);
+    for (uint32_t bin : pattern.histogram)
+      out.put(bin == 0 ? ' ' : bin * 2 >= peak ? '#' : '.');
+    out.append("]\n");
+  }
+
+  out.append("Entropy Profile (");
+  out.appendUnsigned(summary.blocks.size());
+  out.append(" blocks):\n");
+  for (const SampledBlock &block : summary.blocks)
+    writeEntropyRowText(block.offset, block.entropy, out);
+}
+
+// The layout as region kind names, and the entropy profile as one hex digit
+// per cell.
+void writeSignatureText(const Signature &signature, OutputBuffer &out) {
+  static const char hex[] = "0123456789abcdef";
+  out.append("Signature: magic ");
+  putHex(out, signature.magic, signature.magicLength);
+  out.append(", layout");
+  for (size_t i = 0; i < signature.layoutLength; ++i) {
+    out.put(' ');
+    out.append(regionKindName(static_cast<RegionKind>(signature.layout[i])));
+  }
+  out.append(", entropy ");
+  for (uint8_t cell : signature.profile)
+    out.put(hex[cell & 15]);
+  out.put('\n');
+}
+
+// Best first: total score, label, the four parts and the indexed file.
+void writeMatchesText(const IndexQuery &query, OutputBuffer &out) {
+  out.append("Index Matches (");
+  out.appendUnsigned(query.candidates);
+  out.append(" of ");
+  out.appendUnsigned(query.indexSize);
+  out.append(" entries scored in ");
+  putGeneral4(out, query.seconds * 1e3);
+  out.append(" ms):");
+  if (query.matches.empty())
+    out.append(" none");
+  out.put('\n');
+  for (const SignatureMatch &match : query.matches) {
+    const SignatureScore &score = match.score;
+    out.append("  ");
+    putFixed2(out, static_cast<float>(score.total));
+    out.put(' ');
+    out.append(match.entry.label);
+    out.append(" (minhash ");
+    putFixed2(out, static_cast<float>(score.minHash));
+    out.append(" layout ");
+    putFixed2(out, static_cast<float>(score.layout));
+    out.append(" entropy ");
+    putFixed2(out, static_cast<float>(score.profile));
+    out.append(" magic ");
+    putFixed2(out, static_cast<float>(score.magic));
+    out.append(") ");
+    out.append(match.entry.path);
+    out.put('\n');
+  }
+}
+
+void writeIndexQueryText(const std::string &filename, const IndexQuery &query,
+                         OutputBuffer &out) {
+  out.append("File: ");
+  out.append(filename);
+  out.append("\nSize: ");
+  out.appendUnsigned(query.signature.size);
+  out.append(" bytes\n");
+  writeSignatureText(query.signature, out);
+  writeMatchesText(query, out);
+}
+
+// ---- json ----
+
+void putJsonString(OutputBuffer &out, const std::string &text) {
+  static const char hex[] = "0123456789abcdef";
+  out.put('"');
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      out.put('\\');
+      out.put(static_cast<char>(c));
+    } else if (c < 0x20) {
+      char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+      out.append(escape, 6);
+    } else {
+      out.put(static_cast<char>(c));
+    }
+  }
+  out.put('"');
+}
+
+// Shortest representation that round-trips to the same float32.
+void putJsonFloat(OutputBuffer &out, float value) {
+  if (!std::isfinite(value)) {
+    out.append("null", 4);
+    return;
+  }
+  char text[32];
+  auto res = std::to_chars(text, text + sizeof text, value);
+  out.append(text, static_cast<size_t>(res.ptr - text));
+}
+
+// {"2":[[le,be],...],"4":[...],"8":[...]}
+void writePhaseTableJson(const size_t counts[3][8][2], OutputBuffer &out) {
+  out.put('{');
+  for (int w = 0; w < 3; ++w) {
+    int width = AlignmentCounts::kWidths[w];
+    out.append(w ? ",\"" : "\"");
+    out.appendSigned(width);
+    out.append("\":[", 3);
+    for (int p = 0; p < width; ++p) {
+      out.append(p ? ",[" : "[");
+      out.appendUnsigned(counts[w][p][0]);
+      out.put(',');
+      out.appendUnsigned(counts[w][p][1]);
+      out.put(']');
+    }
+    out.put(']');
+  }
+  out.put('}');
+}
+
+void writeAlignmentJson(const AnalysisResult &result, OutputBuffer &out) {
+  out.append(",\"size\":");
+  out.appendUnsigned(result.fileSize);
+  out.append(",\"alignmentScores\":{");
+  bool first = true;
+  for (auto const &[align, score] : result.alignmentScores) {
+    out.append(first ? "\"" : ",\"");
+    out.appendSigned(align);
+    out.append("\":", 2);
+    out.appendUnsigned(score);
+    first = false;
+  }
+  out.append("},\"alignment\":");
+  writePhaseTableJson(result.alignment.small, out);
+  out.append(",\"floats\":");
+  writePhaseTableJson(result.alignment.floats, out);
+}
+
+void writePatternsJson(const PatternSummary &summary, OutputBuffer &out) {
+  out.append(",\"patterns\":{\"recordStride\":");
+  out.appendUnsigned(summary.recordStride);
+  out.append(",\"strideVotes\":");
+  out.appendUnsigned(summary.strideVotes);
+  out.append(",\"totalVotes\":");
+  out.appendUnsigned(summary.totalVotes);
+  out.append(",\"top\":[");
+  for (size_t i = 0; i < summary.patterns.size(); ++i) {
+    const RepeatedPattern &pattern = summary.patterns[i];
+    out.append(i ? ",{\"length\":" : "{\"length\":");
+    out.appendUnsigned(pattern.length);
+    out.append(",\"bytes\":\"");
+    putHex(out, pattern.bytes, pattern.length);
+    out.append("\",\"count\":");
+    out.appendUnsigned(pattern.count);
+    out.append(",\"first\":");
+    out.appendUnsigned(pattern.firstOffset);
+    out.append(",\"period\":");
+    out.appendUnsigned(pattern.period);
+    out.append(",\"periodCount\":");
+    out.appendUnsigned(pattern.periodCount);
+    out.append(",\"histogram\":[");
+    for (int b = 0; b < RepeatedPattern::kHistogramBins; ++b) {
+      if (b)
+        out.put(',');
+      out.appendUnsigned(pattern.histogram[b]);
+    }
+    out.append("]}", 2);
+  }
+  out.append("]}", 2);
+}
+
+void writePeriodListJson(const std::vector<Period> &periods,
+                         OutputBuffer &out) {
+  out.put('[');
+  for (size_t i = 0; i < periods.size(); ++i) {
+    out.append(i ? ",{\"period\":" : "{\"period\":");
+    out.appendUnsigned(periods[i].period);
+    out.append(",\"score\":");
+    putJsonFloat(out, periods[i].score);
+    out.put('}');
+  }
+  out.put(']');
+}
+
+void writePeriodsJson(const PeriodSummary &summary, OutputBuffer &out) {
+  out.append(",\"periods\":{\"regionOffset\":");
+  out.appendUnsigned(summary.regionOffset);
+  out.append(",\"regionSize\":");
+  out.appendUnsigned(summary.regionSize);
+  out.append(",\"bytes\":");
+  writePeriodListJson(summary.bytePeriods, out);
+  out.append(",\"words\":");
+  writePeriodListJson(summary.wordPeriods, out);
+  out.put('}');
+}
+
+void writeRegionsJson(const std::vector<Region> &regions, OutputBuffer &out) {
+  out.append(",\"regions\":[");
+  for (size_t i = 0; i < regions.size(); ++i) {
+    out.append(i ? ",{\"offset\":" : "{\"offset\":");
+    out.appendUnsigned(regions[i].offset);
+    out.append(",\"size\":");
+    out.appendUnsigned(regions[i].size);
+    out.append(",\"kind\":\"");
+    out.append(regionKindName(regions[i].kind));
+    out.append("\",\"entropy\":");
+    putJsonFloat(out, regions[i].entropy);
+    out.append(",\"likelihood\":{");
+    for (int t = 0; t < kElementTypes; ++t) {
+      out.append(t ? ",\"" : "\"");
+      out.append(elementTypeName(static_cast<ElementType>(t)));
+      out.append("\":", 2);
+      putJsonFloat(out, regions[i].likelihood[t]);
+    }
+    out.append("}}");
+  }
+  out.put(']');
+}
+
+void writeEntropyHeaderJson(const std::string &filename, size_t window,
+                            size_t stride, OutputBuffer &out) {
+  out.append("{\"type\":\"analysis\",\"file\":");
+  putJsonString(out, filename);
+  out.append(",\"entropy\":{\"window\":");
+  out.appendUnsigned(window);
+  out.append(",\"stride\":");
+  out.appendUnsigned(stride);
+  out.append(",\"values\":[");
+}
+
+void writeAnalysisJson(const AnalysisResult &result, OutputBuffer &out) {
+  writeEntropyHeaderJson(result.filename, result.entropyWindow,
+                         result.entropyStride, out);
+  for (size_t i = 0; i < result.entropyMap.size(); ++i) {
+    if (i)
+      out.put(',');
+    putJsonFloat(out, result.entropyMap[i]);
+  }
+  out.append("]}", 2);
+  writeAlignmentJson(result, out);
+  writePatternsJson(result.patterns, out);
+  writePeriodsJson(result.periods, out);
+  writeRegionsJson(result.regions, out);
+  out.append("}\n", 2);
+}
+
+void putJsonUnsignedArray(OutputBuffer &out, const uint32_t *values,
+                          size_t count) {
+  out.put('[');
+  for (size_t i = 0; i < count; ++i) {
+    if (i)
+      out.put(',');
+    out.appendUnsigned(values[i]);
+  }
+  out.put(']');
+}
+
+// Hunks are [offsetA, lengthA, offsetB, lengthB] arrays.
+void writeDiffJson(const DiffSummary &diff, OutputBuffer &out) {
+  out.append(",\"diff\":{\"equal\":");
+  out.appendUnsigned(diff.equalBytes);
+  out.append(",\"changed\":");
+  out.appendUnsigned(diff.changedBytes);
+  out.append(",\"deleted\":");
+  out.appendUnsigned(diff.deletedBytes);
+  out.append(",\"inserted\":");
+  out.appendUnsigned(diff.insertedBytes);
+  out.append(",\"anchors\":");
+  out.appendUnsigned(diff.anchors);
+  out.append(",\"hunkCount\":");
+  out.appendUnsigned(diff.hunkCount);
+  out.append(",\"hunks\":[");
+  for (size_t i = 0; i < diff.hunks.size(); ++i) {
+    const DiffHunk &hunk = diff.hunks[i];
+    out.append(i ? ",[" : "[");
+    out.appendUnsigned(hunk.offsetA);
+    out.put(',');
+    out.appendUnsigned(hunk.lengthA);
+    out.put(',');
+    out.appendUnsigned(hunk.offsetB);
+    out.put(',');
+    out.appendUnsigned(hunk.lengthB);
+    out.put(']');
+  }
+  out.append("],\"histogram\":");
+  putJsonUnsignedArray(out, diff.histogram, DiffSummary::kHistogramBins);
+  out.put('}');
+}
+
+void writeFieldsJson(const std::vector<std::string> &filenames,
+                     const FieldSummary &fields, OutputBuffer &out) {
+  out.append("{\"type\":\"fields\",\"files\":[");
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    if (i)
+      out.put(',');
+    putJsonString(out, filenames[i]);
+  }
+  out.append("],\"commonSize\":");
+  out.appendUnsigned(fields.commonSize);
+  out.append(",\"largestSize\":");
+  out.appendUnsigned(fields.largestSize);
+  out.append(",\"stableBytes\":");
+  out.appendUnsigned(fields.stableBytes);
+  out.append(",\"varyingBytes\":");
+  out.appendUnsigned(fields.varyingBytes);
+  out.append(",\"stableFields\":");
+  out.appendUnsigned(fields.stableFields);
+  out.append(",\"varyingFields\":");
+  out.appendUnsigned(fields.varyingFields);
+  out.append(",\"fields\":[");
+  for (size_t i = 0; i < fields.fields.size(); ++i) {
+    const Field &field = fields.fields[i];
+    out.append(i ? ",{\"offset\":" : "{\"offset\":");
+    out.appendUnsigned(field.offset);
+    out.append(",\"length\":");
+    out.appendUnsigned(field.length);
+    out.append(field.stable ? ",\"stable\":true" : ",\"stable\":false");
+    out.append(",\"bytes\":\"");
+    putHex(out, field.value, std::min(field.length, Field::kMaxValueBytes));
+    out.append("\",\"distinct\":");
+    out.appendUnsigned(field.distinct);
+    out.put('}');
+  }
+  const SizeSummary &sizes = fields.sizes;
+  out.append("],\"sizes\":{\"distinctSizes\":");
+  out.appendUnsigned(sizes.distinctSizes);
+  out.append(",\"fields\":");
+  out.appendUnsigned(sizes.fields);
+  out.append(",\"hypotheses\":");
+  out.appendUnsigned(sizes.hypotheses);
+  out.append(",\"consistent\":");
+  out.appendUnsigned(sizes.consistent);
+  out.append(",\"solutions\":[");
+  for (size_t i = 0; i < sizes.solutions.size(); ++i) {
+    const SizeSolution &solution = sizes.solutions[i];
+    out.append(i ? ",{\"header\":" : "{\"header\":");
+    out.appendUnsigned(solution.header);
+    out.append(",\"files\":");
+    out.appendUnsigned(solution.files);
+    out.append(",\"counts\":[");
+    for (size_t t = 0; t < solution.terms; ++t) {
+      const CountTerm &term = solution.counts[t];
+      out.append(t ? ",{\"offset\":" : "{\"offset\":");
+      out.appendUnsigned(term.offset);
+      out.append(",\"width\":");
+      out.appendUnsigned(term.width);
+      out.append(term.bigEndian ? ",\"bigEndian\":true"
+                                : ",\"bigEndian\":false");
+      out.append(",\"stride\":");
+      out.appendUnsigned(term.stride);
+      out.put('}');
+    }
+    out.append("]}");
+  }
+  out.append("]}}\n", 4);
+}
+
+void writeCorpusJson(const std::vector<std::string> &filenames,
+                     const CorpusSummary &corpus, OutputBuffer &out) {
+  auto putFloats = [&](const std::vector<float> &values) {
+    out.put('[');
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i)
+        out.put(',');
+      putJsonFloat(out, values[i]);
+    }
+    out.put(']');
+  };
+  auto putBytes = [&](const std::vector<uint8_t> &values) {
+    out.put('[');
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i)
+        out.put(',');
+      out.appendUnsigned(values[i]);
+    }
+    out.put(']');
+  };
+  out.append("{\"type\":\"corpus\",\"files\":[");
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    if (i)
+      out.put(',');
+    putJsonString(out, filenames[i]);
+  }
+  out.append("],\"bytes\":");
+  out.appendUnsigned(corpus.bytes);
+  out.append(",\"smallestSize\":");
+  out.appendUnsigned(corpus.smallestSize);
+  out.append(",\"largestSize\":");
+  out.appendUnsigned(corpus.largestSize);
+  out.append(",\"meanSize\":");
+  putJsonFloat(out, static_cast<float>(corpus.meanSize));
+  out.append(",\"constantBytes\":");
+  out.appendUnsigned(corpus.constantBytes);
+  out.append(",\"constantFields\":");
+  out.appendUnsigned(corpus.constantFields);
+  out.append(",\"constants\":[");
+  for (size_t i = 0; i < corpus.constants.size(); ++i) {
+    const Field &field = corpus.constants[i];
+    out.append(i ? ",{\"offset\":" : "{\"offset\":");
+    out.appendUnsigned(field.offset);
+    out.append(",\"length\":");
+    out.appendUnsigned(field.length);
+    out.append(",\"bytes\":\"");
+    putHex(out, field.value, std::min(field.length, Field::kMaxValueBytes));
+    out.append("\"}");
+  }
+  out.append("],\"coverage\":");
+  putJsonUnsignedArray(out, corpus.coverage.data(), corpus.coverage.size());
+  out.append(",\"mean\":");
+  putFloats(corpus.mean);
+  out.append(",\"variance\":");
+  putFloats(corpus.variance);
+  out.append(",\"minimum\":");
+  putBytes(corpus.minimum);
+  out.append(",\"maximum\":");
+  putBytes(corpus.maximum);
+  out.append(",\"fieldsTested\":");
+  out.appendUnsigned(corpus.fieldsTested);
+  out.append(",\"correlations\":[");
+  for (size_t i = 0; i < corpus.correlations.size(); ++i) {
+    const SizeCorrelation &c = corpus.correlations[i];
+    out.append(i ? ",{\"offset\":" : "{\"offset\":");
+    out.appendUnsigned(c.offset);
+    out.append(",\"width\":");
+    out.appendUnsigned(c.width);
+    out.append(c.bigEndian ? ",\"bigEndian\":true" : ",\"bigEndian\":false");
+    out.append(",\"r\":");
+    putJsonFloat(out, static_cast<float>(c.r));
+    out.append(",\"slope\":");
+    putJsonFloat(out, static_cast<float>(c.slope));
+    out.append(",\"intercept\":");
+    putJsonFloat(out, static_cast<float>(c.intercept));
+    out.put('}');
+  }
+  out.append("]}\n", 3);
+}
+
+void putEstimateJson(OutputBuffer &out, const Estimate &e) {
+  out.append("{\"value\":");
+  putJsonFloat(out, static_cast<float>(e.value));
+  out.append(",\"low\":");
+  putJsonFloat(out, static_cast<float>(e.low));
+  out.append(",\"high\":");
+  putJsonFloat(out, static_cast<float>(e.high));
+  out.put('}');
+}
+
+void writeSampleJson(const SampleSummary &summary, OutputBuffer &out) {
+  out.append("{\"type\":\"sample\",\"file\":");
+  putJsonString(out, summary.filename);
+  out.append(",\"mode\":\"");
+  out.append(sampleModeName(summary.mode));
+  out.append("\",\"size\":");
+  out.appendUnsigned(summary.inputSize);
+  out.append(",\"seed\":");
+  out.appendUnsigned(summary.seed);
+  out.append(",\"blockSize\":");
+  out.appendUnsigned(summary.blockSize);
+  out.append(",\"inputBlocks\":");
+  out.appendUnsigned(summary.inputBlocks);
+  out.append(",\"sampledBytes\":");
+  out.appendUnsigned(summary.sampledBytes);
+  out.append(",\"meanEntropy\":");
+  putEstimateJson(out, summary.meanEntropy);
+  out.append(",\"highEntropyShare\":");
+  putEstimateJson(out, summary.highEntropyShare);
+  out.append(",\"alignmentScores\":{");
+  for (int w = 0; w < 3; ++w) {
+    out.append(w ? ",\"" : "\"");
+    out.appendSigned(AlignmentCounts::kWidths[w]);
+    out.append("\":", 2);
+    putEstimateJson(out, summary.alignmentScores[w]);
+  }
+  out.append("},\"alignment\":");
+  writePhaseTableJson(summary.alignment.small, out);
+  out.append(",\"floats\":");
+  writePhaseTableJson(summary.alignment.floats, out);
+  out.append(",\"patterns\":{\"sampledBytes\":");
+  out.appendUnsigned(summary.patternBytes);
+  out.append(",\"recordStride\":");
+  out.appendUnsigned(summary.recordStride);
+  out.append(",\"strideVotes\":");
+  out.appendUnsigned(summary.strideVotes);
+  out.append(",\"totalVotes\":");
+  out.appendUnsigned(summary.totalVotes);
+  out.append(",\"top\":[");
+  for (size_t i = 0; i < summary.patterns.size(); ++i) {
+    const RepeatedPattern &pattern = summary.patterns[i].pattern;
+    out.append(i ? ",{\"length\":" : "{\"length\":");
+    out.appendUnsigned(pattern.length);
+    out.append(",\"bytes\":\"");
+    putHex(out, pattern.bytes, pattern.length);
+    out.append("\",\"count\":");
+    putEstimateJson(out, summary.patterns[i].count);
+    out.append(",\"sampleCount\":");
+    out.appendUnsigned(pattern.count);
+    out.append(",\"first\":");
+    out.appendUnsigned(pattern.firstOffset);
+    out.append(",\"period\":");
+    out.appendUnsigned(pattern.period);
+    out.append(",\"periodCount\":");
+    out.appendUnsigned(pattern.periodCount);
+    out.append(",\"histogram\":[");
+    for (int b = 0; b < RepeatedPattern::kHistogramBins; ++b) {
+      if (b)
+        out.put(',');
+      out.appendUnsigned(pattern.histogram[b]);
+    }
+    out.append("]}", 2);
+  }
+  out.append("]},\"blocks\":[");
+  for (size_t i = 0; i < summary.blocks.size(); ++i) {
+    const SampledBlock &block = summary.blocks[i];
+    out.append(i ? ",{\"offset\":" : "{\"offset\":");
+    out.appendUnsigned(block.offset);
+    out.append(",\"size\":");
+    out.appendUnsigned(block.size);
+    out.append(",\"entropy\":");
+    putJsonFloat(out, block.entropy);
+    out.put('}');
+  }
+  out.append("]}\n", 3);
+}
+
+void writeIndexQueryJson(const std::string &filename, const IndexQuery &query,
+                         OutputBuffer &out) {
+  const Signature &signature = query.signature;
+  out.append("{\"type\":\"signature\",\"file\":");
+  putJsonString(out, filename);
+  out.append(",\"size\":");
+  out.appendUnsigned(signature.size);
+  out.append(",\"magic\":\"");
+  putHex(out, signature.magic, signature.magicLength);
+  out.append("\",\"layout\":[");
+  for (size_t i = 0; i < signature.layoutLength; ++i) {
+    out.append(i ? ",\"" : "\"");
+    out.append(regionKindName(static_cast<RegionKind>(signature.layout[i])));
+    out.put('"');
+  }
+  out.append("],\"profile\":[");
+  for (size_t c = 0; c < kSignatureProfileCells; ++c) {
+    if (c)
+      out.put(',');
+    out.appendUnsigned(signature.profile[c]);
+  }
+  out.put(']');
+  out.append(",\"minHash\":");
+  putJsonUnsignedArray(out, signature.minHash, kMinHashSlots);
+  out.append(",\"indexSize\":");
+  out.appendUnsigned(query.indexSize);
+  out.append(",\"candidates\":");
+  out.appendUnsigned(query.candidates);
+  out.append(",\"seconds\":");
+  putJsonFloat(out, static_cast<float>(query.seconds));
+  out.append(",\"matches\":[");
+  for (size_t i = 0; i < query.matches.size(); ++i) {
+    const SignatureMatch &match = query.matches[i];
+    out.append(i ? ",{\"label\":" : "{\"label\":");
+    putJsonString(out, match.entry.label);
+    out.append(",\"path\":");
+    putJsonString(out, match.entry.path);
+    out.append(",\"score\":");
+    putJsonFloat(out, static_cast<float>(match.score.total));
+    out.append(",\"minHash\":");
+    putJsonFloat(out, static_cast<float>(match.score.minHash));
+    out.append(",\"layout\":");
+    putJsonFloat(out, static_cast<float>(match.score.layout));
+    out.append(",\"profile\":");
+    putJsonFloat(out, static_cast<float>(match.score.profile));
+    out.append(",\"magic\":");
+    putJsonFloat(out, static_cast<float>(match.score.magic));
+    out.put('}');
+  }
+  out.append("]}\n", 3);
+}
+
+// ---- msgpack ----
+
+void putBE(OutputBuffer &out, uint8_t tag, uint64_t v, int bytes) {
+  uint8_t b[9];
+  b[0] = tag;
+  for (int i = 0; i < bytes; ++i)
+    b[1 + i] = static_cast<uint8_t>(v >> (8 * (bytes - 1 - i)));
+  out.append(b, static_cast<size_t>(bytes) + 1);
+}
+
+// str and bin headers: the fix form when n < fixLimit, otherwise the
+// 8/16/32-bit length forms, which are tagged tag8, tag8 + 1 and tag8 + 2.
+void putMsgPackLength(OutputBuffer &out, size_t n, uint8_t fixTag,
+                      size_t fixLimit, uint8_t tag8) {
+  if (n < fixLimit)
+    out.put(static_cast<char>(fixTag | n));
+  else if (n <= 0xff)
+    putBE(out, tag8, n, 1);
+  else if (n <= 0xffff)
+    putBE(out, static_cast<uint8_t>(tag8 + 1), n, 2);
+  else
+    putBE(out, static_cast<uint8_t>(tag8 + 2), n, 4);
+}
+
+void putMsgPackString(OutputBuffer &out, const std::string &s) {
+  putMsgPackLength(out, s.size(), 0xa0, 32, 0xd9);
+  out.append(s);
+}
+
+void putMsgPackMap(OutputBuffer &out, size_t n) {
+  if (n < 16)
+    out.put(static_cast<char>(0x80 | n));
+  else if (n <= 0xffff)
+    putBE(out, 0xde, n, 2);
+  else
+    putBE(out, 0xdf, n, 4);
+}
+
+void putMsgPackArray(OutputBuffer &out, size_t n) {
+  if (n < 16)
+    out.put(static_cast<char>(0x90 | n));
+  else if (n <= 0xffff)
+    putBE(out, 0xdc, n, 2);
+  else
+    putBE(out, 0xdd, n, 4);
+}
+
+void putMsgPackUnsigned(OutputBuffer &out, uint64_t v) {
+  if (v < 0x80)
+    out.put(static_cast<char>(v));
+  else if (v <= 0xff)
+    putBE(out, 0xcc, v, 1);
+  else if (v <= 0xffff)
+    putBE(out, 0xcd, v, 2);
+  else if (v <= 0xffffffffu)
+    putBE(out, 0xce, v, 4);
+  else
+    putBE(out, 0xcf, v, 8);
+}
+
+void putMsgPackFloat(OutputBuffer &out, float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  putBE(out, 0xca, bits, 4);
+}
+
+void putMsgPackSigned(OutputBuffer &out, int64_t v) {
+  if (v >= 0)
+    putMsgPackUnsigned(out, static_cast<uint64_t>(v));
+  else if (v >= -32)
+    out.put(static_cast<char>(v));
+  else
+    putBE(out, 0xd3, static_cast<uint64_t>(v), 8);
+}
+
+void writePatternsMsgPack(const PatternSummary &summary, OutputBuffer &out) {
+  putMsgPackMap(out, 4);
+  putMsgPackString(out, "recordStride");
+  putMsgPackUnsigned(out, summary.recordStride);
+  putMsgPackString(out, "strideVotes");
+  putMsgPackUnsigned(out, summary.strideVotes);
+  putMsgPackString(out, "totalVotes");
+  putMsgPackUnsigned(out, summary.totalVotes);
+  putMsgPackString(out, "top");
+  putMsgPackArray(out, summary.patterns.size());
+  for (const RepeatedPattern &pattern : summary.patterns) {
+    putMsgPackMap(out, 7);
+    putMsgPackString(out, "length");
+    putMsgPackUnsigned(out, pattern.length);
+    putMsgPackString(out, "bytes");
+    putMsgPackLength(out, pattern.length, 0, 0, 0xc4);
+    out.append(pattern.bytes, pattern.length);
+    putMsgPackString(out, "count");
+    putMsgPackUnsigned(out, pattern.count);
+    putMsgPackString(out, "first");
+    putMsgPackUnsigned(out, pattern.firstOffset);
+    putMsgPackString(out, "period");
+    putMsgPackUnsigned(out, pattern.period);
+    putMsgPackString(out, "periodCount");
+    putMsgPackUnsigned(out, pattern.periodCount);
+    putMsgPackString(out, "histogram");
+    putMsgPackArray(out, RepeatedPattern::kHistogramBins);
+    for (uint32_t bin : pattern.histogram)
+      putMsgPackUnsigned(out, bin);
+  }
+}
+
+void writePeriodsMsgPack(const PeriodSummary &summary, OutputBuffer &out) {
+  putMsgPackMap(out, 4);
+  putMsgPackString(out, "regionOffset");
+  putMsgPackUnsigned(out, summary.regionOffset);
+  putMsgPackString(out, "regionSize");
+  putMsgPackUnsigned(out, summary.regionSize);
+  const char *labels[2] = {"bytes", "words"};
+  const std::vector<Period> *lists[2] = {&summary.bytePeriods,
+                                         &summary.wordPeriods};
+  for (int s = 0; s < 2; ++s) {
+    putMsgPackString(out, labels[s]);
+    putMsgPackArray(out, lists[s]->size());
+    for (const Period &period : *lists[s]) {
+      putMsgPackMap(out, 2);
+      putMsgPackString(out, "period");
+      putMsgPackUnsigned(out, period.period);
+      putMsgPackString(out, "score");
+      putMsgPackFloat(out, period.score);
+    }
+  }
+}
+
+void writeRegionsMsgPack(const std::vector<Region> &regions,
+                         OutputBuffer &out) {
+  putMsgPackArray(out, regions.size());
+  for (const Region &region : regions) {
+    putMsgPackMap(out, 5);
+    putMsgPackString(out, "offset");
+    putMsgPackUnsigned(out, region.offset);
+    putMsgPackString(out, "size");
+    putMsgPackUnsigned(out, region.size);
+    putMsgPackString(out, "kind");
+    putMsgPackString(out, regionKindName(region.kind));
+    putMsgPackString(out, "entropy");
+    putMsgPackFloat(out, region.entropy);
+    putMsgPackString(out, "likelihood");
+    putMsgPackMap(out, kElementTypes);
+    for (int t = 0; t < kElementTypes; ++t) {
+      putMsgPackString(out, elementTypeName(static_cast<ElementType>(t)));
+      putMsgPackFloat(out, region.likelihood[t]);
+    }
+  }
+}
+
+void writePhaseTableMsgPack(const size_t counts[3][8][2], OutputBuffer &out) {
+  putMsgPackMap(out, 3);
+  for (int w = 0; w < 3; ++w) {
+    int width = AlignmentCounts::kWidths[w];
+    putMsgPackString(out, std::to_string(width));
+    putMsgPackArray(out, static_cast<size_t>(width));
+    for (int p = 0; p < width; ++p) {
+      putMsgPackArray(out, 2);
+      putMsgPackUnsigned(out, counts[w][p][0]);
+      putMsgPackUnsigned(out, counts[w][p][1]);
+    }
+  }
+}
+
+void writeAnalysisMsgPack(const AnalysisResult &result, OutputBuffer &out) {
+  putMsgPackMap(out, 10);
+  putMsgPackString(out, "type");
+  putMsgPackString(out, "analysis");
+  putMsgPackString(out, "file");
+  putMsgPackString(out, result.filename);
+  putMsgPackString(out, "size");
+  putMsgPackUnsigned(out, result.fileSize);
+
+  putMsgPackString(out, "alignmentScores");
+  putMsgPackMap(out, result.alignmentScores.size());
+  for (auto const &[align, score] : result.alignmentScores) {
+    putMsgPackString(out, std::to_string(align));
+    putMsgPackUnsigned(out, score);
+  }
+
+  putMsgPackString(out, "alignment");
+  writePhaseTableMsgPack(result.alignment.small, out);
+  putMsgPackString(out, "floats");
+  writePhaseTableMsgPack(result.alignment.floats, out);
+
+  // The map is a bin of float32 LE rather than an array of msgpack floats:
+  // readers get it with one frombuffer instead of a decode per value.
+  putMsgPackString(out, "entropy");
+  putMsgPackMap(out, 3);
+  putMsgPackString(out, "window");
+  putMsgPackUnsigned(out, result.entropyWindow);
+  putMsgPackString(out, "stride");
+  putMsgPackUnsigned(out, result.entropyStride);
+  putMsgPackString(out, "values");
+  putMsgPackLength(out, result.entropyMap.size() * sizeof(float), 0, 0, 0xc4);
+  putFloatsLE(out, result.entropyMap);
+
+  putMsgPackString(out, "patterns");
+  writePatternsMsgPack(result.patterns, out);
+
+  putMsgPackString(out, "periods");
+  writePeriodsMsgPack(result.periods, out);
+
+  putMsgPackString(out, "regions");
+  writeRegionsMsgPack(result.regions, out);
+}
+
+
+void writeDiffMsgPack(const DiffSummary &diff, OutputBuffer &out) {
+  putMsgPackMap(out, 8);
+  putMsgPackString(out, "equal");
+  putMsgPackUnsigned(out, diff.equalBytes);
+  putMsgPackString(out, "changed");
+  putMsgPackUnsigned(out, diff.changedBytes);
+  putMsgPackString(out, "deleted");
+  putMsgPackUnsigned(out, diff.deletedBytes);
+  putMsgPackString(out, "inserted");
+  putMsgPackUnsigned(out, diff.insertedBytes);
+  putMsgPackString(out, "anchors");
+  putMsgPackUnsigned(out, diff.anchors);
+  putMsgPackString(out, "hunkCount");
+  putMsgPackUnsigned(out, diff.hunkCount);
+  putMsgPackString(out, "hunks");
+  putMsgPackArray(out, diff.hunks.size());
+  for (const DiffHunk &hunk : diff.hunks) {
+    putMsgPackArray(out, 4);
+    putMsgPackUnsigned(out, hunk.offsetA);
+    putMsgPackUnsigned(out, hunk.lengthA);
+    putMsgPackUnsigned(out, hunk.offsetB);
+    putMsgPackUnsigned(out, hunk.lengthB);
+  }
+  putMsgPackString(out, "histogram");
+  putMsgPackArray(out, DiffSummary::kHistogramBins);
+  for (uint32_t bin : diff.histogram)
+    putMsgPackUnsigned(out, bin);
+}
+
+void writeFieldsMsgPack(const std::vector<std::string> &filenames,
+                        const FieldSummary &fields, OutputBuffer &out) {
+  putMsgPackMap(out, 10);
+  putMsgPackString(out, "type");
+  putMsgPackString(out, "fields");
+  putMsgPackString(out, "files");
+  putMsgPackArray(out, filenames.size());
+  for (const std::string &name : filenames)
+    putMsgPackString(out, name);
+  putMsgPackString(out, "commonSize");
+  putMsgPackUnsigned(out, fields.commonSize);
+  putMsgPackString(out, "largestSize");
+  putMsgPackUnsigned(out, fields.largestSize);
+  putMsgPackString(out, "stableBytes");
+  putMsgPackUnsigned(out, fields.stableBytes);
+  putMsgPackString(out, "varyingBytes");
+  putMsgPackUnsigned(out, fields.varyingBytes);
+  putMsgPackString(out, "stableFields");
+  putMsgPackUnsigned(out, fields.stableFields);
+  putMsgPackString(out, "varyingFields");
+  putMsgPackUnsigned(out, fields.varyingFields);
+  putMsgPackString(out, "fields");
+  putMsgPackArray(out, fields.fields.size());
+  for (const Field &field : fields.fields) {
+    putMsgPackMap(out, 5);
+    putMsgPackString(out, "offset");
+    putMsgPackUnsigned(out, field.offset);
+    putMsgPackString(out, "length");
+    putMsgPackUnsigned(out, field.length);
+    putMsgPackString(out, "stable");
+    out.put(field.stable ? char(0xc3) : char(0xc2));
+    putMsgPackString(out, "bytes");
+    size_t shown = std::min(field.length, Field::kMaxValueBytes);
+    putMsgPackLength(out, shown, 0, 0, 0xc4);
+    out.append(field.value, shown);
+    putMsgPackString(out, "distinct");
+    putMsgPackUnsigned(out, field.distinct);
+  }
+  const SizeSummary &sizes = fields.sizes;
+  putMsgPackString(out, "sizes");
+  putMsgPackMap(out, 5);
+  putMsgPackString(out, "distinctSizes");
+  putMsgPackUnsigned(out, sizes.distinctSizes);
+  putMsgPackString(out, "fields");
+  putMsgPackUnsigned(out, sizes.fields);
+  putMsgPackString(out, "hypotheses");
+  putMsgPackUnsigned(out, sizes.hypotheses);
+  putMsgPackString(out, "consistent");
+  putMsgPackUnsigned(out, sizes.consistent);
+  putMsgPackString(out, "solutions");
+  putMsgPackArray(out, sizes.solutions.size());
+  for (const SizeSolution &solution : sizes.solutions) {
+    putMsgPackMap(out, 3);
+    putMsgPackString(out, "header");
+    putMsgPackUnsigned(out, solution.header);
+    putMsgPackString(out, "files");
+    putMsgPackUnsigned(out, solution.files);
+    putMsgPackString(out, "counts");
+    putMsgPackArray(out, solution.terms);
+    for (size_t t = 0; t < solution.terms; ++t) {
+      const CountTerm &term = solution.counts[t];
+      putMsgPackMap(out, 4);
+      putMsgPackString(out, "offset");
+      putMsgPackUnsigned(out, term.offset);
+      putMsgPackString(out, "width");
+      putMsgPackUnsigned(out, term.width);
+      putMsgPackString(out, "bigEndian");
+      out.put(term.bigEndian ? char(0xc3) : char(0xc2));
+      putMsgPackString(out, "stride");
+      putMsgPackUnsigned(out, term.stride);
+    }
+  }
+}
+
+// Like the json record, with the per-offset floats as bins of float32 LE
+// and the minimum and maximum as bins of bytes.
+void writeCorpusMsgPack(const std::vector<std::string> &filenames,
+                        const CorpusSummary &corpus, OutputBuffer &out) {
+  putMsgPackMap(out, 16);
+  putMsgPackString(out, "type");
+  putMsgPackString(out, "corpus");
+  putMsgPackString(out, "files");
+  putMsgPackArray(out, filenames.size());
+  for (const std::string &name : filenames)
+    putMsgPackString(out, name);
+  putMsgPackString(out, "bytes");
+  putMsgPackUnsigned(out, corpus.bytes);
+  putMsgPackString(out, "smallestSize");
+  putMsgPackUnsigned(out, corpus.smallestSize);
+  putMsgPackString(out, "largestSize");
+  putMsgPackUnsigned(out, corpus.largestSize);
+  putMsgPackString(out, "meanSize");
+  putMsgPackFloat(out, static_cast<float>(corpus.meanSize));
+  putMsgPackString(out, "constantBytes");
+  putMsgPackUnsigned(out, corpus.constantBytes);
+  putMsgPackString(out, "constantFields");
+  putMsgPackUnsigned(out, corpus.constantFields);
+  putMsgPackString(out, "constants");
+  putMsgPackArray(out, corpus.constants.size());
+  for (const Field &field : corpus.constants) {
+    putMsgPackMap(out, 3);
+    putMsgPackString(out, "offset");
+    putMsgPackUnsigned(out, field.offset);
+    putMsgPackString(out, "length");
+    putMsgPackUnsigned(out, field.length);
+    putMsgPackString(out, "bytes");
+    size_t shown = std::min(field.length, Field::kMaxValueBytes);
+    putMsgPackLength(out, shown, 0, 0, 0xc4);
+    out.append(field.value, shown);
+  }
+  putMsgPackString(out, "coverage");
+  putMsgPackArray(out, corpus.coverage.size());
+  for (uint32_t files : corpus.coverage)
+    putMsgPackUnsigned(out, files);
+  putMsgPackString(out, "mean");
+  putMsgPackLength(out, corpus.mean.size() * sizeof(float), 0, 0, 0xc4);
+  putFloatsLE(out, corpus.mean);
+  putMsgPackString(out, "variance");
+  putMsgPackLength(out, corpus.variance.size() * sizeof(float), 0, 0, 0xc4);
+  putFloatsLE(out, corpus.variance);
+  putMsgPackString(out, "minimum");
+  putMsgPackLength(out, corpus.minimum.size(), 0, 0, 0xc4);
+  out.append(corpus.minimum.data(), corpus.minimum.size());
+  putMsgPackString(out, "maximum");
+  putMsgPackLength(out, corpus.maximum.size(), 0, 0, 0xc4);
+  out.append(corpus.maximum.data(), corpus.maximum.size());
+  putMsgPackString(out, "fieldsTested");
+  putMsgPackUnsigned(out, corpus.fieldsTested);
+  putMsgPackString(out, "correlations");
+  putMsgPackArray(out, corpus.correlations.size());
+  for (const SizeCorrelation &c : corpus.correlations) {
+    putMsgPackMap(out, 6);
+    putMsgPackString(out, "offset");
+    putMsgPackUnsigned(out, c.offset);
+    putMsgPackString(out, "width");
+    putMsgPackUnsigned(out, c.width);
+    putMsgPackString(out, "bigEndian");
+    out.put(c.bigEndian ? char(0xc3) : char(0xc2));
+    putMsgPackString(out, "r");
+    putMsgPackFloat(out, static_cast<float>(c.r));
+    putMsgPackString(out, "slope");
+    putMsgPackFloat(out, static_cast<float>(c.slope));
+    putMsgPackString(out, "intercept");
+    putMsgPackFloat(out, static_cast<float>(c.intercept));
+  }
+}
+
+void putEstimateMsgPack(OutputBuffer &out, const Estimate &e) {
+  putMsgPackMap(out, 3);
+  putMsgPackString(out, "value");
+  putMsgPackFloat(out, static_cast<float>(e.value));
+  putMsgPackString(out, "low");
+  putMsgPackFloat(out, static_cast<float>(e.low));
+  putMsgPackString(out, "high");
+  putMsgPackFloat(out, static_cast<float>(e.high));
+}
+
+void writeSampleMsgPack(const SampleSummary &summary, OutputBuffer &out) {
+  putMsgPackMap(out, 15);
+  putMsgPackString(out, "type");
+  putMsgPackString(out, "sample");
+  putMsgPackString(out, "file");
+  putMsgPackString(out, summary.filename);
+  putMsgPackString(out, "mode");
+  putMsgPackString(out, sampleModeName(summary.mode));
+  putMsgPackString(out, "size");
+  putMsgPackUnsigned(out, summary.inputSize);
+  putMsgPackString(out, "seed");
+  putMsgPackUnsigned(out, summary.seed);
+  putMsgPackString(out, "blockSize");
+  putMsgPackUnsigned(out, summary.blockSize);
+  putMsgPackString(out, "inputBlocks");
+  putMsgPackUnsigned(out, summary.inputBlocks);
+  putMsgPackString(out, "sampledBytes");
+  putMsgPackUnsigned(out, summary.sampledBytes);
+  putMsgPackString(out, "meanEntropy");
+  putEstimateMsgPack(out, summary.meanEntropy);
+  putMsgPackString(out, "highEntropyShare");
+  putEstimateMsgPack(out, summary.highEntropyShare);
+  putMsgPackString(out, "alignmentScores");
+  putMsgPackMap(out, 3);
+  for (int w = 0; w < 3; ++w) {
+    putMsgPackString(out, std::to_string(AlignmentCounts::kWidths[w]));
+    putEstimateMsgPack(out, summary.alignmentScores[w]);
+  }
+  putMsgPackString(out, "alignment");
+  writePhaseTableMsgPack(summary.alignment.small, out);
+  putMsgPackString(out, "floats");
+  writePhaseTableMsgPack(summary.alignment.floats, out);
+
+  putMsgPackString(out, "patterns");
+  putMsgPackMap(out, 5);
+  putMsgPackString(out, "sampledBytes");
+  putMsgPackUnsigned(out, summary.patternBytes);
+  putMsgPackString(out, "recordStride");
+  putMsgPackUnsigned(out, summary.recordStride);
+  putMsgPackString(out, "strideVotes");
+  putMsgPackUnsigned(out, summary.strideVotes);
+  putMsgPackString(out, "totalVotes");
+  putMsgPackUnsigned(out, summary.totalVotes);
+  putMsgPackString(out, "top");
+  putMsgPackArray(out, summary.patterns.size());
+  for (const SampledPattern &entry : summary.patterns) {
+    const RepeatedPattern &pattern = entry.pattern;
+    putMsgPackMap(out, 8);
+    putMsgPackString(out, "length");
+    putMsgPackUnsigned(out, pattern.length);
+    putMsgPackString(out, "bytes");
+    putMsgPackLength(out, pattern.length, 0, 0, 0xc4);
+    out.append(pattern.bytes, pattern.length);
+    putMsgPackString(out, "count");
+    putEstimateMsgPack(out, entry.count);
+    putMsgPackString(out, "sampleCount");
+    putMsgPackUnsigned(out, pattern.count);
+    putMsgPackString(out, "first");
+    putMsgPackUnsigned(out, pattern.firstOffset);
+    putMsgPackString(out, "period");
+    putMsgPackUnsigned(out, pattern.period);
+    putMsgPackString(out, "periodCount");
+    putMsgPackUnsigned(out, pattern.periodCount);
+    putMsgPackString(out, "histogram");
+    putMsgPackArray(out, RepeatedPattern::kHistogramBins);
+    for (uint32_t bin : pattern.histogram)
+      putMsgPackUnsigned(out, bin);
+  }
+
+  putMsgPackString(out, "blocks");
+  putMsgPackArray(out, summary.blocks.size());
+  for (const SampledBlock &block : summary.blocks) {
+    putMsgPackMap(out, 3);
+    putMsgPackString(out, "offset");
+    putMsgPackUnsigned(out, block.offset);
+    putMsgPackString(out, "size");
+    putMsgPackUnsigned(out, block.size);
+    putMsgPackString(out, "entropy");
+    putMsgPackFloat(out, block.entropy);
+  }
+}
+
+void writeIndexQueryMsgPack(const std::string &filename,
+                            const IndexQuery &query, OutputBuffer &out) {
+  const Signature &signature = query.signature;
+  putMsgPackMap(out, 11);
+  putMsgPackString(out, "type");
+  putMsgPackString(out, "signature");
+  putMsgPackString(out, "file");
+  putMsgPackString(out, filename);
+  putMsgPackString(out, "size");
+  putMsgPackUnsigned(out, signature.size);
+  putMsgPackString(out, "magic");
+  putMsgPackLength(out, signature.magicLength, 0, 0, 0xc4);
+  out.append(signature.magic, signature.magicLength);
+  putMsgPackString(out, "layout");
+  putMsgPackArray(out, signature.layoutLength);
+  for (size_t i = 0; i < signature.layoutLength; ++i)
+    putMsgPackString(
+        out, regionKindName(static_cast<RegionKind>(signature.layout[i])));
+  putMsgPackString(out, "profile");
+  putMsgPackLength(out, kSignatureProfileCells, 0, 0, 0xc4);
+  out.append(signature.profile, kSignatureProfileCells);
+  putMsgPackString(out, "minHash");
+  putMsgPackArray(out, kMinHashSlots);
+  for (uint32_t slot : signature.minHash)
+    putMsgPackUnsigned(out, slot);
+  putMsgPackString(out, "indexSize");
+  putMsgPackUnsigned(out, query.indexSize);
+  putMsgPackString(out, "candidates");
+  putMsgPackUnsigned(out, query.candidates);
+  putMsgPackString(out, "seconds");
+  putMsgPackFloat(out, static_cast<float>(query.seconds));
+  putMsgPackString(out, "matches");
+  putMsgPackArray(out, query.matches.size());
+  for (const SignatureMatch &match : query.matches) {
+    putMsgPackMap(out, 7);
+    putMsgPackString(out, "label");
+    putMsgPackString(out, match.entry.label);
+    putMsgPackString(out, "path");
+    putMsgPackString(out, match.entry.path);
+    putMsgPackString(out, "score");
+    putMsgPackFloat(out, static_cast<float>(match.score.total));
+    putMsgPackString(out, "minHash");
+    putMsgPackFloat(out, static_cast<float>(match.score.minHash));
+    putMsgPackString(out, "layout");
+    putMsgPackFloat(out, static_cast<float>(match.score.layout));
+    putMsgPackString(out, "profile");
+    putMsgPackFloat(out, static_cast<float>(match.score.profile));
+    putMsgPackString(out, "magic");
+    putMsgPackFloat(out, static_cast<float>(match.score.magic));
+  }
+}
+
+} // namespace
+
+bool parseOutputFormat(const std::string &name, OutputFormat &format) {
+  if (name == "text")
+    format = OutputFormat::Text;
+  else if (name == "json")
+    format = OutputFormat::Json;
+  else if (name == "msgpack")
+    format = OutputFormat::MsgPack;
+  else if (name == "bin")
+    format = OutputFormat::Binary;
+  else
+    return false;
+  return true;
+}
+
+OutputBuffer::OutputBuffer(std::FILE *sink, size_t flushThreshold)
+    : sink_(sink), flushThreshold_(flushThreshold) {
+  if (sink_)
+    buffer_.reserve(flushThreshold_ + 4096);
+}
+
+OutputBuffer::~OutputBuffer() { flush(); }
+
+void OutputBuffer::append(const void *data, size_t size) {
+  buffer_.append(static_cast<const char *>(data), size);
+  maybeFlush();
+}
+
+void OutputBuffer::put(char c) {
+  buffer_.push_back(c);
+  maybeFlush();
+}
+
+void OutputBuffer::appendUnsigned(uint64_t value, int width) {
+  char digits[24];
+  auto res = std::to_chars(digits, digits + sizeof digits, value);
+  int length = static_cast<int>(res.ptr - digits);
+  if (width > length)
+    buffer_.append(static_cast<size_t>(width - length), ' ');
+  append(digits, static_cast<size_t>(length));
+}
+
+void OutputBuffer::appendSigned(int64_t value) {
+  char digits[24];
+  auto res = std::to_chars(digits, digits + sizeof digits, value);
+  append(digits, static_cast<size_t>(res.ptr - digits));
+}
+
+void OutputBuffer::flush() {
+  if (!sink_ || buffer_.empty())
+    return;
+  std::fwrite(buffer_.data(), 1, buffer_.size(), sink_);
+  std::fflush(sink_);
+  flushed_ += buffer_.size();
+  buffer_.clear();
+}
+
+bool readAnalysisRecord(ByteView record, AnalysisResult &result) {
+  return readBinary(record, result);
+}
+
+void writeAnalysis(const AnalysisResult &result, OutputFormat format,
+                   OutputBuffer &out, bool entropyRows) {
+  switch (format) {
+  case OutputFormat::Text:
+    writeAnalysisText(result, entropyRows, out);
+    break;
+  case OutputFormat::Json:
+    writeAnalysisJson(result, out);
+    break;
+  case OutputFormat::MsgPack:
+    writeAnalysisMsgPack(result, out);
+    break;
+  case OutputFormat::Binary:
+    writeBinary(result, out);
+    break;
+  }
+}
+
+// Helper: Differential Analysis
+//
+// Compares two files to identify structural differences: the size delta
+// hints at "strides", and the byte diff (diffBytes) shows where they differ.
+//
+// Usage:
+// If File A has 10 items and File B has 20 items, and Size(B) - Size(A) = 120
+// bytes, then we can infer that each item is likely 12 bytes (120 / 10).
+void writeComparison(const AnalysisResult &r1, const AnalysisResult &r2,
+                     const DiffSummary &diff, OutputFormat format,
+                     OutputBuffer &out) {
+  long long delta = (long long)r2.fileSize - (long long)r1.fileSize;
+  switch (format) {
+  case OutputFormat::Text:
+    out.append("\nDifferential Analysis (");
+    out.append(r1.filename);
+    out.append(" vs ");
+    out.append(r2.filename);
+    out.append("):\n");
+    if (r1.fileSize != r2.fileSize) {
+      out.append("Size diff: ");
+      out.appendUnsigned(r1.fileSize);
+      out.append(" vs ");
+      out.appendUnsigned(r2.fileSize);
+      out.append(" (Delta: ");
+      out.appendSigned(delta);
+      out.append(")\n");
+    } else {
+      out.append("Size match.\n");
+    }
+    writeDiffText(diff, out);
+    break;
+  case OutputFormat::Json:
+    out.append("{\"type\":\"compare\",\"files\":[");
+    putJsonString(out, r1.filename);
+    out.put(',');
+    putJsonString(out, r2.filename);
+    out.append("],\"sizeDelta\":");
+    out.appendSigned(delta);
+    writeDiffJson(diff, out);
+    out.append("}\n", 2);
+    break;
+  case OutputFormat::MsgPack:
+    putMsgPackMap(out, 4);
+    putMsgPackString(out, "type");
+    putMsgPackString(out, "compare");
+    putMsgPackString(out, "files");
+    putMsgPackArray(out, 2);
+    putMsgPackString(out, r1.filename);
+    putMsgPackString(out, r2.filename);
+    putMsgPackString(out, "sizeDelta");
+    putMsgPackSigned(out, delta);
+    putMsgPackString(out, "diff");
+    writeDiffMsgPack(diff, out);
+    break;
+  case OutputFormat::Binary:
+    break;
+  }
+}
+
+void writeFieldAnalysis(const std::vector<std::string> &filenames,
+                        const FieldSummary &fields, OutputFormat format,
+                        OutputBuffer &out) {
+  switch (format) {
+  case OutputFormat::Text:
+    writeFieldsText(filenames, fields, out);
+    break;
+  case OutputFormat::Json:
+    writeFieldsJson(filenames, fields, out);
+    break;
+  case OutputFormat::MsgPack:
+    writeFieldsMsgPack(filenames, fields, out);
+    break;
+  case OutputFormat::Binary:
+    break;
+  }
+}
+
+void writeCorpusAnalysis(const std::vector<std::string> &filenames,
+                         const CorpusSummary &corpus, OutputFormat format,
+                         OutputBuffer &out) {
+  switch (format) {
+  case OutputFormat::Text:
+    writeCorpusText(filenames, corpus, out);
+    break;
+  case OutputFormat::Json:
+    writeCorpusJson(filenames, corpus, out);
+    break;
+  case OutputFormat::MsgPack:
+    writeCorpusMsgPack(filenames, corpus, out);
+    break;
+  case OutputFormat::Binary:
+    break;
+  }
+}
+
+void writeSampleAnalysis(const SampleSummary &summary, OutputFormat format,
+                         OutputBuffer &out) {
+  switch (format) {
+  case OutputFormat::Text:
+    writeSampleText(summary, out);
+    break;
+  case OutputFormat::Json:
+    writeSampleJson(summary, out);
+    break;
+  case OutputFormat::MsgPack:
+    writeSampleMsgPack(summary, out);
+    break;
+  case OutputFormat::Binary:
+    break;
+  }
+}
+
+void writeIndexQuery(const std::string &filename, const IndexQuery &query,
+                     OutputFormat format, OutputBuffer &out) {
+  switch (format) {
+  case OutputFormat::Text:
+    writeIndexQueryText(filename, query, out);
+    break;
+  case OutputFormat::Json:
+    writeIndexQueryJson(filename, query, out);
+    break;
+  case OutputFormat::MsgPack:
+    writeIndexQueryMsgPack(filename, query, out);
+    break;
+  case OutputFormat::Binary:
+    break;
+  }
+}
+
+bool formatSupportsStreaming(OutputFormat format) {
+  return format == OutputFormat::Text || format == OutputFormat::Json;
+}
+
+void writeStreamBegin(const std::string &filename,
+                      const AnalysisOptions &options, OutputFormat format,
+                      OutputBuffer &out) {
+  if (format == OutputFormat::Json) {
+    writeEntropyHeaderJson(filename, options.entropyWindow,
+                           options.entropyStride, out);
+    return;
+  }
+  out.append("File: ");
+  out.append(filename);
+  out.append("\nEntropy Map (streaming):\n");
+}
+
+void writeStreamEntropy(size_t index, size_t offset, float entropy,
+                        OutputFormat format, OutputBuffer &out) {
+  if (format == OutputFormat::Json) {
+    if (index)
+      out.put(',');
+    putJsonFloat(out, entropy);
+    return;
+  }
+  writeEntropyRowText(offset, entropy, out);
+}
+
+void writeStreamEnd(const AnalysisResult &result, OutputFormat format,
+                    OutputBuffer &out) {
+  if (format == OutputFormat::Json) {
+    out.append("]}", 2);
+    writeAlignmentJson(result, out);
+    out.append("}\n", 2);
+    return;
+  }
+  out.append("Size: ");
+  out.appendUnsigned(result.fileSize);
+  out.append(" bytes\n");
+  writeAlignmentText(result, out);
+}
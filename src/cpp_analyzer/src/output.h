@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "byte_view.h"
+#include "corpus.h"
+#include "diff.h"
+#include "sample.h"
+#include "signature.h"
+
+// Report formats selectable with --format.
+//
+// - text:    the human/LLM-readable report (the default).
+// - json:    one JSON object per line (JSON Lines), one line per record.
+// - msgpack: a sequence of MessagePack maps with the same keys as json; the
+//            entropy map is a bin blob of little-endian float32s.
+// - bin:     fixed-layout little-endian records whose entropy map can be
+//            viewed in place as a float32 array (layout in output.cpp).
+enum class OutputFormat { Text, Json, MsgPack, Binary };
+
+bool parseOutputFormat(const std::string &name, OutputFormat &format);
+
+// Append-only output buffer.
+//
+// Everything is formatted into memory and handed to the sink in large
+// writes (one fwrite per flushThreshold bytes) rather than a flush per
+// line. Without a sink the buffer just accumulates, which is how batch mode
+// renders a report off-lock before writing it whole.
+class OutputBuffer {
+public:
+  explicit OutputBuffer(std::FILE *sink = nullptr,
+                        size_t flushThreshold = size_t(1) << 20);
+  ~OutputBuffer();
+
+  OutputBuffer(const OutputBuffer &) = delete;
+  OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+  void append(const void *data, size_t size);
+  void append(const std::string &text) { append(text.data(), text.size()); }
+  // Literals go straight in rather than through a temporary std::string.
+  void append(const char *text) { append(text, std::strlen(text)); }
+  void put(char c);
+  // Unsigned decimal, right-aligned to at least `width` characters.
+  void appendUnsigned(uint64_t value, int width = 0);
+  void appendSigned(int64_t value);
+
+  // Writes pending bytes to the sink, if there is one.
+  void flush();
+
+  const std::string &data() const { return buffer_; }
+  void clear() {
+    buffer_.clear();
+    flushed_ = 0;
+  }
+  // Bytes appended since construction or clear(), flushed or not.
+  size_t written() const { return flushed_ + buffer_.size(); }
+
+private:
+  void maybeFlush() {
+    if (sink_ && buffer_.size() >= flushThreshold_)
+      flush();
+  }
+
+  std::FILE *sink_;
+  size_t flushThreshold_;
+  std::string buffer_;
+  size_t flushed_ = 0;
+};
+
+// Writes one analysis record. Text reports list the regions; with
+// `entropyRows` they also print the entropy map, one row per chunk. The
+// structured formats always carry both.
+void writeAnalysis(const AnalysisResult &result, OutputFormat format,
+                   OutputBuffer &out, bool entropyRows = false);
+
+// Parses one bin record back into `result` (everything but `source`).
+// Returns false if the record is truncated, malformed or another version.
+bool readAnalysisRecord(ByteView record, AnalysisResult &result);
+
+// Writes the differential analysis of two results: the size delta and the
+// byte-level diff of r2 against r1. Binary output has no comparison record.
+void writeComparison(const AnalysisResult &r1, const AnalysisResult &r2,
+                     const DiffSummary &diff, OutputFormat format,
+                     OutputBuffer &out);
+
+// Writes the field analysis of N files. Binary output has no field record.
+void writeFieldAnalysis(const std::vector<std::string> &filenames,
+                        const FieldSummary &fields, OutputFormat format,
+                        OutputBuffer &out);
+
+// Writes the corpus statistics of N files. Binary output has no corpus
+// record.
+void writeCorpusAnalysis(const std::vector<std::string> &filenames,
+                         const CorpusSummary &corpus, OutputFormat format,
+                         OutputBuffer &out);
+
+// Writes the estimates of a sampled analysis (--sample). Binary output has
+// no sample record.
+void writeSampleAnalysis(const SampleSummary &summary, OutputFormat format,
+                         OutputBuffer &out);
+
+// A file's signature and its best matches in a signature index of
+// `indexSize` entries, `candidates` of which were scored in `seconds`.
+struct IndexQuery {
+  Signature signature;
+  std::vector<SignatureMatch> matches;
+  size_t indexSize = 0;
+  size_t candidates = 0;
+  double seconds = 0;
+};
+
+// Writes the result of an index lookup (--index). Binary output has no
+// signature record.
+void writeIndexQuery(const std::string &filename, const IndexQuery &query,
+                     OutputFormat format, OutputBuffer &out);
+
+// Streaming reports are written piecewise: the entropy rows are produced
+// before the size and alignment are known. Supported for text and json.
+bool formatSupportsStreaming(OutputFormat format);
+void writeStreamBegin(const std::string &filename,
+                      const AnalysisOptions &options, OutputFormat format,
+                      OutputBuffer &out);
+void writeStreamEntropy(size_t index, size_t offset, float entropy,
+                        OutputFormat format, OutputBuffer &out);
+void writeStreamEnd(const AnalysisResult &result, OutputFormat format,
+                    OutputBuffer &out);
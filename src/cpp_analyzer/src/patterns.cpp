@@ -0,0 +1,389 @@
+#include "patterns.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "arena.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+
+namespace {
+
+// Gap values tracked per candidate in the second pass. Record data has one
+// dominant gap and a handful of others, so a few counters are plenty.
+const size_t kGapCounters = 32;
+
+// Inputs larger than this draw their candidates from evenly spaced blocks
+// that add up to it; the exact second pass still covers every byte. A
+// record table fills many blocks, so its fields are found either way.
+const size_t kCandidateSampleBytes = size_t(16) << 20;
+const size_t kCandidateBlockBytes = size_t(64) << 10;
+
+// Counters in the sketch that screens n-grams before the frequency table
+// (256 KiB per length).
+const size_t kSketchBits = 16;
+
+// Candidates recounted per reported pattern; the surplus makes up for the
+// ones that fall under kMinRepeats or turn out to be shifted copies.
+const size_t kCandidatesPerPattern = 4;
+
+// A pattern seen twice has one gap, which says nothing about a period.
+const size_t kMinRepeats = 3;
+
+// An n-gram of up to 16 bytes as two little-endian words: bytes 0-7 in
+// `lo`, bytes 8-15 in `hi`, unused bytes zero.
+struct NGram {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+
+  bool operator==(const NGram &other) const {
+    return lo == other.lo && hi == other.hi;
+  }
+};
+
+// Multiplicative hashing; tables index with the top bits of the product,
+// which depend on every input bit.
+uint64_t hashKey(uint64_t v) { return v * 0x9e3779b97f4a7c15ULL; }
+
+uint64_t hashKey(const NGram &key) {
+  return (key.lo ^ (key.hi * 0xc2b2ae3d27d4eb4fULL)) * 0x9e3779b97f4a7c15ULL;
+}
+
+// Misra-Gries frequent-item summary in an open-addressing table.
+//
+// Holds at most `counters` keys in twice as many slots, so linear probes
+// stay short. When a new key arrives with every counter taken, all counts
+// drop by one and keys that reach zero are evicted; the new key is absorbed
+// by the same decrement. A pass cancels counters + 1 increments, so passes
+// cost O(1) amortized per add and any key occurring more than
+// n / (counters + 1) times in n adds is kept. Counts are lower bounds.
+// Both tables live in `memory`.
+template <typename Key> class FrequentCounter {
+public:
+  FrequentCounter(size_t counters, std::pmr::memory_resource *memory)
+      : slots_(memory), spare_(memory), limit_(counters) {
+    size_t slots = 2;
+    shift_ = 63;
+    while (slots < counters * 2) {
+      slots <<= 1;
+      --shift_;
+    }
+    slots_.resize(slots);
+  }
+
+  void add(const Key &key) {
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = hashKey(key) >> shift_;; i = (i + 1) & mask) {
+      Slot &slot = slots_[i];
+      if (slot.count == 0) {
+        if (used_ == limit_) {
+          decrementAll();
+          return;
+        }
+        slot.key = key;
+        slot.count = 1;
+        ++used_;
+        return;
+      }
+      if (slot.key == key) {
+        ++slot.count;
+        return;
+      }
+    }
+  }
+
+  template <typename Fn> void forEach(Fn fn) const {
+    for (const Slot &slot : slots_)
+      if (slot.count)
+        fn(slot.key, slot.count);
+  }
+
+private:
+  struct Slot {
+    Key key{};
+    size_t count = 0;
+  };
+
+  // Rebuilds into a fresh table: linear probing can't delete in place
+  // without breaking the probe chains of the survivors.
+  void decrementAll() {
+    spare_.assign(slots_.size(), Slot());
+    const size_t mask = spare_.size() - 1;
+    used_ = 0;
+    for (const Slot &slot : slots_) {
+      if (slot.count <= 1)
+        continue;
+      size_t i = hashKey(slot.key) >> shift_;
+      while (spare_[i].count)
+        i = (i + 1) & mask;
+      spare_[i].key = slot.key;
+      spare_[i].count = slot.count - 1;
+      ++used_;
+    }
+    slots_.swap(spare_);
+  }
+
+  ScratchVector<Slot> slots_;
+  ScratchVector<Slot> spare_;
+  size_t used_ = 0;
+  size_t limit_;
+  int shift_;
+};
+
+uint64_t load(const uint8_t *p, size_t bytes) {
+  uint64_t v = 0;
+  std::memcpy(&v, p, bytes);
+  return v;
+}
+
+// Calls fn(ngram, offset) for every N-byte n-gram of `data`, skipping runs
+// of a single byte value. Each n-gram is one or two unaligned loads (the
+// sizes are constants, so memcpy compiles to plain moves): no state carries
+// from one position to the next, so consecutive positions overlap in the
+// pipeline instead of waiting on a shift register.
+template <size_t N, typename Fn> void forEachNGram(ByteView data, Fn fn) {
+  static_assert(N >= 1 && N <= 16, "n-grams are at most 16 bytes");
+  constexpr size_t loBytes = N < 8 ? N : 8;
+  constexpr size_t hiBytes = N - loBytes;
+  if (data.size() < N)
+    return;
+  const uint8_t *bytes = data.data();
+  const size_t positions = data.size() - N + 1;
+  for (size_t i = 0; i < positions; ++i) {
+    NGram key{load(bytes + i, loBytes),
+              hiBytes ? load(bytes + i + 8, hiBytes) : 0};
+    uint64_t run = (key.lo & 0xff) * 0x0101010101010101ULL;
+    uint64_t loMask = loBytes == 8 ? ~0ULL : (1ULL << (8 * loBytes)) - 1;
+    uint64_t hiMask = hiBytes == 8 ? ~0ULL : (1ULL << (8 * hiBytes)) - 1;
+    if (((key.lo ^ run) & loMask) == 0 && ((key.hi ^ run) & hiMask) == 0)
+      continue;
+    fn(key, i);
+  }
+}
+
+struct Candidate {
+  explicit Candidate(std::pmr::memory_resource *memory)
+      : gaps(kGapCounters, memory) {}
+
+  NGram key;
+  RepeatedPattern pattern;
+  size_t last = 0;
+  FrequentCounter<uint64_t> gaps;
+};
+
+// Both passes for one n-gram length. Writes up to `topK` patterns to `out`
+// and returns how many.
+template <size_t N>
+size_t findRepeats(ByteView data, size_t topK, RepeatedPattern *out) {
+  const size_t n = N;
+  if (data.size() <= n)
+    return 0;
+  ArenaScope scope;
+  std::pmr::memory_resource *memory = scope.resource();
+
+  // Pass 1: the approximately most frequent n-grams. Most n-grams of real
+  // data are unique, and a table insert per position is a branch mispredict
+  // or three. A counting sketch (one counter per hash bucket, a
+  // branch-free increment) screens them first: only n-grams whose bucket
+  // count reached a share of the positions seen so far can be frequent, and
+  // only those are handed to the Misra-Gries table.
+  ScratchVector<std::pair<size_t, NGram>> ranked(memory);
+  ranked.reserve(kPatternCounters);
+  {
+    FrequentCounter<NGram> counter(kPatternCounters, memory);
+    ScratchVector<uint32_t> sketch(size_t(1) << kSketchBits, memory);
+    size_t seen = 0;
+    auto add = [&](const NGram &key, size_t) {
+      uint32_t estimate = ++sketch[hashKey(key) >> (64 - kSketchBits)];
+      size_t threshold = std::max<size_t>(2, ++seen / kPatternCounters);
+      if (estimate >= threshold)
+        counter.add(key);
+    };
+    if (data.size() <= kCandidateSampleBytes) {
+      forEachNGram<N>(data, add);
+    } else {
+      const size_t blocks = kCandidateSampleBytes / kCandidateBlockBytes;
+      const size_t spacing = data.size() / blocks;
+      for (size_t b = 0; b < blocks; ++b)
+        forEachNGram<N>(data.subview(b * spacing, kCandidateBlockBytes), add);
+    }
+    counter.forEach([&](const NGram &key, size_t count) {
+      if (count >= 2)
+        ranked.emplace_back(count, key);
+    });
+  }
+  auto byCount = [](const std::pair<size_t, NGram> &a,
+                    const std::pair<size_t, NGram> &b) {
+    if (a.first != b.first)
+      return a.first > b.first;
+    return a.second.hi != b.second.hi ? a.second.hi < b.second.hi
+                                      : a.second.lo < b.second.lo;
+  };
+  size_t keep = std::min(topK * kCandidatesPerPattern, ranked.size());
+  std::partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(),
+                    byCount);
+  if (keep == 0)
+    return 0;
+
+  // Pass 2: exact counts, gaps and placement of the candidates.
+  ScratchVector<Candidate> candidates(memory);
+  candidates.reserve(keep);
+  for (size_t c = 0; c < keep; ++c)
+    candidates.emplace_back(memory);
+  size_t slots = 2;
+  int shift = 63;
+  while (slots < keep * 4) {
+    slots <<= 1;
+    --shift;
+  }
+  ScratchVector<int> index(slots, -1, memory);
+  for (size_t c = 0; c < keep; ++c) {
+    candidates[c].key = ranked[c].second;
+    size_t i = hashKey(ranked[c].second) >> shift;
+    while (index[i] >= 0)
+      i = (i + 1) & (slots - 1);
+    index[i] = static_cast<int>(c);
+  }
+
+  const size_t binWidth =
+      (data.size() + RepeatedPattern::kHistogramBins - 1) /
+      RepeatedPattern::kHistogramBins;
+  forEachNGram<N>(data, [&](const NGram &key, size_t offset) {
+    for (size_t i = hashKey(key) >> shift; index[i] >= 0;
+         i = (i + 1) & (slots - 1)) {
+      Candidate &c = candidates[static_cast<size_t>(index[i])];
+      if (!(c.key == key))
+        continue;
+      if (c.pattern.count++ == 0)
+        c.pattern.firstOffset = offset;
+      else
+        c.gaps.add(offset - c.last);
+      c.last = offset;
+      ++c.pattern.histogram[offset / binWidth];
+      return;
+    }
+  });
+
+  ScratchVector<RepeatedPattern> found(memory);
+  found.reserve(keep);
+  for (Candidate &c : candidates) {
+    RepeatedPattern &pattern = c.pattern;
+    if (pattern.count < kMinRepeats)
+      continue;
+    pattern.length = n;
+    std::memcpy(pattern.bytes, data.data() + pattern.firstOffset, n);
+    c.gaps.forEach([&](uint64_t gap, size_t count) {
+      if (count > pattern.periodCount ||
+          (count == pattern.periodCount && gap < pattern.period)) {
+        pattern.period = static_cast<size_t>(gap);
+        pattern.periodCount = count;
+      }
+    });
+    found.push_back(pattern);
+  }
+  std::sort(found.begin(), found.end(),
+            [](const RepeatedPattern &a, const RepeatedPattern &b) {
+              if (a.count != b.count)
+                return a.count > b.count;
+              return a.firstOffset < b.firstOffset;
+            });
+
+  // A repeat longer than n shows up as n-grams at nearby shifts with the
+  // same period and about the same count (the ends of the input cut a few
+  // occurrences); keep the most frequent of each such group.
+  size_t kept = 0;
+  for (const RepeatedPattern &pattern : found) {
+    if (kept == topK)
+      break;
+    bool shifted = false;
+    for (const RepeatedPattern *other = out; other != out + kept; ++other) {
+      size_t distance = pattern.firstOffset > other->firstOffset
+                            ? pattern.firstOffset - other->firstOffset
+                            : other->firstOffset - pattern.firstOffset;
+      if (other->period == pattern.period && distance < n &&
+          pattern.count >= other->count - other->count / 64) {
+        shifted = true;
+        break;
+      }
+    }
+    if (!shifted)
+      out[kept++] = pattern;
+  }
+  return kept;
+}
+
+using FindRepeats = size_t (*)(ByteView, size_t, RepeatedPattern *);
+
+template <size_t... L>
+constexpr std::array<FindRepeats, sizeof...(L)>
+repeatKernels(std::index_sequence<L...>) {
+  return {{findRepeats<PatternSummary::kLengths[L]>...}};
+}
+
+// findRepeats for each of PatternSummary::kLengths, in that order: every
+// length is its own instance, with its loads and masks constant.
+constexpr auto kFindRepeats = repeatKernels(
+    std::make_index_sequence<sizeof(PatternSummary::kLengths) /
+                             sizeof(size_t)>());
+
+} // namespace
+
+void findPatterns(ByteView data, const AnalysisOptions &options,
+                  AnalysisResult &result, ThreadPool *pool) {
+  ProfileZone zone(ProfilePhase::Patterns, data.size());
+  PatternSummary &summary = result.patterns;
+  summary.patterns.clear();
+  summary.recordStride = 0;
+  summary.strideVotes = 0;
+  summary.totalVotes = 0;
+  if (options.patternTopK == 0)
+    return;
+
+  // Each length writes its patterns to its own slice of one buffer, sized
+  // up front because the tasks run (and allocate) on other threads.
+  const size_t lengths = sizeof(PatternSummary::kLengths) / sizeof(size_t);
+  const size_t topK = options.patternTopK;
+  ArenaScope scope;
+  ScratchVector<RepeatedPattern> slices(lengths * topK, scope.resource());
+  size_t counts[lengths] = {};
+  auto runLength = [&](size_t l) {
+    counts[l] = kFindRepeats[l](data, topK, slices.data() + l * topK);
+  };
+  if (pool) {
+    pool->parallelFor(lengths, runLength);
+  } else {
+    for (size_t l = 0; l < lengths; ++l)
+      runLength(l);
+  }
+
+  // Every pattern votes for its period with the gaps that matched it; the
+  // lengths overlap (a record's 16-byte constant contains 4-byte ones), so
+  // the true stride collects votes from several of them.
+  ScratchVector<std::pair<size_t, size_t>> votes(scope.resource());
+  votes.reserve(lengths * topK);
+  for (size_t l = 0; l < lengths; ++l) {
+    for (size_t p = 0; p < counts[l]; ++p) {
+      const RepeatedPattern &pattern = slices[l * topK + p];
+      summary.totalVotes += pattern.count - 1;
+      if (pattern.periodCount)
+        votes.emplace_back(pattern.period, pattern.periodCount);
+      summary.patterns.push_back(pattern);
+    }
+  }
+  // Summed per period, smallest period first, so ties go to the shorter.
+  std::sort(votes.begin(), votes.end());
+  for (size_t i = 0; i < votes.size();) {
+    size_t period = votes[i].first;
+    size_t count = 0;
+    for (; i < votes.size() && votes[i].first == period; ++i)
+      count += votes[i].second;
+    if (count >= 2 && count > summary.strideVotes) {
+      summary.recordStride = period;
+      summary.strideVotes = count;
+    }
+  }
+}
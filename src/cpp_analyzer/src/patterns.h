@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+#include "analysis.h"
+#include "byte_view.h"
+
+class ThreadPool;
+
+// Counters in each n-gram length's frequency table. The table has twice as
+// many 24-byte slots, 192 KiB per length plus a rebuild buffer as large, so
+// it stays in L2 while the input streams past.
+const size_t kPatternCounters = size_t(1) << 12;
+
+// Helper: Find repeating patterns
+//
+// Finds the n-grams (4, 8, 12 and 16 bytes) that repeat most often and the
+// distance at which they repeat, and stores them in result.patterns. A file
+// of fixed-size records repeats its constant fields (type tags, padding,
+// flags) once per record, so the most common gap between occurrences is the
+// record stride.
+//
+// Runs in two linear passes per length. The first slides an n-gram window
+// over the input (a window is at most two words, loaded whole and hashed
+// with a multiply) and keeps a Misra-Gries summary in a fixed-size
+// open-addressing table: memory is bounded no matter the input size, and
+// any n-gram occurring more than once per kPatternCounters positions is
+// guaranteed to survive. Inputs over 16 MiB draw candidates from a sample of
+// evenly spaced blocks. The second pass recounts the best candidates exactly
+// over the whole input and collects their gaps and offset histograms; up to
+// options.patternTopK per length that repeat at least three times are kept.
+// Runs of a single byte value are skipped; the entropy map shows those.
+// The lengths run as independent tasks on `pool` when one is given.
+void findPatterns(ByteView data, const AnalysisOptions &options,
+                  AnalysisResult &result, ThreadPool *pool = nullptr);
@@ -0,0 +1,578 @@
+#include "prefetch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#include "profile.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PREFETCH_URING 1
+#endif
+
+// What both backends share: the path list, the budget, buffers for reuse
+// and the files waiting to be handed out. Every member is guarded by
+// mutex_.
+class Prefetcher::Engine {
+public:
+  Engine(const std::vector<std::string> &paths, size_t budget, size_t limit)
+      : paths_(paths), budget_(budget), limit_(limit) {}
+  virtual ~Engine() = default;
+
+  virtual bool next(PrefetchedFile &file) = 0;
+  virtual const char *name() const = 0;
+
+  void recycle(std::vector<uint8_t> &&buffer) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      held_ -= std::min(held_, buffer.size());
+      ++recycled_;
+      if (spare_.size() < kPrefetchDepth) {
+        buffer.clear();
+        spare_.push_back(std::move(buffer));
+      }
+    }
+    changed_.notify_all();
+  }
+
+protected:
+  // Bytes a file will take in memory.
+  size_t wanted(uint64_t size) const {
+    uint64_t n = limit_ ? std::min<uint64_t>(size, limit_) : size;
+    return static_cast<size_t>(n);
+  }
+
+  // Whether `bytes` more fit the budget. Call with mutex_ held.
+  bool fits(size_t bytes) const {
+    return held_ == 0 || bytes <= budget_ - std::min(budget_, held_);
+  }
+
+  // A buffer of `bytes`, a spare one if any is large enough. Call with
+  // mutex_ held; the bytes count against the budget until recycled.
+  std::vector<uint8_t> take(size_t bytes) {
+    held_ += bytes;
+    std::vector<uint8_t> buffer;
+    auto best = spare_.end();
+    for (auto it = spare_.begin(); it != spare_.end(); ++it)
+      if (best == spare_.end() || it->capacity() > best->capacity())
+        best = it;
+    if (best != spare_.end()) {
+      buffer = std::move(*best);
+      spare_.erase(best);
+    }
+    buffer.resize(bytes);
+    return buffer;
+  }
+
+  // A file read short of what was reserved for it gives the rest back.
+  // Call with mutex_ held.
+  void shrink(std::vector<uint8_t> &buffer, size_t bytes) {
+    held_ -= std::min(held_, buffer.size() - bytes);
+    buffer.resize(bytes);
+  }
+
+  const std::vector<std::string> &paths_;
+  const size_t budget_;
+  const size_t limit_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_; // A file is ready or bytes came back
+  size_t held_ = 0;                 // Bytes reserved and not recycled
+  size_t recycled_ = 0;             // Buffers given back so far
+  std::vector<std::vector<uint8_t>> spare_;
+  std::deque<PrefetchedFile> ready_;
+  size_t started_ = 0;   // Files taken from the list
+  size_t delivered_ = 0; // Files handed out
+};
+
+namespace {
+
+// What the latest Prefetcher read with, for lastPrefetchBackend.
+std::atomic<const char *> lastBackend{nullptr};
+
+// Helper: Read a whole stream
+//
+// Reads `in` until EOF or `limit` bytes (0 = no limit) into `out`, for
+// inputs whose size isn't known up front. Returns false on a read error.
+bool readStream(std::FILE *in, size_t limit, std::vector<uint8_t> &out) {
+  out.clear();
+  for (;;) {
+    size_t want = kPrefetchChunk;
+    if (limit)
+      want = std::min(want, limit - out.size());
+    if (want == 0)
+      return true;
+    size_t used = out.size();
+    out.resize(used + want);
+    size_t got = std::fread(out.data() + used, 1, want, in);
+    out.resize(used + got);
+    if (got < want)
+      return !std::ferror(in);
+  }
+}
+
+// The portable backend: reader threads that each take the next path,
+// wait for room in the budget, read the file and queue it.
+class ThreadEngine : public Prefetcher::Engine {
+public:
+  ThreadEngine(const std::vector<std::string> &paths, size_t budget,
+               size_t limit)
+      : Engine(paths, budget, limit) {
+    size_t readers = std::min(kPrefetchReaders, paths.size());
+    for (size_t i = 0; i < readers; ++i)
+      readers_.emplace_back([this] { readLoop(); });
+  }
+
+  ~ThreadEngine() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    for (std::thread &reader : readers_)
+      reader.join();
+  }
+
+  bool next(PrefetchedFile &file) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (delivered_ == paths_.size())
+      return false;
+    changed_.wait(lock, [&] { return !ready_.empty(); });
+    file = std::move(ready_.front());
+    ready_.pop_front();
+    ++delivered_;
+    changed_.notify_all(); // A reader may wait for the file count
+    return true;
+  }
+
+  const char *name() const override { return "threads"; }
+
+private:
+  void readLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_ && started_ < paths_.size()) {
+      size_t index = started_++;
+      lock.unlock();
+      PrefetchedFile file;
+      file.index = index;
+      std::error_code ec;
+      uint64_t size = std::filesystem::file_size(paths_[index], ec);
+      std::FILE *in = std::fopen(paths_[index].c_str(), "rb");
+      lock.lock();
+
+      size_t bytes = in && !ec ? wanted(size) : 0;
+      changed_.wait(lock, [&] {
+        return stopping_ ||
+               (fits(bytes) && started_ - delivered_ <= kPrefetchDepth);
+      });
+      if (stopping_) {
+        if (in)
+          std::fclose(in);
+        return;
+      }
+      file.data = take(bytes);
+      lock.unlock();
+
+      if (in) {
+        if (!ec && size > 0) {
+          size_t got = std::fread(file.data.data(), 1, bytes, in);
+          file.ok = !std::ferror(in);
+          file.size = got < bytes ? got : size;
+          lock.lock();
+          shrink(file.data, got);
+          lock.unlock();
+        } else {
+          // No size to trust (pipes, procfs): read to EOF, and charge the
+          // budget once the bytes are in.
+          file.ok = readStream(in, limit_, file.data);
+          file.size = file.data.size();
+          lock.lock();
+          held_ += file.data.size();
+          lock.unlock();
+        }
+        std::fclose(in);
+      }
+      lock.lock();
+      ready_.push_back(std::move(file));
+      changed_.notify_all();
+    }
+  }
+
+  std::vector<std::thread> readers_;
+  bool stopping_ = false;
+};
+
+#if defined(PREFETCH_URING)
+
+// The io_uring backend, without liburing: the rings are mapped by hand and
+// driven from next(). Each completion's user_data is the file's slot in
+// the upper 16 bits and the offset of the read in the rest.
+class UringEngine : public Prefetcher::Engine {
+public:
+  UringEngine(const std::vector<std::string> &paths, size_t budget,
+              size_t limit)
+      : Engine(paths, budget, limit), slots_(kPrefetchDepth) {}
+
+  ~UringEngine() override {
+    // Reads still in flight write into the slots' buffers; let them land.
+    while (inFlight_ > 0 && enter(pendingSubmit_, 1)) {
+      pendingSubmit_ = 0;
+      reap();
+    }
+    for (Slot &slot : slots_)
+      if (slot.fd >= 0)
+        ::close(slot.fd);
+    if (sqes_)
+      munmap(sqes_, sqesSize_);
+    if (cqMap_ && cqMap_ != sqMap_)
+      munmap(cqMap_, cqMapSize_);
+    if (sqMap_)
+      munmap(sqMap_, sqMapSize_);
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  // Sets up the rings. False if the kernel refuses (no io_uring, or one
+  // without IORING_OP_READ).
+  bool start() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof params);
+    fd_ = static_cast<int>(
+        syscall(__NR_io_uring_setup, unsigned(kRingEntries), &params));
+    if (fd_ < 0 || !(params.features & IORING_FEAT_NODROP))
+      return false;
+    sqMapSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqMapSize_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+      sqMapSize_ = cqMapSize_ = std::max(sqMapSize_, cqMapSize_);
+    sqMap_ = mapRing(sqMapSize_, IORING_OFF_SQ_RING);
+    if (!sqMap_)
+      return false;
+    cqMap_ = params.features & IORING_FEAT_SINGLE_MMAP
+                 ? sqMap_
+                 : mapRing(cqMapSize_, IORING_OFF_CQ_RING);
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(mapRing(sqesSize_, IORING_OFF_SQES));
+    if (!cqMap_ || !sqes_)
+      return false;
+
+    char *sq = static_cast<char *>(sqMap_);
+    char *cq = static_cast<char *>(cqMap_);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // Probe for IORING_OP_READ (5.6); older kernels get the threads.
+    io_uring_probe *probe = static_cast<io_uring_probe *>(std::calloc(
+        1, sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op)));
+    bool readable =
+        probe &&
+        syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe,
+                256) == 0 &&
+        probe->last_op >= IORING_OP_READ &&
+        (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    std::free(probe);
+    return readable;
+  }
+
+  bool next(PrefetchedFile &file) override {
+    for (;;) {
+      size_t recycled;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ready_.empty()) {
+          file = std::move(ready_.front());
+          ready_.pop_front();
+          ++delivered_;
+          return true;
+        }
+        if (delivered_ == paths_.size())
+          return false;
+        recycled = recycled_;
+      }
+      startFiles();
+      submitReads();
+      if (inFlight_ > 0) {
+        if (!enter(pendingSubmit_, 1))
+          failAll();
+        pendingSubmit_ = 0;
+        reap();
+        continue;
+      }
+      // Nothing in flight and nothing ready: the budget is held by files
+      // handed out. Wait for one to come back.
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (ready_.empty())
+        changed_.wait(lock, [&] { return recycled_ != recycled; });
+    }
+  }
+
+  const char *name() const override { return "io_uring"; }
+
+private:
+  static const size_t kRingEntries = 64;
+
+  struct Slot {
+    bool active = false;
+    int fd = -1;
+    PrefetchedFile file;
+    size_t toRead = 0;    // Bytes to read into file.data
+    size_t submitted = 0; // Bytes of reads queued so far
+    size_t reads = 0;     // Reads in flight
+    size_t length = 0;    // Bytes before the end of file, if it shrank
+    bool error = false;
+  };
+
+  void *mapRing(size_t size, off_t offset) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+
+  // Opens files while there are free slots and budget. Files that can't
+  // be read in chunks (empty, pipes, procfs) are read here and queued.
+  void startFiles() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (started_ < paths_.size() && active_ < slots_.size()) {
+      const std::string &path = paths_[started_];
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat st;
+      bool regular = fd >= 0 && fstat(fd, &st) == 0 &&
+                     S_ISREG(st.st_mode) && st.st_size > 0;
+      size_t bytes = regular ? wanted(static_cast<uint64_t>(st.st_size)) : 0;
+      if (!fits(bytes)) {
+        if (fd >= 0)
+          ::close(fd);
+        return; // Opened again once bytes are recycled
+      }
+      PrefetchedFile file;
+      file.index = started_++;
+      if (fd < 0) {
+        ready_.push_back(std::move(file));
+        continue;
+      }
+      if (!regular) {
+        file.data = take(0);
+        lock.unlock();
+        std::FILE *in = fdopen(fd, "rb");
+        file.ok = in && readStream(in, limit_, file.data);
+        file.size = file.data.size();
+        if (in)
+          std::fclose(in);
+        else
+          ::close(fd);
+        lock.lock();
+        held_ += file.data.size();
+        ready_.push_back(std::move(file));
+        continue;
+      }
+      file.size = static_cast<uint64_t>(st.st_size);
+      file.data = take(bytes);
+      Slot *slot = &*std::find_if(slots_.begin(), slots_.end(),
+                                  [](const Slot &s) { return !s.active; });
+      slot->active = true;
+      slot->fd = fd;
+      slot->file = std::move(file);
+      slot->toRead = bytes;
+      slot->submitted = 0;
+      slot->reads = 0;
+      slot->length = bytes;
+      slot->error = false;
+      ++active_;
+    }
+  }
+
+  // Queues reads for the active slots, oldest file first, while the
+  // submission ring has room.
+  void submitReads() {
+    for (bool queued = true; queued;) {
+      queued = false;
+      for (size_t s = 0; s < slots_.size(); ++s) {
+        Slot &slot = slots_[s];
+        if (!slot.active || slot.submitted == slot.toRead ||
+            inFlight_ == sqEntries_)
+          continue;
+        size_t length =
+            std::min(kPrefetchChunk, slot.toRead - slot.submitted);
+        queueRead(s, slot.submitted, length);
+        slot.submitted += length;
+        queued = true;
+      }
+    }
+  }
+
+  void queueRead(size_t s, size_t offset, size_t length) {
+    Slot &slot = slots_[s];
+    unsigned tail = *sqTail_;
+    unsigned index = tail & sqMask_;
+    io_uring_sqe &sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof sqe);
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = slot.fd;
+    sqe.addr = reinterpret_cast<uint64_t>(slot.file.data.data() + offset);
+    sqe.len = static_cast<uint32_t>(length);
+    sqe.off = offset;
+    sqe.user_data = uint64_t(s) << 48 | offset;
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    ++slot.reads;
+    ++inFlight_;
+    ++pendingSubmit_;
+  }
+
+  // io_uring_enter: submits `submit` entries and waits for `wait`
+  // completions. False on an error other than EINTR.
+  bool enter(size_t submit, size_t wait) {
+    for (;;) {
+      long rc = syscall(__NR_io_uring_enter, fd_, unsigned(submit),
+                        unsigned(wait), wait ? IORING_ENTER_GETEVENTS : 0u,
+                        nullptr, 0);
+      if (rc >= 0)
+        return true;
+      if (errno != EINTR)
+        return false;
+      submit = 0; // The kernel consumed them before the signal
+    }
+  }
+
+  void reap() {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe &cqe = cqes_[head & cqMask_];
+      size_t s = static_cast<size_t>(cqe.user_data >> 48);
+      size_t offset = static_cast<size_t>(cqe.user_data & 0xffffffffffffull);
+      complete(s, offset, cqe.res);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  }
+
+  // Handles one finished read. A short read is continued from where it
+  // stopped; reading 0 bytes means the file shrank, and it ends there.
+  void complete(size_t s, size_t offset, int result) {
+    Slot &slot = slots_[s];
+    --slot.reads;
+    --inFlight_;
+    size_t end = std::min(slot.toRead,
+                          (offset / kPrefetchChunk + 1) * kPrefetchChunk);
+    if (result == -EINTR || result == -EAGAIN) {
+      queueRead(s, offset, end - offset);
+    } else if (result < 0) {
+      slot.error = true;
+      slot.submitted = slot.toRead; // Queue nothing more
+    } else if (result == 0) {
+      slot.length = std::min(slot.length, offset);
+    } else if (offset + size_t(result) < end) {
+      queueRead(s, offset + size_t(result), end - offset - size_t(result));
+    }
+    if (slot.reads == 0 && slot.submitted == slot.toRead)
+      finish(slot);
+  }
+
+  void finish(Slot &slot) {
+    ::close(slot.fd);
+    slot.fd = -1;
+    slot.active = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    --active_;
+    slot.file.ok = !slot.error;
+    if (slot.length < slot.toRead) {
+      shrink(slot.file.data, slot.length);
+      slot.file.size = slot.length;
+    }
+    ready_.push_back(std::move(slot.file));
+    slot.file = PrefetchedFile();
+  }
+
+  // The ring itself failed: report every file in flight as unreadable.
+  void failAll() {
+    for (Slot &slot : slots_) {
+      if (!slot.active)
+        continue;
+      inFlight_ -= slot.reads;
+      slot.reads = 0;
+      slot.error = true;
+      finish(slot);
+    }
+  }
+
+  int fd_ = -1;
+  void *sqMap_ = nullptr;
+  void *cqMap_ = nullptr;
+  size_t sqMapSize_ = 0;
+  size_t cqMapSize_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqesSize_ = 0;
+  unsigned *sqTail_ = nullptr;
+  unsigned *sqArray_ = nullptr;
+  unsigned sqMask_ = 0;
+  size_t sqEntries_ = 0;
+  unsigned *cqHead_ = nullptr;
+  unsigned *cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+
+  std::vector<Slot> slots_;
+  size_t active_ = 0;        // Slots in use; guarded by mutex_
+  size_t inFlight_ = 0;      // Reads queued and not completed
+  size_t pendingSubmit_ = 0; // Reads queued since the last enter
+};
+
+#endif
+
+} // namespace
+
+Prefetcher::Prefetcher(const std::vector<std::string> &paths, size_t budget,
+                       size_t limit) {
+#if defined(PREFETCH_URING)
+  const char *forced = std::getenv("ANALYZER_PREFETCH");
+  if (!forced || std::strcmp(forced, "threads") != 0) {
+    auto uring = std::make_unique<UringEngine>(paths, budget, limit);
+    if (uring->start())
+      engine_ = std::move(uring);
+  }
+#endif
+  if (!engine_)
+    engine_ = std::make_unique<ThreadEngine>(paths, budget, limit);
+  lastBackend.store(backend(), std::memory_order_relaxed);
+}
+
+Prefetcher::~Prefetcher() = default;
+
+bool Prefetcher::next(PrefetchedFile &file) {
+  ProfileZone zone(ProfilePhase::Load);
+  if (!engine_->next(file))
+    return false;
+  zone.addBytes(file.data.size());
+  return true;
+}
+
+void Prefetcher::recycle(std::vector<uint8_t> &&buffer) {
+  engine_->recycle(std::move(buffer));
+}
+
+const char *Prefetcher::backend() const { return engine_->name(); }
+
+const char *lastPrefetchBackend() {
+  return lastBackend.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Bytes a prefetcher may hold by default: read ahead or handed out and not
+// yet recycled.
+const size_t kDefaultPrefetchBytes = size_t(256) << 20;
+// Files read at once, and the size of one read request. A large file has
+// several requests in flight, so one file alone still keeps a queue.
+const size_t kPrefetchDepth = 32;
+const size_t kPrefetchChunk = size_t(1) << 20;
+// Blocking reader threads of the portable fallback.
+const size_t kPrefetchReaders = 4;
+
+// A file read ahead of its analysis.
+struct PrefetchedFile {
+  size_t index = 0;          // Position in the path list
+  bool ok = false;           // False if it couldn't be opened or read
+  uint64_t size = 0;         // Size of the file
+  std::vector<uint8_t> data; // Its first `limit` bytes; all for limit 0
+};
+
+// Helper: Read-ahead pipeline
+//
+// Reads a list of files into memory ahead of the code that analyzes them,
+// so the disk stays busy while the cores compute. At most kPrefetchDepth
+// files are read at once, and the bytes read ahead plus the ones handed out
+// and not yet recycled stay within `budget` (a file larger than the whole
+// budget is read alone). Files start in list order and are handed out as
+// they complete.
+//
+// On Linux the reads go to an io_uring, driven from the thread that calls
+// next(): it queues kPrefetchChunk reads for every file in flight, and the
+// kernel works through them while the caller is busy elsewhere. Elsewhere,
+// or where io_uring is unavailable (old kernels, seccomp), kPrefetchReaders
+// threads read with blocking calls instead. ANALYZER_PREFETCH=threads in
+// the environment forces the threads.
+class Prefetcher {
+public:
+  // `limit` caps the bytes read from each file (0 = the whole file).
+  Prefetcher(const std::vector<std::string> &paths, size_t budget,
+             size_t limit = 0);
+  ~Prefetcher();
+
+  Prefetcher(const Prefetcher &) = delete;
+  Prefetcher &operator=(const Prefetcher &) = delete;
+
+  // Waits for the next file to finish. Returns false once every file has
+  // been handed out. Call from one thread at a time.
+  bool next(PrefetchedFile &file);
+
+  // Gives a handed-out buffer back: its bytes leave the budget and its
+  // storage is reused for a later file. Safe from any thread.
+  void recycle(std::vector<uint8_t> &&buffer);
+
+  // "io_uring" or "threads"
+  const char *backend() const;
+
+  class Engine;
+
+private:
+  std::unique_ptr<Engine> engine_;
+};
+
+// The backend of the latest Prefetcher made in this process, null if none
+// was: --profile reports it, so a silent fall back to threads shows.
+const char *lastPrefetchBackend();
@@ -0,0 +1,239 @@
+#include "profile.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace profile_detail {
+bool enabled = false;
+} // namespace profile_detail
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char *const kPhaseNames[] = {
+    "load",     "entropy", "pyramid", "alignment", "regions",
+    "patterns", "periods", "diff",    "corpus",    "signature",
+    "output"};
+const size_t kPhases = static_cast<size_t>(ProfilePhase::Count);
+
+struct PhaseStats {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> nanoseconds{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> allocatedBytes{0};
+};
+
+struct TraceEvent {
+  ProfilePhase phase;
+  int64_t begin; // Nanoseconds since enableProfiling
+  int64_t duration;
+  uint64_t bytes;
+};
+
+// One per thread that has recorded an event; kept until exit so the trace
+// can be written after the threads are gone. A thread's index is its tid.
+struct TraceBuffer {
+  size_t thread;
+  std::vector<TraceEvent> events;
+};
+
+PhaseStats stats[kPhases];
+bool tracing = false;
+Clock::time_point startTime;
+
+std::mutex traceMutex;
+std::vector<std::unique_ptr<TraceBuffer>> traceBuffers;
+
+// Helper: Peak resident set
+//
+// The process' largest resident set so far, in bytes; 0 if unknown. On
+// Linux this is VmHWM, since ru_maxrss also counts the parent's resident
+// set at the fork that started the process (a Python harness' tens of
+// MiB). Elsewhere ru_maxrss, in bytes on macOS, or the peak working set.
+uint64_t peakResidentBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters))
+    return counters.PeakWorkingSetSize;
+  return 0;
+#else
+#ifdef __linux__
+  if (FILE *status = std::fopen("/proc/self/status", "r")) {
+    char line[128];
+    unsigned long long kib = 0;
+    bool found = false;
+    while (!found && std::fgets(line, sizeof line, status))
+      found = std::sscanf(line, "VmHWM: %llu kB", &kib) == 1;
+    std::fclose(status);
+    if (found)
+      return kib << 10;
+  }
+#endif
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) << 10;
+#endif
+#endif
+}
+
+TraceBuffer &threadTraceBuffer() {
+  thread_local TraceBuffer *buffer = nullptr;
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceBuffers.push_back(std::make_unique<TraceBuffer>());
+    buffer = traceBuffers.back().get();
+    buffer->thread = traceBuffers.size();
+  }
+  return *buffer;
+}
+
+int64_t sinceStart(Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time -
+                                                              startTime)
+      .count();
+}
+
+#ifdef ANALYZER_TRACY
+const ___tracy_source_location_data kTracyLocations[] = {
+    {"load", "analyzeFile", __FILE__, 0, 0},
+    {"entropy", "analyzeData", __FILE__, 0, 0},
+    {"pyramid", "analyzeData", __FILE__, 0, 0},
+    {"alignment", "analyzeData", __FILE__, 0, 0},
+    {"regions", "analyzeData", __FILE__, 0, 0},
+    {"patterns", "findPatterns", __FILE__, 0, 0},
+    {"periods", "findPeriods", __FILE__, 0, 0},
+    {"diff", "diffBytes", __FILE__, 0, 0},
+    {"corpus", "analyzeCorpus", __FILE__, 0, 0},
+    {"signature", "computeSignature", __FILE__, 0, 0},
+    {"output", "writeAnalysis", __FILE__, 0, 0},
+};
+#endif
+
+} // namespace
+
+AllocationCounter &threadAllocations() {
+  thread_local AllocationCounter counter;
+  return counter;
+}
+
+void enableProfiling(bool trace) {
+  tracing = trace;
+  startTime = Clock::now();
+  profile_detail::enabled = true;
+}
+
+void ProfileZone::begin() {
+  active_ = true;
+  allocations_ = threadAllocations();
+  start_ = Clock::now();
+}
+
+void ProfileZone::end() {
+  Clock::time_point stop = Clock::now();
+  const AllocationCounter &now = threadAllocations();
+  auto nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start_)
+          .count();
+  PhaseStats &phase = stats[static_cast<size_t>(phase_)];
+  phase.calls.fetch_add(1, std::memory_order_relaxed);
+  phase.nanoseconds.fetch_add(static_cast<uint64_t>(nanoseconds),
+                              std::memory_order_relaxed);
+  phase.bytes.fetch_add(bytes_, std::memory_order_relaxed);
+  phase.allocations.fetch_add(now.count - allocations_.count,
+                              std::memory_order_relaxed);
+  phase.allocatedBytes.fetch_add(now.bytes - allocations_.bytes,
+                                 std::memory_order_relaxed);
+  // After the counters are read, so a growing trace isn't charged to the
+  // phase
+  if (tracing)
+    threadTraceBuffer().events.push_back(
+        {phase_, sinceStart(start_), nanoseconds, bytes_});
+}
+
+#ifdef ANALYZER_TRACY
+TracyCZoneCtx ProfileZone::beginTracyZone(ProfilePhase phase) {
+  return ___tracy_emit_zone_begin(&kTracyLocations[static_cast<size_t>(phase)],
+                                  1);
+}
+#endif
+
+void writeProfileReport(std::ostream &out) {
+  double wall = sinceStart(Clock::now()) / 1e6;
+  char line[160];
+  std::snprintf(line, sizeof line, "Profile: %.3f ms wall, %.1f MiB peak RSS\n",
+                wall, peakResidentBytes() / 1048576.0);
+  out << line;
+  std::snprintf(line, sizeof line, "%-10s %8s %12s %14s %10s %9s %12s\n",
+                "phase", "calls", "time ms", "bytes", "MB/s", "allocs",
+                "alloc bytes");
+  out << line;
+  for (size_t i = 0; i < kPhases; ++i) {
+    const PhaseStats &phase = stats[i];
+    uint64_t calls = phase.calls.load();
+    if (calls == 0)
+      continue;
+    double ms = phase.nanoseconds.load() / 1e6;
+    uint64_t bytes = phase.bytes.load();
+    double throughput = ms > 0 ? bytes / (ms * 1e3) : 0;
+    std::snprintf(line, sizeof line,
+                  "%-10s %8" PRIu64 " %12.3f %14" PRIu64 " %10.1f %9" PRIu64
+                  " %12" PRIu64 "\n",
+                  kPhaseNames[i], calls, ms, bytes, throughput,
+                  phase.allocations.load(), phase.allocatedBytes.load());
+    out << line;
+  }
+  out.flush();
+}
+
+bool writeProfileTrace(const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    std::cerr << "Failed to write profile trace: " << path << std::endl;
+    return false;
+  }
+  // Timestamps and durations are in microseconds
+  std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+  const char *separator = "\n";
+  std::lock_guard<std::mutex> lock(traceMutex);
+  for (const auto &buffer : traceBuffers) {
+    std::fprintf(file,
+                 "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%zu,\"args\":{\"name\":\"thread %zu\"}}",
+                 separator, buffer->thread, buffer->thread);
+    separator = ",\n";
+    for (const TraceEvent &event : buffer->events)
+      std::fprintf(file,
+                   ",\n{\"name\":\"%s\",\"cat\":\"analyzer\",\"ph\":\"X\","
+                   "\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,"
+                   "\"args\":{\"bytes\":%" PRIu64 "}}",
+                   kPhaseNames[static_cast<size_t>(event.phase)],
+                   buffer->thread, event.begin / 1e3, event.duration / 1e3,
+                   event.bytes);
+  }
+  std::fputs("\n]}\n", file);
+  bool ok = std::fclose(file) == 0;
+  if (!ok)
+    std::cerr << "Failed to write profile trace: " << path << std::endl;
+  return ok;
+}
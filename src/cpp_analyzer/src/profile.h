@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#ifdef ANALYZER_TRACY
+#include <tracy/TracyC.h>
+#endif
+
+// Helper: Profiling
+//
+// Per-phase counters for --profile: how often each phase ran, the time it
+// took, the bytes it processed and the allocations it made. Phases are
+// marked with a ProfileZone where the work happens, so every mode that runs
+// them is covered. Time is summed over threads: in a parallel run the
+// entropy and alignment rows add up every tile on every worker, and their
+// throughput is per thread. The run's wall time and peak resident set are
+// reported separately.
+//
+// With --profile-trace, every zone is also recorded as a Chrome trace event
+// (chrome://tracing, Perfetto). Built with ANALYZER_TRACY, zones are sent
+// to Tracy on every run, profiled or not.
+//
+// Disabled (the default), a zone costs one load and branch.
+
+enum class ProfilePhase {
+  Load,      // Opening and mapping an input
+  Entropy,   // Entropy map, per tile
+  Pyramid,   // Entropy pyramid blocks, per tile
+  Alignment, // checkAlignment counts, per tile
+  Regions,   // Region cells per tile, then the segmentation
+  Patterns,  // Repeated n-grams
+  Periods,   // Autocorrelation
+  Diff,      // Byte diff, field analysis and size equations
+  Corpus,    // Cross-file statistics, per (tile, block) of inputs
+  Signature, // Structural signatures and index lookups
+  Output,    // Rendering and writing reports
+  Count
+};
+
+// Operator-new calls made by the calling thread. The CLI replaces the
+// global operator new to count them; elsewhere they stay zero.
+struct AllocationCounter {
+  size_t count = 0;
+  size_t bytes = 0;
+};
+
+AllocationCounter &threadAllocations();
+
+namespace profile_detail {
+extern bool enabled;
+} // namespace profile_detail
+
+// Starts collecting (and with `trace`, recording events). Call before any
+// zone runs.
+void enableProfiling(bool trace);
+
+inline bool profilingEnabled() { return profile_detail::enabled; }
+
+// The per-phase table, the wall time since enableProfiling and the peak
+// resident set.
+void writeProfileReport(std::ostream &out);
+
+// Writes the recorded zones as Chrome trace-event JSON. Returns false (with
+// a message) if `path` can't be written.
+bool writeProfileTrace(const std::string &path);
+
+// Times the enclosing scope as one run of `phase`.
+class ProfileZone {
+public:
+  explicit ProfileZone(ProfilePhase phase, uint64_t bytes = 0)
+      : phase_(phase), bytes_(bytes) {
+#ifdef ANALYZER_TRACY
+    tracy_ = beginTracyZone(phase);
+#endif
+    if (profilingEnabled())
+      begin();
+  }
+
+  ~ProfileZone() {
+    if (active_)
+      end();
+#ifdef ANALYZER_TRACY
+    ___tracy_emit_zone_end(tracy_);
+#endif
+  }
+
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+  // For phases whose size is only known once they're done.
+  void addBytes(uint64_t bytes) { bytes_ += bytes; }
+
+private:
+  void begin();
+  void end();
+#ifdef ANALYZER_TRACY
+  static TracyCZoneCtx beginTracyZone(ProfilePhase phase);
+  TracyCZoneCtx tracy_;
+#endif
+
+  ProfilePhase phase_;
+  bool active_ = false;
+  uint64_t bytes_;
+  std::chrono::steady_clock::time_point start_;
+  AllocationCounter allocations_; // Thread's counter at begin()
+};
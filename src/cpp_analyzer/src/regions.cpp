@@ -0,0 +1,630 @@
+#include "regions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define REGIONS_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define REGIONS_SSE2 1
+#endif
+
+#include "alignment.h"
+#include "arena.h"
+#include "entropy.h"
+#include "profile.h"
+
+namespace {
+
+const size_t kUnit = 64;
+const int kFeatures = 9;
+
+// Least noise level assumed for a feature (all are in [0, 1]), and the
+// penalty per region in units of the noise: a boundary is worth placing
+// when the squared shift in the feature means, times the cells it holds
+// for, pays for a region.
+const double kMinNoise = 0.05;
+const double kPenaltyPerLogCell = 12.0;
+// Neighbours whose features all differ by less than this are one region:
+// over a long run, even a shift this small beats the penalty.
+const double kMinShift = 0.1;
+// Neighbours of the same kind whose entropy differs by less than this many
+// bits are one region too, as a field of records drifting through values
+// moves some feature without changing what the data is.
+const float kMinEntropyShift = 0.5f;
+// Candidates PELT keeps per step; the best ones survive the cap.
+const size_t kMaxCandidates = 64;
+
+// Regions that are named from their content rather than their entropy
+const double kKindShare = 0.7;
+// Every float array passes the narrower widths' tests too, at rates set by
+// its random mantissa bits: float64 reads as ~5/8 float32, and float32 as
+// ~3/4 half. Float64 wins when float32 falls short of it by this much.
+// Half arrays read as float32 about as well as float32 arrays do, so half
+// needs a share float32 doesn't reach.
+const double kNarrowerGap = 0.15;
+const double kHalfShare = 0.9;
+// A first region up to this size, with others after it, is the header.
+const uint64_t kMaxHeaderSize = 4096;
+
+size_t ceilDiv(size_t a, size_t b) { return (a + b - 1) / b; }
+
+// Per-byte class masks of a 64-byte unit: bit i describes byte i.
+struct ClassMasks {
+  uint64_t zero;
+  uint64_t text; // Printable ASCII, tab, LF and CR
+};
+
+#if defined(REGIONS_AVX2) || defined(REGIONS_SSE2)
+
+#if defined(REGIONS_AVX2)
+using Vec = __m256i;
+const int kVecBytes = 32;
+inline Vec loadVec(const uint8_t *p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+inline Vec splat(uint8_t v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+inline Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+inline Vec gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+inline Vec both(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+inline Vec either(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+inline uint64_t mask(Vec x) {
+  return static_cast<uint32_t>(_mm256_movemask_epi8(x));
+}
+#else
+using Vec = __m128i;
+const int kVecBytes = 16;
+inline Vec loadVec(const uint8_t *p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+inline Vec splat(uint8_t v) { return _mm_set1_epi8(static_cast<char>(v)); }
+inline Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+inline Vec gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+inline Vec both(Vec a, Vec b) { return _mm_and_si128(a, b); }
+inline Vec either(Vec a, Vec b) { return _mm_or_si128(a, b); }
+inline uint64_t mask(Vec x) {
+  return static_cast<uint32_t>(_mm_movemask_epi8(x));
+}
+#endif
+
+// Compares are signed: bytes from 0x80 are negative, so x > 0x1F and
+// x < 0x7F together are the printable range.
+ClassMasks classMasks(const uint8_t *p) {
+  const Vec zero = splat(0), low7 = splat(0x7F), space = splat(0x1F);
+  const Vec tab = splat('\t'), lf = splat('\n'), cr = splat('\r');
+  ClassMasks m = {};
+  for (int i = 0; i < 64; i += kVecBytes) {
+    Vec x = loadVec(p + i);
+    Vec text = either(both(gt(x, space), gt(low7, x)),
+                      either(eq(x, tab), either(eq(x, lf), eq(x, cr))));
+    m.zero |= mask(eq(x, zero)) << i;
+    m.text |= mask(text) << i;
+  }
+  return m;
+}
+
+#else
+
+// Eight bytes at once (SWAR): each test sets the top bit of every byte of
+// `x` that passes.
+const uint64_t kBytesOne = 0x0101010101010101ull;
+const uint64_t kBytesLow7 = 0x7F7F7F7F7F7F7F7Full;
+const uint64_t kBytesHigh = 0x8080808080808080ull;
+
+uint64_t zeroBytes(uint64_t x) {
+  return ~(((x & kBytesLow7) + kBytesLow7) | x) & kBytesHigh;
+}
+
+uint64_t bytesEqual(uint64_t x, uint8_t c) {
+  return zeroBytes(x ^ (kBytesOne * c));
+}
+
+// Of bytes below 0x80, those >= c (c <= 0x80): adding 0x80 - c carries
+// into the top bit exactly then, and never into the next byte.
+uint64_t bytesAtLeast(uint64_t low7, uint8_t c) {
+  return (low7 + kBytesOne * uint8_t(0x80 - c)) & kBytesHigh;
+}
+
+// The top bits of the bytes, in memory order, as bits 0..7.
+uint64_t gatherTopBits(uint64_t bits) {
+  uint8_t bytes[8];
+  std::memcpy(bytes, &bits, sizeof bytes);
+  uint64_t m = 0;
+  for (int k = 0; k < 8; ++k)
+    m |= uint64_t(bytes[k] >> 7) << k;
+  return m;
+}
+
+ClassMasks classMasks(const uint8_t *p) {
+  ClassMasks m = {};
+  for (int i = 0; i < 64; i += 8) {
+    uint64_t x;
+    std::memcpy(&x, p + i, sizeof x);
+    uint64_t low7 = x & kBytesLow7;
+    uint64_t printable =
+        bytesAtLeast(low7, 0x20) & ~bytesAtLeast(low7, 0x7F) & ~x;
+    uint64_t text = printable | bytesEqual(x, '\t') | bytesEqual(x, '\n') |
+                    bytesEqual(x, '\r');
+    m.zero |= gatherTopBits(zeroBytes(x)) << i;
+    m.text |= gatherTopBits(text & kBytesHigh) << i;
+  }
+  return m;
+}
+
+#endif
+
+// Adds the zero and text bytes of one 64-byte unit.
+void countUnitClasses(const uint8_t *unit, RegionCell &cell) {
+  ClassMasks m = classMasks(unit);
+  cell.zero += popcount64(m.zero);
+  cell.text += popcount64(m.text);
+}
+
+void addCell(RegionCell &into, const RegionCell &cell) {
+  into.units += cell.units;
+  into.bytes += cell.bytes;
+  into.entropy += cell.entropy;
+  into.zero += cell.zero;
+  into.text += cell.text;
+  for (int w = 0; w < 3; ++w) {
+    into.small[w] += cell.small[w];
+    into.floats[w] += cell.floats[w];
+  }
+}
+
+// The cell's point in feature space, every coordinate in [0, 1].
+void cellFeatures(const RegionCell &cell, double *features) {
+  double units = std::max<uint32_t>(cell.units, 1);
+  double bytes = std::max<uint32_t>(cell.bytes, 1);
+  features[0] = cell.entropy / units / 6.0; // 64 bytes hold <= 6 bits
+  features[1] = cell.zero / bytes;
+  features[2] = cell.text / bytes;
+  for (int w = 0; w < 3; ++w) {
+    double width = AlignmentCounts::kWidths[w];
+    features[3 + w] = cell.small[w] * width / bytes;
+    features[6 + w] = cell.floats[w] * width / bytes;
+  }
+}
+
+// Feature index of each ElementType
+const int kTypeFeature[kElementTypes] = {3, 4, 5, 6, 7, 8};
+
+// Largest difference of any feature.
+double featureShift(const double *a, const double *b) {
+  double shift = 0;
+  for (int f = 0; f < kFeatures; ++f)
+    shift = std::max(shift, std::fabs(a[f] - b[f]));
+  return shift;
+}
+
+double squaredDistance(const double *a, const double *b) {
+  double sum = 0;
+  for (int f = 0; f < kFeatures; ++f)
+    sum += (a[f] - b[f]) * (a[f] - b[f]);
+  return sum;
+}
+
+// Change points over `cells`, as cell indices in (0, count): PELT with an
+// L2 cost, from prefix sums of every feature and of its square.
+void segmentCells(const RegionCell *cells, size_t count,
+                  ScratchVector<size_t> &bounds, ArenaScope &scope) {
+  ScratchVector<double> sums((count + 1) * kFeatures, 0.0,
+                             scope.resource());
+  ScratchVector<double> squares((count + 1) * kFeatures, 0.0,
+                                scope.resource());
+  for (size_t i = 0; i < count; ++i) {
+    double features[kFeatures];
+    cellFeatures(cells[i], features);
+    for (int f = 0; f < kFeatures; ++f) {
+      size_t at = i * kFeatures + f;
+      sums[at + kFeatures] = sums[at] + features[f];
+      squares[at + kFeatures] = squares[at] + features[f] * features[f];
+    }
+  }
+
+  // Noise of each feature from the differences of neighbouring cells,
+  // which change points barely move: the median squared difference is
+  // 0.455 * 2 sigma^2 for Gaussian noise.
+  double scale[kFeatures];
+  {
+    ScratchVector<double> differences(count > 1 ? count - 1 : 0, 0.0,
+                                      scope.resource());
+    for (int f = 0; f < kFeatures; ++f) {
+      double variance = kMinNoise * kMinNoise;
+      if (!differences.empty()) {
+        for (size_t i = 0; i + 1 < count; ++i) {
+          double d = (sums[(i + 2) * kFeatures + f] -
+                      sums[(i + 1) * kFeatures + f]) -
+                     (sums[(i + 1) * kFeatures + f] - sums[i * kFeatures + f]);
+          differences[i] = d * d;
+        }
+        auto middle = differences.begin() + differences.size() / 2;
+        std::nth_element(differences.begin(), middle, differences.end());
+        variance = std::max(variance, *middle / (2 * 0.455));
+      }
+      scale[f] = 1.0 / variance;
+    }
+  }
+
+  // Squared error of cells [s, t) around their mean, in noise units
+  auto cost = [&](size_t s, size_t t) {
+    double length = double(t - s);
+    double error = 0;
+    for (int f = 0; f < kFeatures; ++f) {
+      double sum = sums[t * kFeatures + f] - sums[s * kFeatures + f];
+      double square = squares[t * kFeatures + f] - squares[s * kFeatures + f];
+      error += std::max(square - sum * sum / length, 0.0) * scale[f];
+    }
+    return error;
+  };
+  const double penalty = kPenaltyPerLogCell * std::log(double(count) + 1);
+
+  ScratchVector<double> best(count + 1, 0.0, scope.resource());
+  ScratchVector<size_t> last(count + 1, 0, scope.resource());
+  ScratchVector<size_t> candidates(scope.resource());
+  ScratchVector<double> totals(scope.resource());
+  candidates.reserve(kMaxCandidates + 1);
+  totals.reserve(kMaxCandidates + 1);
+  best[0] = -penalty;
+  candidates.push_back(0);
+  for (size_t t = 1; t <= count; ++t) {
+    totals.clear();
+    double minimum = INFINITY;
+    size_t argmin = 0;
+    for (size_t s : candidates) {
+      double total = best[s] + cost(s, t);
+      totals.push_back(total);
+      if (total < minimum) {
+        minimum = total;
+        argmin = s;
+      }
+    }
+    best[t] = minimum + penalty;
+    last[t] = argmin;
+
+    // Prune: a start that costs more than the optimum now never wins later
+    size_t kept = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (totals[i] <= best[t]) {
+        candidates[kept] = candidates[i];
+        totals[kept++] = totals[i];
+      }
+    }
+    candidates.resize(kept);
+    totals.resize(kept);
+    if (candidates.size() >= kMaxCandidates) {
+      // Keep the cheapest, in any order
+      ScratchVector<size_t> order(candidates.size(), 0, scope.resource());
+      for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+      std::nth_element(order.begin(), order.begin() + kMaxCandidates / 2,
+                       order.end(), [&](size_t a, size_t b) {
+                         return totals[a] < totals[b];
+                       });
+      for (size_t i = 0; i < kMaxCandidates / 2; ++i)
+        order[i] = candidates[order[i]];
+      candidates.assign(order.begin(), order.begin() + kMaxCandidates / 2);
+    }
+    candidates.push_back(t);
+  }
+
+  bounds.clear();
+  for (size_t t = last[count]; t > 0; t = last[t])
+    bounds.push_back(t);
+  std::reverse(bounds.begin(), bounds.end());
+}
+
+// Features of cells [first, last) taken together.
+void segmentFeatures(const RegionCell *cells, size_t first, size_t last,
+                     double *features) {
+  RegionCell total;
+  for (size_t i = first; i < last; ++i)
+    addCell(total, cells[i]);
+  cellFeatures(total, features);
+}
+
+RegionKind classify(const RegionCell &total, float entropy, uint64_t size) {
+  double features[kFeatures];
+  cellFeatures(total, features);
+  if (features[1] >= 0.9 || entropy < 0.5f)
+    return RegionKind::Padding;
+  if (features[2] >= 0.9)
+    return RegionKind::Text;
+  // Zeros pass every test, so mostly-zero arrays are taken as integers
+  if (features[5] >= kKindShare)
+    return RegionKind::Int64;
+  if (features[4] >= kKindShare)
+    return RegionKind::Int32;
+  // Before the entropy test: float mantissas are near random, but random
+  // bytes pass the float tests far less often than these shares
+  double half = features[6], single = features[7], twice = features[8];
+  if (twice >= kKindShare && single <= twice - kNarrowerGap)
+    return RegionKind::Float64;
+  if (half >= kHalfShare)
+    return RegionKind::Float16;
+  if (single >= kKindShare)
+    return RegionKind::Float32;
+  // Short runs can't reach 8 bits: 1 KiB of random bytes averages 7.8
+  if (size >= 1024 && entropy >= 7.5f)
+    return RegionKind::Compressed;
+  if (features[3] >= kKindShare)
+    return RegionKind::Int16;
+  return RegionKind::Mixed;
+}
+
+} // namespace
+
+const char *regionKindName(RegionKind kind) {
+  switch (kind) {
+  case RegionKind::Header:
+    return "header";
+  case RegionKind::Padding:
+    return "padding";
+  case RegionKind::Text:
+    return "text";
+  case RegionKind::Int16:
+    return "int16";
+  case RegionKind::Int32:
+    return "int32";
+  case RegionKind::Int64:
+    return "int64";
+  case RegionKind::Float16:
+    return "float16";
+  case RegionKind::Float32:
+    return "float32";
+  case RegionKind::Float64:
+    return "float64";
+  case RegionKind::Compressed:
+    return "compressed";
+  case RegionKind::Mixed:
+    break;
+  }
+  return "mixed";
+}
+
+const char *elementTypeName(ElementType type) {
+  switch (type) {
+  case ElementType::Int16:
+    return "int16";
+  case ElementType::Int32:
+    return "int32";
+  case ElementType::Int64:
+    return "int64";
+  case ElementType::Float16:
+    return "float16";
+  case ElementType::Float32:
+    return "float32";
+  case ElementType::Float64:
+    break;
+  }
+  return "float64";
+}
+
+size_t regionCellSize(size_t size) {
+  size_t cellSize = kUnit;
+  while (ceilDiv(size, cellSize) > kMaxRegionCells &&
+         cellSize < EntropyPyramid::kHistogramBlock)
+    cellSize *= 2;
+  return cellSize;
+}
+
+void measureRegionCells(ByteView data, size_t begin, size_t end,
+                        size_t cellSize, const float *unitEntropy,
+                        const uint8_t *unitBest, RegionCell *cells) {
+  end = std::min(end, data.size());
+  const size_t kBatch = 2048; // Units per countAlignment call
+  uint8_t measured[kBatch * kUnitBestSize];
+  for (size_t batch = begin; batch < end; batch += kBatch * kUnit) {
+    size_t batchEnd = std::min(end, batch + kBatch * kUnit);
+    const uint8_t *batchBest = measured;
+    if (unitBest) {
+      batchBest = unitBest + kUnitBestSize * ((batch - begin) / kUnit);
+    } else {
+      AlignmentCounts unused;
+      countAlignment(data, batch, batchEnd, unused, measured);
+    }
+    size_t cellIndex = (batch - begin) / cellSize;
+    size_t cellEnd = begin + (cellIndex + 1) * cellSize;
+    for (size_t at = batch; at < batchEnd; at += kUnit) {
+      ByteView unit = data.subview(at, kUnit);
+      if (at >= cellEnd) {
+        cellIndex = (at - begin) / cellSize;
+        cellEnd = begin + (cellIndex + 1) * cellSize;
+      }
+      RegionCell &cell = cells[cellIndex];
+      size_t index = at / kUnit;
+      const uint8_t *best = batchBest + kUnitBestSize * ((at - batch) / kUnit);
+      cell.units += 1;
+      cell.bytes += static_cast<uint32_t>(unit.size());
+      cell.entropy +=
+          unitEntropy ? unitEntropy[index] : calculateEntropy(unit);
+      if (unit.size() == kUnit) {
+        countUnitClasses(unit.data(), cell);
+      } else {
+        // The last, partial unit: its zero padding isn't input
+        uint8_t padded[kUnit] = {};
+        std::memcpy(padded, unit.data(), unit.size());
+        countUnitClasses(padded, cell);
+        cell.zero -= static_cast<uint32_t>(kUnit - unit.size());
+      }
+      for (int w = 0; w < 3; ++w) {
+        cell.small[w] += best[w];
+        cell.floats[w] += best[3 + w];
+      }
+    }
+  }
+}
+
+void findRegions(ByteView data, const RegionCell *cells, size_t cellCount,
+                 size_t cellSize, const float *unitEntropy,
+                 AnalysisResult &result) {
+  ProfileZone zone(ProfilePhase::Regions);
+  result.regions.clear();
+  if (data.empty())
+    return;
+
+  ArenaScope scope;
+  ScratchVector<size_t> bounds(scope.resource());
+  segmentCells(cells, cellCount, bounds, scope);
+
+  // Region starts in bytes, from 0, then the input size
+  ScratchVector<uint64_t> starts(scope.resource());
+  starts.push_back(0);
+  for (size_t bound : bounds)
+    starts.push_back(uint64_t(bound) * cellSize);
+  starts.push_back(data.size());
+
+  if (cellSize > kUnit) {
+    // Move each change point to the unit within a cell of it where the
+    // units best split into the two segments' means
+    ScratchVector<RegionCell> units(2 * cellSize / kUnit, RegionCell(),
+                                    scope.resource());
+    for (size_t i = 1; i + 1 < starts.size(); ++i) {
+      uint64_t lo = std::max(starts[i] - cellSize, starts[i - 1] + kUnit);
+      uint64_t hi = std::min(starts[i] + cellSize, starts[i + 1] - kUnit);
+      if (lo >= hi)
+        continue;
+      double left[kFeatures], right[kFeatures];
+      segmentFeatures(cells, i > 1 ? bounds[i - 2] : 0, bounds[i - 1], left);
+      segmentFeatures(cells, bounds[i - 1],
+                      i < bounds.size() ? bounds[i] : cellCount, right);
+      size_t count = ceilDiv(hi - lo, kUnit);
+      std::fill(units.begin(), units.begin() + count, RegionCell());
+      measureRegionCells(data, lo, hi, kUnit, unitEntropy, nullptr,
+                         units.data());
+
+      // Error of splitting before unit u, swept from u = 0
+      double features[kFeatures];
+      double error = 0;
+      for (size_t u = 0; u < count; ++u) {
+        cellFeatures(units[u], features);
+        error += squaredDistance(features, right);
+      }
+      double minimum = error;
+      size_t split = 0;
+      for (size_t u = 0; u < count; ++u) {
+        cellFeatures(units[u], features);
+        error += squaredDistance(features, left) -
+                 squaredDistance(features, right);
+        if (error < minimum) {
+          minimum = error;
+          split = u + 1;
+        }
+      }
+      starts[i] = std::min<uint64_t>(lo + split * kUnit, hi);
+    }
+
+    // A header is smaller than a cell: segment the head by units
+    uint64_t head = std::min<uint64_t>(starts[1], kMaxHeaderSize);
+    size_t count = ceilDiv(head, kUnit);
+    ScratchVector<RegionCell> headUnits(count, RegionCell(),
+                                        scope.resource());
+    measureRegionCells(data, 0, head, kUnit, unitEntropy, nullptr,
+                       headUnits.data());
+    ScratchVector<size_t> headBounds(scope.resource());
+    segmentCells(headUnits.data(), count, headBounds, scope);
+    starts.insert(starts.begin() + 1, headBounds.size(), 0);
+    for (size_t i = 0; i < headBounds.size(); ++i)
+      starts[1 + i] = uint64_t(headBounds[i]) * kUnit;
+  }
+
+  // Statistics of every region: whole cells from the tile pass, and the
+  // partial cells at its ends measured again
+  ScratchVector<RegionCell> totals(starts.size() - 1, RegionCell(),
+                                   scope.resource());
+  for (size_t i = 0; i + 1 < starts.size(); ++i) {
+    uint64_t begin = starts[i], end = starts[i + 1];
+    uint64_t firstCell = ceilDiv(begin, cellSize);
+    uint64_t lastCell = std::max(firstCell, end / cellSize);
+    for (uint64_t c = firstCell; c < lastCell; ++c)
+      addCell(totals[i], cells[c]);
+    uint64_t innerBegin = std::min(firstCell * cellSize, end);
+    uint64_t innerEnd = std::max(lastCell * cellSize, innerBegin);
+    if (begin < innerBegin)
+      measureRegionCells(data, begin, innerBegin, innerBegin - begin,
+                         unitEntropy, nullptr, &totals[i]);
+    if (innerEnd < end)
+      measureRegionCells(data, innerEnd, end, end - innerEnd, unitEntropy,
+                         nullptr, &totals[i]);
+  }
+
+  // A change point inside a unit leaves that unit as a region of its own,
+  // unlike both sides: fold it into the one it is closer to. Regions too
+  // like the one before to tell apart are folded into it.
+  size_t kept = 0;
+  for (size_t i = 0; i + 1 < starts.size(); ++i) {
+    bool single = starts[i + 1] - starts[i] <= kUnit;
+    bool hasNext = i + 2 < starts.size();
+    if (kept > 0 && !single) {
+      double features[kFeatures], before[kFeatures];
+      cellFeatures(totals[i], features);
+      cellFeatures(totals[kept - 1], before);
+      if (featureShift(features, before) < kMinShift) {
+        addCell(totals[kept - 1], totals[i]);
+        continue;
+      }
+    }
+    if (single && kept > 0) {
+      double features[kFeatures], before[kFeatures], after[kFeatures];
+      cellFeatures(totals[i], features);
+      cellFeatures(totals[kept - 1], before);
+      if (hasNext)
+        cellFeatures(totals[i + 1], after);
+      if (!hasNext ||
+          squaredDistance(features, before) <=
+              squaredDistance(features, after)) {
+        addCell(totals[kept - 1], totals[i]);
+      } else {
+        addCell(totals[i + 1], totals[i]);
+        starts[i + 1] = starts[i];
+      }
+      continue;
+    }
+    totals[kept] = totals[i];
+    starts[kept++] = starts[i];
+  }
+  starts[kept] = data.size();
+
+  // Element type likelihoods of a region from its statistics
+  auto storeLikelihoods = [](const RegionCell &total, Region &region) {
+    double features[kFeatures];
+    cellFeatures(total, features);
+    for (int t = 0; t < kElementTypes; ++t)
+      region.likelihood[t] = static_cast<float>(features[kTypeFeature[t]]);
+  };
+
+  std::vector<Region> &regions = result.regions;
+  regions.reserve(kept);
+  RegionCell lastTotal;
+  for (size_t i = 0; i < kept; ++i) {
+    Region region;
+    region.offset = starts[i];
+    region.size = starts[i + 1] - starts[i];
+    result.entropyPyramid.rangeEntropy(data, region.offset, starts[i + 1],
+                                       region.entropy);
+    region.kind = classify(totals[i], region.entropy, region.size);
+    if (!regions.empty()) {
+      Region &last = regions.back();
+      if (last.kind == region.kind &&
+          std::fabs(last.entropy - region.entropy) < kMinEntropyShift) {
+        last.size += region.size;
+        result.entropyPyramid.rangeEntropy(data, last.offset,
+                                           last.offset + last.size,
+                                           last.entropy);
+        addCell(lastTotal, totals[i]);
+        storeLikelihoods(lastTotal, last);
+        continue;
+      }
+    }
+    lastTotal = totals[i];
+    storeLikelihoods(lastTotal, region);
+    regions.push_back(region);
+  }
+  Region &first = regions.front();
+  if (regions.size() > 1 && first.size <= kMaxHeaderSize &&
+      first.kind != RegionKind::Padding)
+    first.kind = RegionKind::Header;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "analysis.h"
+#include "byte_view.h"
+
+// Most cells a segmentation runs over. Larger inputs get larger cells, and
+// the change points are then refined to 64 bytes.
+const size_t kMaxRegionCells = size_t(1) << 15;
+
+// Statistics of a cell, a run of 64-byte units. Counts are summed over the
+// units, so cells merge by adding.
+struct RegionCell {
+  uint32_t units = 0;
+  uint32_t bytes = 0;
+  float entropy = 0;      // Sum of the units' entropies (64-byte windows)
+  uint32_t zero = 0;      // Zero bytes
+  uint32_t text = 0;       // Printable ASCII, tab, CR and LF
+  uint32_t small[3] = {};  // Small 2/4/8-byte integers, best phase per unit
+  uint32_t floats[3] = {}; // Plausible half/float32/float64, the same way
+};
+
+// Bytes per cell for an input of `size` bytes: 64 times a power of two,
+// no more than one tile, giving at most kMaxRegionCells cells below 8 GiB.
+size_t regionCellSize(size_t size);
+
+// Measures data[begin, end) into cells[0, ...), one per `cellSize` bytes;
+// `begin` is a multiple of cellSize. `unitEntropy` is the entropy of every
+// 64-byte unit of `data` (the entropy map at window and stride 64) and
+// `unitBest` the countAlignment unit counts of data[begin, end); either
+// may be null to compute them here. Tiles of the input may be measured
+// concurrently.
+void measureRegionCells(ByteView data, size_t begin, size_t end,
+                        size_t cellSize, const float *unitEntropy,
+                        const uint8_t *unitBest, RegionCell *cells);
+
+// Helper: Segment regions
+//
+// Splits the input into homogeneous regions (header, padding, text, integer
+// and float arrays, compressed data) and stores them in result.regions, so
+// a report can describe a large file in a few lines instead of its whole
+// entropy map.
+//
+// Every cell is a point of nine features: the mean entropy of its 64-byte
+// units, the shares of zero and printable bytes, and the shares of 2-, 4-
+// and 8-byte elements that pass the alignment pass's small-integer and
+// plausible-float tests. Change points are placed
+// by PELT (optimal partitioning under a penalty per region, with pruning):
+// a boundary goes where the feature means shift by more than the penalty
+// pays for. Each step costs one update per surviving candidate, and
+// candidates are capped, so the pass is linear in the number of cells.
+// With cells larger than 64 bytes, each change point is then moved to the
+// best 64-byte unit within a cell of it. Regions are named from their
+// statistics, with their exact entropy from result.entropyPyramid, which
+// must be built, and their element type likelihoods (Region::likelihood)
+// are the last six features.
+void findRegions(ByteView data, const RegionCell *cells, size_t cellCount,
+                 size_t cellSize, const float *unitEntropy,
+                 AnalysisResult &result);
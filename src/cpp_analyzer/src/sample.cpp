@@ -0,0 +1,441 @@
+#include "sample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <utility>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "alignment.h"
+#include "entropy.h"
+#include "mapped_file.h"
+#include "patterns.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Two-sided 95% quantile of the standard normal distribution.
+const double kZ95 = 1.959964;
+
+// Two-sided 95% quantiles of Student's t, for 1 to 30 degrees of freedom.
+const double kT95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+                       2.306,  2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+                       2.131,  2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+                       2.074,  2.069, 2.064, 2.060, 2.056, 2.052, 2.048,
+                       2.045,  2.042};
+
+// The t quantile for `df` degrees of freedom: the table, then the first
+// Cornish-Fisher term, within 0.1% past it.
+double t95(size_t df) {
+  const size_t tabled = sizeof kT95 / sizeof kT95[0];
+  if (df <= tabled)
+    return kT95[df - 1];
+  return kZ95 + (kZ95 * kZ95 * kZ95 + kZ95) / (4 * static_cast<double>(df));
+}
+
+// splitmix64: small, fast and the same on every platform, unlike the
+// standard distributions.
+uint64_t nextRandom(uint64_t &state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Helper: Scaled estimate
+//
+// Estimates scale * sum(values), `values` being one per sampled unit in
+// input order and `fraction` the share of the input sampled. The variance
+// comes from the spread of the values (a simple random sample) or, when
+// `stratified`, from the successive differences of neighbouring units, one
+// per stratum. Disjoint pairs of strata (collapsed strata) miss a step
+// inside one stratum whenever its block lands on its partner's side; every
+// step shows in a successive difference. Either rests on few degrees of
+// freedom, so the interval takes Student's t quantile for n - 1 of them,
+// or n / 2 with neighbours that overlap. With `events` the values count
+// occurrences, and their sum's variance is at least its Poisson variance,
+// one occurrence's when none was seen: units that agree by chance, or a
+// rare event the sample missed, don't give a point. The interval is
+// clamped to [lo, hi], and spans it when a single unit leaves the variance
+// unknown.
+Estimate estimateScaled(const std::vector<double> &values, double scale,
+                        double fraction, bool stratified, bool events,
+                        double lo, double hi) {
+  const size_t n = values.size();
+  double sum = 0;
+  for (double v : values)
+    sum += v;
+  Estimate estimate;
+  estimate.value = scale * sum;
+  if (fraction >= 1 || n == 0) {
+    estimate.low = estimate.high = estimate.value;
+    return estimate;
+  }
+  if (n < 2) {
+    estimate.low = lo;
+    estimate.high = hi;
+    return estimate;
+  }
+
+  double variance = 0;
+  if (stratified) {
+    double squares = 0;
+    for (size_t i = 0; i + 1 < n; ++i)
+      squares += (values[i + 1] - values[i]) * (values[i + 1] - values[i]);
+    variance = scale * scale * static_cast<double>(n) * squares /
+               (2 * static_cast<double>(n - 1));
+  } else {
+    double mean = sum / static_cast<double>(n);
+    double squares = 0;
+    for (double v : values)
+      squares += (v - mean) * (v - mean);
+    variance = scale * scale * static_cast<double>(n) * squares /
+               static_cast<double>(n - 1);
+  }
+  if (events)
+    variance = std::max(variance, scale * scale * std::max(sum, 1.0));
+  double quantile = t95(stratified ? n / 2 : n - 1);
+  double half = quantile * std::sqrt(variance * (1 - fraction));
+  estimate.low = std::max(lo, estimate.value - half);
+  estimate.high = std::min(hi, estimate.value + half);
+  return estimate;
+}
+
+// Helper: Share estimate
+//
+// Estimates the share of units whose `values` entry is 1, with the Wilson
+// score interval for a simple random sample of n / (1 - fraction) units
+// (the finite-population correction). Stratifying only narrows the true
+// interval, and unlike the normal approximation Wilson's never collapses
+// to a point at a share of 0 or 1, or when the strata happen to agree.
+Estimate estimateShare(const std::vector<double> &values, double fraction) {
+  const size_t n = values.size();
+  double hits = 0;
+  for (double v : values)
+    hits += v;
+  Estimate estimate;
+  estimate.value = n ? hits / static_cast<double>(n) : 0;
+  if (fraction >= 1 || n == 0) {
+    estimate.low = estimate.high = estimate.value;
+    return estimate;
+  }
+  const double p = estimate.value;
+  const double units = static_cast<double>(n) / (1 - fraction);
+  const double z2 = kZ95 * kZ95 / units;
+  const double center = (p + z2 / 2) / (1 + z2);
+  const double half =
+      kZ95 / (1 + z2) * std::sqrt(p * (1 - p) / units + z2 / (4 * units));
+  estimate.low = std::max(0.0, center - half);
+  estimate.high = std::min(1.0, center + half);
+  return estimate;
+}
+
+// Offsets of a stratified sample of `count` blocks: one per stratum, at a
+// random kSampleAlignment boundary that keeps the block inside it. A
+// stratum too narrow for that (under a block plus two boundaries) starts
+// its block at the boundary below its start.
+std::vector<uint64_t> stratifiedOffsets(uint64_t size, size_t count,
+                                        uint64_t seed) {
+  std::vector<uint64_t> offsets(count);
+  uint64_t state = seed;
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t start = size * i / count;
+    uint64_t end = size * (i + 1) / count;
+    uint64_t lo = (start + kSampleAlignment - 1) / kSampleAlignment;
+    uint64_t hi = (end - kSampleBlockSize) / kSampleAlignment;
+    uint64_t slot = start / kSampleAlignment;
+    if (lo <= hi)
+      slot = lo + nextRandom(state) % (hi - lo + 1);
+    offsets[i] = slot * kSampleAlignment;
+  }
+  return offsets;
+}
+
+// Reads `filepath` ("-" for stdin) front to back in kSampleBlockSize blocks
+// and keeps `count` of them uniformly at random: block t replaces a random
+// kept one with probability count / (t + 1). The slot is chosen before the
+// read, so a kept block is read straight into place and the rest into a
+// scratch block.
+bool reservoirSample(const std::string &filepath, size_t count, uint64_t seed,
+                     std::vector<uint8_t> &slots,
+                     std::vector<SampledBlock> &blocks, uint64_t &total) {
+  std::FILE *file = nullptr;
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> owned(nullptr, std::fclose);
+  if (filepath == "-") {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    file = stdin;
+  } else {
+    owned.reset(std::fopen(filepath.c_str(), "rb"));
+    file = owned.get();
+  }
+  if (!file) {
+    std::cerr << "Failed to open file: " << filepath << std::endl;
+    return false;
+  }
+  std::setvbuf(file, nullptr, _IONBF, 0);
+
+  ProfileZone zone(ProfilePhase::Load);
+  const size_t kNone = std::numeric_limits<size_t>::max();
+  std::vector<uint8_t> scratch(kSampleBlockSize);
+  uint64_t state = seed;
+  total = 0;
+  for (uint64_t t = 0;; ++t) {
+    size_t slot = kNone;
+    if (t < count) {
+      slot = static_cast<size_t>(t);
+      slots.resize((t + 1) * kSampleBlockSize);
+      blocks.emplace_back();
+    } else if (uint64_t j = nextRandom(state) % (t + 1); j < count) {
+      slot = static_cast<size_t>(j);
+    }
+    uint8_t *target = slot == kNone
+                          ? scratch.data()
+                          : slots.data() + slot * kSampleBlockSize;
+    size_t got = std::fread(target, 1, kSampleBlockSize, file);
+    total += got;
+    if (got > 0 && slot != kNone)
+      blocks[slot] = {t * kSampleBlockSize, got, 0.0f};
+    if (got < kSampleBlockSize) {
+      if (std::ferror(file)) {
+        std::cerr << "Read error on: " << filepath << std::endl;
+        return false;
+      }
+      // A block claimed for the read that hit the end holds nothing.
+      if (got == 0 && t < count)
+        blocks.pop_back();
+      break;
+    }
+  }
+  zone.addBytes(total);
+  return true;
+}
+
+// Moves the kept blocks into input order, end to end.
+void orderReservoir(const std::vector<uint8_t> &slots,
+                    std::vector<SampledBlock> &blocks,
+                    std::vector<uint8_t> &sample) {
+  std::vector<size_t> order(blocks.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return blocks[a].offset < blocks[b].offset;
+  });
+  std::vector<SampledBlock> sorted;
+  sorted.reserve(blocks.size());
+  for (size_t slot : order) {
+    const uint8_t *bytes = slots.data() + slot * kSampleBlockSize;
+    sample.insert(sample.end(), bytes, bytes + blocks[slot].size);
+    sorted.push_back(blocks[slot]);
+  }
+  blocks = std::move(sorted);
+}
+
+// Helper: Sample statistics
+//
+// Runs the passes over the sampled blocks laid end to end in `sample`
+// (copied there from `source`, the mapped input, first when given) and
+// scales what they count to the whole input.
+void analyzeSample(const uint8_t *source, std::vector<uint8_t> &sample,
+                   const AnalysisOptions &options, SampleSummary &summary,
+                   ThreadPool *pool) {
+  const size_t n = summary.blocks.size();
+  std::vector<size_t> starts(n);
+  size_t sampled = 0;
+  for (size_t i = 0; i < n; ++i) {
+    starts[i] = sampled;
+    sampled += summary.blocks[i].size;
+  }
+  summary.sampledBytes = sampled;
+  if (source)
+    sample.resize(sampled);
+  if (n == 0)
+    return;
+
+  // Entropy and alignment per block; reading the blocks through the
+  // mapping is part of the work, so copies run on the pool too.
+  std::vector<AlignmentCounts> counts(n);
+  auto runBlock = [&](size_t i) {
+    SampledBlock &block = summary.blocks[i];
+    uint8_t *bytes = sample.data() + starts[i];
+    if (source) {
+      ProfileZone zone(ProfilePhase::Load, block.size);
+      std::memcpy(bytes, source + block.offset, block.size);
+    }
+    ByteView view(bytes, block.size);
+    {
+      ProfileZone zone(ProfilePhase::Entropy, block.size);
+      block.entropy = calculateEntropy(view);
+    }
+    ProfileZone zone(ProfilePhase::Alignment, block.size);
+    countAlignment(view, 0, view.size(), counts[i]);
+  };
+  if (pool && n > 1) {
+    pool->parallelFor(n, runBlock);
+  } else {
+    for (size_t i = 0; i < n; ++i)
+      runBlock(i);
+  }
+
+  const double size = static_cast<double>(summary.inputSize);
+  const double fraction = static_cast<double>(sampled) / size;
+  const double scale = size / static_cast<double>(sampled);
+  const bool stratified = summary.mode == SampleMode::Stratified;
+  const double perBlock = 1.0 / static_cast<double>(n);
+
+  std::vector<double> values(n);
+  for (size_t i = 0; i < n; ++i)
+    values[i] = summary.blocks[i].entropy;
+  summary.meanEntropy = estimateScaled(values, perBlock, fraction,
+                                       stratified, false, 0.0, 8.0);
+  for (size_t i = 0; i < n; ++i)
+    values[i] = summary.blocks[i].entropy >= kHighSampleEntropy ? 1.0 : 0.0;
+  summary.highEntropyShare = estimateShare(values, fraction);
+
+  AlignmentCounts total;
+  for (const AlignmentCounts &block : counts)
+    total.merge(block);
+  for (int w = 0; w < 3; ++w) {
+    for (int p = 0; p < 8; ++p) {
+      for (int order = 0; order < 2; ++order) {
+        summary.alignment.small[w][p][order] = static_cast<size_t>(
+            std::llround(scale * total.small[w][p][order]));
+        summary.alignment.floats[w][p][order] = static_cast<size_t>(
+            std::llround(scale * total.floats[w][p][order]));
+      }
+    }
+    for (size_t i = 0; i < n; ++i)
+      values[i] = static_cast<double>(counts[i].small[w][0][0]);
+    summary.alignmentScores[w] =
+        estimateScaled(values, scale, fraction, stratified, true, 0.0, size);
+  }
+
+  // Repeated patterns, over every step-th block: the pattern pass is by far
+  // the slowest, so it sees at most kSamplePatternBytes. An n-gram spanning
+  // two blocks never occurred in the input, but it is one in tens of
+  // thousands.
+  if (options.patternTopK == 0)
+    return;
+  const size_t step =
+      std::max<size_t>(1, (sampled + kSamplePatternBytes - 1) /
+                              kSamplePatternBytes);
+  std::vector<uint8_t> subset;
+  std::vector<size_t> subsetBlocks;
+  std::vector<size_t> subsetStarts;
+  for (size_t i = step / 2; i < n; i += step) {
+    subsetBlocks.push_back(i);
+    subsetStarts.push_back(subset.size());
+    subset.insert(subset.end(), sample.begin() + starts[i],
+                  sample.begin() + starts[i] + summary.blocks[i].size);
+  }
+  const double patternFraction = static_cast<double>(subset.size()) / size;
+  const double patternScale = size / static_cast<double>(subset.size());
+
+  AnalysisResult found;
+  findPatterns(ByteView(subset.data(), subset.size()), options, found, pool);
+  summary.patternBytes = subset.size();
+  summary.recordStride = found.patterns.recordStride;
+  summary.strideVotes = found.patterns.strideVotes;
+  summary.totalVotes = found.patterns.totalVotes;
+  std::vector<double> bins(RepeatedPattern::kHistogramBins);
+  for (const RepeatedPattern &pattern : found.patterns.patterns) {
+    SampledPattern entry;
+    entry.pattern = pattern;
+    size_t k = static_cast<size_t>(
+        std::upper_bound(subsetStarts.begin(), subsetStarts.end(),
+                         pattern.firstOffset) -
+        subsetStarts.begin() - 1);
+    entry.pattern.firstOffset =
+        static_cast<size_t>(summary.blocks[subsetBlocks[k]].offset +
+                            (pattern.firstOffset - subsetStarts[k]));
+    for (int b = 0; b < RepeatedPattern::kHistogramBins; ++b)
+      bins[b] = pattern.histogram[b];
+    entry.count =
+        estimateScaled(bins, patternScale, patternFraction, false, true,
+                       static_cast<double>(pattern.count), size);
+    summary.patterns.push_back(entry);
+  }
+}
+
+} // namespace
+
+bool parseSampleMode(const std::string &name, SampleMode &mode) {
+  if (name == "stratified")
+    mode = SampleMode::Stratified;
+  else if (name == "reservoir")
+    mode = SampleMode::Reservoir;
+  else
+    return false;
+  return true;
+}
+
+const char *sampleModeName(SampleMode mode) {
+  return mode == SampleMode::Stratified ? "stratified" : "reservoir";
+}
+
+bool sampleFile(const std::string &filepath, SampleMode mode, size_t blocks,
+                uint64_t seed, const AnalysisOptions &options,
+                SampleSummary &summary, ThreadPool *pool) {
+  summary = SampleSummary();
+  summary.mode = mode;
+  summary.filename = filepath;
+  summary.seed = seed;
+
+  std::vector<uint8_t> sample;
+  MappedFile file;
+  const uint8_t *source = nullptr;
+  if (mode == SampleMode::Reservoir) {
+    std::vector<uint8_t> slots;
+    if (!reservoirSample(filepath, blocks, seed, slots, summary.blocks,
+                         summary.inputSize))
+      return false;
+    orderReservoir(slots, summary.blocks, sample);
+  } else {
+    if (filepath == "-") {
+      std::cerr << "--sample stratified needs a file; use reservoir for "
+                   "stdin"
+                << std::endl;
+      return false;
+    }
+    {
+      ProfileZone zone(ProfilePhase::Load);
+      if (!file.open(filepath)) {
+        std::cerr << "Failed to open file: " << filepath << std::endl;
+        return false;
+      }
+    }
+    ByteView data = file.view();
+    source = data.data();
+    summary.inputSize = data.size();
+    // Up to the sample's size the whole input is read, every block of it.
+    std::vector<uint64_t> offsets;
+    if (data.size() <= blocks * kSampleBlockSize) {
+      for (uint64_t offset = 0; offset < data.size();
+           offset += kSampleBlockSize)
+        offsets.push_back(offset);
+    } else {
+      offsets = stratifiedOffsets(data.size(), blocks, seed);
+    }
+    for (uint64_t offset : offsets)
+      summary.blocks.push_back(
+          {offset,
+           static_cast<size_t>(std::min<uint64_t>(kSampleBlockSize,
+                                                  data.size() - offset)),
+           0.0f});
+  }
+  summary.inputBlocks =
+      static_cast<size_t>((summary.inputSize + kSampleBlockSize - 1) /
+                          kSampleBlockSize);
+  analyzeSample(source, sample, options, summary, pool);
+  return true;
+}
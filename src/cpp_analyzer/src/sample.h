@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+
+class ThreadPool;
+
+// How --sample picks its blocks.
+//
+// - stratified: the input is cut into as many equal strata as blocks and
+//               one block is read from a random offset in each, through the
+//               mapping, so only the sampled pages are ever touched.
+// - reservoir:  the input is read once, front to back, and a uniform random
+//               set of its blocks is kept (Algorithm R). For pipes and
+//               stdin, whose size isn't known up front.
+enum class SampleMode { Stratified, Reservoir };
+
+bool parseSampleMode(const std::string &name, SampleMode &mode);
+const char *sampleModeName(SampleMode mode);
+
+// Bytes per sampled block, and blocks sampled by default: 8 MiB in all.
+const size_t kSampleBlockSize = size_t(64) << 10;
+const size_t kDefaultSampleBlocks = 128;
+// Sampled bytes the pattern pass sees at most, spread over the sample.
+const size_t kSamplePatternBytes = size_t(1) << 20;
+// Stratified blocks start on this boundary, so phases and byte order count
+// as they would over the whole file.
+const size_t kSampleAlignment = 4096;
+// Block entropy at or above which a block counts as compressed or
+// encrypted.
+const float kHighSampleEntropy = 7.5f;
+
+// An estimate with its 95% confidence interval.
+struct Estimate {
+  double value = 0;
+  double low = 0;
+  double high = 0;
+};
+
+struct SampledBlock {
+  uint64_t offset = 0; // In the input
+  size_t size = 0;     // kSampleBlockSize, less for the input's tail
+  float entropy = 0;   // Bits per byte over the block
+};
+
+// A repeated n-gram found in the sample. `pattern` is as the sample saw it
+// (count and histogram over the sampled bytes), with firstOffset mapped
+// back to the input; `count` is the occurrences expected in the whole input.
+struct SampledPattern {
+  RepeatedPattern pattern;
+  Estimate count;
+};
+
+struct SampleSummary {
+  SampleMode mode = SampleMode::Stratified;
+  std::string filename;
+  uint64_t inputSize = 0;
+  uint64_t seed = 0;
+  size_t blockSize = kSampleBlockSize;
+  size_t inputBlocks = 0;  // Blocks of blockSize the input holds
+  size_t sampledBytes = 0;
+
+  std::vector<SampledBlock> blocks; // By offset: the entropy profile
+  Estimate meanEntropy;             // Mean block entropy, bits per byte
+  Estimate highEntropyShare;        // Share of blocks >= kHighSampleEntropy
+
+  // Alignment counts scaled to the whole input, and the estimate of each
+  // width's phase-0 little-endian score (the alignmentScores of a full
+  // analysis).
+  AlignmentCounts alignment;
+  Estimate alignmentScores[3];
+
+  size_t patternBytes = 0; // Sampled bytes the patterns were counted over
+  std::vector<SampledPattern> patterns; // By length, then count descending
+  size_t recordStride = 0;              // As in PatternSummary
+  size_t strideVotes = 0;
+  size_t totalVotes = 0;
+};
+
+// Helper: Sampled analysis
+//
+// Estimates what a full analysis of `filepath` would report from `blocks`
+// blocks of kSampleBlockSize, for a first look at inputs too large to
+// analyze whole: the block entropy profile, the alignment scores and the
+// repeated patterns, each with a 95% confidence interval. The blocks run
+// through the same kernels as a full analysis (calculateEntropy,
+// countAlignment, findPatterns over the concatenated sample), split over
+// `pool`; the seed fixes which blocks are read, so a run repeats. The
+// pattern pass, much the slowest, sees an evenly spread kSamplePatternBytes
+// of the sample.
+//
+// Intervals take Student's t with a finite-population correction: from
+// the spread of the sampled blocks for a reservoir sample, and from the
+// successive differences of neighbouring strata, which err wide, for a
+// stratified one. Counts are given at least their Poisson spread, and the
+// high-entropy share a Wilson score interval, so neither collapses to a
+// point when the sampled blocks happen to agree. Pattern counts vary by
+// the sixteenths of the sample their occurrences fall in. An input no
+// larger than the sample is read whole, and its entropy and alignment are
+// exact.
+//
+// Reservoir mode reads `filepath` ("-" for stdin) like --stream does;
+// stratified mode needs a file it can map. Returns false, with the error
+// on stderr, if the input can't be read.
+bool sampleFile(const std::string &filepath, SampleMode mode, size_t blocks,
+                uint64_t seed, const AnalysisOptions &options,
+                SampleSummary &summary, ThreadPool *pool = nullptr);
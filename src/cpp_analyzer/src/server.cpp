@@ -0,0 +1,472 @@
+#include "server.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "diff.h"
+#include "thread_pool.h"
+
+namespace {
+
+using ResultPtr = std::shared_ptr<const AnalysisResult>;
+
+// Size and modification time of a regular file. Straight from stat(): a
+// std::filesystem::path would allocate its components on every request.
+bool fileStamp(const std::string &path, uint64_t &size, int64_t &mtime) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (::_stat64(path.c_str(), &st) != 0 || !(st.st_mode & _S_IFREG))
+    return false;
+  mtime = static_cast<int64_t>(st.st_mtime);
+#else
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+#ifdef __APPLE__
+  const timespec &time = st.st_mtimespec;
+#else
+  const timespec &time = st.st_mtim;
+#endif
+  mtime = static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+  size = static_cast<uint64_t>(st.st_size);
+  return true;
+}
+
+// Analysis results of recently requested files, least recently used evicted
+// first. Concurrent requests for the same file share one analysis.
+class WarmResults {
+public:
+  WarmResults(const AnalysisOptions &options, ThreadPool *pool)
+      : options_(options), pool_(pool) {}
+
+  // The result for `path`, analyzed now if it isn't warm or changed on disk
+  // since. Null if the file can't be opened. An analysis that throws
+  // throws in every request waiting on it, and isn't kept.
+  ResultPtr get(const std::string &path) {
+    uint64_t size;
+    int64_t mtime;
+    if (!fileStamp(path, size, mtime)) // Nothing to validate a result by
+      return analyze(path);
+
+    std::optional<std::promise<ResultPtr>> promise;
+    uint64_t added;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto it = entries_.find(path);
+      if (it != entries_.end() && it->second.size == size &&
+          it->second.mtime == mtime) {
+        ++hits_;
+        it->second.lastUse = ++clock_;
+        std::shared_future<ResultPtr> result = it->second.result;
+        lock.unlock();
+        return result.get();
+      }
+      ++misses_;
+      if (it == entries_.end() && entries_.size() >= kWarmResults)
+        evictOldest();
+      promise.emplace();
+      added = ++clock_;
+      entries_[path] = {size, mtime, promise->get_future().share(), added,
+                        added};
+    }
+    ResultPtr result;
+    try {
+      result = analyze(path);
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = entries_.find(path);
+      if (it != entries_.end() && it->second.added == added)
+        entries_.erase(it);
+      throw;
+    }
+    promise->set_value(result);
+    return result;
+  }
+
+  void appendStats(OutputBuffer &out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.append("warm ");
+    out.appendUnsigned(entries_.size());
+    out.append(" hits ");
+    out.appendUnsigned(hits_);
+    out.append(" misses ");
+    out.appendUnsigned(misses_);
+  }
+
+private:
+  struct Entry {
+    uint64_t size;
+    int64_t mtime;
+    std::shared_future<ResultPtr> result;
+    uint64_t lastUse;
+    uint64_t added; // Tells this entry from a later one for the same path
+  };
+
+  ResultPtr analyze(const std::string &path) {
+    auto result =
+        std::make_shared<AnalysisResult>(analyzeFile(path, options_, pool_));
+    if (!result->source.isOpen())
+      return nullptr;
+    return result;
+  }
+
+  void evictOldest() {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it)
+      if (it->second.lastUse < oldest->second.lastUse)
+        oldest = it;
+    entries_.erase(oldest);
+  }
+
+  const AnalysisOptions &options_;
+  ThreadPool *pool_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t clock_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
+
+// Reads one line without its "\n" or "\r\n". False at end of input.
+bool readLine(std::FILE *in, std::string &line) {
+  line.clear();
+  char chunk[4096];
+  while (std::fgets(chunk, sizeof chunk, in)) {
+    line += chunk;
+    if (line.back() == '\n') {
+      line.pop_back();
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      return true;
+    }
+  }
+  return !line.empty();
+}
+
+// Splits `line` at tabs into `fields`, reusing the strings already there.
+void splitFields(const std::string &line, std::vector<std::string> &fields) {
+  size_t count = 0;
+  size_t start = 0;
+  for (;;) {
+    size_t tab = line.find('\t', start);
+    size_t end = tab == std::string::npos ? line.size() : tab;
+    if (count == fields.size())
+      fields.emplace_back();
+    fields[count++].assign(line, start, end - start);
+    if (tab == std::string::npos)
+      break;
+    start = tab + 1;
+  }
+  fields.resize(count);
+}
+
+class Server {
+public:
+  Server(const AnalysisOptions &options, OutputFormat format,
+         bool entropyRows, ThreadPool *pool)
+      : format_(format), entropyRows_(entropyRows), pool_(pool),
+        warm_(options, pool) {}
+
+  // Answers the requests read from `in` on `out` until the input ends or
+  // the client quits. Returns once every answer has been written.
+  void serve(std::FILE *in, std::FILE *out) {
+    Session session(out);
+    std::unique_ptr<TaskGroup> group;
+    if (pool_)
+      group = std::make_unique<TaskGroup>(*pool_);
+    std::string line;
+    std::string finalId;
+    while (!stopping_ && readLine(in, line)) {
+      if (line.empty())
+        continue;
+      Request *request = takeRequest();
+      request->session = &session;
+      std::vector<std::string> &fields = request->fields;
+      splitFields(line, fields);
+      if (fields.size() >= 2 &&
+          (fields[1] == "quit" || fields[1] == "shutdown")) {
+        if (fields[1] == "shutdown")
+          stopping_ = true;
+        finalId = fields[0];
+        giveBack(request);
+        break;
+      }
+      // Two pointers: std::function stores them in place.
+      auto work = [this, request] { answer(request); };
+      if (group)
+        group->run(work);
+      else
+        work();
+    }
+    if (group)
+      group->wait();
+    if (!finalId.empty())
+      respond(session, finalId, true, std::string());
+  }
+
+  bool stopping() const { return stopping_; }
+
+private:
+  // One client connection's output.
+  struct Session {
+    explicit Session(std::FILE *out) : out(out) {}
+
+    std::FILE *out;
+    std::mutex writeMutex;
+  };
+
+  // A request in flight. Requests are recycled, so once the server has seen
+  // its widest burst a warm request allocates nothing.
+  struct Request {
+    Session *session = nullptr;
+    std::vector<std::string> fields;
+    std::vector<ResultPtr> results;
+    OutputBuffer payload;
+  };
+
+  Request *takeRequest() {
+    std::lock_guard<std::mutex> lock(requestsMutex_);
+    if (spare_.empty())
+      return requests_.emplace_back(std::make_unique<Request>()).get();
+    Request *request = spare_.back();
+    spare_.pop_back();
+    return request;
+  }
+
+  void giveBack(Request *request) {
+    request->results.clear();
+    request->payload.clear();
+    std::lock_guard<std::mutex> lock(requestsMutex_);
+    spare_.push_back(request);
+  }
+
+  // Every request gets its response: a request that throws (out of
+  // memory, a pool that can't start) is answered with the error, and the
+  // server goes on serving.
+  void answer(Request *request) {
+    const std::string &id = request->fields[0];
+    try {
+      bool ok = handle(*request);
+      respond(*request->session, id, ok, request->payload.data());
+    } catch (const std::bad_alloc &) {
+      respond(*request->session, id, false, "out of memory");
+    } catch (const std::exception &e) {
+      respond(*request->session, id, false, e.what());
+    } catch (...) {
+      respond(*request->session, id, false, "unknown error");
+    }
+    giveBack(request);
+  }
+
+  static void respond(Session &session, const std::string &id, bool ok,
+                      const std::string &payload) {
+    std::lock_guard<std::mutex> lock(session.writeMutex);
+    std::fprintf(session.out, "%s\t%s\t%zu\n", id.c_str(),
+                 ok ? "ok" : "error", payload.size());
+    std::fwrite(payload.data(), 1, payload.size(), session.out);
+    std::fflush(session.out);
+  }
+
+  bool handle(Request &request) {
+    const std::vector<std::string> &fields = request.fields;
+    OutputBuffer &out = request.payload;
+    if (fields.size() < 2) {
+      out.append("expected <id>\\t<command>[\\t<argument>...]");
+      return false;
+    }
+    served_.fetch_add(1);
+    const std::string &command = fields[1];
+    std::vector<ResultPtr> &results = request.results;
+    for (size_t i = 2; i < fields.size(); ++i) {
+      results.push_back(warm_.get(fields[i]));
+      if (!results.back()) {
+        out.clear();
+        out.append("Failed to open file: " + fields[i]);
+        return false;
+      }
+    }
+
+    if (command == "analyze" && results.size() == 1) {
+      writeAnalysis(*results[0], format_, out, entropyRows_);
+    } else if (command == "compare" && results.size() == 2) {
+      const AnalysisResult &a = *results[0], &b = *results[1];
+      writeAnalysis(a, format_, out, entropyRows_);
+      if (format_ != OutputFormat::Text)
+        writeAnalysis(b, format_, out);
+      DiffSummary diff = diffBytes(a.source.view(), b.source.view(), pool_);
+      writeComparison(a, b, diff, format_, out);
+      writeFields(results, out);
+    } else if (command == "fields" && results.size() >= 2) {
+      writeFields(results, out);
+    } else if (command == "stats" && results.empty()) {
+      out.append("requests ");
+      out.appendUnsigned(served_.load());
+      out.put(' ');
+      warm_.appendStats(out);
+      out.put('\n');
+    } else {
+      out.append("unknown command or wrong argument count: " + command);
+      return false;
+    }
+    return true;
+  }
+
+  void writeFields(const std::vector<ResultPtr> &results, OutputBuffer &out) {
+    std::vector<std::string> names;
+    std::vector<ByteView> views;
+    for (const ResultPtr &result : results) {
+      names.push_back(result->filename);
+      views.push_back(result->source.view());
+    }
+    writeFieldAnalysis(names, compareFields(views), format_, out);
+  }
+
+  OutputFormat format_;
+  bool entropyRows_;
+  ThreadPool *pool_;
+  WarmResults warm_;
+  std::atomic<bool> stopping_{false};
+  std::atomic<size_t> served_{0};
+  std::mutex requestsMutex_;
+  std::vector<std::unique_ptr<Request>> requests_; // Every request made
+  std::vector<Request *> spare_;                   // Those not in flight
+};
+
+#ifndef _WIN32
+// One thread per client; clients share the server's pool and warm results.
+int serveSocket(const std::string &path, Server &server) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path) {
+    std::cerr << "Socket path too long: " << path << std::endl;
+    return 1;
+  }
+  path.copy(address.sun_path, path.size());
+
+  // A socket left behind by a server that didn't exit cleanly; any other
+  // kind of file is left alone and makes bind fail.
+  struct stat existing;
+  if (::lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+    ::unlink(path.c_str());
+
+  int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 ||
+      ::bind(listener, reinterpret_cast<sockaddr *>(&address),
+             sizeof address) != 0 ||
+      ::listen(listener, 64) != 0) {
+    std::cerr << "Failed to listen on " << path << std::endl;
+    if (listener >= 0)
+      ::close(listener);
+    return 1;
+  }
+  // Writes to a client that hung up fail with EPIPE instead of killing us.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  struct Client {
+    std::thread thread;
+    std::atomic<bool> done{false};
+    int fd = -1;
+  };
+  std::list<Client> clients;
+  std::mutex clientsMutex;
+
+  while (!server.stopping()) {
+    int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      break; // The listener was shut down
+    }
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto it = clients.begin(); it != clients.end();) {
+      if (it->done) {
+        it->thread.join();
+        it = clients.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    clients.emplace_back();
+    Client &client = clients.back();
+    client.fd = fd;
+    client.thread = std::thread([&, fd] {
+      std::FILE *in = ::fdopen(fd, "r");
+      std::FILE *out = ::fdopen(::dup(fd), "w");
+      if (in && out)
+        server.serve(in, out);
+      if (server.stopping()) {
+        // Wake the accept loop and every other client's read.
+        ::shutdown(listener, SHUT_RDWR);
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (Client &other : clients)
+          if (&other != &client && other.fd >= 0)
+            ::shutdown(other.fd, SHUT_RD);
+      }
+      {
+        // Cleared before the close, so nobody shuts down a reused fd.
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        client.fd = -1;
+      }
+      if (out)
+        std::fclose(out);
+      if (in)
+        std::fclose(in);
+      else
+        ::close(fd);
+      client.done = true;
+    });
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (Client &client : clients)
+      if (client.fd >= 0)
+        ::shutdown(client.fd, SHUT_RD);
+  }
+  for (Client &client : clients)
+    client.thread.join();
+  ::close(listener);
+  ::unlink(path.c_str());
+  return 0;
+}
+#endif
+
+} // namespace
+
+int runServer(const std::string &socketPath, const AnalysisOptions &options,
+              OutputFormat format, bool entropyRows, ThreadPool *pool) {
+  Server server(options, format, entropyRows, pool);
+  if (socketPath.empty()) {
+    server.serve(stdin, stdout);
+    return 0;
+  }
+#ifndef _WIN32
+  return serveSocket(socketPath, server);
+#else
+  std::cerr << "--socket is not supported on Windows; use --serve over stdin"
+            << std::endl;
+  return 1;
+#endif
+}
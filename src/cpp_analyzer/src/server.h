@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+#include "analysis.h"
+#include "output.h"
+
+class ThreadPool;
+
+// Analysis results kept warm (mapping included) by a server.
+const size_t kWarmResults = 256;
+
+// Helper: Server mode
+//
+// Answers requests until the input ends or a client asks to shut down, so a
+// caller with many files pays for process start-up once. Requests are read
+// from stdin (answers go to stdout) or, with a `socketPath`, from any number
+// of clients of a Unix domain socket at that path.
+//
+// A request is one line of tab-separated fields: a client-chosen id (no
+// tabs or newlines), a command and its arguments.
+//
+//   <id> analyze <path>              the report of one file
+//   <id> compare <path> <path>       both reports, the diff and the fields
+//   <id> fields <path> <path> ...    the field analysis of two or more files
+//   <id> stats                       request and warm-result counters (text)
+//   <id> quit                        ends this client's session
+//   <id> shutdown                    stops the server
+//
+// Every request gets one response: a header line "<id> ok <n>" or
+// "<id> error <n>" (tab separated), then exactly n bytes of payload, the
+// report in `format` or the error message. Clients may send any number of
+// requests without waiting: they run concurrently on `pool` and are
+// answered as they finish, so responses can come back in any order.
+//
+// Results of recently requested files are kept, with their mappings, and
+// reused until the file's size or modification time changes. Text reports
+// list the entropy map row by row only with `entropyRows`.
+int runServer(const std::string &socketPath, const AnalysisOptions &options,
+              OutputFormat format, bool entropyRows, ThreadPool *pool);
@@ -0,0 +1,505 @@
+#include "signature.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <system_error>
+
+#include "entropy.h"
+#include "hash.h"
+#include "output.h"
+#include "profile.h"
+
+namespace fs = std::filesystem;
+
+// Index layout (little endian):
+//
+//   0  char[4]  magic "ANLX"
+//   4  u32      index version (kIndexVersion)
+//   8  u64      record count N
+//  16  u64      string bytes S
+//  24  u64      reserved, 0
+//  32  ...      N records of kRecordBytes:
+//                 0  u64     file size
+//                 8  u32     label offset, u32 label length (in the strings)
+//                16  u32     path offset, u32 path length
+//                24  u8[8]   magic bytes, u8 magic length, u8 layout length,
+//                            6 bytes padding
+//                40  u32[64] MinHash slots
+//               296  u8[32]  entropy profile
+//               328  u8[16]  region layout
+//   .  ...      kSignatureBands + 1 tables of N (u64 key, u64 record), each
+//               sorted by key, then record: one per band, then the magic
+//   .  u8[S]    labels and paths; equal labels share their bytes
+
+namespace {
+
+const char kIndexMagic[4] = {'A', 'N', 'L', 'X'};
+const uint32_t kIndexVersion = 1;
+const size_t kIndexHeaderBytes = 32;
+const size_t kRecordBytes = 344;
+const size_t kTableSlotBytes = 16;
+const size_t kIndexTables = kSignatureBands + 1;
+const size_t kBandSlots = kMinHashSlots / kSignatureBands;
+
+// Words of a file's first kSignatureHeaderValueBytes count by value, the
+// rest of the header by type: constants such as a version repeat across
+// files of a format, counts and payload rarely do.
+const size_t kSignatureHeaderValueBytes = 64;
+const size_t kSampleBlock = size_t(64) << 10;
+
+uint64_t readLE(const uint8_t *p, int n) {
+  uint64_t v = 0;
+  for (int i = n - 1; i >= 0; --i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+void putLE(OutputBuffer &out, uint64_t v, int n) {
+  for (int i = 0; i < n; ++i)
+    out.put(static_cast<char>(v >> (8 * i)));
+}
+
+// The murmur3 finalizer: spreads a feature over all 64 bits.
+uint64_t mix64(uint64_t z) {
+  z ^= z >> 33;
+  z *= 0xff51afd7ed558ccdULL;
+  z ^= z >> 33;
+  z *= 0xc4ceb9fe1a85ec53ULL;
+  return z ^ (z >> 33);
+}
+
+// Helper: One-permutation MinHash
+//
+// A single hash per feature: its top six bits pick the slot and the low 32
+// bits compete for the slot's minimum, so a feature costs one hash however
+// many slots there are. Slots no feature reached borrow from the next
+// filled one to the right, mixed with the distance (rotation
+// densification), so two equal sets still agree on every slot.
+class MinHasher {
+public:
+  MinHasher() { std::fill(slots_, slots_ + kMinHashSlots, kEmpty); }
+
+  void add(uint64_t feature) {
+    uint64_t h = mix64(feature);
+    size_t slot = static_cast<size_t>(h >> 58);
+    uint32_t value = static_cast<uint32_t>(h);
+    if (value < slots_[slot])
+      slots_[slot] = value;
+  }
+
+  void finish(uint32_t *out) const {
+    for (size_t s = 0; s < kMinHashSlots; ++s) {
+      out[s] = slots_[s];
+      for (size_t d = 1; out[s] == kEmpty && d < kMinHashSlots; ++d) {
+        uint32_t next = slots_[(s + d) % kMinHashSlots];
+        if (next != kEmpty)
+          out[s] = static_cast<uint32_t>(mix64(next + d));
+      }
+    }
+  }
+
+private:
+  static const uint32_t kEmpty = std::numeric_limits<uint32_t>::max();
+  uint32_t slots_[kMinHashSlots];
+};
+
+// Type of a little-endian 32-bit word: 0 zero, 1 under 256, 2 under 2^16,
+// 3 four printable ASCII bytes, 4 a float32 of everyday magnitude (2^-31 to
+// 2^33, as checkAlignment counts them), 5 under 2^24, 6 anything else.
+const uint32_t kWordClasses = 7;
+uint32_t wordClass(uint32_t v) {
+  if (v == 0)
+    return 0;
+  if (v < 0x100)
+    return 1;
+  if (v < 0x10000)
+    return 2;
+  bool text = true;
+  for (int b = 0; b < 4; ++b) {
+    uint8_t c = static_cast<uint8_t>(v >> (8 * b));
+    text = text && c >= 0x20 && c < 0x7f;
+  }
+  if (text)
+    return 3;
+  uint32_t exponent = (v >> 23) & 0xff;
+  if (exponent >= 127 - 31 && exponent <= 127 + 33)
+    return 4;
+  return v < 0x1000000 ? 5 : 6;
+}
+
+// Adds the header's features: each word's type at its offset, and the
+// value of the first words.
+void addHeaderWords(ByteView data, MinHasher &hasher) {
+  ByteView header = data.subview(0, kSignatureHeaderBytes);
+  for (size_t offset = 0; offset + 4 <= header.size(); offset += 4) {
+    uint32_t v = static_cast<uint32_t>(readLE(header.data() + offset, 4));
+    hasher.add((uint64_t(1) << 56) | (uint64_t(offset) << 8) | wordClass(v));
+    if (offset < kSignatureHeaderValueBytes)
+      hasher.add((uint64_t(4) << 56) | (uint64_t(offset) << 32) | v);
+  }
+}
+
+// Adds the types of every three consecutive aligned words, over all of
+// `data` up to kSignatureSampleBytes, else that many bytes in evenly
+// spread blocks.
+void addWordTrigrams(ByteView data, MinHasher &hasher) {
+  const uint32_t kTrigrams = kWordClasses * kWordClasses * kWordClasses;
+  bool seen[kTrigrams] = {};
+  auto scan = [&](ByteView block) {
+    uint32_t previous[2] = {0, 0};
+    for (size_t offset = 0; offset + 4 <= block.size(); offset += 4) {
+      uint32_t type =
+          wordClass(static_cast<uint32_t>(readLE(block.data() + offset, 4)));
+      uint32_t trigram =
+          (previous[0] * kWordClasses + previous[1]) * kWordClasses + type;
+      previous[0] = previous[1];
+      previous[1] = type;
+      if (offset >= 8 && !seen[trigram]) {
+        seen[trigram] = true;
+        hasher.add((uint64_t(2) << 56) | trigram);
+      }
+    }
+  };
+  if (data.size() <= kSignatureSampleBytes) {
+    scan(data);
+    return;
+  }
+  const size_t blocks = kSignatureSampleBytes / kSampleBlock;
+  for (size_t i = 0; i < blocks; ++i)
+    scan(data.subview(data.size() / blocks * i / 4 * 4, kSampleBlock));
+}
+
+// Key of `signature` in table `t`: a band of kBandSlots slots, or for the
+// last table its first four magic bytes.
+uint64_t tableKey(const Signature &signature, size_t t) {
+  uint8_t bytes[kBandSlots * 4];
+  if (t == kSignatureBands) {
+    size_t n = std::min(signature.magicLength, kSignatureMagicWord);
+    return hashBytes(ByteView(signature.magic, n), t + 1);
+  }
+  for (size_t i = 0; i < kBandSlots; ++i) {
+    uint32_t v = signature.minHash[t * kBandSlots + i];
+    for (int b = 0; b < 4; ++b)
+      bytes[4 * i + b] = static_cast<uint8_t>(v >> (8 * b));
+  }
+  return hashBytes(ByteView(bytes, sizeof bytes), t + 1);
+}
+
+// Longest common subsequence of two region layouts.
+size_t commonLayout(const uint8_t *a, size_t na, const uint8_t *b,
+                    size_t nb) {
+  size_t lengths[kSignatureLayoutKinds + 1][kSignatureLayoutKinds + 1] = {};
+  for (size_t i = 1; i <= na; ++i)
+    for (size_t j = 1; j <= nb; ++j)
+      lengths[i][j] = a[i - 1] == b[j - 1]
+                          ? lengths[i - 1][j - 1] + 1
+                          : std::max(lengths[i - 1][j], lengths[i][j - 1]);
+  return lengths[na][nb];
+}
+
+void decodeSignature(const uint8_t *p, Signature &signature) {
+  signature.size = readLE(p, 8);
+  std::memcpy(signature.magic, p + 24, kSignatureMagicBytes);
+  signature.magicLength = std::min<size_t>(p[32], kSignatureMagicBytes);
+  signature.layoutLength = std::min<size_t>(p[33], kSignatureLayoutKinds);
+  for (size_t s = 0; s < kMinHashSlots; ++s)
+    signature.minHash[s] = static_cast<uint32_t>(readLE(p + 40 + 4 * s, 4));
+  std::memcpy(signature.profile, p + 296, kSignatureProfileCells);
+  std::memcpy(signature.layout, p + 328, kSignatureLayoutKinds);
+}
+
+void encodeRecord(const Signature &signature, uint64_t label,
+                  uint64_t labelLength, uint64_t path, uint64_t pathLength,
+                  OutputBuffer &out) {
+  putLE(out, signature.size, 8);
+  putLE(out, label, 4);
+  putLE(out, labelLength, 4);
+  putLE(out, path, 4);
+  putLE(out, pathLength, 4);
+  out.append(signature.magic, kSignatureMagicBytes);
+  out.put(static_cast<char>(signature.magicLength));
+  out.put(static_cast<char>(signature.layoutLength));
+  putLE(out, 0, 6);
+  for (uint32_t v : signature.minHash)
+    putLE(out, v, 4);
+  out.append(signature.profile, kSignatureProfileCells);
+  out.append(signature.layout, kSignatureLayoutKinds);
+}
+
+} // namespace
+
+Signature computeSignature(ByteView data, const AnalysisResult &result) {
+  ProfileZone zone(ProfilePhase::Signature, data.size());
+  Signature signature;
+  signature.size = data.size();
+  signature.magicLength = std::min(data.size(), kSignatureMagicBytes);
+  if (signature.magicLength)
+    std::memcpy(signature.magic, data.data(), signature.magicLength);
+
+  MinHasher hasher;
+  addHeaderWords(data, hasher);
+  addWordTrigrams(data, hasher);
+  for (const RepeatedPattern &pattern : result.patterns.patterns)
+    hasher.add((uint64_t(3) << 56) |
+               (hashBytes(ByteView(pattern.bytes, pattern.length)) >> 8));
+  hasher.finish(signature.minHash);
+
+  for (size_t c = 0; c < kSignatureProfileCells; ++c) {
+    size_t begin = data.size() * c / kSignatureProfileCells;
+    size_t end = data.size() * (c + 1) / kSignatureProfileCells;
+    ByteView cell = data.subview(begin, std::min(end - begin, kSampleBlock));
+    if (!cell.empty())
+      signature.profile[c] = static_cast<uint8_t>(
+          std::min(15, static_cast<int>(calculateEntropy(cell) * 2.0f)));
+  }
+
+  for (const Region &region : result.regions) {
+    uint8_t kind = static_cast<uint8_t>(region.kind);
+    size_t &n = signature.layoutLength;
+    if (n > 0 && signature.layout[n - 1] == kind)
+      continue;
+    if (n == kSignatureLayoutKinds)
+      break;
+    signature.layout[n++] = kind;
+  }
+  return signature;
+}
+
+SignatureScore compareSignatures(const Signature &a, const Signature &b) {
+  SignatureScore score;
+  size_t equal = 0;
+  for (size_t s = 0; s < kMinHashSlots; ++s)
+    equal += a.minHash[s] == b.minHash[s];
+  score.minHash = static_cast<double>(equal) / kMinHashSlots;
+
+  size_t longest = std::max(a.layoutLength, b.layoutLength);
+  score.layout = longest == 0
+                     ? 1.0
+                     : static_cast<double>(commonLayout(
+                           a.layout, a.layoutLength, b.layout,
+                           b.layoutLength)) /
+                           static_cast<double>(longest);
+
+  int distance = 0;
+  for (size_t c = 0; c < kSignatureProfileCells; ++c)
+    distance += std::abs(a.profile[c] - b.profile[c]);
+  score.profile = 1.0 - distance / (15.0 * kSignatureProfileCells);
+
+  // Four equal leading bytes are as good as a whole magic number: most are
+  // 32-bit, and the words after them vary from file to file.
+  size_t magic = std::min(std::max(a.magicLength, b.magicLength),
+                          kSignatureMagicWord);
+  size_t prefix = 0;
+  while (prefix < std::min(a.magicLength, b.magicLength) &&
+         prefix < magic && a.magic[prefix] == b.magic[prefix])
+    ++prefix;
+  score.magic =
+      magic == 0 ? 1.0
+                 : static_cast<double>(prefix) / static_cast<double>(magic);
+
+  score.total = 0.35 * score.minHash + 0.15 * score.layout +
+                0.15 * score.profile + 0.35 * score.magic;
+  return score;
+}
+
+bool SignatureIndex::open(const std::string &path) {
+  path_ = path;
+  records_ = 0;
+  std::error_code ec;
+  if (!fs::exists(path, ec))
+    return true;
+  if (!file_.open(path)) {
+    std::cerr << "Failed to open index: " << path << std::endl;
+    return false;
+  }
+  ByteView data = file_.view();
+  bool valid = data.size() >= kIndexHeaderBytes &&
+               std::memcmp(data.data(), kIndexMagic, 4) == 0 &&
+               readLE(data.data() + 4, 4) == kIndexVersion;
+  uint64_t records = valid ? readLE(data.data() + 8, 8) : 0;
+  uint64_t strings = valid ? readLE(data.data() + 16, 8) : 0;
+  // Each record needs its own bytes, so a count the file can't hold is
+  // rejected before it can overflow the size below.
+  valid = valid && records <= data.size() / kRecordBytes &&
+          strings <= data.size() &&
+          data.size() == kIndexHeaderBytes +
+                             records * (kRecordBytes +
+                                        kIndexTables * kTableSlotBytes) +
+                             strings;
+  if (!valid) {
+    std::cerr << "Not a signature index: " << path << std::endl;
+    file_.close();
+    return false;
+  }
+  records_ = static_cast<size_t>(records);
+  recordData_ = data.data() + kIndexHeaderBytes;
+  tables_ = recordData_ + records_ * kRecordBytes;
+  stringBytes_ = static_cast<size_t>(strings);
+  strings_ = tables_ + kIndexTables * records_ * kTableSlotBytes;
+  return true;
+}
+
+IndexEntry SignatureIndex::entry(size_t record) const {
+  const uint8_t *p = recordData_ + record * kRecordBytes;
+  IndexEntry entry;
+  decodeSignature(p, entry.signature);
+  auto text = [&](const uint8_t *field) {
+    uint64_t offset = readLE(field, 4);
+    uint64_t length = readLE(field + 4, 4);
+    if (offset > stringBytes_ || length > stringBytes_ - offset)
+      return std::string();
+    return std::string(reinterpret_cast<const char *>(strings_ + offset),
+                       static_cast<size_t>(length));
+  };
+  entry.label = text(p + 8);
+  entry.path = text(p + 16);
+  return entry;
+}
+
+std::vector<SignatureMatch>
+SignatureIndex::query(const Signature &signature, size_t limit,
+                      size_t *candidates) const {
+  ProfileZone zone(ProfilePhase::Signature);
+  // Records sharing a key with `signature` in any table
+  std::vector<size_t> hits;
+  for (size_t t = 0; t < kIndexTables; ++t) {
+    const uint8_t *table = tables_ + t * records_ * kTableSlotBytes;
+    uint64_t key = tableKey(signature, t);
+    size_t lo = 0, hi = records_;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (readLE(table + mid * kTableSlotBytes, 8) < key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    for (; lo < records_ && readLE(table + lo * kTableSlotBytes, 8) == key;
+         ++lo) {
+      uint64_t record = readLE(table + lo * kTableSlotBytes + 8, 8);
+      if (record < records_)
+        hits.push_back(static_cast<size_t>(record));
+    }
+  }
+  std::sort(hits.begin(), hits.end());
+  hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+  if (candidates)
+    *candidates = hits.size();
+
+  // Best record per label: the rest would repeat the same format. Equal
+  // labels share their bytes, so the label offset identifies one.
+  struct Scored {
+    size_t record;
+    SignatureScore score;
+  };
+  std::map<uint64_t, Scored> best;
+  Signature other;
+  for (size_t record : hits) {
+    const uint8_t *p = recordData_ + record * kRecordBytes;
+    decodeSignature(p, other);
+    SignatureScore score = compareSignatures(signature, other);
+    auto [it, inserted] = best.try_emplace(readLE(p + 8, 4),
+                                           Scored{record, score});
+    if (!inserted && score.total > it->second.score.total)
+      it->second = Scored{record, score};
+  }
+  std::vector<Scored> ranked;
+  for (const auto &[label, scored] : best)
+    ranked.push_back(scored);
+  std::sort(ranked.begin(), ranked.end(),
+            [](const Scored &a, const Scored &b) {
+              return a.score.total != b.score.total
+                         ? a.score.total > b.score.total
+                         : a.record < b.record;
+            });
+  if (ranked.size() > limit)
+    ranked.resize(limit);
+
+  std::vector<SignatureMatch> matches;
+  for (const Scored &scored : ranked)
+    matches.push_back({entry(scored.record), scored.score});
+  return matches;
+}
+
+bool SignatureIndex::write() {
+  std::vector<IndexEntry> entries;
+  entries.reserve(size());
+  for (size_t r = 0; r < records_; ++r)
+    entries.push_back(entry(r));
+  for (const IndexEntry &added : added_)
+    entries.push_back(added);
+  file_.close();
+  records_ = 0;
+  added_.clear();
+
+  // Strings, each label once
+  std::string strings;
+  std::map<std::string, uint64_t> labels;
+  std::vector<uint64_t> labelOffsets, pathOffsets;
+  for (const IndexEntry &e : entries) {
+    auto [it, inserted] = labels.try_emplace(e.label, strings.size());
+    if (inserted)
+      strings += e.label;
+    labelOffsets.push_back(it->second);
+    pathOffsets.push_back(strings.size());
+    strings += e.path;
+  }
+
+  std::error_code ec;
+  fs::path target(path_);
+  if (target.has_parent_path())
+    fs::create_directories(target.parent_path(), ec);
+  // Unique per writer, as for cache entries: two runs may add at once, and
+  // the last rename wins.
+  static std::atomic<uint64_t> counter{0};
+  fs::path temp = target;
+  temp += ".tmp" +
+          std::to_string(static_cast<uint64_t>(
+              std::chrono::steady_clock::now().time_since_epoch().count()) ^
+                         (counter.fetch_add(1) << 48));
+  std::FILE *file = std::fopen(temp.string().c_str(), "wb");
+  if (!file) {
+    std::cerr << "Failed to write index: " << path_ << std::endl;
+    return false;
+  }
+  {
+    OutputBuffer out(file);
+    out.append(kIndexMagic, 4);
+    putLE(out, kIndexVersion, 4);
+    putLE(out, entries.size(), 8);
+    putLE(out, strings.size(), 8);
+    putLE(out, 0, 8);
+    for (size_t i = 0; i < entries.size(); ++i)
+      encodeRecord(entries[i].signature, labelOffsets[i],
+                   entries[i].label.size(), pathOffsets[i],
+                   entries[i].path.size(), out);
+    std::vector<std::pair<uint64_t, uint64_t>> table(entries.size());
+    for (size_t t = 0; t < kIndexTables; ++t) {
+      for (size_t i = 0; i < entries.size(); ++i)
+        table[i] = {tableKey(entries[i].signature, t), i};
+      std::sort(table.begin(), table.end());
+      for (const auto &[key, record] : table) {
+        putLE(out, key, 8);
+        putLE(out, record, 8);
+      }
+    }
+    out.append(strings);
+  }
+  bool written = std::ferror(file) == 0;
+  written = std::fclose(file) == 0 && written;
+  if (written)
+    fs::rename(temp, target, ec);
+  if (!written || ec) {
+    fs::remove(temp, ec);
+    std::cerr << "Failed to write index: " << path_ << std::endl;
+    return false;
+  }
+  return open(path_);
+}
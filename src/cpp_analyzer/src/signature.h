@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "analysis.h"
+#include "byte_view.h"
+#include "mapped_file.h"
+
+// Leading bytes kept as the magic number, and those compared and indexed.
+const size_t kSignatureMagicBytes = 8;
+const size_t kSignatureMagicWord = 4;
+// MinHash slots, and the LSH bands they are cut into (four slots each).
+const size_t kMinHashSlots = 64;
+const size_t kSignatureBands = 16;
+// Quantized entropy cells spread over the file, and the region kinds kept.
+const size_t kSignatureProfileCells = 32;
+const size_t kSignatureLayoutKinds = 16;
+// Bytes whose words are features by offset, and the bytes the word-type
+// trigrams read at most (spread over the file in 64 KiB blocks).
+const size_t kSignatureHeaderBytes = 256;
+const size_t kSignatureSampleBytes = size_t(4) << 20;
+// Matches reported per query.
+const size_t kMaxSignatureMatches = 8;
+
+// Compact structural description of one file, comparable across files of
+// the same format whatever their size and payload.
+struct Signature {
+  uint64_t size = 0;
+  uint8_t magic[kSignatureMagicBytes] = {}; // The file's first bytes
+  size_t magicLength = 0;
+  // One-permutation MinHash of the file's features: the type (zero, small
+  // integer, text, float, ...) of each 32-bit word of the header by offset,
+  // the values of its first words, the type trigrams of the words
+  // throughout and the repeated patterns. Equal slots estimate the sets'
+  // Jaccard index.
+  uint32_t minHash[kMinHashSlots] = {};
+  // Entropy of each of kSignatureProfileCells equal slices, in half bits
+  // per byte (0-15).
+  uint8_t profile[kSignatureProfileCells] = {};
+  // RegionKind of each region in order, runs of one kind merged.
+  uint8_t layout[kSignatureLayoutKinds] = {};
+  size_t layoutLength = 0;
+};
+
+// Similarity of two signatures, each part and the weighted total in [0, 1].
+struct SignatureScore {
+  double total = 0;
+  double minHash = 0; // Share of equal MinHash slots
+  double layout = 0;  // Longest common subsequence of the region layouts
+  double profile = 0; // 1 - mean distance of the entropy profiles
+  double magic = 0;   // Common prefix of the first four magic bytes
+};
+
+// Builds the signature of `data` from its analysis (regions and patterns).
+Signature computeSignature(ByteView data, const AnalysisResult &result);
+
+SignatureScore compareSignatures(const Signature &a, const Signature &b);
+
+// A file in the index: its signature and what it was indexed as.
+struct IndexEntry {
+  std::string label; // The format, e.g. "simplemesh"
+  std::string path;  // The file the signature came from
+  Signature signature;
+};
+
+struct SignatureMatch {
+  IndexEntry entry;
+  SignatureScore score;
+};
+
+// Helper: Signature index
+//
+// An on-disk library of known formats, queried in place. The file holds
+// fixed-size signature records and, for each LSH band (four MinHash slots
+// hashed together) and for the first four magic bytes, a table of (key,
+// record) pairs sorted by key. A query maps the file, binary-searches each
+// table for its own key and decodes and scores only the records that share
+// a key with it, so a lookup costs microseconds however many formats are
+// known. Files whose feature sets have Jaccard index J share a band with
+// probability 1 - (1 - J^4)^16: 0.98 at J = 0.6, under 0.1 at J = 0.25.
+//
+// Adding rewrites the whole file, to a temporary that is then renamed over
+// it, so readers always see a complete index.
+class SignatureIndex {
+public:
+  // Maps the index at `path`. A missing file opens as an empty index;
+  // returns false, with the error on stderr, for a file that isn't one.
+  bool open(const std::string &path);
+
+  // Entries in the file plus those added since.
+  size_t size() const { return records_ + added_.size(); }
+
+  // The best `limit` matches for `signature` among the entries in the
+  // file, best first. `candidates` receives the number scored.
+  std::vector<SignatureMatch> query(const Signature &signature, size_t limit,
+                                    size_t *candidates = nullptr) const;
+
+  void add(IndexEntry entry) { added_.push_back(std::move(entry)); }
+
+  // Writes the file's entries and the added ones, with the tables rebuilt,
+  // to the path the index was opened from. The mapping is closed first.
+  bool write();
+
+private:
+  IndexEntry entry(size_t record) const;
+
+  std::string path_;
+  MappedFile file_;
+  size_t records_ = 0;
+  const uint8_t *recordData_ = nullptr;
+  const uint8_t *tables_ = nullptr; // kSignatureBands + 1 sorted tables
+  const uint8_t *strings_ = nullptr;
+  size_t stringBytes_ = 0;
+  std::vector<IndexEntry> added_;
+};
@@ -0,0 +1,300 @@
+#include "sizes.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "hash.h"
+
+namespace {
+
+// Element sizes tried for every count: the primitive types and the small
+// structs made of them (vec3 of float, a triangle of int32, ...).
+const uint32_t kStrides[] = {1, 2, 3, 4, 6, 8, 12, 16, 20, 24, 32, 36, 48, 64};
+const size_t kStrideCount = sizeof kStrides / sizeof kStrides[0];
+
+// Most equations the first input may enter into the table. Only reached
+// with a search far past kSizeSearchBytes; later entries are dropped.
+const size_t kMaxSizeTable = size_t(1) << 21;
+
+struct Candidate {
+  uint64_t value = 0;
+  uint32_t offset = 0;
+  uint32_t width = 0;
+  bool bigEndian = false;
+
+  uint32_t end() const { return offset + width; }
+  // Term code: offset, width, byte order and stride index, never 0
+  uint64_t code(size_t stride) const {
+    uint64_t widthLog = width == 2 ? 1 : width == 4 ? 2 : 3;
+    return uint64_t(offset) << 8 | widthLog << 5 |
+           uint64_t(bigEndian) << 4 | stride;
+  }
+};
+
+CountTerm decodeTerm(uint64_t code) {
+  CountTerm term;
+  term.offset = static_cast<uint32_t>(code >> 8);
+  term.width = 1u << ((code >> 5) & 3);
+  term.bigEndian = (code >> 4) & 1;
+  term.stride = kStrides[code & 15];
+  return term;
+}
+
+// header + the terms; second is 0 for one count. Three words without
+// padding, so the key hashes as bytes.
+struct Equation {
+  uint64_t header;
+  uint64_t first;
+  uint64_t second;
+
+  bool operator==(const Equation &other) const {
+    return header == other.header && first == other.first &&
+           second == other.second;
+  }
+};
+
+struct EquationHash {
+  size_t operator()(const Equation &equation) const {
+    return static_cast<size_t>(hashBytes(
+        ByteView(reinterpret_cast<const uint8_t *>(&equation),
+                 sizeof equation)));
+  }
+};
+
+struct Votes {
+  uint32_t files = 1;
+  uint32_t lastFile = 0;
+  uint64_t counts[2] = {}; // In the first input
+  uint32_t varying = 0;    // Bit t: term t's count differs in some input
+};
+
+using EquationTable = std::unordered_map<Equation, Votes, EquationHash>;
+
+uint64_t readField(const uint8_t *p, uint32_t width, bool bigEndian) {
+  uint64_t v = 0;
+  for (uint32_t i = 0; i < width; ++i)
+    v |= uint64_t(p[bigEndian ? width - 1 - i : i]) << (8 * i);
+  return v;
+}
+
+// Helper: Collect count fields
+//
+// The aligned integers in input[0, limit) that could count elements: in
+// 1 .. size. A field is dropped if the aligned 4-byte field containing it
+// (2 bytes) or inside it (8 bytes) has the same value, and a big-endian
+// field if it reads the same as the little-endian one, so a count is one
+// candidate and not three.
+void findCandidates(ByteView input, size_t limit,
+                    std::vector<Candidate> &out) {
+  const uint8_t *data = input.data();
+  const uint64_t size = input.size();
+  out.clear();
+  for (uint32_t width = 2; width <= 8; width *= 2) {
+    for (uint32_t offset = 0; offset + width <= limit; offset += width) {
+      const uint8_t *p = data + offset;
+      for (int order = 0; order < 2; ++order) {
+        bool bigEndian = order == 1;
+        uint64_t v = readField(p, width, bigEndian);
+        if (v == 0 || v > size)
+          continue;
+        if (bigEndian && v == readField(p, width, false))
+          continue;
+        if (width == 2) {
+          uint32_t word = offset & ~3u;
+          if (word + 4 <= limit &&
+              readField(data + word, 4, bigEndian) == v)
+            continue;
+        } else if (width == 8 && (readField(p, 4, bigEndian) == v ||
+                                  readField(p + 4, 4, bigEndian) == v)) {
+          continue;
+        }
+        Candidate candidate;
+        candidate.value = v;
+        candidate.offset = offset;
+        candidate.width = width;
+        candidate.bigEndian = bigEndian;
+        out.push_back(candidate);
+      }
+    }
+  }
+}
+
+// Helper: Enumerate equations
+//
+// Calls emit(equation, countA, countB) for every equation the candidates
+// satisfy for an input of `size` bytes with a header of at most `limit`,
+// and returns the number of equations tested. One count: header = size -
+// v * s for every stride. Two counts a before b: for each b and pair of
+// strides the remainder fixes a range of values of a, found by binary
+// search in the pair candidates sorted by value.
+template <typename Emit>
+size_t forEachEquation(const std::vector<Candidate> &candidates,
+                       uint64_t size, uint64_t limit, Emit emit) {
+  size_t tested = candidates.size() * kStrideCount;
+  for (const Candidate &c : candidates) {
+    for (size_t s = 0; s < kStrideCount; ++s) {
+      uint64_t product = c.value * kStrides[s];
+      if (product > size - c.end())
+        break;
+      uint64_t header = size - product;
+      if (header <= limit)
+        emit(Equation{header, c.code(s), 0}, c.value, 0);
+    }
+  }
+
+  std::vector<const Candidate *> pair;
+  std::vector<uint32_t> ends;
+  for (const Candidate &c : candidates) {
+    if (c.end() <= kSizePairSearchBytes) {
+      pair.push_back(&c);
+      ends.push_back(c.end());
+    }
+  }
+  std::sort(pair.begin(), pair.end(),
+            [](const Candidate *x, const Candidate *y) {
+              return x->value < y->value;
+            });
+  std::sort(ends.begin(), ends.end());
+  for (const Candidate *b : pair) {
+    size_t before =
+        std::upper_bound(ends.begin(), ends.end(), b->offset) - ends.begin();
+    tested += before * kStrideCount * kStrideCount;
+    if (before == 0)
+      continue;
+    for (size_t sb = 0; sb < kStrideCount; ++sb) {
+      uint64_t productB = b->value * kStrides[sb];
+      if (productB >= size - b->end())
+        break;
+      uint64_t rest = size - productB;
+      uint64_t lowest = rest > limit ? rest - limit : 0;
+      uint64_t highest = rest - b->end();
+      for (size_t sa = 0; sa < kStrideCount; ++sa) {
+        uint64_t stride = kStrides[sa];
+        uint64_t low = std::max<uint64_t>(1, (lowest + stride - 1) / stride);
+        uint64_t high = highest / stride;
+        if (high < low)
+          continue;
+        auto it = std::lower_bound(
+            pair.begin(), pair.end(), low,
+            [](const Candidate *x, uint64_t v) { return x->value < v; });
+        for (; it != pair.end() && (*it)->value <= high; ++it) {
+          const Candidate *a = *it;
+          if (a->end() > b->offset)
+            continue;
+          emit(Equation{rest - a->value * stride, a->code(sa), b->code(sb)},
+               a->value, b->value);
+        }
+      }
+    }
+  }
+  return tested;
+}
+
+struct Ranked {
+  const Equation *equation;
+  const Votes *votes;
+  size_t constant; // Terms whose count is the same in every input
+  size_t terms;
+  uint64_t slack;
+  uint32_t widest;
+};
+
+bool betterSolution(const Ranked &x, const Ranked &y) {
+  if (x.constant != y.constant)
+    return x.constant < y.constant;
+  if (x.terms != y.terms)
+    return x.terms > y.terms;
+  if (x.slack != y.slack)
+    return x.slack < y.slack;
+  if (x.widest != y.widest)
+    return x.widest < y.widest;
+  if (x.equation->header != y.equation->header)
+    return x.equation->header < y.equation->header;
+  if (x.equation->first != y.equation->first)
+    return x.equation->first < y.equation->first;
+  return x.equation->second < y.equation->second;
+}
+
+} // namespace
+
+SizeSummary solveSizes(const std::vector<ByteView> &inputs,
+                       size_t searchBytes) {
+  SizeSummary summary;
+  summary.files = inputs.size();
+  std::vector<uint64_t> sizes;
+  for (const ByteView &input : inputs)
+    sizes.push_back(input.size());
+  std::sort(sizes.begin(), sizes.end());
+  summary.distinctSizes =
+      std::unique(sizes.begin(), sizes.end()) - sizes.begin();
+  if (summary.distinctSizes < 2)
+    return summary;
+
+  EquationTable table;
+  table.reserve(size_t(1) << 16);
+  std::vector<Candidate> candidates;
+  for (size_t f = 0; f < inputs.size(); ++f) {
+    const ByteView &input = inputs[f];
+    uint64_t limit = std::min<uint64_t>(searchBytes, input.size());
+    findCandidates(input, limit, candidates);
+    summary.fields += candidates.size();
+    uint32_t file = static_cast<uint32_t>(f);
+    auto emit = [&](const Equation &equation, uint64_t a, uint64_t b) {
+      if (file == 0) {
+        if (table.size() < kMaxSizeTable) {
+          Votes &votes = table[equation];
+          votes.counts[0] = a;
+          votes.counts[1] = b;
+        }
+        return;
+      }
+      auto it = table.find(equation);
+      if (it == table.end() || it->second.lastFile == file)
+        return;
+      Votes &votes = it->second;
+      ++votes.files;
+      votes.lastFile = file;
+      votes.varying |= (a != votes.counts[0]) | (b != votes.counts[1]) << 1;
+    };
+    summary.hypotheses +=
+        forEachEquation(candidates, input.size(), limit, emit);
+  }
+
+  std::vector<Ranked> ranked;
+  ranked.reserve(table.size());
+  for (const auto &entry : table) {
+    const Equation &equation = entry.first;
+    const Votes &votes = entry.second;
+    if (votes.files != inputs.size())
+      continue;
+    ++summary.consistent;
+    Ranked r;
+    r.equation = &equation;
+    r.votes = &votes;
+    r.terms = equation.second ? 2 : 1;
+    size_t varying = (votes.varying & 1) + (votes.varying >> 1);
+    r.constant = r.terms - varying;
+    CountTerm last = decodeTerm(equation.second ? equation.second
+                                                : equation.first);
+    r.slack = equation.header - (last.offset + last.width);
+    r.widest = decodeTerm(equation.first).stride;
+    if (equation.second)
+      r.widest = std::max(r.widest, last.stride);
+    ranked.push_back(r);
+  }
+  size_t kept = std::min(ranked.size(), kMaxSizeSolutions);
+  std::partial_sort(ranked.begin(), ranked.begin() + kept, ranked.end(),
+                    betterSolution);
+  for (size_t i = 0; i < kept; ++i) {
+    const Equation &equation = *ranked[i].equation;
+    SizeSolution solution;
+    solution.header = equation.header;
+    solution.terms = ranked[i].terms;
+    solution.counts[0] = decodeTerm(equation.first);
+    if (equation.second)
+      solution.counts[1] = decodeTerm(equation.second);
+    solution.files = ranked[i].votes->files;
+    summary.solutions.push_back(solution);
+  }
+  return summary;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_view.h"
+
+// Bytes at the start of each input searched for count fields; headers are
+// assumed to end inside them.
+const size_t kSizeSearchBytes = 4096;
+// Two-count equations only take fields from the first bytes, where format
+// headers keep their counts. All pairs of a 4 KiB search would be 10^7
+// hypotheses per stride pair.
+const size_t kSizePairSearchBytes = 256;
+// Equations kept for the report, best first.
+const size_t kMaxSizeSolutions = 16;
+
+// An integer field read as an element count, `stride` bytes per element.
+struct CountTerm {
+  uint32_t offset = 0;
+  uint32_t width = 0; // 2, 4 or 8 bytes
+  bool bigEndian = false;
+  uint32_t stride = 0;
+};
+
+// size == header + sum of count * stride over the terms, in all `files`
+// inputs.
+struct SizeSolution {
+  uint64_t header = 0;
+  size_t terms = 0; // 1 or 2, in offset order
+  CountTerm counts[2];
+  size_t files = 0;
+};
+
+struct SizeSummary {
+  size_t files = 0;
+  size_t distinctSizes = 0; // Under 2, nothing is solved
+  size_t fields = 0;     // Candidate count fields, over all inputs
+  size_t hypotheses = 0; // Equations tested, over all inputs
+  size_t consistent = 0; // Equations that hold in every input
+  std::vector<SizeSolution> solutions; // The best kMaxSizeSolutions of them
+};
+
+// Helper: Size equations
+//
+// Finds header + count * stride equations that explain the input sizes.
+// Every naturally aligned 2-, 4- and 8-byte integer in the first
+// `searchBytes` of an input, in both byte orders, that could count elements
+// of a common stride is a candidate; for one count the equation fixes the
+// header size, and for two, with both fields in the first
+// kSizePairSearchBytes, a binary search over the candidates sorted by value
+// finds the partners that leave a plausible header. The header must end
+// past the fields and inside the search. The equations of the first input
+// go into a hash table keyed by header and terms, and every other input
+// only votes for the entries it also satisfies, so N samples cost N linear
+// passes instead of an intersection of N hypothesis sets.
+//
+// Only the equations that hold in every input are solutions. Inputs that
+// all have one size can't tell them apart: each of the first input's
+// thousands of equations holds in a copy of it, so unless there are two
+// sizes nothing is solved. Solutions are ranked by the counts that
+// actually vary between the samples (a constant folds into the header),
+// the number of counts, the slack between the fields and the header end,
+// the largest stride and the header size.
+SizeSummary solveSizes(const std::vector<ByteView> &inputs,
+                       size_t searchBytes = kSizeSearchBytes);
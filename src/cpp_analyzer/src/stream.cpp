@@ -0,0 +1,69 @@
+#include "stream.h"
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "alignment.h"
+
+bool analyzeStream(const std::string &filepath, size_t blockSize,
+                   const AnalysisOptions &options,
+                   EntropyAccumulator::Sink entropySink,
+                   AnalysisResult &result) {
+  result.filename = filepath;
+  result.entropyWindow = options.entropyWindow;
+  result.entropyStride = options.entropyStride;
+
+  std::FILE *file = nullptr;
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> owned(nullptr, std::fclose);
+  if (filepath == "-") {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    file = stdin;
+  } else {
+    owned.reset(std::fopen(filepath.c_str(), "rb"));
+    file = owned.get();
+  }
+  if (!file) {
+    std::cerr << "Failed to open file: " << filepath << std::endl;
+    return false;
+  }
+  // We already read in large blocks; stdio buffering would only add a copy.
+  std::setvbuf(file, nullptr, _IONBF, 0);
+
+  EntropyAccumulator entropy(options.entropyWindow, options.entropyStride,
+                             std::move(entropySink));
+  AlignmentAccumulator alignment;
+
+  std::vector<uint8_t> block(blockSize);
+  size_t total = 0;
+  for (;;) {
+    size_t got = std::fread(block.data(), 1, block.size(), file);
+    if (got > 0) {
+      ByteView view(block.data(), got);
+      entropy.feed(view);
+      alignment.feed(view);
+      total += got;
+    }
+    if (got < block.size()) {
+      if (std::ferror(file)) {
+        std::cerr << "Read error on: " << filepath << std::endl;
+        return false;
+      }
+      break;
+    }
+  }
+
+  entropy.finish();
+  alignment.finish(result);
+  result.fileSize = total;
+  return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "analysis.h"
+#include "entropy.h"
+
+const size_t kDefaultStreamBlockSize = 1 << 20;
+
+// Helper: Streaming analysis
+//
+// Reads `filepath` ("-" for stdin) in fixed blockSize reads and feeds each
+// block to the incremental form of every pass. Nothing is mapped or retained:
+// entropy values are handed to `entropySink` as soon as their chunk is
+// complete, so peak memory is one block regardless of input size. This is the
+// mode for disk images and pipes that don't fit in RAM.
+//
+// On return `result` holds the filename, size and alignment scores;
+// result.entropyMap is left empty. Returns false if the input can't be read.
+bool analyzeStream(const std::string &filepath, size_t blockSize,
+                   const AnalysisOptions &options,
+                   EntropyAccumulator::Sink entropySink,
+                   AnalysisResult &result);
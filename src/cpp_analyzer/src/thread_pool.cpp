@@ -0,0 +1,205 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace {
+
+// Which pool and deque the current thread works from. Threads outside any
+// pool use the pool's injection queue.
+thread_local const ThreadPool *tlsPool = nullptr;
+thread_local size_t tlsQueue = 0;
+
+// How often a sleeping TaskGroup::wait looks at its deque again.
+const std::chrono::milliseconds kWaitRecheck(1);
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t workers) {
+  for (size_t i = 0; i <= workers; ++i)
+    queues_.push_back(std::make_unique<Queue>());
+  workers_.reserve(workers);
+  try {
+    for (size_t i = 0; i < workers; ++i)
+      workers_.emplace_back([this, i] { workerLoop(i); });
+  } catch (...) {
+    // A thread that can't start (std::system_error): the ones already
+    // running poll queues_, so they are joined before the members go.
+    stop();
+    throw;
+  }
+}
+
+ThreadPool::~ThreadPool() { stop(); }
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    stopping_ = true;
+  }
+  sleep_.notify_all();
+  for (std::thread &worker : workers_)
+    worker.join();
+}
+
+size_t ThreadPool::currentQueue() const {
+  return tlsPool == this ? tlsQueue : workers_.size();
+}
+
+void ThreadPool::push(Task task) {
+  Queue &queue = *queues_[currentQueue()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  pending_.fetch_add(1, std::memory_order_release);
+  {
+    // Pairs with the predicate check in workerLoop so the wakeup isn't lost.
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+  }
+  sleep_.notify_one();
+}
+
+bool ThreadPool::popOwn(TaskGroup *group, Task &task) {
+  Queue &queue = *queues_[currentQueue()];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty() || queue.tasks.back().group != group)
+    return false;
+  task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  pending_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool ThreadPool::popAny(size_t self, Task &task) {
+  Queue &queue = *queues_[self];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty())
+    return false;
+  task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  pending_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool ThreadPool::steal(size_t self, Task &task) {
+  // Start past our own deque so thieves spread over different victims.
+  for (size_t k = 1; k <= queues_.size(); ++k) {
+    Queue &queue = *queues_[(self + k) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::run(Task &task) {
+  TaskGroup *group = task.group;
+  task.fn();
+  task.fn = nullptr;
+  group->finish();
+}
+
+void ThreadPool::workerLoop(size_t index) {
+  tlsPool = this;
+  tlsQueue = index;
+  for (;;) {
+    Task task;
+    if (popAny(index, task) || steal(index, task)) {
+      run(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    sleep_.wait(lock, [&] {
+      return stopping_ || pending_.load(std::memory_order_acquire) > 0;
+    });
+    if (stopping_)
+      return;
+  }
+}
+
+void ThreadPool::TaskRing::push_back(Task task) {
+  if (size_ == slots_.size()) {
+    std::vector<Task> grown(std::max<size_t>(16, slots_.size() * 2));
+    for (size_t i = 0; i < size_; ++i)
+      grown[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+    slots_.swap(grown);
+    head_ = 0;
+  }
+  slots_[(head_ + size_) & (slots_.size() - 1)] = std::move(task);
+  ++size_;
+}
+
+void ThreadPool::parallelFor(size_t count, const void *callable,
+                             void (*call)(const void *, size_t)) {
+  if (count == 0)
+    return;
+  if (workers_.empty() || count == 1) {
+    for (size_t i = 0; i < count; ++i)
+      call(callable, i);
+    return;
+  }
+
+  // A few ranges per thread: enough slack for stealing to even out uneven
+  // tiles without paying for one task per index.
+  struct Ranges {
+    const void *callable;
+    void (*call)(const void *, size_t);
+    size_t count;
+    size_t perRange;
+  };
+  size_t ranges = std::min(count, concurrency() * 4);
+  const Ranges shared{callable, call, count, (count + ranges - 1) / ranges};
+  TaskGroup group(*this);
+  for (size_t begin = 0; begin < count; begin += shared.perRange) {
+    // Two words, small enough for std::function to store in place.
+    group.run([&shared, begin] {
+      size_t end = std::min(begin + shared.perRange, shared.count);
+      for (size_t i = begin; i < end; ++i)
+        shared.call(shared.callable, i);
+    });
+  }
+  group.wait();
+}
+
+void TaskGroup::run(std::function<void()> fn) {
+  remaining_.fetch_add(1, std::memory_order_relaxed);
+  pool_.push(ThreadPool::Task{std::move(fn), this});
+}
+
+void TaskGroup::finish() {
+  // Under the mutex, so a waiter that sees 0 can't destroy the group before
+  // the notify is done with it.
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    done_.notify_all();
+}
+
+void TaskGroup::wait() {
+  for (;;) {
+    ThreadPool::Task task;
+    while (remaining_.load(std::memory_order_acquire) > 0 &&
+           pool_.popOwn(this, task))
+      pool_.run(task);
+    // The rest run on other threads. Wake now and then all the same: threads
+    // outside the pool share the injection deque, and another one's tasks
+    // may sit on top of ours until it takes them.
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (done_.wait_for(lock, kWaitRecheck, [&] {
+          return remaining_.load(std::memory_order_acquire) == 0;
+        }))
+      return;
+  }
+}
+
+size_t resolveThreadCount(size_t requested) {
+  if (requested > 0)
+    return requested;
+  unsigned hw = std::thread::hardware_concurrency();
+  return hw > 0 ? hw : 1;
+}
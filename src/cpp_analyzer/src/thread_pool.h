@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// Work-stealing pool of worker threads.
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the back
+// (LIFO, so freshly split work stays in cache) and idle workers steal from
+// the front of the others (FIFO, so they take the oldest, largest pieces).
+// Threads outside the pool share one extra injection deque.
+//
+// Work is submitted through a TaskGroup, which is what makes nesting safe: a
+// batch of whole-file tasks can each fan out into tile tasks on the same
+// pool, and a thread waiting on a group helps by running that group's tasks.
+// The calling thread takes part in the work, so a pool built with
+// threads - 1 workers runs `threads` tasks at a time.
+class ThreadPool {
+public:
+  // Throws std::system_error, with no worker left running, if a thread
+  // can't start.
+  explicit ThreadPool(size_t workers);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of threads that execute a parallelFor, including the caller.
+  size_t concurrency() const { return workers_.size() + 1; }
+
+  // Runs fn(i) for every i in [0, count) and returns once all calls finish.
+  // Calls must not throw. May be called from inside a pool task.
+  template <typename Fn> void parallelFor(size_t count, const Fn &fn) {
+    parallelFor(count, &fn, [](const void *callable, size_t i) {
+      (*static_cast<const Fn *>(callable))(i);
+    });
+  }
+
+private:
+  friend class TaskGroup;
+
+  struct Task {
+    std::function<void()> fn;
+    TaskGroup *group;
+  };
+
+  // Double-ended queue in a growable ring. Unlike std::deque it keeps its
+  // storage when it drains, so a pool stops allocating once its queues have
+  // grown to the deepest fan-out it has seen.
+  class TaskRing {
+  public:
+    bool empty() const { return size_ == 0; }
+    Task &front() { return slots_[head_]; }
+    Task &back() { return slots_[(head_ + size_ - 1) & (slots_.size() - 1)]; }
+    void push_back(Task task);
+    void pop_front() {
+      head_ = (head_ + 1) & (slots_.size() - 1);
+      --size_;
+    }
+    void pop_back() { --size_; }
+
+  private:
+    std::vector<Task> slots_; // Power-of-two size
+    size_t head_ = 0;
+    size_t size_ = 0;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    TaskRing tasks;
+  };
+
+  // Type-erased parallelFor: the callable is passed by address, so no
+  // std::function (and no allocation) is made for it.
+  void parallelFor(size_t count, const void *callable,
+                   void (*call)(const void *, size_t));
+
+  void push(Task task);
+  // Pops the calling thread's newest task if it belongs to `group`.
+  bool popOwn(TaskGroup *group, Task &task);
+  bool popAny(size_t self, Task &task);
+  bool steal(size_t self, Task &task);
+  void run(Task &task);
+  void workerLoop(size_t index);
+  // Wakes the workers to exit and joins them.
+  void stop();
+  size_t currentQueue() const;
+
+  std::vector<std::thread> workers_;
+  // One per worker plus the shared injection queue at index workers_.size()
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+  std::atomic<size_t> pending_{0}; // Tasks queued and not yet taken
+  std::mutex sleepMutex_;
+  std::condition_variable sleep_;
+  bool stopping_ = false;
+};
+
+// A set of tasks that can be waited on together.
+//
+// wait() only runs tasks of its own group from the calling thread's deque,
+// so a waiter never gets buried under unrelated work and nesting depth stays
+// bounded by the nesting of groups. Once none is left there, the rest are
+// running (or queued) on other threads, and the waiter sleeps until the last
+// of them finishes instead of spinning on a core.
+class TaskGroup {
+public:
+  explicit TaskGroup(ThreadPool &pool) : pool_(pool) {}
+  ~TaskGroup() { wait(); }
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  void run(std::function<void()> fn);
+  void wait();
+
+private:
+  friend class ThreadPool;
+
+  // Called by the pool as each task finishes.
+  void finish();
+
+  ThreadPool &pool_;
+  std::atomic<size_t> remaining_{0};
+  std::mutex mutex_;
+  std::condition_variable done_; // remaining_ reached 0
+};
+
+// Resolves a --threads value: 0 means one per hardware thread.
+size_t resolveThreadCount(size_t requested);
@@ -0,0 +1,106 @@
+"""--cache gives the same report as a run without it: on a cold cache, on
+an unchanged file, and after the file grew or was edited in place, when
+only the changed tiles are analyzed again.
+
+  python cache_test.py <analyzer binary>
+"""
+
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+
+# Tiles of a cached analysis (BlockCache)
+TILE = 256 << 10
+
+
+def sample_bytes(rng: random.Random) -> bytes:
+    """About 3 MB in regions the report tells apart: a header, float32
+    vertices, uint32 indices, text and random bytes."""
+    parts = [b"SMSH" + struct.pack("<III", 1, 120000, 60000)]
+    parts.append(struct.pack("<%df" % 360000,
+                             *[rng.uniform(-10, 10) for _ in range(360000)]))
+    parts.append(struct.pack("<%dI" % 180000,
+                             *[rng.randrange(120000) for _ in range(180000)]))
+    words = [b"vertex", b"normal", b"face", b"count", b"mesh", b"\n"]
+    parts.append(b" ".join(rng.choice(words) for _ in range(60000)))
+    parts.append(rng.randbytes(400000))
+    return b"".join(parts)
+
+
+def run(analyzer: str, args, path: str) -> subprocess.CompletedProcess:
+    return subprocess.run([analyzer] + args + [path], check=True,
+                          capture_output=True)
+
+
+def entropy_bytes(profile: bytes) -> int:
+    """Bytes the entropy phase covered, from a --profile report."""
+    for line in profile.decode().splitlines():
+        fields = line.split()
+        if fields and fields[0] == "entropy":
+            return int(fields[3])
+    return 0
+
+
+def main() -> int:
+    analyzer = sys.argv[1]
+    failures = 0
+    rng = random.Random(3)
+    data = bytearray(sample_bytes(rng))
+
+    with tempfile.TemporaryDirectory() as work:
+        path = os.path.join(work, "sample.bin")
+        cache = os.path.join(work, "cache")
+
+        def check(step: str, incremental: bool) -> None:
+            nonlocal failures
+            with open(path, "wb") as f:
+                f.write(data)
+            # Windows of 100 bytes every 64 straddle the tile boundaries
+            for options in (["--entropy-map"], ["--format", "json"],
+                            ["--threads", "3"],
+                            ["--window", "100", "--stride", "64",
+                             "--entropy-map"]):
+                cached = run(analyzer, ["--cache", cache, "--profile"] +
+                             options, path)
+                full = run(analyzer, options, path)
+                if cached.stdout != full.stdout:
+                    print(f"{step}, {' '.join(options)}: cached report "
+                          "differs from a full analysis", file=sys.stderr)
+                    failures += 1
+                # Only the first run of a step sees the change
+                if incremental:
+                    covered = entropy_bytes(cached.stderr)
+                    if not 0 < covered < len(data):
+                        print(f"{step}: {covered} of {len(data)} bytes "
+                              "analyzed again, not just the changed tiles",
+                              file=sys.stderr)
+                        failures += 1
+                    incremental = False
+
+        check("cold cache", False)
+        check("unchanged", False)
+
+        data += rng.randbytes(100000)
+        check("appended", True)
+
+        data[300000:300016] = bytes(16)
+        check("edited", True)
+
+        # Bytes just past a tile, and across the end of one, in the
+        # vertices: the tile whose windows and elements reach them must be
+        # analyzed again
+        for offset in (3 * TILE, 5 * TILE - 4):
+            data[offset:offset + 8] = rng.randbytes(8)
+            check(f"edited at {offset}", True)
+
+        del data[-50000:]
+        check("truncated", False)
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
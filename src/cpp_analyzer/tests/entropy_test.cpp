@@ -0,0 +1,56 @@
+// Entropy of uniform data must be exactly 0, never -0.0: reports print it
+// with %.2f, and JSON would carry a negative value.
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "entropy.h"
+
+namespace {
+
+int failures = 0;
+
+void expectZero(float entropy, const char *what, size_t size) {
+  if (entropy != 0.0f || std::signbit(entropy)) {
+    std::cerr << what << " of " << size << " uniform bytes: " << entropy
+              << std::endl;
+    ++failures;
+  }
+}
+
+} // namespace
+
+int main() {
+  // Every chunk length up to the small-chunk path's limit and past it,
+  // powers of two or not
+  for (size_t size = 1; size <= 1024; ++size) {
+    std::vector<uint8_t> data(size, 0x5a);
+    expectZero(calculateEntropy(ByteView(data.data(), size)),
+               "calculateEntropy", size);
+  }
+
+  // A 700001-byte all-zero file: its last 64-byte window holds 33 bytes
+  const size_t size = 700001;
+  std::vector<uint8_t> zeros(size, 0);
+  std::vector<float> map;
+  computeEntropyMap(ByteView(zeros.data(), size), 64, 64, map);
+  for (float entropy : map)
+    expectZero(entropy, "entropy map window", size);
+
+  // Sliding windows, full and shrinking at the tail
+  SlidingEntropy sliding(100);
+  for (size_t i = 0; i < 100; ++i) {
+    sliding.push(0);
+    expectZero(sliding.entropy(), "SlidingEntropy", sliding.size());
+  }
+  for (size_t i = 0; i + 1 < 100; ++i) {
+    sliding.pop(0);
+    expectZero(sliding.entropy(), "SlidingEntropy", sliding.size());
+  }
+
+  if (failures)
+    std::cerr << failures << " failures" << std::endl;
+  return failures ? 1 : 0;
+}
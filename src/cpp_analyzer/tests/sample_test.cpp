@@ -0,0 +1,156 @@
+// Coverage of the stratified sample's 95% intervals: over many seeds, most
+// intervals must contain what the whole input gives, and none may be a
+// point that misses it.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "alignment.h"
+#include "entropy.h"
+#include "sample.h"
+
+namespace {
+
+int failures = 0;
+
+// Values a full analysis gives for what the sample estimates
+struct Truth {
+  double meanEntropy = 0;
+  double highEntropyShare = 0;
+  double alignmentScores[3] = {};
+};
+
+Truth wholeInput(const std::vector<uint8_t> &data) {
+  Truth truth;
+  size_t blocks = 0;
+  for (size_t offset = 0; offset < data.size();
+       offset += kSampleBlockSize, ++blocks) {
+    size_t size = std::min(kSampleBlockSize, data.size() - offset);
+    float entropy = calculateEntropy(ByteView(data.data() + offset, size));
+    truth.meanEntropy += entropy;
+    truth.highEntropyShare += entropy >= kHighSampleEntropy ? 1 : 0;
+  }
+  truth.meanEntropy /= static_cast<double>(blocks);
+  truth.highEntropyShare /= static_cast<double>(blocks);
+  AlignmentCounts counts;
+  countAlignment(ByteView(data.data(), data.size()), 0, data.size(), counts);
+  for (int w = 0; w < 3; ++w)
+    truth.alignmentScores[w] = static_cast<double>(counts.small[w][0][0]);
+  return truth;
+}
+
+// A SimpleMesh: float32 vertices in [-10, 10], then uint32 triangle indices
+std::vector<uint8_t> mesh(uint32_t vertices, uint32_t triangles,
+                          std::mt19937 &rng) {
+  std::vector<uint8_t> data(16 + (size_t(vertices) + triangles) * 12);
+  uint32_t header[4] = {0x48534d53, 1, vertices, triangles};
+  std::memcpy(data.data(), header, sizeof header);
+  std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+  size_t at = 16;
+  for (size_t i = 0; i < size_t(vertices) * 3; ++i, at += 4) {
+    float v = coordinate(rng);
+    std::memcpy(&data[at], &v, 4);
+  }
+  for (size_t i = 0; i < size_t(triangles) * 3; ++i, at += 4) {
+    uint32_t v = rng() % vertices;
+    std::memcpy(&data[at], &v, 4);
+  }
+  return data;
+}
+
+// Runs of small uint32 records with random-byte runs (compressed
+// payloads) covering about a tenth of the input between them
+std::vector<uint8_t> patched(size_t size, std::mt19937 &rng) {
+  std::vector<uint8_t> data(size);
+  size_t at = 0;
+  while (at < size) {
+    size_t run = std::min(size - at, size_t(24 + rng() % 200) << 10);
+    bool random = rng() % 10 == 0;
+    for (size_t i = at; i + 4 <= at + run; i += 4) {
+      uint32_t v = random ? static_cast<uint32_t>(rng()) : rng() % 5000;
+      std::memcpy(&data[i], &v, 4);
+    }
+    at += run;
+  }
+  return data;
+}
+
+// Within is the share of seeds whose interval holds the truth; a point
+// interval off the truth is always a failure.
+struct Coverage {
+  const char *name;
+  size_t within = 0;
+  size_t points = 0;
+
+  void add(const Estimate &estimate, double truth) {
+    double slack = 1e-9 * (1 + truth);
+    bool inside =
+        estimate.low - slack <= truth && truth <= estimate.high + slack;
+    within += inside;
+    points += !inside && estimate.low == estimate.high;
+  }
+};
+
+void checkCoverage(const char *input, const std::vector<uint8_t> &data,
+                   size_t blocks, size_t seeds) {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "analyzer_sample_test.bin")
+          .string();
+  {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    std::fwrite(data.data(), 1, data.size(), file);
+    std::fclose(file);
+  }
+  const Truth truth = wholeInput(data);
+  AnalysisOptions options;
+  options.patternTopK = 0;
+  Coverage coverage[] = {{"mean entropy"},
+                         {"high-entropy share"},
+                         {"alignment 2"},
+                         {"alignment 4"},
+                         {"alignment 8"}};
+  for (uint64_t seed = 0; seed < seeds; ++seed) {
+    SampleSummary summary;
+    if (!sampleFile(path, SampleMode::Stratified, blocks, seed, options,
+                    summary)) {
+      ++failures;
+      break;
+    }
+    coverage[0].add(summary.meanEntropy, truth.meanEntropy);
+    coverage[1].add(summary.highEntropyShare, truth.highEntropyShare);
+    for (int w = 0; w < 3; ++w)
+      coverage[2 + w].add(summary.alignmentScores[w],
+                          truth.alignmentScores[w]);
+  }
+  std::remove(path.c_str());
+
+  for (const Coverage &c : coverage) {
+    // 95% intervals; a few seeds more may miss, over a handful of strata
+    if (c.within < seeds * 85 / 100 || c.points > 0) {
+      std::cerr << input << ", " << blocks << " blocks, " << c.name << ": "
+                << c.within << " of " << seeds << " intervals hold it, "
+                << c.points << " points miss it" << std::endl;
+      ++failures;
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(11);
+  const size_t kSeeds = 200;
+  std::vector<uint8_t> smsh = mesh(120000, 240000, rng);
+  std::vector<uint8_t> mixed = patched(size_t(4) << 20, rng);
+  for (size_t blocks : {10, 32}) {
+    checkCoverage("mesh", smsh, blocks, kSeeds);
+    checkCoverage("patched", mixed, blocks, kSeeds);
+  }
+  return failures ? 1 : 0;
+}
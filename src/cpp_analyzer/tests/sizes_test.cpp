@@ -0,0 +1,80 @@
+// Size equations: every solution holds in every input, the SimpleMesh
+// layout is found, and inputs that all have one size solve nothing.
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "sizes.h"
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << what << std::endl;
+    ++failures;
+  }
+}
+
+// "SMSH", version, vertex and triangle counts, then 12-byte vertices and
+// 12-byte triangles of random bytes
+std::vector<uint8_t> simpleMesh(uint32_t vertices, uint32_t triangles,
+                                std::mt19937 &rng) {
+  std::vector<uint8_t> data(16 + (vertices + triangles) * 12);
+  for (uint8_t &b : data)
+    b = static_cast<uint8_t>(rng());
+  uint32_t header[4] = {0x48534d53, 1, vertices, triangles};
+  std::memcpy(data.data(), header, sizeof header);
+  return data;
+}
+
+std::vector<ByteView> views(const std::vector<std::vector<uint8_t>> &files) {
+  std::vector<ByteView> out;
+  for (const auto &file : files)
+    out.emplace_back(file.data(), file.size());
+  return out;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(7);
+  std::vector<std::vector<uint8_t>> meshes;
+  for (uint32_t i = 0; i < 6; ++i)
+    meshes.push_back(simpleMesh(100 + 37 * i, 50 + 91 * i, rng));
+  SizeSummary summary = solveSizes(views(meshes));
+  expect(summary.distinctSizes == meshes.size(), "distinct mesh sizes");
+  expect(summary.consistent == summary.solutions.size(),
+         "solutions other than the consistent equations");
+  for (const SizeSolution &solution : summary.solutions)
+    expect(solution.files == meshes.size(), "solution misses an input");
+  bool found = false;
+  for (const SizeSolution &solution : summary.solutions)
+    found |= solution.header == 16 && solution.terms == 2 &&
+             solution.counts[0].offset == 8 &&
+             solution.counts[1].offset == 12 &&
+             solution.counts[0].stride == 12 &&
+             solution.counts[1].stride == 12;
+  expect(found, "16 + u32le@8 * 12 + u32le@12 * 12 not found");
+
+  // Two copies of one file: every equation of the first holds in the
+  // second, so none can be told apart
+  std::vector<std::vector<uint8_t>> copies(2, meshes[3]);
+  SizeSummary same = solveSizes(views(copies));
+  expect(same.distinctSizes == 1, "distinct sizes of copies");
+  expect(same.consistent == 0 && same.solutions.empty(),
+         "copies of one file solved");
+
+  // Two sizes among the copies are enough to solve again
+  copies.push_back(meshes[4]);
+  SizeSummary mixed = solveSizes(views(copies));
+  expect(mixed.distinctSizes == 2, "distinct sizes of copies and a mesh");
+  expect(!mixed.solutions.empty(), "copies and a mesh not solved");
+  for (const SizeSolution &solution : mixed.solutions)
+    expect(solution.files == copies.size(), "solution misses an input");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+"""AnalyzerWrapper.analyze_structured (--format bin, or the library when
+it's loaded) gives the same record fields as --format json.
+
+  python structured_test.py <analyzer binary>
+"""
+
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import types
+
+SRC_DIR = os.path.dirname(os.path.dirname(os.path.dirname(
+    os.path.abspath(__file__))))
+sys.path.append(SRC_DIR)
+# Imported from the source tree; ctest shouldn't write bytecode into it
+sys.dont_write_bytecode = True
+
+# agent.py imports the LLM client at the top; the analyzer wrappers don't
+# use it
+for name in ("google", "google.generativeai", "dotenv"):
+    sys.modules.setdefault(name, types.ModuleType(name))
+sys.modules["google"].generativeai = sys.modules["google.generativeai"]
+sys.modules["dotenv"].load_dotenv = lambda: None
+
+from agent.agent import AnalyzerLibrary, AnalyzerWrapper
+from generator.generate_simplemesh import generate_simplemesh
+
+
+def main() -> int:
+    analyzer = sys.argv[1]
+    failures = 0
+    with tempfile.TemporaryDirectory() as directory:
+        paths = []
+        for i, (vertices, triangles) in enumerate(((50, 30), (1000, 500))):
+            path = os.path.join(directory, f"mesh_{i}.smsh")
+            generate_simplemesh(path, vertices, triangles,
+                                random.Random(i))
+            paths.append(path)
+
+        wrappers = {"bin": AnalyzerWrapper(analyzer)}
+        library = AnalyzerLibrary.find(analyzer)
+        if library:
+            wrappers["library"] = AnalyzerWrapper(analyzer, library=library)
+        for source, wrapper in wrappers.items():
+            records = wrapper.analyze_structured(paths)
+            for path in paths:
+                expected = json.loads(subprocess.run(
+                    [analyzer, "--format", "json", path], check=True,
+                    capture_output=True, text=True).stdout)
+                record = records[path]
+                checks = {
+                    "entropy.window": (record["entropy"]["window"],
+                                       expected["entropy"]["window"]),
+                    "entropy.stride": (record["entropy"]["stride"],
+                                       expected["entropy"]["stride"]),
+                    "entropy values": (len(record["entropy"]["values"]),
+                                       len(expected["entropy"]["values"])),
+                    "patterns.recordStride": (
+                        record["patterns"]["recordStride"],
+                        expected["patterns"]["recordStride"]),
+                    "size": (record["size"], expected["size"]),
+                }
+                for what, (got, want) in checks.items():
+                    if got != want:
+                        print(f"{source} {os.path.basename(path)}: {what} "
+                              f"is {got}, --format json has {want}")
+                        failures += 1
+    if failures:
+        print(f"{failures} failures")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,85 @@
+// Nested TaskGroups finish, and every task runs once, whether waiters run
+// their own tasks, sleep while workers run them, or share the injection
+// deque with other threads outside the pool; a pool whose threads can't
+// all start throws instead of hanging or terminating.
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "thread_pool.h"
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAILED: " << what << std::endl;
+    ++failures;
+  }
+}
+
+// Batch-like: outer tasks that each fan out a parallelFor.
+size_t nestedSum(ThreadPool &pool, size_t outer, size_t inner) {
+  std::atomic<size_t> sum{0};
+  TaskGroup group(pool);
+  for (size_t i = 0; i < outer; ++i)
+    group.run([&] {
+      pool.parallelFor(inner, [&](size_t) {
+        sum.fetch_add(1, std::memory_order_relaxed);
+      });
+    });
+  group.wait();
+  return sum.load();
+}
+
+} // namespace
+
+int main() {
+  for (size_t workers : {0, 1, 3}) {
+    ThreadPool pool(workers);
+    expect(nestedSum(pool, 64, 100) == 6400, "nested groups");
+
+    // Several threads outside the pool submitting at once, as in --serve:
+    // they share the injection deque
+    std::vector<size_t> sums(4);
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < sums.size(); ++c)
+      clients.emplace_back([&, c] { sums[c] = nestedSum(pool, 16, 50); });
+    for (std::thread &client : clients)
+      client.join();
+    for (size_t sum : sums)
+      expect(sum == 800, "groups from threads outside the pool");
+  }
+
+#ifdef __linux__
+  // An address space too small for 3000 thread stacks: the spawn loop fails
+  // partway, with workers already running
+  rlimit limit;
+  if (getrlimit(RLIMIT_AS, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY) {
+    rlimit tight = limit;
+    tight.rlim_cur = rlim_t(1) << 30;
+    setrlimit(RLIMIT_AS, &tight);
+    bool threw = false;
+    try {
+      ThreadPool pool(3000);
+    } catch (const std::exception &) {
+      threw = true;
+    }
+    setrlimit(RLIMIT_AS, &limit);
+    expect(threw, "pool whose threads can't start");
+    ThreadPool pool(2);
+    expect(nestedSum(pool, 8, 10) == 80, "pool after a failed start");
+  }
+#endif
+
+  if (failures)
+    std::cerr << failures << " failures" << std::endl;
+  return failures ? 1 : 0;
+}
@@ -2,7 +2,26 @@ import struct
 import random
 import os
 
-def generate_simplemesh(filename, vertex_count, triangle_count):
+# Elements packed per write
+BLOCK_ELEMENTS = 1 << 16
+
+def _write_blocks(f, count, pack, rng, tile):
+    """Writes `count` elements, pack(n) giving n of them. With tile, blocks
+    after the first `tile` reuse those in an order drawn from rng."""
+    blocks = []
+    while count > 0:
+        n = min(count, BLOCK_ELEMENTS)
+        if tile and len(blocks) == tile and n == BLOCK_ELEMENTS:
+            f.write(blocks[rng.randrange(tile)])
+        else:
+            block = pack(n)
+            if tile and len(blocks) < tile:
+                blocks.append(block)
+            f.write(block)
+        count -= n
+
+def generate_simplemesh(filename, vertex_count, triangle_count, rng=random,
+                        tile=0):
     """
     Generates a SimpleMesh v1.0 binary file.
     
@@ -13,6 +32,10 @@ def generate_simplemesh(filename, vertex_count, triangle_count):
     [12-15] TriangleCount: uint32
     [16+]   Vertices: VertexCount * 12 bytes (3x float32)
     [?+]    Triangles: TriangleCount * 12 bytes (3x uint32)
+
+    Values are drawn from rng (default: the random module). With tile, only
+    the first `tile` blocks of each section are drawn and the rest repeat
+    them, for files too large to generate value by value.
     """
     
     magic = b'SMSH'
@@ -26,18 +49,15 @@ def generate_simplemesh(filename, vertex_count, triangle_count):
         f.write(struct.pack('<I', triangle_count))
         
         # Vertices
-        for _ in range(vertex_count):
-            x = random.uniform(-10.0, 10.0)
-            y = random.uniform(-10.0, 10.0)
-            z = random.uniform(-10.0, 10.0)
-            f.write(struct.pack('<fff', x, y, z))
+        _write_blocks(f, vertex_count, lambda n: struct.pack(
+            '<%df' % (3 * n), *[rng.uniform(-10.0, 10.0) for _ in range(3 * n)]),
+            rng, tile)
             
         # Triangles
-        for _ in range(triangle_count):
-            v0 = random.randint(0, vertex_count - 1)
-            v1 = random.randint(0, vertex_count - 1)
-            v2 = random.randint(0, vertex_count - 1)
-            f.write(struct.pack('<III', v0, v1, v2))
+        _write_blocks(f, triangle_count, lambda n: struct.pack(
+            '<%dI' % (3 * n),
+            *[rng.randint(0, vertex_count - 1) for _ in range(3 * n)]),
+            rng, tile)
 
 def main():
     # Output to data directory relative to this script
@@ -2,7 +2,7 @@ import struct
 import random
 import os
 import json
-from typing import List, Dict, Any
+from typing import List, Dict, Any, Optional
 
 class RandomFormatGenerator:
     def __init__(self, output_dir: str):
@@ -62,15 +62,18 @@ class RandomFormatGenerator:
             
         return spec
 
-    def _write_file(self, filepath: str, spec: Dict):
+    def _write_file(self, filepath: str, spec: Dict,
+                    counts: Optional[Dict[str, int]] = None,
+                    rng=random, tile: int = 0):
+        """Writes one file of `spec`. counts gives each count field's value
+        (default: 5 to 50 elements per array); rng and tile are as for
+        write_elements."""
         with open(filepath, "wb") as f:
-            # Track values for arrays
-            counts = {}
-            
             # Decide counts first
-            for arr in spec["arrays"]:
-                count = random.randint(5, 50)
-                counts[arr["count_field"]] = count
+            if counts is None:
+                counts = {}
+                for arr in spec["arrays"]:
+                    counts[arr["count_field"]] = rng.randint(5, 50)
                 
             # Write Header
             for field in spec["header"]:
@@ -79,8 +82,8 @@ class RandomFormatGenerator:
                     # It's a count field
                     val = counts[field["name"]]
                 elif field["value"] == "random":
-                    if field["type"] == "float": val = random.random()
-                    else: val = random.randint(0, 100)
+                    if field["type"] == "float": val = rng.random()
+                    else: val = rng.randint(0, 100)
                 else:
                     val = field["value"]
                 
@@ -90,14 +93,57 @@ class RandomFormatGenerator:
                 
             # Write Arrays
             for arr in spec["arrays"]:
-                count = counts[arr["count_field"]]
-                for _ in range(count):
-                    if arr["type"] == "float3":
-                        f.write(struct.pack('<fff', random.random(), random.random(), random.random()))
-                    elif arr["type"] == "uint32":
-                        f.write(struct.pack('<I', random.randint(0, 1000)))
-                    elif arr["type"] == "float":
-                        f.write(struct.pack('<f', random.random()))
+                write_elements(f, arr["type"], counts[arr["count_field"]],
+                               rng, tile)
+
+    def write_sized_file(self, filepath: str, spec: Dict, size: int,
+                         rng=random,
+                         tile: int = 0) -> Dict[str, int]:
+        """Writes a file of `spec` of about `size` bytes (at least the
+        header), its arrays sharing the payload evenly. Returns the counts."""
+        header = sum(FIELD_SIZES[field["type"]] for field in spec["header"])
+        payload = max(0, size - header) // len(spec["arrays"])
+        counts = {arr["count_field"]: payload // ELEMENT_SIZES[arr["type"]]
+                  for arr in spec["arrays"]}
+        self._write_file(filepath, spec, counts, rng, tile)
+        return counts
+
+
+FIELD_SIZES = {"uint32": 4, "uint16": 2, "float": 4}
+ELEMENT_SIZES = {"float3": 12, "uint32": 4, "float": 4}
+
+# Elements packed per write
+BLOCK_ELEMENTS = 1 << 16
+
+
+def _pack_elements(element_type: str, count: int, rng: random.Random) -> bytes:
+    if element_type == "float3":
+        return struct.pack('<%df' % (3 * count),
+                           *[rng.random() for _ in range(3 * count)])
+    if element_type == "uint32":
+        return struct.pack('<%dI' % count,
+                           *[rng.randint(0, 1000) for _ in range(count)])
+    return struct.pack('<%df' % count, *[rng.random() for _ in range(count)])
+
+
+def write_elements(f, element_type: str, count: int,
+                   rng=random, tile: int = 0):
+    """Writes `count` array elements of element_type drawn from rng, in
+    blocks of BLOCK_ELEMENTS. With tile, only the first `tile` blocks are
+    drawn and later ones repeat them in an order drawn from rng: Python packs
+    about 10 MB/s, too slow for multi-GB files, and the repeats are far
+    apart."""
+    blocks = []
+    while count > 0:
+        n = min(count, BLOCK_ELEMENTS)
+        if tile and len(blocks) == tile and n == BLOCK_ELEMENTS:
+            f.write(blocks[rng.randrange(tile)])
+        else:
+            block = _pack_elements(element_type, n, rng)
+            if tile and len(blocks) < tile:
+                blocks.append(block)
+            f.write(block)
+        count -= n
 
 def main():
     # Test